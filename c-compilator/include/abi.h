@@ -0,0 +1,55 @@
+#ifndef X_INCLUDE_ABI
+#define X_INCLUDE_ABI
+
+#include "..\include\symbol.h"
+#include "..\include\type.h"
+#include "..\include\arch.h"
+#include "..\include\register.h"
+
+//соглашение о вызовах: классификация аргументов SysV AMD64 и Win64,
+//размещение в регистрах и в выровненной области стека
+
+typedef enum ABI_CLASS {
+    ABI_NONE,       //восьмерка без данных
+    ABI_INTEGER,    //целочисленный регистр
+    ABI_SSE,        //XMM регистр
+    ABI_MEMORY      //весь аргумент в стеке
+} ABI_CLASS;
+
+enum {
+    ABI_Eightbytes = 2  //SysV: в регистрах передаются записи до 16 байт
+};
+
+//размещение одного аргумента или возвращаемого значения
+typedef struct AbiArg {
+    int size;
+    ABI_CLASS classes[ABI_Eightbytes];
+    REG_INDEX regs[ABI_Eightbytes];     //целочисленные регистры восьмерок
+    int xmms[ABI_Eightbytes];           //номера XMM регистров, -1 - нет
+    int eightbytes;                     //число восьмерок в регистрах, 0 - в стеке
+    int byRef;      //Win64: передается указатель на копию
+    int offset;     //смещение в области аргументов, -1 - только в регистрах
+    int copy;       //Win64: смещение копии для byRef
+    int home;       //в вызываемой: смещение от базы кадра, см. AbiParams
+} AbiArg;
+
+//размещение всех аргументов вызова или параметров функции
+typedef struct AbiCall {
+    AbiArg* args;
+    int n;
+
+    AbiArg ret;             //ABI_MEMORY - через скрытый указатель
+    REG_INDEX retPtr;       //регистр скрытого указателя
+    int retOffset;          //или его смещение в стеке, -1 - нет
+    int retHome;            //в вызываемой: смещение скрытого указателя от базы кадра
+
+    int stackSize;          //область аргументов с теневой и выравниванием
+    int sseUsed;            //SysV: число XMM регистров, в al для вариативных
+} AbiCall;
+
+void AbiCallInit (AbiCall* call, const Arch* arch, const Type* fn, const Type** argTypes, int n);
+void AbiCallFree (AbiCall* call);
+
+int AbiParams (const Arch* arch, Symbol* Fn, AbiCall* call);
+int AbiFrameSize (const Arch* arch, int localSize);
+#endif /*X_INCLUDE_ABI*/
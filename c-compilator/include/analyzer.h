@@ -0,0 +1,58 @@
+#ifndef X_INCLUDE_ANALYZER
+#define X_INCLUDE_ANALYZER
+
+#include "..\include\ast.h"
+#include "..\include\arch.h"
+#include "..\include\parser.h"
+#include "..\include\incremental.h"
+
+//роль узла в обходе: от нее зависит, каких детей посетить и что
+//вычислить на выходе из узла
+typedef enum ANALYZER_ROLE {
+    ANALYZER_STMT,
+    ANALYZER_VALUE,
+    ANALYZER_INIT,          //значение, ожидаемый тип - у декларатора или типа в l родителя
+    ANALYZER_BASIC,         //спецификатор типа
+    ANALYZER_TYPE,          //имя типа: приведение, sizeof, составной литерал
+    ANALYZER_DECLARATOR,    //корень декларатора; у родителя в l - спецификатор
+    ANALYZER_DECLINIT,      //декларатор с инициализатором
+    ANALYZER_PARAM,
+    ANALYZER_ENUMCONST,
+    ANALYZER_DESIGNATOR
+} ANALYZER_ROLE;
+
+typedef struct AnalyzerFrame {
+    Ast* node;
+    Ast* parent;
+    const Type* target;     //ожидаемый тип инициализатора
+    ANALYZER_ROLE role;
+    int entered;            //дети уже в стеке
+    int skip;               //тип узла уже известен
+} AnalyzerFrame;
+
+//обход без рекурсии: стек кадров, узел обрабатывается после всех детей
+typedef struct AnalyzerCTX {
+    const Arch* arch;
+    Symbol* module;
+
+    /*встроенные типы для литералов, sizeof и разности указателей*/
+    const Symbol* intType;
+    const Symbol* charType;
+    const Symbol* sizeType;
+    const Symbol* ptrdiffType;
+
+    const Symbol* fn;       //функция, тело которой обходится
+    ParserResult* parsed;   //тела, отложенные ParserLazy, разбираются при обходе
+    IncrCTX* incr;          //с -fincremental: тела неизменных функций пропускаются, иначе 0
+
+    AnalyzerFrame* stack;
+    int depth;
+    int capacity;
+
+    int errors;
+    int warnings;
+} AnalyzerCTX;
+
+int Analyzer (ParserResult* parsed, Symbol* Global, const Arch* arch, IncrCTX* incr);
+int AnalyzerConstValue (const Arch* arch, const Ast* Node, long* value);
+#endif /*X_INCLUDE_ANALYZER*/
@@ -11,11 +11,35 @@ typedef enum OS_TAG {
     OS_WINDOWS
 } OS_TAG;
 
+//возможности процессора сверх базового x86-64 с SSE2
+typedef enum ARCH_FEATURE {
+    ARCH_SSE42 = 1 << 0,    //вместе с SSE4.1: pmulld, pminsd, pmaxsd
+    ARCH_POPCNT = 1 << 1,
+    ARCH_LZCNT = 1 << 2,
+    ARCH_BMI1 = 1 << 3,     //andn, tzcnt
+    ARCH_BMI2 = 1 << 4,     //shlx, sarx - сдвиг без CL
+    ARCH_MOVBE = 1 << 5,
+    ARCH_AVX2 = 1 << 6      //VEX формы и 32-байтные целые векторы
+} ARCH_FEATURE;
+
 typedef struct Arch {
     int wordsize;           //размер слова - зависит от архитектуры
+    OS_TAG os;              //соглашение о вызовах: SysV или Win64
     
     Vector scratchRegs;
     Vector calleeSaveRegs;  //список регистров для сохранения
+    Vector calleeSaveXmms;  //Win64: XMM6-15 сохраняются вызываемой
+    Vector argRegs;         //целочисленные регистры аргументов по порядку
+
+    int sseArgRegs;         //число XMM регистров для аргументов
+    int shadowSpace;        //Win64: место для 4 регистров аргументов у вызывающего
+    int stackAlign;         //выравнивание стека в точке вызова
+
+    int vectorSize;         //ширина блочных пересылок: 16 - SSE2, 32 - AVX
+    int blockInline;        //блоки до стольких байт - пересылками подряд
+    int blockLoop;          //до стольких - развернутым циклом, больше - строковыми командами
+    int fastStrings;        //ERMS: rep movsb/stosb, иначе вызов memcpy/memset
+    int features;           //ARCH_FEATURE: -march, -m<возможность> или cpuid
     
     char *asflags;
     char *ldflags;
@@ -26,4 +50,9 @@ typedef struct Arch {
 void ArchInit (Arch* arch);
 void ArchFree (Arch* arch);
 void ArchSetup (Arch* arch, OS_TAG os, int wordsize);
+void ArchSetupCpu (Arch* arch, const char* march, const char* mtune, int enable, int disable);
+int ArchHas (const Arch* arch, ARCH_FEATURE feature);
+
+int ArchIsCpu (const char* name);
+int ArchFeatureByName (const char* name);
 #endif /*X_INCLUDE_ARCH*/
\ No newline at end of file
@@ -33,7 +33,9 @@ typedef struct AsmCTX {
 } AsmCTX;
 
 AsmCTX* AsmInit (const char* output, const Arch* arch);
+AsmCTX* AsmInitBuffer (const AsmCTX* parent, char** buffer, size_t* length);
 void AsmEnd (AsmCTX* ctx);
+void AsmEndBuffer (AsmCTX* ctx);
 void AsmOutLn (AsmCTX* ctx, const char* format, ...);
 void AsmEnter (AsmCTX* ctx);
 void AsmLeave (AsmCTX* ctx);
@@ -2,6 +2,8 @@
 #define X_INCLUDE_ASM64
 
 #include "..\include\operand.h"
+#include "..\include\abi.h"
+#include "..\include\profile.h"
 
 //бинарные команды
 typedef enum BIN_OPERATION {
@@ -13,7 +15,9 @@ typedef enum BIN_OPERATION {
     BINOP_BITOR,
     BINOP_BITXOR,
     BINOP_SHR,
-    BINOP_SHL
+    BINOP_SHL,
+    BINOP_ANDNOT,   //L & ~R, andn с BMI1; источника пока нет, ждет перевода выражений в IR
+    BINOP_DIV       //только float и double, целое деление - AsmDivide
 } BIN_OPERATION;
 
 //унарные команды
@@ -22,7 +26,13 @@ typedef enum UNARY_OPERATION {
     UNARY_INC,
     UNARY_DEC,
     UNARY_NEG,
-    UNARY_BITWISENOT
+    UNARY_BITWISENOT,
+    /*битовые: пока без источников, ждут перевода __builtin_popcount,
+      __builtin_clz, __builtin_ctz и __builtin_bswap в IR*/
+    UNARY_POPCOUNT, //число единичных битов; операнд 2, 4 или 8 байт
+    UNARY_CLZ,      //старшие нули, для нуля не определено, как __builtin_clz
+    UNARY_CTZ,      //младшие нули, для нуля не определено
+    UNARY_BSWAP     //обратный порядок байт
 } UNARY_OPERATION;
 
 void AsmComment (AsmCTX* ctx, const char* str);
@@ -30,21 +40,38 @@ void AsmComment (AsmCTX* ctx, const char* str);
 void AsmUOP (IrCTX* ir, IrBLOCK* block, UNARY_OPERATION Op, Operand R);
 void AsmBOP (IrCTX* ir, IrBLOCK* block, BIN_OPERATION Op, Operand L, Operand R);
 void AsmDivision (IrCTX* ir, IrBLOCK* block, Operand R);
+void AsmDivide (IrCTX* ir, IrBLOCK* block, Operand L, Operand R, int isUnsigned, int modulo);
 void AsmCompare (IrCTX* ir, IrBLOCK* block, Operand L, Operand R);
+Operand AsmFloatCompare (IrCTX* ir, IrBLOCK* block, CONDITION_TAG cond, Operand L, Operand R);
+void AsmConvert (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src, int isUnsigned);
 void AsmRepStos (IrCTX* ir, IrBLOCK* block, Operand RAX, Operand RCX, Operand RDI, Operand Dest, int length, Operand Src);
+void AsmBlockMove (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src, Operand Size);
+void AsmBlockFill (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Value, Operand Size);
 void AsmConditionalMove (IrCTX* ir, IrBLOCK* block, Operand Cond, Operand Dest, Operand Src);
 void AsmMove (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src);
 
 void AsmReturn (AsmCTX* ctx);
 void AsmCall (AsmCTX* ctx, const char* label);
 void AsmCallIndirect (IrBLOCK* block, Operand L);
+void AsmCallArgs (IrCTX* ir, IrBLOCK* block, const AbiCall* call, const Operand* args, Operand Ret);
+void AsmCallCleanup (IrCTX* ir, IrBLOCK* block, const AbiCall* call);
+void AsmCallResult (IrCTX* ir, IrBLOCK* block, const AbiCall* call, Operand Dest);
+void AsmSwitchWiden (AsmCTX* ctx, REG_INDEX value, int size, int isSigned);
+void AsmSwitchCompare (AsmCTX* ctx, REG_INDEX value, int size, REG_INDEX scratch, long long literal);
+void AsmSwitchJump (AsmCTX* ctx, const char* condition, const char* label);
+void AsmSwitchIndex (AsmCTX* ctx, REG_INDEX value, int size, REG_INDEX scratch, long long low);
+void AsmSwitchTable (AsmCTX* ctx, REG_INDEX value, REG_INDEX scratch, const char* table, char** labels, int n);
+void AsmSwitchBitTest (AsmCTX* ctx, REG_INDEX value, REG_INDEX scratch, unsigned long long mask, const char* label);
 void AsmBranch (AsmCTX* ctx, Operand Condition, const char* label);
 void AsmJump (AsmCTX* ctx, const char* label);
 void AsmLabel (AsmCTX* ctx, const char* label);
 
 void AsmStringConstant (AsmCTX* ctx, const char* label, const char* str);
+void AsmFloatConstant (AsmCTX* ctx, const char* label, double value, int size);
 void AsmStaticData (AsmCTX* ctx, const char* label, int global, int size, intptr_t initial);
 void AsmRODataSection (AsmCTX* ctx);
+void AsmTextSection (AsmCTX* ctx);
+void AsmColdSection (AsmCTX* ctx);
 void AsmDataSection (AsmCTX* ctx);
 
 void AsmPush (IrCTX* ir, IrBLOCK* block, Operand L);
@@ -59,8 +86,13 @@ void AsmRestoreReg (IrCTX* ir, IrBLOCK* block, REG_INDEX r);
 void AsmEvalAddress (IrCTX* ir, IrBLOCK* block, Operand L, Operand R);
 
 void AsmFnPrologue (IrCTX* ir, IrBLOCK* block, int localSize);
+void AsmFnParams (IrCTX* ir, IrBLOCK* block, const AbiCall* call);
+void AsmFnResult (IrCTX* ir, IrBLOCK* block, const AbiCall* call, Operand Src);
 void AsmFnEpilogue (IrCTX* ir, IrBLOCK* block);
 
+void AsmProfileCount (IrCTX* ir, IrBLOCK* block, const char* label, int index);
+void AsmProfileData (AsmCTX* ctx, const ProfileModule* module);
+
 void AsmFnLinkageBegin (FILE* file, const char* name);
 void AsmFnLinkageEnd (FILE* file, const char* name);
 
@@ -0,0 +1,79 @@
+#ifndef X_INCLUDE_AST_POOL
+#define X_INCLUDE_AST_POOL
+
+#include <stdint.h>
+
+#include "..\include\ast.h"
+
+//плоское хранение AST: поля узлов - отдельными массивами по номеру узла,
+//дети узла - отрезок массива children; узлы пронумерованы в прямом
+//порядке обхода, так что поддерево - это отрезок номеров [id, end[id])
+
+typedef uint32_t AstId;     //0 - нет узла
+
+//то, что есть не у всех узлов: символ, тип и литерал; принадлежат дереву
+typedef struct AstPoolExtra {
+    Symbol* symbol;
+    Type* dt;
+    void* literal;
+} AstPoolExtra;
+
+typedef struct AstPool {
+    int length;             //узлов, считая пустой нулевой
+    int capacity;
+
+    uint8_t* tags;          //AST_TAG
+    uint8_t* ops;           //OP_TAG
+    uint8_t* subs;          //marker, litTag или isDo - по тегу
+    AstId* l;
+    AstId* r;
+    AstId* end;             //первый номер после поддерева
+    uint32_t* firstChild;   //начало отрезка в children
+    uint32_t* childNo;
+    uint32_t* location;     //номер в locations
+    uint32_t* extra;        //номер в extras, 0 - нет
+
+    AstId* children;
+    int childLength;
+    int childCapacity;
+
+    TokenLocation* locations;
+    int locationNo;
+    int locationCapacity;
+
+    AstPoolExtra* extras;
+    int extraNo;
+    int extraCapacity;
+} AstPool;
+
+//прямой обход поддерева
+typedef struct AstPoolIter {
+    const AstPool* pool;
+    AstId next;
+    AstId end;
+} AstPoolIter;
+
+void AstPoolInit (AstPool* pool);
+void AstPoolFree (AstPool* pool);
+
+AstId AstPoolAdd (AstPool* pool, const Ast* Node);
+
+AST_TAG AstPoolTag (const AstPool* pool, AstId id);
+OP_TAG AstPoolOp (const AstPool* pool, AstId id);
+MARKER_TAG AstPoolMarker (const AstPool* pool, AstId id);
+LITERAL_TAG AstPoolLitTag (const AstPool* pool, AstId id);
+int AstPoolIsDo (const AstPool* pool, AstId id);
+
+AstId AstPoolL (const AstPool* pool, AstId id);
+AstId AstPoolR (const AstPool* pool, AstId id);
+const AstId* AstPoolChildren (const AstPool* pool, AstId id, int* count);
+
+TokenLocation AstPoolLocation (const AstPool* pool, AstId id);
+Symbol* AstPoolSymbol (const AstPool* pool, AstId id);
+Type* AstPoolDT (const AstPool* pool, AstId id);
+void* AstPoolLiteral (const AstPool* pool, AstId id);
+
+void AstPoolIterInit (AstPoolIter* iter, const AstPool* pool, AstId root);
+AstId AstPoolIterNext (AstPoolIter* iter);
+void AstPoolIterSkip (AstPoolIter* iter, AstId id);
+#endif /*X_INCLUDE_AST_POOL*/
@@ -41,6 +41,9 @@ typedef enum AST_TAG {
     AST_RETURN,
     AST_BREAK,
     AST_CONTINUE,
+    AST_SWITCH,
+    AST_CASE,
+    AST_DEFAULT,
     AST_ELLIPSIS
 } AST_TAG;
 
@@ -116,7 +119,9 @@ typedef enum MARKER_TAG {
 typedef enum LITERAL_TAG {
     LITERAL_UNDEFINED,
     LITERAL_IDENT,
-    LITERAL_INT,
+    LITERAL_INT,        //literal - IntLiteral
+    LITERAL_FLOAT,      //float, literal - double
+    LITERAL_DOUBLE,     //double и long double, literal - double
     LITERAL_CHAR,
     LITERAL_BOOL,
     LITERAL_STR,
@@ -125,6 +130,14 @@ typedef enum LITERAL_TAG {
     LITERAL_LAMBDA
 } LITERAL_TAG;
 
+//целая константа: значение и то, от чего по 6.4.4.1 зависит ее тип
+typedef struct IntLiteral {
+    unsigned long long value;
+    int isUnsigned;     //суффикс u
+    int longs;          //суффикс l - 1, ll - 2
+    int isDecimal;      //десятичной без u подходят только знаковые типы
+} IntLiteral;
+
 typedef struct Ast {
     AST_TAG tag;
     
@@ -146,6 +159,20 @@ typedef struct Ast {
     union {
         /*astMarker*/
         MARKER_TAG marker;
+
+        /*astLoop: do-while - тело в l, условие в r*/
+        int isDo;
+
+        /*astFnImpl: пока r == 0, тело не разобрано - начинается с токена bodyToken,
+          видит первые bodyScope детей модуля. У функции, код которой взят из
+          прошлой сборки (IncrUnchanged), r остается 0 и после анализа.
+          На месте literal - 0, его освобождает AstDestroy*/
+        struct {
+            int bodyToken;
+            int bodyLine;
+            void* bodyNoLiteral;
+            int bodyScope;
+        };
         
         /*astLiteral*/
         struct {
@@ -0,0 +1,36 @@
+#ifndef X_INCLUDE_CACHE
+#define X_INCLUDE_CACHE
+
+#include <stdint.h>
+
+//SHA-256 содержимого единицы трансляции: при совпадении ключа код берется
+//из кеша без проверки, так что хеш должен быть стойким к коллизиям
+typedef struct Hasher {
+    uint32_t state[8];
+    unsigned char block[64];
+    long long length;       //байт всего, в block - length % 64
+} Hasher;
+
+enum {
+    CACHE_KeyLength = 64   //ключ - хеш в шестнадцатеричном виде
+};
+
+//дисковый кеш результатов компиляции
+typedef struct CacheCTX {
+    char* dir;
+    long long maxSize;  //в байтах, при превышении удаляются давно не использованные
+} CacheCTX;
+
+void HasherInit (Hasher* h);
+void HasherAdd (Hasher* h, const void* data, int length);
+void HasherAddStr (Hasher* h, const char* str);
+void HasherAddInt (Hasher* h, long long value);
+void HasherDigest (const Hasher* h, char key[CACHE_KeyLength + 1]);
+
+void CacheInit (CacheCTX* ctx, const char* dir, long long maxSize);
+void CacheFree (CacheCTX* ctx);
+
+int CacheFetch (CacheCTX* ctx, const char* key, const char* ext, const char* output);
+void CacheStore (CacheCTX* ctx, const char* key, const char* ext, const char* output, const char* diagnostics);
+void CacheEvict (CacheCTX* ctx);
+#endif /*X_INCLUDE_CACHE*/
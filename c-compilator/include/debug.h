@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 
+//уровень сообщения выдается, если он не меньше текущего режима
 typedef enum DEBUG_MODE {
     DEBUG_FULL,
     DEBUG_COMPRESSED,
@@ -10,15 +11,33 @@ typedef enum DEBUG_MODE {
     DEBUG_SILENT
 } DEBUG_MODE;
 
+extern DEBUG_MODE d_mode;
+
+/*трассировка: SCC_DEBUGMODE при сборке - наименьший собираемый уровень
+  (-DSCC_DEBUGMODE без значения - 1, DEBUG_COMPRESSED; пустой #define -
+  0, DEBUG_FULL: + 0 делает из пустого определения выражение). Без него
+  условие - константа 0 и макросы не порождают кода, аргументы лишь
+  проверяются на типы. Во время работы режим сравнивается до всякого
+  форматирования*/
+#ifdef SCC_DEBUGMODE
+    #define DebugIsOn(mode) ((mode) >= (SCC_DEBUGMODE + 0) && (mode) >= d_mode)
+#else
+    #define DebugIsOn(mode) 0
+#endif
+
+#define DebugMsg(...) (DebugIsOn(DEBUG_MINIMAL) ? DebugTrace(__VA_ARGS__) : (void) 0)
+#define DebugEnter(str) (DebugIsOn(DEBUG_COMPRESSED) ? DebugTraceEnter(str) : (void) 0)
+#define DebugLeave() (DebugIsOn(DEBUG_COMPRESSED) ? DebugTraceLeave() : (void) 0)
+
+void DebugTrace (const char* format, ...);
+void DebugTraceV (const char* format, va_list args);
+void DebugTraceEnter (const char* str);
+void DebugTraceLeave (void);
 
 void DebugWait ();
-void DebugLeave ();
-void DebugEnter (const char* str);
-void DebugMsg (const char* format, ...);
-void DebugVarMsg (const char* format, va_list args);
-void DebugOut (const char* format, ...);
-void DebugVarOut (const char* format, va_list args);
 void DebugInit (FILE* nlog);
+void DebugSetRing (int perThread);
+void DebugFlush (void);
 DEBUG_MODE DebugSetMode (DEBUG_MODE nmode);
 
 void DebugErrorUnhandledChar (const char* functionName, const char* className, char classChar);
@@ -26,4 +45,4 @@ void DebugErrorUnhandledInt (const char* functionName, const char* className, in
 void DebugErrorUnhandled (const char* functionName, const char* className, const char* classStr);
 int DebugAssert (const char* functionName, const char* testName, int result);
 void DebugError (const char* functionName, const char* format, ...);
-#endif /*X_INCLUDE_DEBUG*/
\ No newline at end of file
+#endif /*X_INCLUDE_DEBUG*/
@@ -0,0 +1,77 @@
+#ifndef X_INCLUDE_DRIVER
+#define X_INCLUDE_DRIVER
+
+#include "..\include\vector.h"
+#include "..\include\arch.h"
+
+#define SCC_VERSION "scc 0.2"
+
+//до какой стадии вести сборку
+typedef enum DRIVER_MODE {
+    DRIVER_COMPILE,     //-S: только ассемблерный текст
+    DRIVER_ASSEMBLE,    //-c: объектные файлы
+    DRIVER_LINK,        //исполняемый файл
+    DRIVER_MERGE        //-merge-profile: сырые профили в индексированный
+} DRIVER_MODE;
+
+//настройки компилятора, разобранные из командной строки
+typedef struct Config {
+    DRIVER_MODE mode;
+
+    Vector inputs;      //единицы трансляции в порядке командной строки
+    char* output;       //-o, для -S и -c допустим только при одном входе
+
+    Vector includes;    //-I
+    Vector defines;     //-D, "имя" или "имя=значение"
+
+    int jobs;           //-jN, 0 - взять у make jobserver или 1
+    int threads;        //-fthreads=N: потоков на функции единицы, 0 - по числу ядер
+    int optimise;       //-O: оптимизация на уровне блоков
+    int warnPadded;     //-Wpadded: заполнение в структурах
+
+    char* cacheDir;     //-fcache[=dir], 0 - кеш выключен
+    long long cacheSize;//-fcache-size=MB
+
+    char* includePch;   //-include-pch: готовая глобальная область
+    int emitPch;        //-emit-pch: записать <вход>.pch
+
+    char* profileGenerate;  //-fprofile-generate[=file]: сырой профиль запусков
+    char* profileUse;       //-fprofile-use[=file]: индексированный профиль
+
+    int timeReport;         //-ftime-report: время и память фаз в сообщения
+    int timeTrace;          //-ftime-trace[=file]: трасса Chrome trace event
+    char* timeTraceFile;    //0 - <вход>.json в текущем каталоге
+
+    int incremental;    //-fincremental: код неизмененных функций из <вход>.fn/
+
+    OS_TAG os;
+    int wordsize;
+    char* march;        //-march=: набор команд, 0 - x86-64
+    char* mtune;        //-mtune=: настройка, 0 - как -march
+    int featuresOn;     //-m<возможность>, ARCH_FEATURE
+    int featuresOff;    //-mno-<возможность>
+
+    int fail;           //ошибка в командной строке
+} Config;
+
+//результат сборки одной единицы трансляции
+typedef struct DriverUnit {
+    const char* input;
+    char* asmOutput;
+    char* objOutput;
+    char* diagnostics;  //временный файл с сообщениями процесса
+
+    int pid;
+    int status;         //0 - успех
+    int done;
+} DriverUnit;
+
+void ConfigInit (Config* config);
+void ConfigFree (Config* config);
+void ConfigParse (Config* config, int argc, char** argv);
+
+void DriverHashUnit (const Config* config, const char* input, char* key);
+int DriverCompileUnit (const Config* config, const char* input, const char* asmOutput);
+int DriverRun (Config* config);
+int DriverMergeProfiles (const Config* config);
+#endif /*X_INCLUDE_DRIVER*/
@@ -1,6 +1,15 @@
 #ifndef X_INCLUDE_ERROR
 #define X_INCLUDE_ERROR
 
+struct ParserCTX;
+struct AnalyzerCTX;
+struct Ast;
+
 void ErrorF (const char* format, ...);
 
+void ErrorParser (struct ParserCTX* ctx, const char* format, ...);
+void ErrorExpected (struct ParserCTX* ctx, const char* expected);
+
+void ErrorAnalyzer (struct AnalyzerCTX* ctx, const struct Ast* Node, const char* format, ...);
+
 #endif /*X_INCLUDE_ERROR*/
\ No newline at end of file
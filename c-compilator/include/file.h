@@ -0,0 +1,30 @@
+#ifndef X_INCLUDE_FILE
+#define X_INCLUDE_FILE
+
+//таблица файлов процесса: каждый файл читается один раз, токены и
+//сообщения ссылаются на него по номеру
+typedef struct FileEntry {
+    char* name;         //как при первом открытии
+    char* dir;          //каталог для #include "..."
+    const char* text;   //0 - только имя (#line)
+    int length;
+    int mapped;         //текст отображен mmap, иначе выделен malloc
+
+    char* guard;        //макрос из #ifndef, охватывающего весь файл
+    int guardKnown;     //файл уже проверен на такую защиту
+    int once;           //#pragma once
+} FileEntry;
+
+int FileOpen (const char* name);
+int FileIntern (const char* name);
+int FileAddText (const char* name, char* text, int length);
+
+int FileCount (void);
+const FileEntry* FileGet (int id);
+const char* FileName (int id);
+
+void FileSetGuard (int id, const char* guard);
+void FileSetOnce (int id);
+
+void FileTableFree (void);
+#endif /*X_INCLUDE_FILE*/
@@ -26,6 +26,17 @@ typedef GHashMap IntSet;
 typedef void (*hashmapKeyDtor)(char* key, const void* value);
 typedef void (*hashmapValueDtor)(void* value);
 
+void* HashMapMap (const HashMap* map, const char* key);
+int HashMapAdd (HashMap* map, const char* key, void* value);
+void HashMapFreeObjs (HashMap* map, hashmapKeyDtor keyDtor, hashmapValueDtor valueDtor);
+void HashMapFree (HashMap* map);
+HashMap* HashMapInit (HashMap* map, int size);
+
+void* IntMapMap (const IntMap* map, intptr_t key);
+int IntMapAdd (IntMap* map, intptr_t key, void* value);
+void IntMapFree (IntMap* map);
+IntMap* IntMapInit (IntMap* map, int size);
+
 
 int IntSetTest (const IntSet* set, intptr_t element);
 void IntSetMerge (IntSet* dest, const IntSet* src);
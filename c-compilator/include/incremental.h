@@ -0,0 +1,39 @@
+#ifndef X_INCLUDE_INCREMENTAL
+#define X_INCLUDE_INCREMENTAL
+
+#include "..\include\ast.h"
+#include "..\include\ir.h"
+#include "..\include\hashmap.h"
+#include "..\include\cache.h"
+#include "..\include\parser.h"
+
+//инкрементальная перекомпиляция по функциям: для каждой функции хранится
+//отпечаток (хеш объявления, токенов тела, внешних символов, на которые она
+//может ссылаться, и настроек компиляции) и ассемблерный текст с прошлой
+//сборки вместе с ее константами. Тело неизменной функции не разбирается
+//и не анализируется. Метки в тексте - по имени функции, см. IrFnCreateLabel
+typedef struct IncrCTX {
+    char* dir;      //<вход>.fn/
+    char options[CACHE_KeyLength + 1];  //хеш настроек, от которых зависит код
+    HashMap fns;    //имя функции -> ключ отпечатка прошлой сборки
+    HashMap next;   //имя функции -> ключ текущей сборки
+    HashMap keys;   //имя функции -> отпечаток в этой сборке
+
+    int reused;
+    int rebuilt;
+} IncrCTX;
+
+void IncrInit (IncrCTX* ctx, const char* input, const char* options);
+void IncrFree (IncrCTX* ctx);
+
+void AstHash (Hasher* h, const Ast* Node);
+int IncrFingerprint (ParserResult* parsed, const Symbol* Global, const Ast* impl, char key[CACHE_KeyLength + 1]);
+int IncrUnchanged (IncrCTX* ctx, ParserResult* parsed, const Symbol* Global, const Ast* impl);
+
+int IncrReuse (IncrCTX* ctx, IrFN* fn, const char* key);
+void IncrUpdate (IncrCTX* ctx, const IrFN* fn, const char* key);
+void IncrSave (IncrCTX* ctx);
+
+void IncrPrepare (IncrCTX* ctx, IrCTX* ir);
+void IncrCommit (IncrCTX* ctx, const IrCTX* ir);
+#endif /*X_INCLUDE_INCREMENTAL*/
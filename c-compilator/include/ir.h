@@ -20,7 +20,8 @@ typedef enum TERM_TAG {
     TERM_BRANCH,
     TERM_CALL,
     TERM_CALLINDIRECT,
-    TERM_RETURN
+    TERM_RETURN,
+    TERM_SWITCH
 } TERM_TAG;
 
 typedef struct IrINSTR {
@@ -32,6 +33,12 @@ typedef struct IrINSTR {
     Operand r;
 } IrINSTR;
 
+//метка switch: значение и блок перехода
+typedef struct IrCASE {
+    long long value;
+    IrBLOCK* to;
+} IrCASE;
+
 typedef struct IrTERM {
     TERM_TAG tag;
 
@@ -43,6 +50,8 @@ typedef struct IrTERM {
             IrBLOCK* ifTrue;
             IrBLOCK* ifFalse;
             Operand cond;
+            long trueCount;     //переходы по профилю в каждую сторону
+            long falseCount;
         };
         
         //для вызова функции
@@ -56,13 +65,27 @@ typedef struct IrTERM {
                 Operand toAsOperand;
             };
         };
+
+        //для switch: метки по возрастанию значений, способ выдачи
+        //выбирается по их плотности, см. ir-switch.c
+        struct {
+            REG_INDEX value;    //копия значения, портится при выдаче
+            int valueSize;
+            REG_INDEX scratch;  //свободный в момент перехода регистр
+            IrCASE* cases;
+            int caseNo;
+            int isSigned;
+            IrBLOCK* ifDefault;
+        };
     };
 } IrTERM;
 
 typedef enum STATICDATA_TAG {
     STATICDATA_UNDEFINED,
     STATICDATA_REGULAR,
-    STATICDATA_STRINGCONSTANT
+    STATICDATA_STRINGCONSTANT,
+    STATICDATA_PROFILE,
+    STATICDATA_FLOAT
 } STATICDATA_TAG;
 
 typedef struct IrSTATICDATA {
@@ -81,6 +104,14 @@ typedef struct IrSTATICDATA {
             char* strlabel;
             char* str;
         };
+        /*dataProfile: счетчики -fprofile-generate*/
+        struct ProfileModule* profile;
+        /*dataFloat: константа float или double*/
+        struct {
+            char* fplabel;
+            double fpvalue;
+            int fpsize;
+        };
     };
 } IrSTATICDATA;
 
@@ -89,12 +120,14 @@ typedef struct IrBLOCK {
     IrTERM* term;
 
     char* label;
+    IrFN* fn;       //функция, которой принадлежит блок
 
     char* str;      //строка с командами ассемблера заканчивающиеся \n
     int length;     //длина на которую увеличивается строка
     int capacity;   //емкость строки
 
     int nthChild;   //индекс родительского FN вектора
+    long count;     //число выполнений по профилю, -1 - профиля нет
 
     ///Blocks that this block may (at runtime) have (directly)
     ///come from / go to, respectively
@@ -113,6 +146,19 @@ typedef struct IrFN {
     IrBLOCK* epilogue;
     ///Includes and owns the above blocks, as well as all others
     Vector blocks;  //вектор блоков
+
+    int labelNo;    //счетчик меток функции, см. IrFnCreateLabel
+    Vector labels;  //строки меток IrFnCreateLabel
+    Vector rodata;  //константы функции, выдаются вместе с ее кодом
+
+    ///Fills the blocks of the function; deferred by IrFnDefer and run by
+    ///IrBuild on a worker thread
+    void (*build)(IrCTX* ctx, IrFN* fn, void* data);
+    void* buildData;
+    struct AbiCall* abi;    //параметры и результат по соглашению, 0 - без него
+
+    char* code;     //ассемблерный текст функции после IrEmit
+    size_t codeLength;
 } IrFN;
 
 //промежуточное представление
@@ -123,28 +169,50 @@ typedef struct IrCTX {
     Vector rodata;
     
     int labelNo;
+    int jobs;           //число потоков для обработки функций, 0 - по числу ядер
 
     AsmCTX* assem;      //контекст ассемблера
     const Arch* arch;   //архитектурные данные
 } IrCTX;
 
+///Per-function pass, run by IrForEachFn possibly on a worker thread.
+///It may only touch the given IrFN and thread-local state
+typedef void (*IrFnWorker)(IrCTX* ctx, IrFN* fn, void* data);
+
 void IrInit (IrCTX* ctx, const char* output, const Arch* arch);
 void IrFree (IrCTX* ctx);
 
 void IrEmit (IrCTX* ctx);
+void IrBlockLevelAnalysis (IrCTX* ctx);
+int IrLayoutFn (const IrFN* fn, Vector* order);
+void IrLayoutEstimate (const IrFN* fn, long* weights);
 IrFN* IrFnCreate (IrCTX* ctx, const char* name, int stacksize);
+IrFN* IrFnCreateAbi (IrCTX* ctx, Symbol* Fn, int localSize);
+void IrFnReturn (IrCTX* ctx, IrFN* fn, IrBLOCK* block, Operand Src);
+const char* IrFnCreateLabel (IrFN* fn);
+
+void IrForEachFn (IrCTX* ctx, IrFnWorker worker, void* data);
+void IrFnDefer (IrFN* fn, IrFnWorker build, void* data);
+void IrBuild (IrCTX* ctx);
 
 void IrBlockOut (IrBLOCK* block, const char* format, ...);
 IrBLOCK* IrBlockCreate (IrCTX* ctx, IrFN* fn);
 void IrBlockDelete (IrFN* fn, IrBLOCK* block);
 
 void IrStaticValue (IrCTX* ctx, const char* label, int global, int size, intptr_t initial);
-Operand IrStringConstant (IrCTX* ctx, const char* str);
+Operand IrStringConstant (IrCTX* ctx, IrFN* fn, const char* str);
+Operand IrFloatConstant (IrCTX* ctx, IrFN* fn, double value, int size);
+void IrStaticProfile (IrCTX* ctx, struct ProfileModule* profile);
 
 void IrJump (IrBLOCK* block, IrBLOCK* to);
 void IrBranch (IrBLOCK* block, Operand cond, IrBLOCK* ifTrue, IrBLOCK* ifFalse);
 void IrCall (IrBLOCK* block, Symbol* to, IrBLOCK* ret);
+void IrCallAbi (IrCTX* ctx, IrBLOCK* block, Symbol* to, const struct AbiCall* call, const Operand* args, Operand Dest, IrBLOCK* ret);
 void IrCallIndirect (IrBLOCK* block, Operand to, IrBLOCK* ret);
+void IrSwitch (IrCTX* ctx, IrBLOCK* block, Operand value, int isSigned, const IrCASE* cases, int n, IrBLOCK* ifDefault);
+void IrSwitchEmit (AsmCTX* assem, const IrBLOCK* block);
+
+IrBLOCK* IrEdgeSplit (IrCTX* ctx, IrFN* fn, IrBLOCK* from, IrBLOCK* to);
 
 int IrBlockGetPredNo (IrFN* fn, IrBLOCK* block);
 int IrBlockGetSuccNo (IrBLOCK* block);
@@ -0,0 +1,14 @@
+#ifndef X_INCLUDE_LAYOUT
+#define X_INCLUDE_LAYOUT
+
+#include "..\include\symbol.h"
+#include "..\include\arch.h"
+
+//раскладка записей: смещения полей, размер и выравнивание по правилам
+//SysV/Win64 для выбранного размера слова
+
+void LayoutRecord (const Arch* arch, Symbol* Record);
+int LayoutPadding (const Arch* arch, const Symbol* Record);
+int LayoutIsAnonMember (const Symbol* Record, const Symbol* Child);
+int LayoutReport (const Arch* arch, const Symbol* Scope);
+#endif /*X_INCLUDE_LAYOUT*/
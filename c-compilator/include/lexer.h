@@ -4,14 +4,25 @@
 #include "stream.h"
 #include "tokens.h"
 
+struct PPCTX;
+
 typedef struct LexerCTX {
     StreamCTX *stream;
+    struct PPCTX *pp;   //не 0 - токены берутся из препроцессора
+    int directives;     //'#' - пунктуация, а не комментарий до конца строки
+
+    int file;           //номер в таблице файлов
     int line;
     int lineChar;
     
     char *buffer;
     int buffsz;
     int length;
+
+    const char* text;   //написание токена в исходном тексте, без копирования
+    int textLength;
+    int bol;            //токен первый в строке
+    int space;          //перед токеном был пробел или комментарий
     
     TOKEN_TAG   token;
     KEYWORD_TAG keyword;
@@ -19,6 +30,8 @@ typedef struct LexerCTX {
 } LexerCTX;
 
 LexerCTX* LexerInit (const char* filename);
+LexerCTX* LexerInitStream (StreamCTX* stream, int directives);
+LexerCTX* LexerInitPP (struct PPCTX* pp);
 void LexerEnd (LexerCTX* ctx);
 void LexerNext (LexerCTX* ctx);
-#endif /*X_INCLUDE_LEXER*/
\ No newline at end of file
+#endif /*X_INCLUDE_LEXER*/
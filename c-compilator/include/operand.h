@@ -24,7 +24,11 @@ typedef enum CONDITION_TAG {
     CONDITION_GT,
     CONDITION_GE,
     CONDITION_LT,
-    CONDITION_LE
+    CONDITION_LE,
+    CONDITION_A,        //беззнаковые и ucomiss/ucomisd
+    CONDITION_AE,
+    CONDITION_B,
+    CONDITION_BE
 } CONDITION_TAG;
 
 typedef struct Operand {
@@ -52,6 +56,7 @@ typedef struct Operand {
 
     int size;   //размер в байтах для операндов в памяти
     int array;
+    int floating;   //float или double в памяти; XMM регистр - всегда
 } Operand;
 
 
@@ -65,13 +70,16 @@ Operand OperandCreateLiteral (int literal);
 Operand OperandCreateLabel (const char* label);
 Operand OperandCreateLabelMem (const char* label, int size);
 Operand OperandCreateLabelOffset (const char* label);
+Operand OperandAsFloat (Operand Value);
 void OperandFree (Operand Value);
 
 int OperandIsEqual (Operand L, Operand R);
+int OperandIsFloat (Operand Value);
 int OperandGetSize (const Arch* arch, Operand Value);
 char* OperandToStr (Operand Value);
 const char* OperandTagGetStr (OPERAND_TAG tag);
 
 CONDITION_TAG ConditionFromOp (OP_TAG cond);
 CONDITION_TAG ConditionNegate (CONDITION_TAG cond);
+CONDITION_TAG ConditionUnsigned (CONDITION_TAG cond);
 #endif /*X_INCLUDE_OPERAND*/
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef X_INCLUDE_PARSER_DECL
+#define X_INCLUDE_PARSER_DECL
+
+#include "..\include\ast.h"
+#include "..\include\parser-internal.h"
+
+int ParserIsDecl (ParserCTX* ctx);
+int ParserIsTypeAt (ParserCTX* ctx, int k);
+
+Ast* ParserDecl (ParserCTX* ctx, int module);
+Ast* ParserType (ParserCTX* ctx);
+Ast* ParserFnBody (ParserCTX* ctx, Ast* Impl);
+#endif /*X_INCLUDE_PARSER_DECL*/
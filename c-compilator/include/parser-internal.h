@@ -2,15 +2,19 @@
 #define X_INCLUDE_PARSER_INTERNAL
 
 #include "lexer.h"
+#include "symbol.h"
+#include "token-buffer.h"
 
+//номер файла вместо имени: имя берется из таблицы файлов (FileName)
 typedef struct TokenLocation {
-    const char* filename;
+    int fileId;
     int line;
     int lineChar;
 } TokenLocation;
 
 typedef struct ParserCTX {
     LexerCTX *lexer;
+    TokenBuffer tokens;     //поток токенов с заглядыванием вперед
     TokenLocation location;
     
     char* filename;
@@ -20,11 +24,15 @@ typedef struct ParserCTX {
     Symbol* module;
     Symbol* scope;
     
-    int breakLevel;
+    int breakLevel;         //вложенность циклов и switch
+    int continueLevel;      //вложенность только циклов
 
     int errors;
     int warnings;
 
+    int lazy;               //тела функций только пропускаются, см. ParserBody
+
     int lastErrorLine;
-};
+    int panic;              //после ошибки: молчать до синхронизации на ';' или '}'
+} ParserCTX;
 #endif /*X_INCLUDE_PARSER_INTERNAL*/
\ No newline at end of file
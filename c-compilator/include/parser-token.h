@@ -0,0 +1,33 @@
+#ifndef X_INCLUDE_PARSER_TOKEN
+#define X_INCLUDE_PARSER_TOKEN
+
+#include "..\include\parser-internal.h"
+#include "..\include\tokens.h"
+
+const Token* TokenPeek (ParserCTX* ctx, int k);
+int TokenPeekIsPunct (ParserCTX* ctx, int k, PUNCT_TAG punct);
+
+int TokenIsKeyword (ParserCTX* ctx, KEYWORD_TAG keyword);
+int TokenIsPunct (ParserCTX* ctx, PUNCT_TAG punct);
+int TokenIsIdent (ParserCTX* ctx);
+int TokenIsInt (ParserCTX* ctx);
+int TokenIsFloat (ParserCTX* ctx);
+int TokenIsString (ParserCTX* ctx);
+int TokenIsChar (ParserCTX* ctx);
+int TokenIsEOF (ParserCTX* ctx);
+
+void TokenNext (ParserCTX* ctx);
+void TokenMatch (ParserCTX* ctx);
+const char* TokenText (ParserCTX* ctx, int* length);
+char* TokenDupMatch (ParserCTX* ctx);
+
+void TokenMatchPunct (ParserCTX* ctx, PUNCT_TAG punct);
+void TokenMatchKeyword (ParserCTX* ctx, KEYWORD_TAG keyword);
+char* TokenMatchIdent (ParserCTX* ctx);
+int TokenTryMatchPunct (ParserCTX* ctx, PUNCT_TAG punct);
+int TokenTryMatchKeyword (ParserCTX* ctx, KEYWORD_TAG keyword);
+
+void TokenSkipStatement (ParserCTX* ctx);
+void TokenSkipBlock (ParserCTX* ctx);
+void TokenSeek (ParserCTX* ctx, int pos, int line);
+#endif /*X_INCLUDE_PARSER_TOKEN*/
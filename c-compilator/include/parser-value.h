@@ -0,0 +1,10 @@
+#ifndef X_INCLUDE_PARSER_VALUE
+#define X_INCLUDE_PARSER_VALUE
+
+#include "..\include\ast.h"
+#include "..\include\parser-internal.h"
+
+Ast* ParserValue (ParserCTX* ctx);
+Ast* ParserAssignValue (ParserCTX* ctx);
+Ast* ParserInitializer (ParserCTX* ctx);
+#endif /*X_INCLUDE_PARSER_VALUE*/
@@ -0,0 +1,30 @@
+#ifndef X_INCLUDE_PARSER
+#define X_INCLUDE_PARSER
+
+#include "..\include\ast.h"
+#include "..\include\arch.h"
+#include "..\include\lexer.h"
+#include "..\include\symbol.h"
+#include "..\include\token-buffer.h"
+
+typedef struct ParserResult {
+    Ast* tree;
+    int errors;
+    int warnings;
+
+    ParserCTX* lazy;    //для отложенных тел функций, иначе 0
+} ParserResult;
+
+typedef void (*ParserTokenFn)(void* data, const Token* token, const char* text);
+
+ParserResult Parser (LexerCTX* lexer, Symbol* Global, const char* filename);
+ParserResult ParserLazy (LexerCTX* lexer, Symbol* Global, const char* filename);
+Ast* ParserBody (ParserResult* result, Ast* Impl);
+int ParserBodyTokens (ParserResult* result, const Ast* Impl, ParserTokenFn visit, void* data);
+void ParserFree (ParserResult* result);
+void ParserBuiltins (Symbol* Global, const Arch* arch, OS_TAG os);
+int ParserEscape (const char** str);
+
+//для parser-decl.c: тело функции
+Ast* ParserCode (ParserCTX* ctx);
+#endif /*X_INCLUDE_PARSER*/
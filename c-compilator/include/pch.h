@@ -0,0 +1,28 @@
+#ifndef X_INCLUDE_PCH
+#define X_INCLUDE_PCH
+
+#include "..\include\type.h"
+#include "..\include\symbol.h"
+#include "..\include\pp.h"
+
+//предкомпилированный заголовок: дерево символов и типы, записанные без
+//указателей (индексы и смещения от начала файла); файл отображается mmap,
+//строки используются прямо из отображения
+typedef struct PchCTX {
+    void* map;
+    long long size;
+
+    Symbol* symbols;    //символы и типы восстанавливаются в два массива
+    int symbolCount;
+    Type* types;
+    int typeCount;
+    Type** params;      //массивы paramTypes всех функциональных типов
+
+    Symbol* global;
+} PchCTX;
+
+int PchWrite (const char* filename, const Symbol* Global, const PPCTX* pp, const char* config);
+
+Symbol* PchLoad (PchCTX* ctx, const char* filename, const char* config, PPCTX* pp);
+void PchFree (PchCTX* ctx);
+#endif /*X_INCLUDE_PCH*/
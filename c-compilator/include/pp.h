@@ -0,0 +1,113 @@
+#ifndef X_INCLUDE_PP
+#define X_INCLUDE_PP
+
+#include "..\include\tokens.h"
+#include "..\include\vector.h"
+#include "..\include\hashmap.h"
+
+typedef enum PPTOKEN_FLAGS {
+    PPTOKEN_BOL = 1,        //первый токен в строке
+    PPTOKEN_SPACE = 2,      //перед токеном пробел
+    PPTOKEN_NOEXPAND = 4    //имя макроса, которое больше не раскрывается (6.10.3.4p2)
+} PPTOKEN_FLAGS;
+
+struct PPMacro;
+
+//набор скрытия: макросы, в раскрытии которых появился токен
+typedef struct PPHideSet {
+    const struct PPMacro* macro;
+    const struct PPHideSet* next;
+} PPHideSet;
+
+//токен - отрезок текста файла (или пула препроцессора), текст не копируется
+typedef struct PPToken {
+    TOKEN_TAG tag;
+    int sub;                //KEYWORD_TAG или PUNCT_TAG
+    const char* text;       //написание, у строк вместе с кавычками
+    int length;
+    int flags;
+
+    int file;               //номер в таблице файлов
+    int line;
+    int lineChar;
+
+    const PPHideSet* hide;
+} PPToken;
+
+typedef struct PPMacro {
+    char* name;
+    int kind;               //0 или PP_FILE/PP_LINE/PP_DATE для встроенных
+    int defined;            //0 после #undef, сам макрос остается в наборах скрытия
+
+    int function;
+    int variadic;           //последний параметр принимает остаток аргументов
+    PPToken* params;
+    int paramNo;
+
+    const PPToken* body;    //отрезок строки #define
+    int length;
+} PPMacro;
+
+//токены файла, разобранные один раз за PPCTX; текст - в таблице файлов
+typedef struct PPFile {
+    int id;
+    PPToken* tokens;
+    int count;
+} PPFile;
+
+//источник токенов: файл или результат раскрытия макроса
+typedef struct PPSource {
+    const PPToken* tokens;
+    int pos;
+    int length;
+
+    PPFile* file;           //не 0 - разбираются директивы
+    int conds;              //глубина стека условий при входе в файл
+    int fileId;             //с учетом #line
+    int lineDelta;
+
+    PPToken* owned;
+} PPSource;
+
+//условная компиляция
+typedef struct PPCond {
+    int taken;              //одна из ветвей уже выбрана
+    int hadElse;
+} PPCond;
+
+typedef struct PPCTX {
+    const char* input;
+    Vector paths;           //каталоги -I
+    char* predefs;          //#define из командной строки
+    int predefsLength;
+
+    HashMap macros;         //имя -> PPMacro*
+    Vector files;           //PPFile* по номеру файла
+    IntSet entered;         //номера включенных файлов + 1, для #pragma once
+    Vector sources;         //стек PPSource*
+    Vector conds;           //стек PPCond*
+    Vector pool;            //строки и наборы скрытия, созданные при раскрытии
+
+    int started;
+    int silent;             //не печатать сообщения, только считать
+    int errors;
+    int warnings;
+} PPCTX;
+
+void PPInit (PPCTX* ctx, const char* input);
+void PPFree (PPCTX* ctx);
+
+void PPAddPath (PPCTX* ctx, const char* dir);
+void PPDefine (PPCTX* ctx, const char* definition);
+void PPPredefine (PPCTX* ctx, const char* text, int length);
+void PPMarkEntered (PPCTX* ctx, int id);
+char* PPMacroText (const PPCTX* ctx, int* length);
+
+int PPNext (PPCTX* ctx, PPToken* token);
+
+//pp-lex.c
+PPToken* PPLexText (int file, const char* text, int length, int* count);
+
+//pp-expr.c
+int PPEval (const PPToken* tokens, int length, long long* value, const char** message);
+#endif /*X_INCLUDE_PP*/
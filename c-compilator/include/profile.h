@@ -0,0 +1,56 @@
+#ifndef X_INCLUDE_PROFILE
+#define X_INCLUDE_PROFILE
+
+#include "..\include\ir.h"
+#include "..\include\vector.h"
+#include "..\include\hashmap.h"
+#include "..\include\cache.h"
+
+//профиль по счетчикам ребер: -fprofile-generate ставит счетчики на ребра
+//CFG вне остовного дерева, -fprofile-use восстанавливает по ним остальные
+//ребра и размечает блоки. Файлы текстовые, строка на функцию:
+//  <модуль> <функция> <контрольная сумма CFG> <n> <счетчик>...
+//сырой профиль дописывается каждым запуском после строки PROFILE_RawMagic,
+//индексированный - записи по порядку ключей после заголовка с их числом.
+//В именах пробельные, '\' и непечатаемые байты записываются как \ooo
+
+#define PROFILE_RawMagic "scc-profraw 1"
+#define PROFILE_DataMagic "scc-profdata 1"
+#define PROFILE_Register "__scc_profile_register"   //вход среды выполнения, runtime/profile.c
+
+//счетчики одной функции
+typedef struct ProfileRecord {
+    char* key;          //"модуль функция"
+    char* module;
+    char* fn;
+    char checksum[CACHE_KeyLength + 1];     //форма CFG, с другой профиль не применяется
+    int first;          //номер первого счетчика в массиве модуля
+    int n;
+    long long* counters;
+} ProfileRecord;
+
+//функции модуля со счетчиками, выдаются в данные вместе с регистрацией
+typedef struct ProfileModule {
+    char* name;
+    char* output;       //файл сырого профиля по умолчанию
+    char* label;        //метка массива счетчиков
+    Vector fns;         //ProfileRecord без значений
+    int counters;
+} ProfileModule;
+
+//профиль в памяти: записи по ключу, одинаковые складываются
+typedef struct ProfileData {
+    HashMap records;
+    Vector list;
+} ProfileData;
+
+void ProfileInstrument (IrCTX* ctx, const char* module, const char* output);
+int ProfileAnnotate (IrCTX* ctx, const ProfileData* data, const char* module);
+void ProfileModuleFree (ProfileModule* module);
+char* ProfileEscape (const char* name);
+
+void ProfileInit (ProfileData* data);
+void ProfileFree (ProfileData* data);
+int ProfileRead (ProfileData* data, const char* path);
+int ProfileWrite (const ProfileData* data, const char* path);
+#endif /*X_INCLUDE_PROFILE*/
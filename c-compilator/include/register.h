@@ -19,6 +19,22 @@ typedef enum REG_INDEX {
     REG_R15,
     REG_RBP,
     REG_RSP,
+    REG_XMM0,       //SSE2: float и double, по одному значению в младшей части
+    REG_XMM1,
+    REG_XMM2,
+    REG_XMM3,
+    REG_XMM4,
+    REG_XMM5,
+    REG_XMM6,
+    REG_XMM7,
+    REG_XMM8,
+    REG_XMM9,
+    REG_XMM10,
+    REG_XMM11,
+    REG_XMM12,
+    REG_XMM13,
+    REG_XMM14,
+    REG_XMM15,
     REG_MAX
 } REG_INDEX;
 
@@ -28,16 +44,18 @@ typedef struct Register {
     int allocatedAs;        //если неиспользованный то 0, в противном случае выделенный размер в байтах
 } Register;
 
-extern Register Regs[REG_MAX];
+extern _Thread_local Register Regs[REG_MAX];
 
 const char* RegGetStr (const Register* r);
 const char* RegIndexGetName (REG_INDEX r, int size);
 
 Register* RegAlloc (int size);
+Register* RegAllocFloat (int size);
 void RegFree (Register* r);
 
 Register* RegRequest (REG_INDEX r, int size);
 const Register* RegGet (REG_INDEX r);
 int RegIsUsed (REG_INDEX r);
+int RegIsFloat (REG_INDEX r);
 
 #endif /*X_INCLUDE_REGISTER*/
\ No newline at end of file
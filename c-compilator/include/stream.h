@@ -3,8 +3,13 @@
 
 #include <stdio.h>
 
+//поток символов: файл целиком в памяти, чтобы токены могли
+//ссылаться на исходный текст без копирования
 typedef struct StreamCTX {
-    FILE *file;
+    const char* text;
+    int length;
+    int pos;
+    char* owned;    //текст, прочитанный самим потоком
     
     char current;
     int line;
@@ -12,11 +17,14 @@ typedef struct StreamCTX {
     
 } StreamCTX;
 
+char* StreamReadFile (const char* filename, int* length);
+
 StreamCTX* StreamInit (const char* filename);
+StreamCTX* StreamInitText (const char* text, int length);
 void StreamEnd (StreamCTX* ctx);
 
 char StreamNext (StreamCTX* ctx);
-char StreamPrev (StreamCTX* ctx);
+char StreamPeek (const StreamCTX* ctx);
 
 
-#endif /*X_INCLUDE_STREAM*/
\ No newline at end of file
+#endif /*X_INCLUDE_STREAM*/
@@ -40,6 +40,9 @@ typedef enum TYPEMASK_TAG {
     ///Condition describes whether the type can be tested for boolean
     ///truth
     TYPEMASK_CONDITION = 1 << 4,
+    //для обычных арифметических преобразований
+    TYPEMASK_UNSIGNED = 1 << 5,
+    TYPEMASK_FLOATING = 1 << 6,
     //обобщенные маски
     TYPEMASK_INTEGRAL = TYPEMASK_NUMERIC | TYPEMASK_ORDINAL | TYPEMASK_EQUALITY | TYPEMASK_ASSIGNMENT | TYPEMASK_CONDITION,
     TYPEMASK_BOOL = TYPEMASK_EQUALITY | TYPEMASK_ASSIGNMENT | TYPEMASK_CONDITION,
@@ -48,6 +51,13 @@ typedef enum TYPEMASK_TAG {
     TYPEMASK_ENUM = TYPEMASK_INTEGRAL
 } TYPEMASK_TAG;
 
+//пространства имен C: теги struct/union/enum живут отдельно от прочих имен
+typedef enum SYMBOL_NS {
+    SYMBOL_NS_ANY,
+    SYMBOL_NS_ORDINARY,
+    SYMBOL_NS_TAG
+} SYMBOL_NS;
+
 typedef struct Symbol {
     SYMBOL_TAG tag;
     char* ident;
@@ -61,6 +71,11 @@ typedef struct Symbol {
             Type *dt;
             /*symId symParam*/
             STORAGE_TAG storage;
+            /*symId: _Alignas, 0 - естественное выравнивание*/
+            int alignAs;
+            /*symId функции: область сохранения регистровых параметров в начале
+              локальных переменных, см. AbiParams*/
+            int paramHome;
         };
         
         /*symType symStruct symUnion symEnum*/
@@ -69,6 +84,10 @@ typedef struct Symbol {
             ///A mask defining operator capabilities
             TYPEMASK_TAG typeMask;
             int complete;
+            /*выравнивание; у записи до раскладки - запрошенное aligned*/
+            int align;
+            /*symStruct symUnion: __attribute__((packed))*/
+            int packed;
         };
     };
        
@@ -89,4 +108,23 @@ typedef struct Symbol {
         int hasConstFields;
     };
 } Symbol;
+
+Symbol* SymbolInit ();
+void SymbolEnd (Symbol* Global);
+
+Symbol* SymbolCreateScope (Symbol* Parent);
+Symbol* SymbolCreateModuleLink (Symbol* parent, const Symbol* module);
+Symbol* SymbolCreateType (Symbol* Parent, const char* ident, int size, TYPEMASK_TAG typeMask);
+Symbol* SymbolCreateNamed (SYMBOL_TAG tag, Symbol* Parent, const char* ident);
+void SymbolChangeParent (Symbol* Child, Symbol* parent);
+
+int SymbolIsFunction (const Symbol* Fn);
+const Symbol* SymbolGetNthParam (const Symbol* fn, int n);
+Symbol* SymbolChild (const Symbol* Scope, const char* look);
+Symbol* SymbolFind (const Symbol* Scope, const char* look);
+Symbol* SymbolChildNs (const Symbol* Scope, const char* look, SYMBOL_NS ns);
+Symbol* SymbolFindNs (const Symbol* Scope, const char* look, SYMBOL_NS ns);
+
+const char* SymbolTagGetStr (SYMBOL_TAG tag);
+const char* StorageTagGetStr (STORAGE_TAG tag);
 #endif /*X_INCLUDE_SYMBOL*/
\ No newline at end of file
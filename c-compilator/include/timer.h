@@ -0,0 +1,38 @@
+#ifndef X_INCLUDE_TIMER
+#define X_INCLUDE_TIMER
+#include <stdio.h>
+
+//фазы компиляции для -ftime-report и -ftime-trace
+typedef enum TIMER_PHASE {
+    TIMER_TOTAL,
+    TIMER_LEX,          //токены файла и их перевод для парсера
+    TIMER_PREPROCESS,   //директивы и раскрытие макросов
+    TIMER_PARSE,
+    TIMER_ANALYZE,
+    TIMER_SELECT,       //наполнение функций IR: выбор команд и регистров
+    TIMER_OPTIMISE,     //проходы по IR
+    TIMER_PROFILE,      //-fprofile-generate и -fprofile-use
+    TIMER_REGALLOC,     //выбор регистров во время выдачи
+    TIMER_EMIT,
+    TIMER_PCH,
+    TIMER_MAX
+} TIMER_PHASE;
+
+//замеры включены TimerInit. Проверка - в месте вызова: без -ftime-report
+//и -ftime-trace интервалы в лексере и препроцессоре не стоят вызова
+extern int timerOn;
+
+#define TimerEnter(phase, detail) (timerOn ? TimerPhaseEnter(phase, detail) : (void) 0)
+#define TimerEnterFn(phase, fn) (timerOn ? TimerPhaseEnterFn(phase, fn) : (void) 0)
+#define TimerLeave() (timerOn ? TimerPhaseLeave() : (void) 0)
+
+void TimerInit (void);
+void TimerFree (void);
+
+void TimerPhaseEnter (TIMER_PHASE phase, const char* detail);
+void TimerPhaseEnterFn (TIMER_PHASE phase, const char* fn);
+void TimerPhaseLeave (void);
+
+void TimerReport (FILE* file);
+int TimerWriteTrace (const char* filename);
+#endif /*X_INCLUDE_TIMER*/
@@ -0,0 +1,84 @@
+#ifndef X_INCLUDE_TOKEN_BUFFER
+#define X_INCLUDE_TOKEN_BUFFER
+
+#include <stdint.h>
+
+#include "..\include\lexer.h"
+#include "..\include\hashmap.h"
+
+typedef enum TOKEN_FLAGS {
+    TOKEN_BOL = 1,          //первый токен в строке
+    TOKEN_SPACE = 2,        //перед токеном пробел
+    TOKEN_FILE = 4          //с этого токена другой файл: см. marks
+} TOKEN_FLAGS;
+
+//компактная запись токена, 24 байта; текст не копируется -
+//это отрезок одного из буферов sources
+typedef struct Token {
+    uint8_t tag;            //TOKEN_TAG
+    uint8_t flags;
+    uint16_t sub;           //KEYWORD_TAG или PUNCT_TAG
+    uint16_t source;        //0 - пул буфера, иначе текст файла
+    int32_t lineChar;
+    int32_t offset;
+    int32_t length;
+    int32_t lineDelta;      //строк от предыдущего токена, у TOKEN_FILE - номер строки
+} Token;
+
+//смена файла: номер токена и файл, с которого он идет
+typedef struct TokenMark {
+    int index;
+    int file;
+} TokenMark;
+
+//текст, на который ссылаются токены
+typedef struct TokenSource {
+    const char* text;
+    int length;
+} TokenSource;
+
+//все токены единицы трансляции подряд: лексер разбирается вперед
+//кусками по мере того, как парсер заглядывает дальше
+typedef struct TokenBuffer {
+    LexerCTX* lexer;        //не принадлежит буферу
+
+    Token* tokens;
+    int length;
+    int capacity;
+
+    TokenMark* marks;
+    int markNo;
+    int markCapacity;
+
+    TokenSource* sources;
+    int sourceNo;
+    int sourceCapacity;
+    int* order;             //номера sources по возрастанию адреса текста
+    IntMap fileSource;      //номер файла + 2 -> номер в sources (ключ 0 занят)
+    int fileNo;             //файлов таблицы, уже добавленных в sources
+
+    char* pool;             //написание токенов, которых нет в тексте файлов
+    int poolLength;
+    int poolCapacity;
+
+    /*позиция разбора*/
+    int pos;
+    int file;
+    int line;
+    int mark;               //следующая непримененная смена файла
+
+    /*позиция последнего прочитанного у лексера токена*/
+    int lastFile;
+    int lastLine;
+} TokenBuffer;
+
+void TokenBufferInit (TokenBuffer* buffer, LexerCTX* lexer);
+void TokenBufferFree (TokenBuffer* buffer);
+
+const Token* TokenBufferPeek (TokenBuffer* buffer, int k);
+void TokenBufferNext (TokenBuffer* buffer);
+void TokenBufferSeek (TokenBuffer* buffer, int pos, int line);
+
+const char* TokenBufferText (const TokenBuffer* buffer, const Token* token);
+char* TokenBufferDup (const TokenBuffer* buffer, const Token* token);
+#endif /*X_INCLUDE_TOKEN_BUFFER*/
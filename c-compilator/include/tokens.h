@@ -11,6 +11,7 @@ typedef enum TOKEN_TAG {
     TOK_PUNCT,
     TOK_IDENT,
     TOK_INT,
+    TOK_FLOAT,
     TOK_CHR,
     TOK_STR,
 } TOKEN_TAG; 
@@ -44,6 +45,7 @@ typedef enum KEYWORD_TAG {
     
     KEYWORD_TYPEDEF,
     KEYWORD_ALIGN,
+    KEYWORD_ATTRIBUTE,
     KEYWORD_EXTERN,
     KEYWORD_AUTO,
     KEYWORD_CONST,
@@ -126,6 +128,10 @@ typedef enum PUNCT_TAG {
     
     PUNCT_PLUSPLUS,
     PUNCT_MINMIN,
+
+    // препроцессор
+    PUNCT_HASH,
+    PUNCT_HASHHASH,
     
       
     
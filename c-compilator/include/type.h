@@ -54,6 +54,7 @@ typedef struct Type {
 
 const char* TypeTagGetStr (TYPE_TAG tag);
 int TypeGetSize (const Arch* arch, const Type* dt);
+int TypeGetAlign (const Arch* arch, const Type* dt);
 
 char* TypeToStr (const Type* dt);
 char* TypeToStrEmbed (const Type* dt, const char* embedded);
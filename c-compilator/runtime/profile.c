@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+//среда выполнения -fprofile-generate: собирается системным компилятором
+//вместе с программой. Каждый модуль регистрируется конструктором, при выходе
+//счетчики дописываются в сырой профиль, см. include/profile.h
+
+//функция модуля, выдается AsmProfileData
+typedef struct ScProfileFn {
+    const char* name;
+    const char* checksum;
+    intptr_t first;
+    intptr_t n;
+} ScProfileFn;
+
+typedef struct ScProfileModule {
+    const char* name;
+    const char* output;
+    const ScProfileFn* fns;
+    intptr_t nfns;
+    const long long* counters;
+    struct ScProfileModule* next;
+} ScProfileModule;
+
+static ScProfileModule* ScProfileModules = 0;
+
+//внутренние функции
+static void ScProfileDump (void)
+{
+    const char* override = getenv("SCC_PROFILE_FILE");
+
+    for (ScProfileModule* module = ScProfileModules; module; module = module->next)
+    {
+        FILE* file = fopen(override ? override : module->output, "a");
+
+        if (!file) continue;
+
+        fprintf(file, "scc-profraw 1\n");
+
+        for (intptr_t i = 0; i < module->nfns; i++)
+        {
+            const ScProfileFn* fn = &module->fns[i];
+
+            fprintf(file, "%s %s %s %d", module->name, fn->name, fn->checksum, (int) fn->n);
+
+            for (intptr_t j = 0; j < fn->n; j++)
+                fprintf(file, " %lld", module->counters[fn->first + j]);
+
+            fputc('\n', file);
+        }
+
+        fclose(file);
+    }
+}
+
+void __scc_profile_register (ScProfileModule* module)
+{
+    if (!ScProfileModules) atexit(ScProfileDump);
+
+    module->next = ScProfileModules;
+    ScProfileModules = module;
+}
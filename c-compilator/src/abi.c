@@ -0,0 +1,389 @@
+#include <stdlib.h>
+
+#include "..\include\abi.h"
+#include "..\include\type.h"
+#include "..\include\layout.h"
+#include "..\include\debug.h"
+
+enum {
+    ABI_Eightbyte = 8,
+    ABI_MaxRegSize = 16,    //SysV: записи больше передаются в памяти
+    ABI_WinHome = 4         //Win64: позиции с регистрами и теневыми слотами
+};
+
+//внутренние функции
+static int AbiRound (int offset, int align)
+{
+    return (offset + align - 1) / align * align;
+}
+
+static int AbiIsFloating (const Type* dt)
+{
+    const Symbol* basic = TypeGetBasic(dt);
+
+    return basic && basic->tag == SYMBOL_TYPE && (basic->typeMask & TYPEMASK_FLOATING);
+}
+
+//массивы и функции в параметрах передаются как указатели
+static int AbiIsPointerLike (const Type* dt)
+{
+    return !TypeIsInvalid(dt) && (TypeIsArray(dt) || TypeIsFunction(dt));
+}
+
+static ABI_CLASS AbiMerge (ABI_CLASS l, ABI_CLASS r)
+{
+    if (l == r || r == ABI_NONE) return l;
+    else if (l == ABI_NONE) return r;
+    else if (l == ABI_MEMORY || r == ABI_MEMORY) return ABI_MEMORY;
+    else
+        return ABI_INTEGER;
+}
+
+static void AbiClassifyAt (const Arch* arch, const Type* dt, int offset, ABI_CLASS* classes);
+
+//поля записи уже имеют смещения от ее начала, в т.ч. поля анонимных членов
+static void AbiClassifyRecord (const Arch* arch, const Symbol* Record, int offset, ABI_CLASS* classes)
+{
+    for (int i = 0; i < Record->children.length; i++)
+    {
+        const Symbol* Child = VectorGet(&Record->children, i);
+
+        if (Child->tag == SYMBOL_ID && Child->dt) AbiClassifyAt(arch, Child->dt, offset + Child->offset, classes);
+        else if (LayoutIsAnonMember(Record, Child))
+            AbiClassifyRecord(arch, Child, offset, classes);
+    }
+}
+
+//SysV: каждая восьмерка получает класс всех скаляров, которые в нее попали
+static void AbiClassifyAt (const Arch* arch, const Type* dt, int offset, ABI_CLASS* classes)
+{
+    int size = TypeGetSize(arch, dt);
+    int align = TypeGetAlign(arch, dt);
+
+    if (TypeIsInvalid(dt) || size <= 0) return;
+
+    /*невыровненное поле упакованной записи*/
+    if (align > 0 && offset % align != 0) classes[0] = ABI_MEMORY;
+
+    else if (TypeIsArray(dt))
+    {
+        const Type* base = TypeGetBase(dt);
+        int step = TypeGetSize(arch, base);
+
+        for (int i = 0; step > 0 && i < TypeGetArraySize(dt); i++)
+            AbiClassifyAt(arch, base, offset + i * step, classes);
+    }
+    else if (TypeIsStruct(dt) || TypeIsUnion(dt))
+        AbiClassifyRecord(arch, TypeGetBasic(dt), offset, classes);
+
+    else
+    {
+        /*long double - x87, всегда в памяти*/
+        ABI_CLASS cls = !AbiIsFloating(dt) ? ABI_INTEGER : size > ABI_Eightbyte ? ABI_MEMORY : ABI_SSE;
+        int nth = offset / ABI_Eightbyte;
+
+        if (nth < ABI_Eightbytes) classes[nth] = AbiMerge(classes[nth], cls);
+    }
+}
+
+static AbiArg AbiArgCreate (int size)
+{
+    return (AbiArg) {size, {ABI_NONE, ABI_NONE}, {REG_UNDEFINED, REG_UNDEFINED}, {-1, -1}, 0, 0, -1, -1, 0};
+}
+
+//классы восьмерок или 0, если значение передается в памяти
+static int AbiClassify (const Arch* arch, const Type* dt, ABI_CLASS* classes)
+{
+    int size = TypeGetSize(arch, dt);
+
+    classes[0] = classes[1] = ABI_NONE;
+
+    if (size <= 0 || size > ABI_MaxRegSize) return 0;
+
+    AbiClassifyAt(arch, dt, 0, classes);
+
+    for (int i = 0; i < ABI_Eightbytes; i++)
+    {
+        if (classes[i] == ABI_MEMORY) return 0;
+        /*восьмерка из одного заполнения едет в целочисленном регистре*/
+        else if (classes[i] == ABI_NONE && i * ABI_Eightbyte < size) classes[i] = ABI_INTEGER;
+    }
+
+    return 1;
+}
+
+//слот в области аргументов: восьмерки, 16 байт для сильнее выровненных;
+//на 32 битах - слова стека без дополнительного выравнивания
+static void AbiArgStack (const Arch* arch, const Type* dt, AbiArg* arg, int* stack)
+{
+    int align = arch->wordsize;
+
+    if (arch->wordsize == 8 && TypeGetAlign(arch, dt) > ABI_Eightbyte) align = ABI_MaxRegSize;
+
+    arg->classes[0] = arg->classes[1] = ABI_MEMORY;
+    arg->offset = AbiRound(*stack, align);
+    *stack = arg->offset + AbiRound(arg->size, arch->wordsize);
+}
+
+//SysV: все восьмерки в регистрах или весь аргумент в стеке
+static void AbiArgSysV (const Arch* arch, const Type* dt, AbiArg* arg, int* ints, int* sses, int* stack)
+{
+    ABI_CLASS classes[ABI_Eightbytes];
+
+    if (arch->wordsize == 8 && AbiClassify(arch, dt, classes))
+    {
+        int eightbytes = AbiRound(arg->size, ABI_Eightbyte) / ABI_Eightbyte;
+        int needInts = 0, needSses = 0;
+
+        for (int i = 0; i < eightbytes; i++)
+        {
+            if (classes[i] == ABI_SSE) needSses++;
+            else
+                needInts++;
+        }
+
+        if (*ints + needInts <= arch->argRegs.length && *sses + needSses <= arch->sseArgRegs)
+        {
+            for (int i = 0; i < eightbytes; i++)
+            {
+                arg->classes[i] = classes[i];
+
+                if (classes[i] == ABI_SSE) arg->xmms[i] = (*sses)++;
+                else
+                    arg->regs[i] = (REG_INDEX) VectorGet(&arch->argRegs, (*ints)++);
+            }
+
+            arg->eightbytes = eightbytes;
+            return;
+        }
+    }
+
+    AbiArgStack(arch, dt, arg, stack);
+}
+
+//Win64: позиция аргумента определяет и регистр, и слот; записи не из 1, 2, 4
+//или 8 байт передаются указателем на копию; dt = 0 - указатель
+static void AbiArgWin64 (const Arch* arch, const Type* dt, AbiArg* arg, int pos, int variadic)
+{
+    int size = arg->size;
+
+    arg->offset = pos * ABI_Eightbyte;
+    arg->byRef = dt && (TypeIsStruct(dt) || TypeIsUnion(dt)) && size != 1 && size != 2 && size != 4 && size != 8;
+
+    if (pos >= arch->argRegs.length)
+    {
+        arg->classes[0] = ABI_MEMORY;
+        return;
+    }
+
+    arg->eightbytes = 1;
+
+    if (dt && AbiIsFloating(dt) && !arg->byRef)
+    {
+        arg->classes[0] = ABI_SSE;
+        arg->xmms[0] = pos;
+
+        /*вариативный вызов дублирует значение в целочисленный регистр*/
+        if (variadic) arg->regs[0] = (REG_INDEX) VectorGet(&arch->argRegs, pos);
+    }
+    else
+    {
+        arg->classes[0] = ABI_INTEGER;
+        arg->regs[0] = (REG_INDEX) VectorGet(&arch->argRegs, pos);
+    }
+}
+
+//возвращаемое значение: RAX/RDX и XMM0/XMM1 или скрытый указатель
+static void AbiReturn (const Arch* arch, const Type* dt, AbiCall* call)
+{
+    ABI_CLASS classes[ABI_Eightbytes];
+    REG_INDEX intRets[ABI_Eightbytes] = {REG_RAX, REG_RDX};
+    int size = !dt || TypeIsVoid(dt) ? 0 : TypeGetSize(arch, dt);
+    int isRecord, inRegs;
+
+    call->ret = AbiArgCreate(size);
+
+    if (size == 0) return;
+
+    isRecord = TypeIsStruct(dt) || TypeIsUnion(dt);
+
+    if (arch->os == OS_WINDOWS)
+        inRegs = !isRecord || size == 1 || size == 2 || size == 4 || size == 8;
+
+    else if (arch->wordsize == 8)
+        inRegs = AbiClassify(arch, dt, classes);
+
+    else
+        inRegs = !isRecord;
+
+    if (!inRegs)
+    {
+        call->ret.classes[0] = ABI_MEMORY;
+        return;
+    }
+    /*32 бита: плавающие возвращаются в st0, регистров не занимают*/
+    else if (arch->wordsize != 8 && AbiIsFloating(dt)) return;
+
+    /*Win64 и 32 бита: одна или две части по слову в RAX, RDX или XMM0*/
+    if (arch->os == OS_WINDOWS || arch->wordsize != 8)
+    {
+        classes[0] = AbiIsFloating(dt) ? ABI_SSE : ABI_INTEGER;
+        classes[1] = size > arch->wordsize && classes[0] == ABI_INTEGER ? ABI_INTEGER : ABI_NONE;
+    }
+
+    for (int i = 0, ints = 0, sses = 0; i < ABI_Eightbytes && classes[i] != ABI_NONE; i++)
+    {
+        call->ret.classes[i] = classes[i];
+
+        if (classes[i] == ABI_SSE) call->ret.xmms[i] = sses++;
+        else
+            call->ret.regs[i] = intRets[ints++];
+
+        call->ret.eightbytes++;
+    }
+}
+
+//размещение аргументов вызова функции типа fn; аргументы после
+//объявленных параметров - вариативные, с уже продвинутыми типами
+void AbiCallInit (AbiCall* call, const Arch* arch, const Type* fn, const Type** argTypes, int n)
+{
+    fn = fn ? TypeGetCallable(fn) : 0;
+
+    int ints = 0, sses = 0, stack = 0, pos = 0;
+
+    call->args = malloc(sizeof(AbiArg) * (n + 1));
+    call->n = n;
+    call->retPtr = REG_UNDEFINED;
+    call->retOffset = -1;
+    call->retHome = 0;
+
+    AbiReturn(arch, TypeGetReturn(fn), call);
+
+    /*скрытый указатель на результат занимает первый аргумент*/
+    if (call->ret.classes[0] == ABI_MEMORY)
+    {
+        if (arch->argRegs.length) call->retPtr = (REG_INDEX) VectorGet(&arch->argRegs, 0);
+        else
+            call->retOffset = 0;
+
+        if (arch->os == OS_WINDOWS) pos++;
+        else if (arch->argRegs.length) ints++;
+        else
+            stack += arch->wordsize;
+    }
+
+    for (int i = 0; i < n; i++, pos++)
+    {
+        const Type* dt = argTypes[i];
+        AbiArg* arg = &call->args[i];
+
+        *arg = AbiArgCreate(AbiIsPointerLike(dt) ? arch->wordsize : TypeGetSize(arch, dt));
+
+        if (AbiIsPointerLike(dt)) dt = 0;
+
+        if (arch->os == OS_WINDOWS && arch->wordsize == 8)
+            AbiArgWin64(arch, dt, arg, pos, fn && i >= fn->params);
+
+        else if (!dt)
+        {
+            /*указатель - одно целочисленное слово*/
+            if (ints < arch->argRegs.length)
+            {
+                arg->classes[0] = ABI_INTEGER;
+                arg->regs[0] = (REG_INDEX) VectorGet(&arch->argRegs, ints++);
+                arg->eightbytes = 1;
+            }
+            else
+            {
+                arg->classes[0] = ABI_MEMORY;
+                arg->offset = AbiRound(stack, arch->wordsize);
+                stack = arg->offset + arch->wordsize;
+            }
+        }
+        else
+            AbiArgSysV(arch, dt, arg, &ints, &sses, &stack);
+    }
+
+    /*Win64: слоты по позициям, теневая область есть всегда, за ней копии byRef*/
+    if (arch->os == OS_WINDOWS && arch->wordsize == 8)
+    {
+        stack = (pos > ABI_WinHome ? pos : ABI_WinHome) * ABI_Eightbyte;
+
+        for (int i = 0; i < n; i++)
+        {
+            if (!call->args[i].byRef) continue;
+
+            call->args[i].copy = AbiRound(stack, TypeGetAlign(arch, argTypes[i]) > ABI_Eightbyte ? ABI_MaxRegSize : ABI_Eightbyte);
+            stack = call->args[i].copy + AbiRound(call->args[i].size, ABI_Eightbyte);
+        }
+    }
+
+    call->sseUsed = sses;
+    call->stackSize = AbiRound(stack, arch->stackAlign > 0 ? arch->stackAlign : arch->wordsize);
+}
+
+void AbiCallFree (AbiCall* call)
+{
+    free(call->args);
+    call->args = 0;
+    call->n = 0;
+}
+
+//смещения параметров от базы кадра: переданные в стеке лежат над адресом
+//возврата и сохраненной базой, регистровые SysV сохраняются под базой;
+//возвращает размер этой области, ее место - в начале локальных переменных
+int AbiParams (const Arch* arch, Symbol* Fn, AbiCall* call)
+{
+    AbiCall local;
+    const Type* fn = Fn->dt ? TypeGetCallable(Fn->dt) : 0;
+    int home = 0, nth = 0;
+
+    if (!fn) return 0;
+
+    if (!call) call = &local;
+
+    AbiCallInit(call, arch, fn, (const Type**) fn->paramTypes, fn->params);
+
+    /*скрытый указатель на результат*/
+    if (call->retPtr != REG_UNDEFINED && arch->os != OS_WINDOWS)
+    {
+        home += ABI_Eightbyte;
+        call->retHome = -home;
+    }
+    else if (call->retPtr != REG_UNDEFINED) call->retHome = 2 * arch->wordsize;
+    else if (call->retOffset >= 0) call->retHome = 2 * arch->wordsize + call->retOffset;
+
+    for (int i = 0; i < Fn->children.length && nth < call->n; i++)
+    {
+        Symbol* Param = VectorGet(&Fn->children, i);
+        AbiArg* arg = &call->args[nth];
+
+        if (Param->tag != SYMBOL_PARAM) continue;
+
+        if (arg->offset >= 0) arg->home = 2 * arch->wordsize + arg->offset;
+        else
+        {
+            home += arg->eightbytes * ABI_Eightbyte;
+            arg->home = -home;
+        }
+
+        Param->offset = arg->home;
+
+        nth++;
+    }
+
+    if (call == &local) AbiCallFree(&local);
+
+    return home;
+}
+
+//размер локальной области, при котором после пролога (адрес возврата,
+//база, локальные, сохраненные регистры) стек выровнен для вызовов
+int AbiFrameSize (const Arch* arch, int localSize)
+{
+    int fixed = 2 * arch->wordsize + arch->calleeSaveRegs.length * arch->wordsize;
+
+    if (arch->stackAlign <= 0) return localSize;
+
+    return AbiRound(localSize + fixed, arch->stackAlign) - fixed;
+}
@@ -0,0 +1,1443 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "..\include\analyzer.h"
+#include "..\include\type.h"
+#include "..\include\symbol.h"
+#include "..\include\layout.h"
+#include "..\include\abi.h"
+#include "..\include\error.h"
+#include "..\include\debug.h"
+#include "..\include\timer.h"
+
+enum {
+    ANALYZER_StackSize = 64,
+    ANALYZER_MaxAlign = 16      //aligned без аргумента
+};
+
+//внутренние функции
+static void AnalyzerPush (AnalyzerCTX* ctx, Ast* Node, Ast* Parent, ANALYZER_ROLE role, const Type* target)
+{
+    if (!Node) return;
+
+    if (ctx->depth == ctx->capacity)
+    {
+        ctx->capacity *= 2;
+        ctx->stack = realloc(ctx->stack, sizeof(AnalyzerFrame) * ctx->capacity);
+    }
+
+    ctx->stack[ctx->depth++] = (AnalyzerFrame) {Node, Parent, target, role, 0, 0};
+}
+
+//выражение на месте оператора обходится как значение
+static void AnalyzerPushStmt (AnalyzerCTX* ctx, Ast* Node, Ast* Parent)
+{
+    if (Node) AnalyzerPush(ctx, Node, Parent, AstIsValueTag(Node->tag) ? ANALYZER_VALUE : ANALYZER_STMT, 0);
+}
+
+//дети кладутся в порядке исходного текста, а сниматься должны так же
+static void AnalyzerReverse (AnalyzerCTX* ctx, int first)
+{
+    for (int i = first, j = ctx->depth - 1; i < j; i++, j--)
+    {
+        AnalyzerFrame frame = ctx->stack[i];
+        ctx->stack[i] = ctx->stack[j];
+        ctx->stack[j] = frame;
+    }
+}
+
+static const Symbol* AnalyzerBuiltin (AnalyzerCTX* ctx, const char* ident)
+{
+    const Symbol* Symbol = SymbolFind(ctx->module, ident);
+
+    if (!Symbol || Symbol->tag != SYMBOL_TYPE)
+    {
+        DebugError("AnalyzerBuiltin", "нет встроенного типа %s", ident);
+        return 0;
+    }
+
+    return Symbol;
+}
+
+//целый тип размером в слово: size_t и ptrdiff_t по модели данных цели
+static const Symbol* AnalyzerWordType (AnalyzerCTX* ctx, int isUnsigned)
+{
+    const Symbol* Long = AnalyzerBuiltin(ctx, isUnsigned ? "unsigned long" : "long");
+
+    if (Long && Long->size == ctx->arch->wordsize) return Long;
+
+    return AnalyzerBuiltin(ctx, isUnsigned ? "unsigned long long" : "long long");
+}
+
+static Type* AnalyzerCreateBasic (const Symbol* basic)
+{
+    return basic ? TypeCreateBasic(basic) : TypeCreateInvalid();
+}
+
+static int AnalyzerIsInvalid (const Type* dt)
+{
+    return !dt || TypeIsInvalid(dt);
+}
+
+//арифметический тип: встроенный числовой или перечисление
+static const Symbol* AnalyzerArithBasic (const Type* dt)
+{
+    const Symbol* basic = dt ? TypeGetBasic(dt) : 0;
+
+    return basic && (basic->tag == SYMBOL_TYPE || basic->tag == SYMBOL_ENUM) && (basic->typeMask & TYPEMASK_NUMERIC) ? basic : 0;
+}
+
+static int AnalyzerIsInteger (const Type* dt)
+{
+    const Symbol* basic = AnalyzerArithBasic(dt);
+    return basic && !(basic->typeMask & TYPEMASK_FLOATING);
+}
+
+//указатель или массив, который превращается в указатель
+static int AnalyzerIsPointer (const Type* dt)
+{
+    return dt && !TypeIsInvalid(dt) && TypeGetBase(dt) != 0;
+}
+
+//целочисленное расширение: все, что короче int, и перечисления - в int
+static const Symbol* AnalyzerPromote (AnalyzerCTX* ctx, const Symbol* basic)
+{
+    if (basic->tag == SYMBOL_ENUM) return ctx->intType;
+    else if (!(basic->typeMask & TYPEMASK_FLOATING) && basic->size < ctx->intType->size) return ctx->intType;
+    else
+        return basic;
+}
+
+//ранг целого типа (6.3.1.1): char < short < int < long < long long, знак
+//не влияет; long и long long различаются рангом и при равном размере
+static int AnalyzerRank (const Symbol* basic)
+{
+    static const char* const ranks[] = {"char", "short", "int", "long", "long long"};
+    const char* ident = basic->ident;
+
+    if (!strncmp(ident, "unsigned ", 9)) ident += 9;
+
+    for (int i = 0; i < (int) (sizeof(ranks)/sizeof(*ranks)); i++)
+        if (!strcmp(ident, ranks[i])) return i;
+
+    return basic->size <= 4 ? basic->size / 2 : 4;
+}
+
+//обычные арифметические преобразования (6.3.1.8)
+static const Symbol* AnalyzerArithmetic (AnalyzerCTX* ctx, const Symbol* L, const Symbol* R)
+{
+    L = AnalyzerPromote(ctx, L);
+    R = AnalyzerPromote(ctx, R);
+
+    int floatL = L->typeMask & TYPEMASK_FLOATING, floatR = R->typeMask & TYPEMASK_FLOATING;
+
+    if (floatL || floatR)
+    {
+        if (floatL && floatR) return L->size >= R->size ? L : R;
+        else
+            return floatL ? L : R;
+    }
+    else if (L == R)
+        return L;
+
+    int unsignedL = L->typeMask & TYPEMASK_UNSIGNED, unsignedR = R->typeMask & TYPEMASK_UNSIGNED;
+
+    if (!unsignedL == !unsignedR) return AnalyzerRank(L) >= AnalyzerRank(R) ? L : R;
+
+    const Symbol* Unsigned = unsignedL ? L : R;
+    const Symbol* Signed = unsignedL ? R : L;
+
+    if (AnalyzerRank(Unsigned) >= AnalyzerRank(Signed)) return Unsigned;
+
+    /*знаковый шире - вмещает все значения беззнакового*/
+    else if (Signed->size > Unsigned->size) return Signed;
+
+    /*иначе беззнаковый знакового: long и unsigned int при LLP64 - unsigned long*/
+    char ident[32];
+    snprintf(ident, sizeof(ident), "unsigned %s", Signed->ident);
+
+    const Symbol* Found = AnalyzerBuiltin(ctx, ident);
+    return Found ? Found : Unsigned;
+}
+
+//конец спины декларатора: имя или пустое место
+static Ast* AnalyzerDeclLeaf (Ast* Node)
+{
+    while (Node)
+    {
+        if (Node->tag == AST_UOP || Node->tag == AST_CONST) Node = Node->r;
+        else if (Node->tag == AST_INDEX || Node->tag == AST_CALL) Node = Node->l;
+        else
+            return Node;
+    }
+
+    return 0;
+}
+
+//число элементов списка инициализации массива с учетом [n] = ...
+static int AnalyzerInitLength (const AnalyzerCTX* ctx, const Ast* Init)
+{
+    long position = 0, length = 0;
+
+    for (const Ast* Current = Init->firstChild; Current; Current = Current->nextSibling, position++)
+    {
+        if (Current->tag == AST_MARKER && Current->marker == MARKER_ArrayDesignatedInit)
+            AnalyzerConstValue(ctx->arch, Current->l, &position);
+
+        if (position + 1 > length) length = position + 1;
+    }
+
+    return length;
+}
+
+//число символов строки: escape-последовательности разбираются как в парсере
+static int AnalyzerStrLength (const char* str)
+{
+    int length = 0;
+
+    for (; *str; length++)
+        ParserEscape(&str);
+
+    return length;
+}
+
+//тип целой константы (6.4.4.1): первый из подходящих по суффиксу, в
+//котором помещается значение. Восьмеричным и шестнадцатеричным без u
+//подходят и беззнаковые
+static const Symbol* AnalyzerIntLiteralType (AnalyzerCTX* ctx, const IntLiteral* literal)
+{
+    static const char* const types[] = {"int", "unsigned int", "long", "unsigned long", "long long", "unsigned long long"};
+
+    for (int i = 2*literal->longs; i < 6; i++)
+    {
+        int isUnsigned = i % 2;
+
+        if (isUnsigned ? !literal->isUnsigned && literal->isDecimal : literal->isUnsigned) continue;
+
+        const Symbol* Type = AnalyzerBuiltin(ctx, types[i]);
+
+        if (!Type) continue;
+
+        int bits = Type->size*8 - !isUnsigned;
+
+        if (bits >= 64 || literal->value >> bits == 0) return Type;
+    }
+
+    /*не помещается ни в один знаковый: как у gcc, unsigned long long*/
+    return AnalyzerBuiltin(ctx, "unsigned long long");
+}
+
+//значение, приведенное к целому размера size: старшие биты отбрасываются,
+//у знакового знак расширяется
+static long AnalyzerConstTruncate (long value, int size, int isUnsigned)
+{
+    if (size <= 0 || size >= (int) sizeof(long)) return value;
+
+    unsigned long mask = (1UL << size*8) - 1, bits = (unsigned long) value & mask;
+
+    if (!isUnsigned && (bits >> (size*8 - 1))) bits |= ~mask;
+
+    return (long) bits;
+}
+
+//размер и знак целого типа; у прочих и неизвестных - long
+static void AnalyzerConstType (const Type* dt, int* size, int* isUnsigned)
+{
+    const Symbol* basic = AnalyzerArithBasic(dt);
+
+    if (basic && !(basic->typeMask & TYPEMASK_FLOATING) && basic->size > 0)
+    {
+        *size = basic->size;
+        *isUnsigned = (basic->typeMask & TYPEMASK_UNSIGNED) != 0;
+    }
+    else
+    {
+        *size = sizeof(long);
+        *isUnsigned = 0;
+    }
+}
+
+static long AnalyzerConstWrap (const Type* dt, long value)
+{
+    int size, isUnsigned;
+    AnalyzerConstType(dt, &size, &isUnsigned);
+
+    return AnalyzerConstTruncate(value, size, isUnsigned);
+}
+
+//тип после целочисленного расширения: короче int - int
+static void AnalyzerConstPromoted (const Type* dt, int* size, int* isUnsigned)
+{
+    AnalyzerConstType(dt, size, isUnsigned);
+
+    if (*size < 4)
+    {
+        *size = 4;
+        *isUnsigned = 0;
+    }
+}
+
+//общий тип обычных арифметических преобразований; для значения важны
+//только размер и знак, так что ранг здесь не нужен
+static void AnalyzerConstCommon (const Type* L, const Type* R, int* size, int* isUnsigned)
+{
+    int sizeL, unsignedL, sizeR, unsignedR;
+
+    AnalyzerConstPromoted(L, &sizeL, &unsignedL);
+    AnalyzerConstPromoted(R, &sizeR, &unsignedR);
+
+    if (unsignedL == unsignedR || (unsignedL ? sizeL >= sizeR : sizeR >= sizeL))
+    {
+        *size = sizeL > sizeR ? sizeL : sizeR;
+        *isUnsigned = unsignedL || unsignedR;
+    }
+    else
+    {
+        *size = unsignedL ? sizeR : sizeL;
+        *isUnsigned = 0;
+    }
+}
+
+/*свертка в общем типе операндов: переполнение заворачивается по ширине типа,
+  деление и сравнение беззнаковых - беззнаковые. Неопределенное поведение
+  (деление на 0, минимум на -1, сдвиг за ширину) - не константа*/
+static int AnalyzerConstBOP (OP_TAG o, const Type* L, const Type* R, long l, long r, long* value)
+{
+    int size, isUnsigned;
+    AnalyzerConstCommon(L, R, &size, &isUnsigned);
+
+    if (o == OP_SHL || o == OP_SHR)
+    {
+        AnalyzerConstPromoted(L, &size, &isUnsigned);
+
+        if (r < 0 || r >= size*8) return 0;
+
+        l = AnalyzerConstTruncate(l, size, isUnsigned);
+
+        if (o == OP_SHL) *value = AnalyzerConstTruncate((long) ((unsigned long) l << r), size, isUnsigned);
+        else
+            *value = isUnsigned ? (long) ((unsigned long) l >> r) : l >> r;
+
+        return 1;
+    }
+
+    l = AnalyzerConstTruncate(l, size, isUnsigned);
+    r = AnalyzerConstTruncate(r, size, isUnsigned);
+
+    unsigned long a = l, b = r;
+    long min = AnalyzerConstTruncate(1UL << (size*8 - 1), size, 0);
+
+    switch (o)
+    {
+        case OP_PLUS: *value = (long) (a + b); break;
+        case OP_MIN: *value = (long) (a - b); break;
+        case OP_MUL: *value = (long) (a * b); break;
+
+        case OP_DIV:
+        case OP_MOD:
+            if (r == 0 || (!isUnsigned && r == -1 && l == min)) return 0;
+
+            if (isUnsigned) *value = (long) (o == OP_DIV ? a / b : a % b);
+            else
+                *value = o == OP_DIV ? l / r : l % r;
+
+            break;
+
+        case OP_AND: *value = l & r; break;
+        case OP_OR: *value = l | r; break;
+        case OP_XOR: *value = l ^ r; break;
+
+        case OP_LT: *value = isUnsigned ? a < b : l < r; return 1;
+        case OP_GT: *value = isUnsigned ? a > b : l > r; return 1;
+        case OP_LE: *value = isUnsigned ? a <= b : l <= r; return 1;
+        case OP_GE: *value = isUnsigned ? a >= b : l >= r; return 1;
+        case OP_EQ: *value = l == r; return 1;
+        case OP_NEQ: *value = l != r; return 1;
+        default: return 0;
+    }
+
+    *value = AnalyzerConstTruncate(*value, size, isUnsigned);
+    return 1;
+}
+
+//_Alignas и aligned: тип, константа - степень двойки или пусто
+static int AnalyzerAlignValue (AnalyzerCTX* ctx, Ast* Spec, int report)
+{
+    long value;
+
+    if (Spec->tag == AST_EMPTY) return ANALYZER_MaxAlign;
+    else if (Spec->tag == AST_TYPE) return Spec->dt ? TypeGetAlign(ctx->arch, Spec->dt) : 0;
+    else if (!AnalyzerConstValue(ctx->arch, Spec, &value))
+    {
+        if (report) ErrorAnalyzer(ctx, Spec, "выравнивание должно быть константой");
+
+        return 0;
+    }
+    else if (value < 0 || (value & (value - 1)))
+    {
+        if (report) ErrorAnalyzer(ctx, Spec, "выравнивание $d - не степень двойки", (int) value);
+
+        return 0;
+    }
+
+    return value;
+}
+
+//самое строгое из выравниваний маркера; ошибки выдаются один раз, на
+//выходе из маркера
+static int AnalyzerAlignAs (AnalyzerCTX* ctx, Ast* Marker, int report)
+{
+    int align = 0;
+
+    for (Ast* Current = Marker ? Marker->firstChild : 0; Current; Current = Current->nextSibling)
+    {
+        int value = AnalyzerAlignValue(ctx, Current, report);
+
+        if (value > align) align = value;
+    }
+
+    return align;
+}
+
+//поле неполного типа; массив без размера допустим последним полем структуры
+static void AnalyzerFields (AnalyzerCTX* ctx, Symbol* Record)
+{
+    for (int i = 0; i < Record->children.length; i++)
+    {
+        const Symbol* Field = VectorGet(&Record->children, i);
+        int isLast = i == Record->children.length - 1;
+
+        if (Field->tag != SYMBOL_ID || !Field->dt || TypeIsInvalid(Field->dt) || TypeIsComplete(Field->dt)) continue;
+        else if (isLast && Record->tag == SYMBOL_STRUCT && TypeIsArray(Field->dt)) continue;
+
+        ErrorAnalyzer(ctx, VectorGet(&Field->decls, 0), "поле '$h' неполного типа $t", Field->ident, Field->dt);
+    }
+}
+
+//спецификаторы в порядке выхода из них уже имеют тип
+static Type* AnalyzerBasicType (AnalyzerCTX* ctx, Ast* Node)
+{
+    if (Node->tag == AST_CONST)
+    {
+        Type* dt = TypeDeepDuplicate(Node->r->dt);
+        dt->qual.isConst = 1;
+        return dt;
+    }
+    else if (Node->tag == AST_LITERAL && Node->symbol
+             && (Node->symbol->tag == SYMBOL_TYPE || Node->symbol->tag == SYMBOL_TYPEDEF))
+        return TypeCreateBasic(Node->symbol);
+
+    else if (Node->tag == AST_STRUCT || Node->tag == AST_UNION)
+    {
+        Symbol* Record = Node->symbol;
+
+        if (Record->impl == Node)
+        {
+            AnalyzerFields(ctx, Record);
+
+            Record->align = AnalyzerAlignAs(ctx, Node->r, 0);
+            LayoutRecord(ctx->arch, Record);
+
+            Record->complete = 1;
+            Record->hasConstFields = 0;
+
+            for (int i = 0; i < Record->children.length; i++)
+            {
+                const Symbol* field = VectorGet(&Record->children, i);
+
+                if (field->tag == SYMBOL_ID && field->dt && TypeIsMutable(field->dt) != TYPE_MUTABLE)
+                    Record->hasConstFields = 1;
+            }
+        }
+
+        return TypeCreateBasic(Record);
+    }
+    else if (Node->tag == AST_ENUM)
+    {
+        Symbol* Enum = Node->symbol;
+
+        if (Enum->impl == Node)
+        {
+            long value = 0;
+
+            for (Ast* Current = Node->firstChild; Current; Current = Current->nextSibling)
+            {
+                Ast* Const = Current->tag == AST_BOP ? Current->l : Current;
+
+                if (Current->tag == AST_BOP && !AnalyzerConstValue(ctx->arch, Current->r, &value))
+                    ErrorAnalyzer(ctx, Current->r, "значение '$h' должно быть константой", Const->symbol->ident);
+
+                Const->symbol->constValue = value++;
+            }
+
+            Enum->size = ctx->intType->size;
+            Enum->align = ctx->intType->align;
+            Enum->complete = 1;
+        }
+
+        return TypeCreateBasic(Enum);
+    }
+    else
+        return TypeCreateInvalid();
+}
+
+//размер массива в деклараторе
+static long AnalyzerArraySize (AnalyzerCTX* ctx, Ast* Size)
+{
+    long value;
+
+    if (Size->tag == AST_EMPTY) return ArraySizeUnspecified;
+    else if (!AnalyzerConstValue(ctx->arch, Size, &value))
+    {
+        ErrorAnalyzer(ctx, Size, "размер массива должен быть константой");
+        return ArraySizeError;
+    }
+    else if (value < 0)
+    {
+        ErrorAnalyzer(ctx, Size, "отрицательный размер массива");
+        return ArraySizeError;
+    }
+
+    return value;
+}
+
+static STORAGE_TAG AnalyzerStorage (AnalyzerCTX* ctx, const Symbol* Symbol, const Ast* Parent, const Type* dt)
+{
+    MARKER_TAG marker = Parent->tag == AST_DECL && Parent->r ? Parent->r->marker : MARKER_UNDEFINED;
+    int isFunction = !TypeIsInvalid(dt) && TypeIsFunction(dt);
+
+    /*поле записи: место задает раскладка*/
+    if (Symbol->parent && (Symbol->parent->tag == SYMBOL_STRUCT || Symbol->parent->tag == SYMBOL_UNION))
+        return STORAGE_UNDEFINED;
+
+    /*static у первого объявления остается за символом*/
+    else if (Symbol->dt && Symbol->storage == STORAGE_STATIC)
+        return STORAGE_STATIC;
+
+    else if (marker == MARKER_STATIC) return STORAGE_STATIC;
+    else if (marker == MARKER_EXTERN || isFunction) return STORAGE_EXTERN;
+    else if (Symbol->parent == ctx->module) return STORAGE_STATIC;
+    else
+        return STORAGE_AUTO;
+}
+
+//тип декларатора собирается снаружи внутрь: '*', [] и () оборачивают
+//тип, полученный от спецификатора
+static void AnalyzerDeclarator (AnalyzerCTX* ctx, Ast* Root, Ast* Parent)
+{
+    Type* dt = TypeDeepDuplicate(Parent->l->dt);
+    Ast* Current = Root;
+
+    for (;;)
+    {
+        if (Current->tag == AST_UOP)
+        {
+            dt = TypeCreatePtr(dt);
+            Current = Current->r;
+        }
+        else if (Current->tag == AST_CONST)
+        {
+            dt->qual.isConst = 1;
+            Current = Current->r;
+        }
+        else if (Current->tag == AST_INDEX)
+        {
+            dt = TypeCreateArray(dt, AnalyzerArraySize(ctx, Current->r));
+            Current = Current->l;
+        }
+        else if (Current->tag == AST_CALL)
+        {
+            Type** paramTypes = calloc(Current->children, sizeof(Type*));
+            int params = 0, variadic = 0;
+
+            for (Ast* Param = Current->firstChild; Param; Param = Param->nextSibling)
+            {
+                if (Param->tag == AST_ELLIPSIS) variadic = 1;
+                else
+                    paramTypes[params++] = Param->dt ? TypeDeepDuplicate(Param->dt) : TypeCreateInvalid();
+            }
+
+            dt = TypeCreateFunction(dt, paramTypes, params, variadic);
+            Current = Current->l;
+        }
+        else
+            break;
+    }
+
+    /*параметр-массив и параметр-функция - это указатели*/
+    if (Parent->tag == AST_PARAM && !TypeIsInvalid(dt) && (TypeIsArray(dt) || TypeIsFunction(dt)))
+    {
+        Type* ptr = TypeIsArray(dt) ? TypeDeriveBase(dt) : TypeDeepDuplicate(dt);
+
+        TypeDestroy(dt);
+        dt = TypeCreatePtr(ptr);
+    }
+
+    Symbol* Symbol = Current->tag == AST_LITERAL ? Current->symbol : 0;
+
+    if (Symbol && (Symbol->tag == SYMBOL_ID || Symbol->tag == SYMBOL_PARAM || Symbol->tag == SYMBOL_TYPEDEF))
+    {
+        if (Symbol->tag != SYMBOL_TYPEDEF)
+            Symbol->storage = Symbol->tag == SYMBOL_PARAM ? STORAGE_AUTO : AnalyzerStorage(ctx, Symbol, Parent, dt);
+
+        if (Symbol->tag == SYMBOL_ID && !TypeIsInvalid(dt) && TypeIsVoid(dt))
+            ErrorAnalyzer(ctx, Current, "'$h' объявлен как void", Symbol->ident);
+
+        /*_Alignas не может ослабить естественное выравнивание*/
+        int alignAs = Parent->tag == AST_DECL ? AnalyzerAlignAs(ctx, Parent->r, 0) : 0;
+
+        if (!alignAs) ;
+        else if (Symbol->tag != SYMBOL_ID || TypeIsFunction(dt))
+            ErrorAnalyzer(ctx, Current, "_Alignas недопустим для '$h'", Symbol->ident);
+
+        else if (alignAs < TypeGetAlign(ctx->arch, dt))
+            ErrorAnalyzer(ctx, Current, "_Alignas($d) слабее выравнивания $t", alignAs, dt);
+
+        else if (alignAs > Symbol->alignAs)
+            Symbol->alignAs = alignAs;
+
+        /*повторное объявление: прототип, extern*/
+        if (Symbol->dt)
+        {
+            if (!TypeIsCompatible(dt, Symbol->dt))
+                ErrorAnalyzer(ctx, Current, "конфликтующие типы '$h': $t и $t", Symbol->ident, dt, Symbol->dt);
+
+            TypeDestroy(Symbol->dt);
+        }
+
+        Symbol->dt = TypeDeepDuplicate(dt);
+    }
+
+    if (Current != Root && Current->tag == AST_LITERAL) Current->dt = TypeDeepDuplicate(dt);
+
+    Root->dt = dt;
+}
+
+//инициализатор массива без размера задает размер
+static void AnalyzerDeclInit (AnalyzerCTX* ctx, Ast* Node)
+{
+    Ast* Root = Node->l;
+    Ast* Init = Node->r;
+
+    if (AnalyzerIsInvalid(Root->dt) || AnalyzerIsInvalid(Init->dt)) ;
+    else if (TypeIsArray(Root->dt) && TypeGetArraySize(Root->dt) == ArraySizeUnspecified
+             && Init->tag == AST_LITERAL && (Init->litTag == LITERAL_INIT || Init->litTag == LITERAL_STR))
+    {
+        int size = Init->litTag == LITERAL_INIT ? AnalyzerInitLength(ctx, Init) : TypeGetArraySize(Init->dt);
+        Ast* Leaf = AnalyzerDeclLeaf(Root);
+
+        TypeSetArraySize(Root->dt, size);
+        TypeSetArraySize(Init->dt, size);
+
+        if (Leaf && Leaf != Root && Leaf->dt) TypeSetArraySize(Leaf->dt, size);
+        if (Leaf && Leaf->symbol && Leaf->symbol->dt) TypeSetArraySize(Leaf->symbol->dt, size);
+    }
+    else if (Init->tag == AST_LITERAL && Init->litTag == LITERAL_INIT) ;
+    else if (Init->tag == AST_LITERAL && Init->litTag == LITERAL_STR && TypeIsArray(Root->dt)) ;
+    else if (!TypeIsCompatible(Init->dt, Root->dt))
+        ErrorAnalyzer(ctx, Init, "несовместимый инициализатор: $t вместо $t", Init->dt, Root->dt);
+
+    Node->dt = TypeDeepDuplicate(Root->dt);
+}
+
+static Type* AnalyzerLiteral (AnalyzerCTX* ctx, Ast* Node, const Type* target)
+{
+    switch (Node->litTag)
+    {
+        case LITERAL_IDENT:
+        {
+            const Symbol* Symbol = Node->symbol;
+
+            if (!Symbol) return TypeCreateInvalid();
+            else if (Symbol->tag != SYMBOL_ID && Symbol->tag != SYMBOL_PARAM && Symbol->tag != SYMBOL_ENUMCONSTANT)
+            {
+                ErrorAnalyzer(ctx, Node, "'$h' не является значением", Symbol->ident);
+                return TypeCreateInvalid();
+            }
+
+            return Symbol->dt ? TypeDeepDuplicate(Symbol->dt) : TypeCreateInvalid();
+        }
+
+        case LITERAL_INT:
+            return AnalyzerCreateBasic(AnalyzerIntLiteralType(ctx, Node->literal));
+
+        case LITERAL_CHAR:
+        case LITERAL_BOOL:
+            return AnalyzerCreateBasic(ctx->intType);
+
+        case LITERAL_FLOAT:
+            return AnalyzerCreateBasic(AnalyzerBuiltin(ctx, "float"));
+
+        case LITERAL_DOUBLE:
+            return AnalyzerCreateBasic(AnalyzerBuiltin(ctx, "double"));
+
+        case LITERAL_STR:
+            return TypeCreateArray(AnalyzerCreateBasic(ctx->charType), AnalyzerStrLength(Node->literal) + 1);
+
+        case LITERAL_COMPOUND:
+            return TypeDeepDuplicate(Node->l->dt);
+
+        case LITERAL_INIT:
+            if (target) return TypeDeepDuplicate(target);
+
+            ErrorAnalyzer(ctx, Node, "список инициализации вне объявления");
+            return TypeCreateInvalid();
+
+        default:
+            return TypeCreateInvalid();
+    }
+}
+
+static Type* AnalyzerAssign (AnalyzerCTX* ctx, Ast* Node)
+{
+    const Type *L = Node->l->dt, *R = Node->r->dt;
+
+    if (TypeIsArray(L) && !TypeIsInvalid(L))
+        ErrorAnalyzer(ctx, Node, "присваивание массиву");
+
+    else if (TypeIsMutable(L) != TYPE_MUTABLE)
+        ErrorAnalyzer(ctx, Node, "присваивание константе типа $t", L);
+
+    else if (Node->o == OP_ASSIGN && !TypeIsCompatible(R, L))
+        ErrorAnalyzer(ctx, Node, "несовместимые типы в присваивании: $t и $t", L, R);
+
+    else if ((Node->o == OP_PLUSASSIGN || Node->o == OP_MINASSIGN) && AnalyzerIsPointer(L))
+    {
+        if (!AnalyzerIsInteger(R)) ErrorAnalyzer(ctx, Node, "$o: указатель и $t", Node->o, R);
+    }
+    else if (Node->o != OP_ASSIGN && (!AnalyzerArithBasic(L) || !AnalyzerArithBasic(R)))
+        ErrorAnalyzer(ctx, Node, "$o: неарифметические операнды $t и $t", Node->o, L, R);
+
+    return TypeDeepDuplicate(L);
+}
+
+static Type* AnalyzerMember (AnalyzerCTX* ctx, Ast* Node)
+{
+    const Type* L = Node->l->dt;
+    Ast* Field = Node->r;
+
+    if (Node->o == OP_MEMBERDEREF) L = AnalyzerIsPointer(L) ? TypeGetBase(L) : 0;
+
+    const Symbol* Record = L ? TypeGetBasic(L) : 0;
+
+    if (!Record || (Record->tag != SYMBOL_STRUCT && Record->tag != SYMBOL_UNION))
+    {
+        ErrorAnalyzer(ctx, Node, "$o: слева должна быть запись, а не $t", Node->o, Node->l->dt);
+        return TypeCreateInvalid();
+    }
+    else if (Field->tag != AST_LITERAL)
+        return TypeCreateInvalid();
+
+    Field->symbol = SymbolChild(Record, Field->literal);
+
+    if (!Field->symbol || Field->symbol->tag != SYMBOL_ID)
+    {
+        ErrorAnalyzer(ctx, Field, "в $n нет поля '$h'", Record, (char*) Field->literal);
+        return TypeCreateInvalid();
+    }
+
+    Field->dt = TypeDeepDuplicate(Field->symbol->dt);
+
+    /*поле константной записи - тоже константа*/
+    Type* dt = TypeDeepDuplicate(Field->symbol->dt);
+
+    if (TypeIsMutable(L) == TYPE_MUTCONSTQUALIFIED) dt->qual.isConst = 1;
+
+    return dt;
+}
+
+static Type* AnalyzerBOP (AnalyzerCTX* ctx, Ast* Node)
+{
+    OP_TAG o = Node->o;
+
+    if (OpIsMember(o)) return AnalyzerMember(ctx, Node);
+
+    const Type *L = Node->l->dt, *R = Node->r->dt;
+
+    if (AnalyzerIsInvalid(L) || AnalyzerIsInvalid(R))
+        return OpIsAssignment(o) && L ? TypeDeepDuplicate(L) : TypeCreateInvalid();
+
+    else if (OpIsAssignment(o)) return AnalyzerAssign(ctx, Node);
+    else if (o == OP_COMMA) return TypeDeepDuplicate(R);
+
+    else if (OpIsLogical(o) || OpIsEquality(o) || OpIsOrdinal(o))
+    {
+        int ok = OpIsLogical(o) ? TypeIsCondition(L) && TypeIsCondition(R)
+                : OpIsEquality(o) ? TypeIsEquality(L) && TypeIsEquality(R)
+                : TypeIsOrdinal(L) && TypeIsOrdinal(R);
+
+        if (!ok) ErrorAnalyzer(ctx, Node, "$o: недопустимые операнды $t и $t", o, L, R);
+
+        return AnalyzerCreateBasic(ctx->intType);
+    }
+
+    /*арифметика указателей*/
+    else if ((o == OP_PLUS || o == OP_MIN) && AnalyzerIsPointer(L))
+    {
+        if (o == OP_MIN && AnalyzerIsPointer(R)) return AnalyzerCreateBasic(ctx->ptrdiffType);
+        else if (!AnalyzerIsInteger(R))
+        {
+            ErrorAnalyzer(ctx, Node, "$o: указатель и $t", o, R);
+            return TypeCreateInvalid();
+        }
+
+        return TypeCreatePtr(TypeDeriveBase(L));
+    }
+    else if (o == OP_PLUS && AnalyzerIsPointer(R))
+    {
+        if (!AnalyzerIsInteger(L))
+        {
+            ErrorAnalyzer(ctx, Node, "$o: $t и указатель", o, L);
+            return TypeCreateInvalid();
+        }
+
+        return TypeCreatePtr(TypeDeriveBase(R));
+    }
+
+    const Symbol *basicL = AnalyzerArithBasic(L), *basicR = AnalyzerArithBasic(R);
+    int integerOnly = o == OP_MOD || o == OP_SHL || o == OP_SHR || OpIsBitwise(o);
+
+    if (!basicL || !basicR || (integerOnly && (!AnalyzerIsInteger(L) || !AnalyzerIsInteger(R))))
+    {
+        ErrorAnalyzer(ctx, Node, "$o: недопустимые операнды $t и $t", o, L, R);
+        return TypeCreateInvalid();
+    }
+
+    /*у сдвига тип - расширенный левый операнд*/
+    if (o == OP_SHL || o == OP_SHR) return AnalyzerCreateBasic(AnalyzerPromote(ctx, basicL));
+
+    return AnalyzerCreateBasic(AnalyzerArithmetic(ctx, basicL, basicR));
+}
+
+static Type* AnalyzerUOP (AnalyzerCTX* ctx, Ast* Node)
+{
+    const Type* R = Node->r->dt;
+
+    if (AnalyzerIsInvalid(R)) return Node->o == OP_ADDRESS && R ? TypeDerivePtr(R) : TypeCreateInvalid();
+
+    switch (Node->o)
+    {
+        case OP_DEREF:
+            if (AnalyzerIsPointer(R)) return TypeDeriveBase(R);
+            else if (TypeIsFunction(R)) return TypeDeepDuplicate(R);
+
+            ErrorAnalyzer(ctx, Node, "разыменование не указателя: $t", R);
+            return TypeCreateInvalid();
+
+        case OP_ADDRESS:
+            return TypeDerivePtr(R);
+
+        case OP_NOT:
+            if (!TypeIsCondition(R)) ErrorAnalyzer(ctx, Node, "$o: недопустимый операнд $t", Node->o, R);
+
+            return AnalyzerCreateBasic(ctx->intType);
+
+        case OP_PREPLUSPLUS:
+        case OP_PREMINMIN:
+        case OP_PLUSPLUS:
+        case OP_MINMIN:
+            if (!AnalyzerArithBasic(R) && !AnalyzerIsPointer(R))
+                ErrorAnalyzer(ctx, Node, "$o: недопустимый операнд $t", Node->o, R);
+
+            else if (TypeIsMutable(R) != TYPE_MUTABLE || TypeIsArray(R))
+                ErrorAnalyzer(ctx, Node, "$o: операнд нельзя изменить", Node->o);
+
+            return TypeDeepDuplicate(R);
+
+        default:
+        {
+            /*унарные плюс, минус и ~*/
+            const Symbol* basic = AnalyzerArithBasic(R);
+
+            if (!basic || (Node->o == OP_TILDE && !AnalyzerIsInteger(R)))
+            {
+                ErrorAnalyzer(ctx, Node, "$o: недопустимый операнд $t", Node->o, R);
+                return TypeCreateInvalid();
+            }
+
+            return AnalyzerCreateBasic(AnalyzerPromote(ctx, basic));
+        }
+    }
+}
+
+static Type* AnalyzerTOP (AnalyzerCTX* ctx, Ast* Node)
+{
+    const Type *Cond = Node->firstChild->dt, *L = Node->l->dt, *R = Node->r->dt;
+
+    if (!AnalyzerIsInvalid(Cond) && !TypeIsCondition(Cond))
+        ErrorAnalyzer(ctx, Node, "условие типа $t", Cond);
+
+    if (AnalyzerIsInvalid(L) || AnalyzerIsInvalid(R)) return TypeCreateInvalid();
+    else if (AnalyzerArithBasic(L) && AnalyzerArithBasic(R))
+        return AnalyzerCreateBasic(AnalyzerArithmetic(ctx, AnalyzerArithBasic(L), AnalyzerArithBasic(R)));
+
+    else if (!TypeIsCompatible(L, R) || !TypeIsCompatible(R, L))
+    {
+        ErrorAnalyzer(ctx, Node, "несовместимые ветви ?: $t и $t", L, R);
+        return TypeCreateInvalid();
+    }
+
+    return TypeDeriveUnified(L, R);
+}
+
+static Type* AnalyzerIndex (AnalyzerCTX* ctx, Ast* Node)
+{
+    const Type *L = Node->l->dt, *R = Node->r->dt;
+
+    if (AnalyzerIsInvalid(L) || AnalyzerIsInvalid(R)) return TypeCreateInvalid();
+    else if (AnalyzerIsPointer(L) && AnalyzerIsInteger(R)) return TypeDeriveBase(L);
+    else if (AnalyzerIsPointer(R) && AnalyzerIsInteger(L)) return TypeDeriveBase(R);
+
+    ErrorAnalyzer(ctx, Node, "[]: недопустимые операнды $t и $t", L, R);
+    return TypeCreateInvalid();
+}
+
+static Type* AnalyzerCall (AnalyzerCTX* ctx, Ast* Node)
+{
+    const Type* L = Node->l->dt;
+
+    if (AnalyzerIsInvalid(L)) return TypeCreateInvalid();
+
+    const Type* fn = TypeGetCallable(L);
+
+    if (!fn)
+    {
+        ErrorAnalyzer(ctx, Node, "вызов значения типа $t", L);
+        return TypeCreateInvalid();
+    }
+
+    if (Node->children < fn->params || (Node->children > fn->params && !fn->variadic))
+        ErrorAnalyzer(ctx, Node, "функции нужно $d аргументов, передано $d", fn->params, Node->children);
+
+    int n = 0;
+
+    for (Ast* Arg = Node->firstChild; Arg && n < fn->params; Arg = Arg->nextSibling, n++)
+        if (!AnalyzerIsInvalid(Arg->dt) && !TypeIsCompatible(Arg->dt, fn->paramTypes[n]))
+            ErrorAnalyzer(ctx, Arg, "аргумент $d: $t вместо $t", n + 1, Arg->dt, fn->paramTypes[n]);
+
+    return TypeDeriveReturn(fn);
+}
+
+static Type* AnalyzerValue (AnalyzerCTX* ctx, Ast* Node, const Type* target)
+{
+    switch (Node->tag)
+    {
+        case AST_LITERAL: return AnalyzerLiteral(ctx, Node, target);
+        case AST_BOP: return AnalyzerBOP(ctx, Node);
+        case AST_UOP: return AnalyzerUOP(ctx, Node);
+        case AST_TOP: return AnalyzerTOP(ctx, Node);
+        case AST_INDEX: return AnalyzerIndex(ctx, Node);
+        case AST_CALL: return AnalyzerCall(ctx, Node);
+        case AST_CAST: return TypeDeepDuplicate(Node->l->dt);
+        case AST_SIZEOF: return AnalyzerCreateBasic(ctx->sizeType);
+        case AST_EMPTY: return 0;
+        default: return TypeCreateInvalid();
+    }
+}
+
+//условие, значение switch и return
+static void AnalyzerStatement (AnalyzerCTX* ctx, Ast* Node)
+{
+    const Type* Cond = 0;
+
+    if (Node->tag == AST_BRANCH) Cond = Node->firstChild->dt;
+    else if (Node->tag == AST_LOOP) Cond = Node->isDo ? Node->r->dt : Node->l->dt;
+    else if (Node->tag == AST_ITER) Cond = Node->firstChild->nextSibling->dt;
+
+    if (!AnalyzerIsInvalid(Cond) && !TypeIsCondition(Cond))
+        ErrorAnalyzer(ctx, Node, "условие типа $t", Cond);
+
+    if (Node->tag == AST_SWITCH && !AnalyzerIsInvalid(Node->l->dt) && !AnalyzerIsInteger(Node->l->dt))
+        ErrorAnalyzer(ctx, Node->l, "switch по значению типа $t", Node->l->dt);
+
+    else if (Node->tag == AST_CASE)
+    {
+        long value;
+
+        if (!AnalyzerConstValue(ctx->arch, Node->l, &value))
+            ErrorAnalyzer(ctx, Node->l, "метка case должна быть константой");
+    }
+    else if (Node->tag == AST_RETURN && ctx->fn && ctx->fn->dt)
+    {
+        const Type* ret = TypeGetReturn(ctx->fn->dt);
+        int isVoid = !ret || TypeIsInvalid(ret) || TypeIsVoid(ret);
+
+        if (isVoid && Node->r && !AnalyzerIsInvalid(Node->r->dt) && !TypeIsVoid(Node->r->dt))
+            ErrorAnalyzer(ctx, Node, "возврат значения из void-функции '$h'", ctx->fn->ident);
+
+        else if (!isVoid && !Node->r)
+            ErrorAnalyzer(ctx, Node, "функция '$h' должна вернуть $t", ctx->fn->ident, ret);
+
+        else if (!isVoid && !AnalyzerIsInvalid(Node->r->dt) && !TypeIsCompatible(Node->r->dt, ret))
+            ErrorAnalyzer(ctx, Node->r, "возврат $t из функции, возвращающей $t", Node->r->dt, ret);
+    }
+}
+
+//ожидаемые типы элементов списка инициализации
+static void AnalyzerInitChildren (AnalyzerCTX* ctx, Ast* Node, const Type* target)
+{
+    const Type* base = target && AnalyzerIsPointer(target) && TypeIsArray(target) ? TypeGetBase(target) : 0;
+    const Symbol* Record = target && !base ? TypeGetBasic(target) : 0;
+    int field = 0;
+
+    if (Record && Record->tag != SYMBOL_STRUCT && Record->tag != SYMBOL_UNION) Record = 0;
+
+    for (Ast* Current = Node->firstChild; Current; Current = Current->nextSibling)
+    {
+        const Type* element = base ? base : Record ? 0 : target;
+
+        if (Current->tag == AST_MARKER && Current->marker == MARKER_StructDesignatedInit)
+        {
+            Ast* Name = Current->l;
+            Symbol* Field = Record && Name->tag == AST_LITERAL ? SymbolChild(Record, Name->literal) : 0;
+
+            if (Field && Field->tag == SYMBOL_ID)
+            {
+                Name->symbol = Field;
+                element = Field->dt;
+                field = VectorFind((Vector*) &Record->children, Field) + 1;
+            }
+            else if (Name->tag == AST_LITERAL)
+                ErrorAnalyzer(ctx, Name, "нет поля '$h'", (char*) Name->literal);
+
+            AnalyzerPush(ctx, Current, Node, ANALYZER_DESIGNATOR, element);
+            continue;
+        }
+
+        /*следующее по порядку поле; у объединения - только первое*/
+        if (Record)
+        {
+            while (field < Record->children.length && ((Symbol*) VectorGet(&Record->children, field))->tag != SYMBOL_ID)
+                field++;
+
+            if (field < Record->children.length && (Record->tag == SYMBOL_STRUCT || field == 0 || Current == Node->firstChild))
+                element = ((Symbol*) VectorGet(&Record->children, field++))->dt;
+        }
+
+        AnalyzerPush(ctx, Current, Node, Current->tag == AST_MARKER ? ANALYZER_DESIGNATOR : ANALYZER_VALUE, element);
+    }
+}
+
+//дети, которых надо обойти, в порядке исходного текста
+static void AnalyzerEnter (AnalyzerCTX* ctx, AnalyzerFrame frame)
+{
+    Ast* Node = frame.node;
+
+    switch (frame.role)
+    {
+        case ANALYZER_STMT:
+            if (Node->tag == AST_MODULE || Node->tag == AST_CODE || Node->tag == AST_ITER)
+            {
+                for (Ast* Current = Node->firstChild; Current; Current = Current->nextSibling)
+                    AnalyzerPushStmt(ctx, Current, Node);
+
+                if (Node->tag == AST_ITER) AnalyzerPushStmt(ctx, Node->l, Node);
+            }
+            else if (Node->tag == AST_FNIMPL)
+            {
+                /*интервал закрывается в AnalyzerExit*/
+                TimerEnterFn(TIMER_ANALYZE, Node->symbol ? Node->symbol->ident : 0);
+
+                AnalyzerPush(ctx, Node->l, Node, ANALYZER_STMT, 0);
+
+                /*код неизменной функции берется из прошлой сборки: ее тело
+                  остается неразобранным и не обходится*/
+                int unchanged = ctx->incr && IncrUnchanged(ctx->incr, ctx->parsed, ctx->module, Node);
+
+                /*тело, отложенное ленивым разбором, разбирается здесь; с ошибками
+                  разбора оно не обходится*/
+                int parseErrors = ctx->parsed->errors;
+
+                if (!unchanged) ParserBody(ctx->parsed, Node);
+
+                ctx->errors += ctx->parsed->errors - parseErrors;
+
+                if (!unchanged && ctx->parsed->errors == parseErrors)
+                    AnalyzerPush(ctx, Node->r, Node, ANALYZER_STMT, 0);
+            }
+            else if (Node->tag == AST_DECL)
+            {
+                AnalyzerPush(ctx, Node->l, Node, ANALYZER_BASIC, 0);
+                AnalyzerPush(ctx, Node->r, Node, ANALYZER_STMT, 0);
+
+                for (Ast* Current = Node->firstChild; Current; Current = Current->nextSibling)
+                    AnalyzerPush(ctx, Current, Node, Current->tag == AST_BOP && Current->o == OP_ASSIGN
+                                                     ? ANALYZER_DECLINIT : ANALYZER_DECLARATOR, 0);
+            }
+            else if (Node->tag == AST_BRANCH)
+            {
+                AnalyzerPush(ctx, Node->firstChild, Node, ANALYZER_VALUE, 0);
+                AnalyzerPushStmt(ctx, Node->l, Node);
+                AnalyzerPushStmt(ctx, Node->r, Node);
+            }
+            else if (Node->tag == AST_LOOP && Node->isDo)
+            {
+                AnalyzerPushStmt(ctx, Node->l, Node);
+                AnalyzerPush(ctx, Node->r, Node, ANALYZER_VALUE, 0);
+            }
+            else if (Node->tag == AST_LOOP || Node->tag == AST_SWITCH || Node->tag == AST_CASE || Node->tag == AST_DEFAULT)
+            {
+                AnalyzerPush(ctx, Node->l, Node, ANALYZER_VALUE, 0);
+                AnalyzerPushStmt(ctx, Node->r, Node);
+            }
+            else if (Node->tag == AST_RETURN)
+                AnalyzerPush(ctx, Node->r, Node, ANALYZER_VALUE, 0);
+
+            /*класс хранения и выравнивание*/
+            else if (Node->tag == AST_MARKER)
+            {
+                for (Ast* Current = Node->firstChild; Current; Current = Current->nextSibling)
+                    if (Current->tag != AST_EMPTY)
+                        AnalyzerPush(ctx, Current, Node, Current->tag == AST_TYPE ? ANALYZER_TYPE : ANALYZER_VALUE, 0);
+            }
+
+            break;
+
+        case ANALYZER_VALUE:
+            if (Node->tag == AST_LITERAL && Node->litTag == LITERAL_INIT)
+                AnalyzerInitChildren(ctx, Node, frame.target);
+
+            else if (Node->tag == AST_LITERAL && Node->litTag == LITERAL_COMPOUND)
+            {
+                AnalyzerPush(ctx, Node->l, Node, ANALYZER_TYPE, 0);
+                AnalyzerPush(ctx, Node->r, Node, ANALYZER_INIT, 0);
+            }
+            else if (Node->tag == AST_CAST)
+            {
+                AnalyzerPush(ctx, Node->l, Node, ANALYZER_TYPE, 0);
+                AnalyzerPush(ctx, Node->r, Node, ANALYZER_VALUE, 0);
+            }
+            else if (Node->tag == AST_SIZEOF)
+                AnalyzerPush(ctx, Node->r, Node, Node->r->tag == AST_TYPE ? ANALYZER_TYPE : ANALYZER_VALUE, 0);
+
+            /*имя поля справа от '.' и '->' находится на выходе*/
+            else if (Node->tag == AST_BOP && OpIsMember(Node->o))
+                AnalyzerPush(ctx, Node->l, Node, ANALYZER_VALUE, 0);
+
+            else if (Node->tag != AST_LITERAL)
+            {
+                for (Ast* Current = Node->firstChild; Current; Current = Current->nextSibling)
+                    AnalyzerPush(ctx, Current, Node, ANALYZER_VALUE, 0);
+
+                AnalyzerPush(ctx, Node->l, Node, ANALYZER_VALUE, 0);
+                AnalyzerPush(ctx, Node->r, Node, ANALYZER_VALUE, 0);
+            }
+
+            break;
+
+        case ANALYZER_BASIC:
+            if (Node->tag == AST_CONST) AnalyzerPush(ctx, Node->r, Node, ANALYZER_BASIC, 0);
+            else if (Node->tag == AST_STRUCT || Node->tag == AST_UNION)
+            {
+                AnalyzerPush(ctx, Node->r, Node, ANALYZER_STMT, 0);
+
+                for (Ast* Current = Node->firstChild; Current; Current = Current->nextSibling)
+                    AnalyzerPush(ctx, Current, Node, ANALYZER_STMT, 0);
+            }
+            else if (Node->tag == AST_ENUM)
+            {
+                /*константы известны значениям следующих констант*/
+                for (Ast* Current = Node->firstChild; Current; Current = Current->nextSibling)
+                {
+                    Ast* Const = Current->tag == AST_BOP ? Current->l : Current;
+
+                    if (Const->symbol && !Const->symbol->dt)
+                        Const->symbol->dt = AnalyzerCreateBasic(ctx->intType);
+
+                    AnalyzerPush(ctx, Current, Node, ANALYZER_ENUMCONST, 0);
+                }
+            }
+
+            break;
+
+        case ANALYZER_TYPE:
+            AnalyzerPush(ctx, Node->l, Node, ANALYZER_BASIC, 0);
+            AnalyzerPush(ctx, Node->r, Node, ANALYZER_DECLARATOR, 0);
+            break;
+
+        case ANALYZER_DECLARATOR:
+            /*размеры массивов и параметры по всей спине*/
+            for (Ast* Current = Node; Current; )
+            {
+                if (Current->tag == AST_UOP || Current->tag == AST_CONST) Current = Current->r;
+                else if (Current->tag == AST_INDEX)
+                {
+                    if (Current->r->tag != AST_EMPTY) AnalyzerPush(ctx, Current->r, Current, ANALYZER_VALUE, 0);
+
+                    Current = Current->l;
+                }
+                else if (Current->tag == AST_CALL)
+                {
+                    for (Ast* Param = Current->firstChild; Param; Param = Param->nextSibling)
+                        if (Param->tag == AST_PARAM) AnalyzerPush(ctx, Param, Current, ANALYZER_PARAM, 0);
+
+                    Current = Current->l;
+                }
+                else
+                    break;
+            }
+
+            break;
+
+        case ANALYZER_DECLINIT:
+            AnalyzerPush(ctx, Node->l, frame.parent, ANALYZER_DECLARATOR, 0);
+            AnalyzerPush(ctx, Node->r, Node, ANALYZER_INIT, 0);
+            break;
+
+        case ANALYZER_PARAM:
+            AnalyzerPush(ctx, Node->l, Node, ANALYZER_BASIC, 0);
+            AnalyzerPush(ctx, Node->r, Node, ANALYZER_DECLARATOR, 0);
+            break;
+
+        case ANALYZER_ENUMCONST:
+            if (Node->tag == AST_BOP) AnalyzerPush(ctx, Node->r, Node, ANALYZER_VALUE, 0);
+
+            break;
+
+        case ANALYZER_DESIGNATOR:
+            if (Node->marker == MARKER_ArrayDesignatedInit) AnalyzerPush(ctx, Node->l, Node, ANALYZER_VALUE, 0);
+
+            AnalyzerPush(ctx, Node->r, Node, ANALYZER_VALUE, frame.target);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void AnalyzerExit (AnalyzerCTX* ctx, AnalyzerFrame frame)
+{
+    Ast* Node = frame.node;
+
+    if (frame.skip) return;
+
+    switch (frame.role)
+    {
+        case ANALYZER_STMT:
+            if (Node->tag == AST_FNIMPL)
+            {
+                /*смещения параметров по соглашению о вызовах, область их
+                  сохранения добавляется к кадру при создании IR функции*/
+                if (Node->symbol) Node->symbol->paramHome = AbiParams(ctx->arch, Node->symbol, 0);
+
+                ctx->fn = 0;
+                TimerLeave();
+            }
+            else if (Node->tag == AST_MARKER) AnalyzerAlignAs(ctx, Node, 1);
+            else
+                AnalyzerStatement(ctx, Node);
+
+            break;
+
+        case ANALYZER_VALUE:
+            Node->dt = AnalyzerValue(ctx, Node, frame.target);
+            break;
+
+        case ANALYZER_BASIC:
+            Node->dt = AnalyzerBasicType(ctx, Node);
+            break;
+
+        case ANALYZER_TYPE:
+            Node->dt = TypeDeepDuplicate(Node->r && Node->r->dt ? Node->r->dt : Node->l->dt);
+            break;
+
+        case ANALYZER_DECLARATOR:
+            AnalyzerDeclarator(ctx, Node, frame.parent);
+            break;
+
+        case ANALYZER_DECLINIT:
+            AnalyzerDeclInit(ctx, Node);
+            break;
+
+        case ANALYZER_PARAM:
+            Node->dt = TypeDeepDuplicate(Node->r ? Node->r->dt : Node->l->dt);
+            break;
+
+        case ANALYZER_DESIGNATOR:
+            if (Node->r->dt) Node->dt = TypeDeepDuplicate(Node->r->dt);
+
+            break;
+
+        default:
+            break;
+    }
+}
+
+//готовность узла к обходу: роль ANALYZER_INIT берет ожидаемый тип у
+//уже обойденного соседа, тип значения вычисляется только один раз
+static void AnalyzerPrepare (AnalyzerCTX* ctx, AnalyzerFrame* frame)
+{
+    if (frame->role == ANALYZER_INIT)
+    {
+        frame->role = ANALYZER_VALUE;
+        frame->target = frame->parent->l->dt;
+    }
+
+    if (frame->role == ANALYZER_VALUE && frame->node->dt) frame->skip = 1;
+
+    if (frame->node->tag == AST_CODE && frame->parent && frame->parent->tag == AST_FNIMPL)
+        ctx->fn = frame->parent->symbol;
+}
+
+static void AnalyzerWalk (AnalyzerCTX* ctx, Ast* Root)
+{
+    AnalyzerPush(ctx, Root, 0, ANALYZER_STMT, 0);
+
+    while (ctx->depth)
+    {
+        AnalyzerFrame* frame = &ctx->stack[ctx->depth - 1];
+
+        if (!frame->entered)
+        {
+            frame->entered = 1;
+            AnalyzerPrepare(ctx, frame);
+
+            if (frame->skip) continue;
+
+            /*frame может сдвинуться при росте стека*/
+            int first = ctx->depth;
+
+            AnalyzerEnter(ctx, *frame);
+            AnalyzerReverse(ctx, first);
+        }
+        else
+            AnalyzerExit(ctx, ctx->stack[--ctx->depth]);
+    }
+}
+
+//семантический анализ: каждому узлу-значению - тип в dt, именам полей -
+//символ, объявленным символам - тип и класс хранения; один проход,
+//узел обрабатывается после своих детей
+int Analyzer (ParserResult* parsed, Symbol* Global, const Arch* arch, IncrCTX* incr)
+{
+    DebugEnter("Analyzer");
+
+    AnalyzerCTX ctx;
+
+    ctx.arch = arch;
+    ctx.module = Global;
+    ctx.fn = 0;
+    ctx.parsed = parsed;
+    ctx.incr = incr;
+    ctx.errors = 0;
+    ctx.warnings = 0;
+
+    ctx.intType = AnalyzerBuiltin(&ctx, "int");
+    ctx.charType = AnalyzerBuiltin(&ctx, "char");
+    ctx.sizeType = AnalyzerWordType(&ctx, 1);
+    ctx.ptrdiffType = AnalyzerWordType(&ctx, 0);
+
+    ctx.depth = 0;
+    ctx.capacity = ANALYZER_StackSize;
+    ctx.stack = malloc(sizeof(AnalyzerFrame) * ctx.capacity);
+
+    if (ctx.intType && ctx.charType && ctx.sizeType && ctx.ptrdiffType) AnalyzerWalk(&ctx, parsed->tree);
+    else
+        ctx.errors++;
+
+    free(ctx.stack);
+
+    DebugLeave();
+    return ctx.errors;
+}
+
+//значение константного выражения; 0 - выражение не константа
+int AnalyzerConstValue (const Arch* arch, const Ast* Node, long* value)
+{
+    long l, r;
+
+    if (!Node) return 0;
+    else if (Node->tag == AST_LITERAL)
+    {
+        if (Node->litTag == LITERAL_INT && Node->literal)
+        {
+            *value = (long) ((const IntLiteral*) Node->literal)->value;
+            return 1;
+        }
+        else if ((Node->litTag == LITERAL_CHAR || Node->litTag == LITERAL_BOOL) && Node->literal)
+        {
+            *value = *(int*) Node->literal;
+            return 1;
+        }
+        else if (Node->litTag == LITERAL_IDENT && Node->symbol && Node->symbol->tag == SYMBOL_ENUMCONSTANT)
+        {
+            *value = Node->symbol->constValue;
+            return 1;
+        }
+
+        return 0;
+    }
+    else if (Node->tag == AST_UOP)
+    {
+        if (!AnalyzerConstValue(arch, Node->r, &r)) return 0;
+
+        int size, isUnsigned;
+        AnalyzerConstPromoted(Node->r->dt, &size, &isUnsigned);
+
+        switch (Node->o)
+        {
+            case OP_UNARYPLUS: *value = AnalyzerConstTruncate(r, size, isUnsigned); return 1;
+            case OP_UNARYMIN: *value = AnalyzerConstTruncate((long) -(unsigned long) r, size, isUnsigned); return 1;
+            case OP_TILDE: *value = AnalyzerConstTruncate(~r, size, isUnsigned); return 1;
+            case OP_NOT: *value = !r; return 1;
+            default: return 0;
+        }
+    }
+    else if (Node->tag == AST_BOP)
+    {
+        if (!AnalyzerConstValue(arch, Node->l, &l)) return 0;
+
+        /*правый операнд && и || может быть не константой, если не вычисляется*/
+        if (Node->o == OP_ANDAND || Node->o == OP_OROR)
+        {
+            if (!l == (Node->o == OP_ANDAND))
+            {
+                *value = Node->o == OP_OROR;
+                return 1;
+            }
+
+            if (!AnalyzerConstValue(arch, Node->r, &r)) return 0;
+
+            *value = r != 0;
+            return 1;
+        }
+
+        if (!AnalyzerConstValue(arch, Node->r, &r)) return 0;
+        else if (Node->o == OP_COMMA)
+        {
+            *value = r;
+            return 1;
+        }
+
+        return AnalyzerConstBOP(Node->o, Node->l->dt, Node->r->dt, l, r, value);
+    }
+    else if (Node->tag == AST_TOP)
+    {
+        long cond;
+        int size, isUnsigned;
+
+        if (!AnalyzerConstValue(arch, Node->firstChild, &cond)) return 0;
+        else if (!AnalyzerConstValue(arch, cond ? Node->l : Node->r, value)) return 0;
+
+        /*общий тип ветвей: 1 ? -1 : 0u - это UINT_MAX*/
+        AnalyzerConstCommon(Node->l->dt, Node->r->dt, &size, &isUnsigned);
+        *value = AnalyzerConstTruncate(*value, size, isUnsigned);
+        return 1;
+    }
+    else if (Node->tag == AST_CAST)
+    {
+        if (!AnalyzerConstValue(arch, Node->r, value)) return 0;
+
+        *value = AnalyzerConstWrap(Node->dt, *value);
+        return 1;
+    }
+
+    else if (Node->tag == AST_SIZEOF && Node->r->dt && !TypeIsInvalid(Node->r->dt))
+    {
+        *value = TypeGetSize(arch, Node->r->dt);
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,13 +1,71 @@
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
 #include "..\include\arch.h"
 #include "..\include\symbol.h"
 #include "..\include\register.h"
 
+//процессор для -march и -mtune: набор команд и настройка блочных пересылок
+typedef struct ArchCpu {
+    const char* name;
+    int features;
+    int vectorSize;     //предпочтительная ширина, не больше позволенной командами
+    int fastStrings;    //ERMS
+} ArchCpu;
+
+enum {
+    ARCH_V2 = ARCH_SSE42 | ARCH_POPCNT,
+    ARCH_V3 = ARCH_V2 | ARCH_AVX2 | ARCH_BMI1 | ARCH_BMI2 | ARCH_LZCNT | ARCH_MOVBE
+};
+
+/*у Zen 1 256-битные операции разбиваются надвое, rep movsb без ERMS до Zen 3*/
+static const ArchCpu ArchCpus[] = {
+    {"x86-64", 0, 32, 1},
+    {"x86-64-v2", ARCH_V2, 32, 1},
+    {"x86-64-v3", ARCH_V3, 32, 1},
+    {"nehalem", ARCH_V2, 16, 0},
+    {"sandybridge", ARCH_V2, 16, 0},
+    {"haswell", ARCH_V3, 32, 1},
+    {"skylake", ARCH_V3, 32, 1},
+    {"btver2", ARCH_V2 | ARCH_LZCNT | ARCH_BMI1 | ARCH_MOVBE, 16, 0},
+    {"znver1", ARCH_V3, 16, 0},
+    {"znver2", ARCH_V3, 32, 0},
+    {"znver3", ARCH_V3, 32, 1}
+};
+
+static const struct {
+    const char* name;
+    ARCH_FEATURE feature;
+} ArchFeatureNames[] = {
+    {"sse4.2", ARCH_SSE42},
+    {"popcnt", ARCH_POPCNT},
+    {"lzcnt", ARCH_LZCNT},
+    {"bmi", ARCH_BMI1},
+    {"bmi2", ARCH_BMI2},
+    {"movbe", ARCH_MOVBE},
+    {"avx2", ARCH_AVX2}
+};
+
 void ArchInit (Arch* arch)
 {
     arch->wordsize = 0;
+    arch->os = OS_LINUX;
 
     VectorInit(&arch->scratchRegs, 4);
     VectorInit(&arch->calleeSaveRegs, 4);
+    VectorInit(&arch->calleeSaveXmms, 10);
+    VectorInit(&arch->argRegs, 6);
+    arch->sseArgRegs = 0;
+    arch->shadowSpace = 0;
+    arch->stackAlign = 0;
+    arch->vectorSize = 0;
+    arch->blockInline = 0;
+    arch->blockLoop = 0;
+    arch->fastStrings = 0;
+    arch->features = 0;
     arch->asflags = 0;
     arch->ldflags = 0;
     
@@ -18,6 +76,8 @@ void ArchFree (Arch* arch)
 {
     VectorFree(&arch->scratchRegs);
     VectorFree(&arch->calleeSaveRegs);
+    VectorFree(&arch->calleeSaveXmms);
+    VectorFree(&arch->argRegs);
 
     free(arch->asflags);
     free(arch->ldflags);
@@ -29,9 +89,12 @@ void ArchFree (Arch* arch)
 void ArchSetup (Arch* arch, OS_TAG os, int wordsize)
 {
     arch->wordsize = wordsize;
+    arch->os = os;
 
     /*сохранеие регистров для вызова*/
     ArchSetupRegs(arch, os);
+    ArchSetupArgs(arch, os);
+    ArchSetupBlocks(arch);
 
     if (os == OS_LINUX) arch->symbolMangler = ManglerLinux;
     else if (os == OS_WINDOWS)  arch->symbolMangler = ManglerWindows;
@@ -45,7 +108,110 @@ void ArchSetup (Arch* arch, OS_TAG os, int wordsize)
     ArchSetupDriverFlags(arch, os);
 }
 
+//набор команд по -march (0 - x86-64), плюс enable и минус disable из
+//-m<возможность> и -mno-<возможность>; настройка по -mtune, иначе по -march.
+//"native" - процессор, на котором идет сборка
+void ArchSetupCpu (Arch* arch, const char* march, const char* mtune, int enable, int disable)
+{
+    ArchCpu isa, tune;
+
+    ArchFindCpu(march ? march : "x86-64", &isa);
+    ArchFindCpu(mtune ? mtune : march ? march : "x86-64", &tune);
+
+    /*AVX2 требует SSE4.2*/
+    if (enable & ARCH_AVX2) enable |= ARCH_SSE42;
+    if (disable & ARCH_SSE42) disable |= ARCH_AVX2;
+
+    arch->features = (isa.features | enable) & ~disable;
+    arch->vectorSize = ArchHas(arch, ARCH_AVX2) && tune.vectorSize == 32 ? 32 : 16;
+    arch->fastStrings = tune.fastStrings;
+}
+
+int ArchHas (const Arch* arch, ARCH_FEATURE feature)
+{
+    return (arch->features & feature) == (int) feature;
+}
+
+//известное имя для -march и -mtune
+int ArchIsCpu (const char* name)
+{
+    ArchCpu cpu;
+
+    return ArchFindCpu(name, &cpu);
+}
+
+//возможность по имени из -m<имя>, 0 - нет такой
+int ArchFeatureByName (const char* name)
+{
+    for (unsigned i = 0; i < sizeof(ArchFeatureNames) / sizeof(ArchFeatureNames[0]); i++)
+        if (!strcmp(ArchFeatureNames[i].name, name)) return ArchFeatureNames[i].feature;
+
+    return 0;
+}
+
 //внутренние функции
+static int ArchFindCpu (const char* name, ArchCpu* cpu)
+{
+    if (!strcmp(name, "native"))
+    {
+        ArchHostCpu(cpu);
+        return 1;
+    }
+
+    for (unsigned i = 0; i < sizeof(ArchCpus) / sizeof(ArchCpus[0]); i++)
+    {
+        if (!strcmp(ArchCpus[i].name, name))
+        {
+            *cpu = ArchCpus[i];
+            return 1;
+        }
+    }
+
+    *cpu = ArchCpus[0];
+    return 0;
+}
+
+//возможности по cpuid. AVX2 годен, только если ОС сохраняет YMM (XCR0)
+static void ArchHostCpu (ArchCpu* cpu)
+{
+    *cpu = ArchCpus[0];
+    cpu->name = "native";
+
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned a, b, c, d;
+    unsigned max = __get_cpuid_max(0, 0);
+    int ymm = 0;
+
+    if (max >= 1 && __get_cpuid(1, &a, &b, &c, &d))
+    {
+        if (c & bit_SSE4_2) cpu->features |= ARCH_SSE42;
+        if (c & bit_POPCNT) cpu->features |= ARCH_POPCNT;
+        if (c & bit_MOVBE) cpu->features |= ARCH_MOVBE;
+
+        if (c & bit_OSXSAVE)
+        {
+            unsigned xcr0, high;
+
+            __asm__ ("xgetbv" : "=a" (xcr0), "=d" (high) : "c" (0));
+            ymm = (xcr0 & 6) == 6;
+        }
+    }
+
+    if (max >= 7 && __get_cpuid_count(7, 0, &a, &b, &c, &d))
+    {
+        if (b & bit_BMI) cpu->features |= ARCH_BMI1;
+        if (b & bit_BMI2) cpu->features |= ARCH_BMI2;
+        if ((b & bit_AVX2) && ymm) cpu->features |= ARCH_AVX2;
+
+        /*ERMS*/
+        cpu->fastStrings = (b >> 9) & 1;
+    }
+
+    if (__get_cpuid(0x80000001, &a, &b, &c, &d) && (c & bit_LZCNT))
+        cpu->features |= ARCH_LZCNT;
+#endif
+}
+
 static void ManglerLinux (Symbol* Symbol)
 {
     Symbol->label = strdup(Symbol->ident);
@@ -73,18 +239,60 @@ static void ArchSetupRegs (Arch* arch, OS_TAG os)
         REG_INDEX calleeSaveRegs[5] = {REG_RBX, REG_R12, REG_R13, REG_R14, REG_R15};
 
         VectorPushFromArray(&arch->scratchRegs, (void**) scratchRegs, sizeof(scratchRegs)/sizeof(REG_INDEX), sizeof(REG_INDEX));
-        VectorPushFromArray(&arch->calleeSaveRegs, (void**) calleeSaveRegs, sizeof(scratchRegs)/sizeof(REG_INDEX), sizeof(REG_INDEX));
+        VectorPushFromArray(&arch->calleeSaveRegs, (void**) calleeSaveRegs, sizeof(calleeSaveRegs)/sizeof(REG_INDEX), sizeof(REG_INDEX));
 
-        /*сохранить RDI & RSI*/
-        Vector* RSIandRDI = os == OS_WINDOWS ? &arch->scratchRegs : &arch->calleeSaveRegs;
+        /*RDI & RSI: в SysV передают аргументы и не сохраняются, в Win64 - сохраняются*/
+        Vector* RSIandRDI = os == OS_WINDOWS ? &arch->calleeSaveRegs : &arch->scratchRegs;
         
         VectorPush(RSIandRDI, (void*) REG_RSI);
         VectorPush(RSIandRDI, (void*) REG_RDI);
+
+        if (os == OS_WINDOWS)
+        {
+            for (REG_INDEX r = REG_XMM6; r <= REG_XMM15; r++)
+                VectorPush(&arch->calleeSaveXmms, (void*) r);
+        }
     }
     else
         DebugErrorUnhandledInt("ArchSetupRegs", "размер аппартного слова", arch->wordsize);
 }
 
+//регистры аргументов: SysV - RDI RSI RDX RCX R8 R9 и XMM0-7, Win64 - RCX RDX R8 R9
+//или XMM0-3 по позиции аргумента и 32 байта теневой области; 32 бита - только стек
+static void ArchSetupArgs (Arch* arch, OS_TAG os)
+{
+    arch->stackAlign = 16;
+
+    if (arch->wordsize != 8) return;
+
+    if (os == OS_WINDOWS)
+    {
+        REG_INDEX argRegs[4] = {REG_RCX, REG_RDX, REG_R8, REG_R9};
+
+        VectorPushFromArray(&arch->argRegs, (void**) argRegs, sizeof(argRegs)/sizeof(REG_INDEX), sizeof(REG_INDEX));
+        arch->sseArgRegs = 4;
+        arch->shadowSpace = 32;
+    }
+    else
+    {
+        REG_INDEX argRegs[6] = {REG_RDI, REG_RSI, REG_RDX, REG_RCX, REG_R8, REG_R9};
+
+        VectorPushFromArray(&arch->argRegs, (void**) argRegs, sizeof(argRegs)/sizeof(REG_INDEX), sizeof(REG_INDEX));
+        arch->sseArgRegs = 8;
+        arch->shadowSpace = 0;
+    }
+}
+
+//блочные пересылки для базового x86-64: SSE2 есть всегда, rep movsb
+//с ERMS быстрее цикла после пары килобайт
+static void ArchSetupBlocks (Arch* arch)
+{
+    arch->vectorSize = 16;
+    arch->blockInline = 128;
+    arch->blockLoop = 2048;
+    arch->fastStrings = 1;
+}
+
 static void ArchSetupDriverFlags (Arch* arch, OS_TAG os)
 {
     (void) os;
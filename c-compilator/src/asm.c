@@ -20,6 +20,22 @@ AsmCTX* AsmInit (const char* output, const Arch* arch)
     return ctx;
 }
 
+//контекст, пишущий в память, для выдачи одной функции в отдельном потоке
+AsmCTX* AsmInitBuffer (const AsmCTX* parent, char** buffer, size_t* length)
+{
+    AsmCTX* ctx = malloc(sizeof(AsmCTX));
+
+    ctx->filename = strdup(parent->filename);
+    ctx->file = open_memstream(buffer, length);
+    ctx->lineNo = 1;
+    ctx->depth = parent->depth;
+    ctx->arch = parent->arch;
+    /*регистры стека разделяются с родителем и им же освобождаются*/
+    ctx->stackPtr = parent->stackPtr;
+    ctx->basePtr = parent->basePtr;
+    return ctx;
+}
+
 void AsmEnd (AsmCTX* ctx)
 {
     free(ctx->filename);
@@ -29,18 +45,30 @@ void AsmEnd (AsmCTX* ctx)
     free(ctx);
 }
 
+void AsmEndBuffer (AsmCTX* ctx)
+{
+    free(ctx->filename);
+    fclose(ctx->file);
+    free(ctx);
+}
+
 void AsmOutLn (AsmCTX* ctx, const char* format, ...)
 {
     for (int i = 0; i < 4*ctx->depth; i++)
         fputc(' ', ctx->file);
 
-    va_list args[2];
-    va_start(args[0], format);
-    va_copy(args[1], args[0]);
-    DebugVarMsg(format, args[0]);
-    vfprintf(ctx->file, format, args[1]);
-    va_end(args[1]);
-    va_end(args[0]);
+    va_list args;
+
+    if (DebugIsOn(DEBUG_FULL))
+    {
+        va_start(args, format);
+        DebugTraceV(format, args);
+        va_end(args);
+    }
+
+    va_start(args, format);
+    vfprintf(ctx->file, format, args);
+    va_end(args);
 
     fputc('\n', ctx->file);
     ctx->lineNo++;
@@ -1,14 +1,35 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 
 #include "..\include\asm64.h"
 #include "..\include\asm.h"
 #include "..\include\register.h"
 #include "..\include\arch.h"
+#include "..\include\abi.h"
 #include "..\include\debug.h"
 #include "..\include\util.h"
 
+static Register* AsmBorrowReg (IrCTX* ir, IrBLOCK* block, REG_INDEX r, Operand* Values, int n);
+static char* AsmSizedStr (Operand Value, int size);
+static Register* AsmDivideMagic (IrCTX* ir, IrBLOCK* block, Operand X, unsigned __int128 m, int N, int pre, int post, int isUnsigned);
+static Register* AsmCallStaging (void);
+static void AsmAsciz (AsmCTX* ctx, const char* str);
+
+//секция кода
+void AsmTextSection (AsmCTX* ctx)
+{
+    AsmOutLn(ctx, ".text");
+}
+
+//секция редко выполняемого кода, компоновщик собирает ее отдельно от горячего
+void AsmColdSection (AsmCTX* ctx)
+{
+    AsmOutLn(ctx, ".section .text.unlikely,\"ax\",@progbits");
+}
+
 //секция данных для глобальных и статических переменных
 void AsmDataSection (AsmCTX* ctx)
 {
@@ -37,6 +58,26 @@ void AsmStaticData (AsmCTX* ctx, const char* label, int global, int size, intptr
         DebugErrorUnhandledInt("AsmStaticData", "data size", size);
 }
 
+//произвольные байты строкой ассемблера: кавычки, '\' и непечатаемые
+//экранируются
+static void AsmAsciz (AsmCTX* ctx, const char* str)
+{
+    char* escaped = malloc(4*strlen(str) + 1);
+    char* out = escaped;
+
+    for (const unsigned char* c = (const unsigned char*) str; *c; c++)
+    {
+        if (*c == '"' || *c == '\\') out += sprintf(out, "\\%c", *c);
+        else if (*c < ' ' || *c >= 0x7f) out += sprintf(out, "\\%03o", *c);
+        else
+            *out++ = *c;
+    }
+
+    *out = 0;
+    AsmOutLn(ctx, ".asciz \"%s\"", escaped);
+    free(escaped);
+}
+
 //строка
 void AsmStringConstant (AsmCTX* ctx, const char* label, const char* str)
 {
@@ -44,6 +85,31 @@ void AsmStringConstant (AsmCTX* ctx, const char* label, const char* str)
     AsmOutLn(ctx, ".asciz \"%s\"", str);
 }
 
+//константа float или double по битам, выровненная по размеру
+void AsmFloatConstant (AsmCTX* ctx, const char* label, double value, int size)
+{
+    AsmOutLn(ctx, ".balign %d", size);
+    AsmOutLn(ctx, "%s:", label);
+
+    if (size == 4)
+    {
+        float single = (float) value;
+        uint32_t bits;
+
+        memcpy(&bits, &single, sizeof(bits));
+        AsmOutLn(ctx, ".long 0x%08X", (unsigned) bits);
+    }
+    else if (size == 8)
+    {
+        uint64_t bits;
+
+        memcpy(&bits, &value, sizeof(bits));
+        AsmOutLn(ctx, ".quad 0x%016llX", (unsigned long long) bits);
+    }
+    else
+        DebugErrorUnhandledInt("AsmFloatConstant", "data size", size);
+}
+
 //метка
 void AsmLabel (AsmCTX* ctx, const char* label)
 {
@@ -131,6 +197,259 @@ void AsmPush (IrCTX* ir, IrBLOCK* block, Operand L)
     }
 }
 
+//аргументы вызова по соглашению из call: выровненная область в стеке,
+//значения в памяти и копии byRef, затем регистры; Ret - буфер для
+//результата в памяти. Регистры аргументов должны быть свободны
+void AsmCallArgs (IrCTX* ir, IrBLOCK* block, const AbiCall* call, const Operand* args, Operand Ret)
+{
+    AsmCTX* ctx = ir->assem;
+    Register* staging = AsmCallStaging();
+    const char* stagingStr = RegIndexGetName((REG_INDEX) (staging - Regs), 8);
+    const char* spStr = RegIndexGetName(REG_RSP, ctx->arch->wordsize);
+    int depth = 0;
+
+    if (call->stackSize)
+        AsmBOP(ir, block, BINOP_SUB, ctx->stackPtr, OperandCreateLiteral(call->stackSize));
+
+    /*стек*/
+    for (int i = 0; i < call->n; i++)
+    {
+        const AbiArg* arg = &call->args[i];
+
+        if (arg->byRef)
+        {
+            AsmMove(ir, block, OperandCreateMem(ctx->stackPtr.base, arg->copy, arg->size), args[i]);
+
+            if (arg->eightbytes == 0)
+            {
+                IrBlockOut(block, "lea %s, [%s%+d]", stagingStr, spStr, arg->copy);
+                IrBlockOut(block, "mov qword ptr [%s%+d], %s", spStr, arg->offset, stagingStr);
+            }
+        }
+        else if (arg->eightbytes == 0)
+            AsmMove(ir, block, OperandCreateMem(ctx->stackPtr.base, arg->offset, arg->size), args[i]);
+    }
+
+    if (call->retOffset >= 0)
+        AsmEvalAddress(ir, block, OperandCreateMem(ctx->stackPtr.base, call->retOffset, ctx->arch->wordsize), Ret);
+
+    /*регистры: все восьмерки сначала в стек, потом по местам, чтобы загрузка
+      одного аргумента не затерла источник другого*/
+    for (int i = 0; i < call->n; i++)
+    {
+        const AbiArg* arg = &call->args[i];
+
+        for (int k = 0; k < arg->eightbytes; k++, depth += 8)
+        {
+            if (arg->byRef) IrBlockOut(block, "lea %s, [%s%+d]", stagingStr, spStr, arg->copy + depth);
+            else
+                AsmLoadEightbyte(ir, block, staging, args[i], 8*k, arg->size - 8*k < 8 ? arg->size - 8*k : 8);
+
+            IrBlockOut(block, "push %s", stagingStr);
+        }
+    }
+
+    if (call->retPtr != REG_UNDEFINED)
+    {
+        Ret.size = 8;
+
+        char* RetStr = OperandToStr(Ret);
+
+        IrBlockOut(block, "lea %s, %s", RegIndexGetName(call->retPtr, 8), RetStr);
+        free(RetStr);
+    }
+
+    for (int i = call->n - 1; i >= 0; i--)
+    {
+        const AbiArg* arg = &call->args[i];
+
+        for (int k = arg->eightbytes - 1; k >= 0; k--)
+        {
+            if (arg->classes[k] != ABI_SSE) IrBlockOut(block, "pop %s", RegIndexGetName(arg->regs[k], 8));
+            else
+            {
+                IrBlockOut(block, "pop %s", stagingStr);
+                IrBlockOut(block, "movq xmm%d, %s", arg->xmms[k], stagingStr);
+
+                /*Win64, вариативный аргумент - копия в целочисленном регистре*/
+                if (arg->regs[k] != REG_UNDEFINED)
+                    IrBlockOut(block, "mov %s, %s", RegIndexGetName(arg->regs[k], 8), stagingStr);
+            }
+        }
+    }
+
+    /*SysV: верхняя граница числа XMM регистров для вариативной функции*/
+    if (ctx->arch->wordsize == 8 && ctx->arch->os != OS_WINDOWS)
+        IrBlockOut(block, "mov %s, %d", RegIndexGetName(REG_RAX, 4), call->sseUsed);
+
+    RegFree(staging);
+}
+
+//промежуточный регистр раскладки: R11 и R10 не передают аргументов ни в
+//SysV, ни в Win64, так что XMM аргумент через него не затрет уже
+//снятый в RCX или RDX целый. RAX пишется только после раскладки
+static Register* AsmCallStaging (void)
+{
+    static const REG_INDEX order[3] = {REG_R11, REG_R10, REG_RAX};
+    Register* found = 0;
+
+    for (int i = 0; i < 3 && !found; i++)
+        found = RegRequest(order[i], 8);
+
+    if (!found) DebugError("AsmCallStaging", "R10, R11 и RAX заняты");
+
+    return found;
+}
+
+//switch: копия значения меньше двойного слова расширяется на месте
+void AsmSwitchWiden (AsmCTX* ctx, REG_INDEX value, int size, int isSigned)
+{
+    if (size < 4)
+        AsmOutLn(ctx, "%s %s, %s", isSigned ? "movsx" : "movzx", RegIndexGetName(value, 4), RegIndexGetName(value, size));
+}
+
+//сравнение с числом; не влезающее в imm32 идет через scratch
+void AsmSwitchCompare (AsmCTX* ctx, REG_INDEX value, int size, REG_INDEX scratch, long long literal)
+{
+    if (size < 8) AsmOutLn(ctx, "cmp %s, %d", RegIndexGetName(value, 4), (int) literal);
+    else if (literal == (int) literal) AsmOutLn(ctx, "cmp %s, %d", RegIndexGetName(value, 8), (int) literal);
+    else
+    {
+        AsmOutLn(ctx, "mov %s, %lld", RegIndexGetName(scratch, 8), literal);
+        AsmOutLn(ctx, "cmp %s, %s", RegIndexGetName(value, 8), RegIndexGetName(scratch, 8));
+    }
+}
+
+//переход по условию в мнемонике: знаковые и беззнаковые сравнения switch
+//в CONDITION_TAG не выражаются
+void AsmSwitchJump (AsmCTX* ctx, const char* condition, const char* label)
+{
+    AsmOutLn(ctx, "j%s %s", condition, label);
+}
+
+//scratch = value - low, дальше сравнивается беззнаково с размером диапазона
+void AsmSwitchIndex (AsmCTX* ctx, REG_INDEX value, int size, REG_INDEX scratch, long long low)
+{
+    int width = size < 8 ? 4 : 8;
+    const char* scratchStr = RegIndexGetName(scratch, width);
+
+    if (low == (int) low || width == 4)
+    {
+        AsmOutLn(ctx, "mov %s, %s", scratchStr, RegIndexGetName(value, width));
+
+        if (low) AsmOutLn(ctx, "sub %s, %d", scratchStr, (int) low);
+    }
+    else
+    {
+        AsmOutLn(ctx, "mov %s, %lld", scratchStr, (long long) (0ull - (unsigned long long) low));
+        AsmOutLn(ctx, "add %s, %s", scratchStr, RegIndexGetName(value, width));
+    }
+}
+
+//переход по таблице с индексом в scratch; в 64 битах таблица из смещений
+//относительно нее самой, так что код не зависит от адреса загрузки
+void AsmSwitchTable (AsmCTX* ctx, REG_INDEX value, REG_INDEX scratch, const char* table, char** labels, int n)
+{
+    if (ctx->arch->wordsize == 8)
+    {
+        const char* baseStr = RegIndexGetName(value, 8);
+        const char* scratchStr = RegIndexGetName(scratch, 8);
+
+        AsmOutLn(ctx, "lea %s, [rip + %s]", baseStr, table);
+        AsmOutLn(ctx, "movsxd %s, dword ptr [%s + %s*4]", scratchStr, baseStr, scratchStr);
+        AsmOutLn(ctx, "add %s, %s", scratchStr, baseStr);
+        AsmOutLn(ctx, "jmp %s", scratchStr);
+    }
+    else
+        AsmOutLn(ctx, "jmp dword ptr [%s + %s*4]", table, RegIndexGetName(scratch, 4));
+
+    /*таблица рядом с кодом в тексте, а в файле - в .rodata*/
+    AsmOutLn(ctx, ".pushsection .rodata");
+    AsmOutLn(ctx, ".balign 4");
+    AsmOutLn(ctx, "%s:", table);
+
+    for (int i = 0; i < n; i++)
+    {
+        if (ctx->arch->wordsize == 8) AsmOutLn(ctx, ".long %s - %s", labels[i], table);
+        else
+            AsmOutLn(ctx, ".long %s", labels[i]);
+    }
+
+    AsmOutLn(ctx, ".popsection");
+}
+
+//проверка бита scratch в маске: переход, если значение из этой группы
+void AsmSwitchBitTest (AsmCTX* ctx, REG_INDEX value, REG_INDEX scratch, unsigned long long mask, const char* label)
+{
+    int width = ctx->arch->wordsize;
+
+    AsmOutLn(ctx, "mov %s, %llu", RegIndexGetName(value, width), mask);
+    AsmOutLn(ctx, "bt %s, %s", RegIndexGetName(value, width), RegIndexGetName(scratch, width));
+    AsmOutLn(ctx, "jc %s", label);
+}
+
+//снятие области аргументов после возврата
+void AsmCallCleanup (IrCTX* ir, IrBLOCK* block, const AbiCall* call)
+{
+    AsmCTX* ctx = ir->assem;
+
+    if (call->stackSize)
+        AsmBOP(ir, block, BINOP_ADD, ctx->stackPtr, OperandCreateLiteral(call->stackSize));
+}
+
+//результат вызова из RAX/RDX или XMM0/XMM1 в Dest, запись из двух восьмерок -
+//в память по восьмеркам, буфер округлен до 8 байт. ABI_MEMORY уже в буфере;
+//на 32 битах float и double снимаются с вершины стека x87
+void AsmCallResult (IrCTX* ir, IrBLOCK* block, const AbiCall* call, Operand Dest)
+{
+    AsmCTX* ctx = ir->assem;
+    const AbiArg* ret = &call->ret;
+
+    if (ctx->arch->wordsize != 8 && ret->size && ret->eightbytes == 0 && ret->classes[0] != ABI_MEMORY)
+    {
+        const char* sizeStr = ret->size == 4 ? "dword" : "qword";
+
+        if (OperandIsMem(Dest))
+        {
+            Dest.size = ret->size;
+
+            char* DestStr = OperandToStr(Dest);
+
+            IrBlockOut(block, "fstp %s", DestStr);
+            free(DestStr);
+        }
+        else
+        {
+            IrBlockOut(block, "sub esp, 8");
+            IrBlockOut(block, "fstp %s ptr [esp]", sizeStr);
+            AsmMove(ir, block, Dest, OperandAsFloat(OperandCreateMem(ctx->stackPtr.base, 0, ret->size)));
+            IrBlockOut(block, "add esp, 8");
+        }
+
+        return;
+    }
+
+    for (int k = 0; k < ret->eightbytes; k++)
+    {
+        int size = ret->size - 8*k > 4 ? 8 : ret->size - 8*k == 3 ? 4 : ret->size - 8*k;
+        REG_INDEX r = ret->classes[k] == ABI_SSE ? REG_XMM0 + ret->xmms[k] : ret->regs[k];
+        Register* reg = RegRequest(r, size);
+        Operand Part = Dest;
+
+        if (Part.tag == OPERAND_MEM)
+        {
+            Part.offset += 8*k;
+            Part.size = size;
+        }
+
+        if (ret->classes[k] == ABI_SSE) Part = OperandAsFloat(Part);
+
+        AsmMove(ir, block, Part, OperandCreateReg(reg ? reg : &Regs[r]));
+
+        if (reg) RegFree(reg);
+    }
+}
+
 //вытолкнуть элемент из стека
 void AsmPop (IrCTX* ir, IrBLOCK* block, Operand L)
 {
@@ -164,28 +483,17 @@ void AsmMove (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src)
 
     if (Dest.tag == OPERAND_INVALID || Src.tag == OPERAND_INVALID) return;
 
+    /*float и double: XMM регистры*/
+    else if (OperandIsFloat(Dest) || OperandIsFloat(Src))
+        AsmFloatMove(ir, block, Dest, Src);
+
     /*слишком большой для регистра*/
     else if (OperandGetSize(ctx->arch, Dest) > ctx->arch->wordsize)
     {
         if (DebugAssert("AsmMove", "Dest mem", Dest.tag == OPERAND_MEM) || DebugAssert("AsmMove", "Src mem", Src.tag == OPERAND_MEM)
            || DebugAssert("AsmMove", "operand size equality", OperandGetSize(ctx->arch, Dest) == OperandGetSize(ctx->arch, Src))) return;
 
-        int size = OperandGetSize(ctx->arch, Dest);
-        int chunk = ctx->arch->wordsize;
-        
-        Dest.size = Src.size = chunk;
-
-        /*Move up the operands, so far as a chunk would not go past their ends*/
-        for (int i = 0; i + chunk <= size; i += chunk, Dest.offset += chunk, Src.offset += chunk)
-            AsmMove(ir, block, Dest, Src);
-
-        /*Were the operands not an even multiple of the chunk size?*/
-        if (size % chunk != 0)
-        {
-            /*Final chunk size is the remainder*/
-            Dest.size = Src.size = size % chunk;
-            AsmMove(ir, block, Dest, Src);
-        }
+        AsmBlockMove(ir, block, Dest, Src, OperandCreateLiteral(OperandGetSize(ctx->arch, Dest)));
 
     /*оба операнда в памяти*/
     }
@@ -220,9 +528,7 @@ void AsmMove (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src)
 
 void AsmConditionalMove (IrCTX* ir, IrBLOCK* block, Operand Cond, Operand Dest, Operand Src)
 {
-    char falseLabel[10];
-    
-    sprintf(falseLabel, ".%X", ir->labelNo++);
+    const char* falseLabel = IrFnCreateLabel(block->fn);
 
     Cond.condition = ConditionNegate(Cond.condition);
     char* cond = OperandToStr(Cond);
@@ -261,6 +567,53 @@ void AsmRepStos (IrCTX* ir, IrBLOCK* block, Operand RAX, Operand RCX, Operand RD
     AsmEvalAddress(ir, block, RDI, Dest);
 
     IrBlockOut(block, "rep stos%s", chunksize == 8 ? "q" : "d");
+
+    /*хвост: RDI уже за последним словом, в RAX тот же образец*/
+    int tail = length % chunksize;
+
+    if (tail & 4) IrBlockOut(block, "stosd");
+    if (tail & 2) IrBlockOut(block, "stosw");
+    if (tail & 1) IrBlockOut(block, "stosb");
+}
+
+//копирование блока памяти, Size - число или регистр. Малые блоки - пересылками
+//по убывающей ширине с перекрытием последней, средние - развернутым циклом,
+//большие и неизвестные - rep movsb или memcpy, см. Arch.blockInline
+void AsmBlockMove (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src, Operand Size)
+{
+    const Arch* arch = ir->arch;
+    int destBase = AsmBlockBase(ir, block, &Dest);
+    int srcBase = AsmBlockBase(ir, block, &Src);
+
+    if (Size.tag != OPERAND_LITERAL || Size.literal > arch->blockLoop)
+        AsmBlockString(ir, block, 0, Dest, Src, Size);
+
+    else if (Size.literal > arch->blockInline)
+        AsmBlockLoop(ir, block, 0, Dest, Src, Size.literal);
+
+    else
+        AsmBlockInline(ir, block, 0, Dest, Src, Size.literal);
+
+    if (destBase != REG_UNDEFINED) RegFree(&Regs[destBase]);
+    if (srcBase != REG_UNDEFINED) RegFree(&Regs[srcBase]);
+}
+
+//заполнение блока байтом Value, число или регистр
+void AsmBlockFill (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Value, Operand Size)
+{
+    const Arch* arch = ir->arch;
+    int destBase = AsmBlockBase(ir, block, &Dest);
+
+    if (Size.tag != OPERAND_LITERAL || Size.literal > arch->blockLoop)
+        AsmBlockString(ir, block, 1, Dest, Value, Size);
+
+    else if (Size.literal > arch->blockInline)
+        AsmBlockLoop(ir, block, 1, Dest, Value, Size.literal);
+
+    else
+        AsmBlockInline(ir, block, 1, Dest, Value, Size.literal);
+
+    if (destBase != REG_UNDEFINED) RegFree(&Regs[destBase]);
 }
 
 //загрузка эффективного адреса
@@ -318,10 +671,72 @@ void AsmCompare (IrCTX* ir, IrBLOCK* block, Operand L, Operand R)
     }
 }
 
+//сравнение float/double, результат - флаги условия cond. ucomiss/ucomisd для
+//неупорядоченных (NaN) ставит ZF, PF и CF, при этом "выше" и "не ниже" ложны:
+//меньше - это больше с переставленными операндами. Равенству ZF недостаточно,
+//оно проверяется маской cmpeq/cmpneq
+Operand AsmFloatCompare (IrCTX* ir, IrBLOCK* block, CONDITION_TAG cond, Operand L, Operand R)
+{
+    int size = OperandGetSize(ir->arch, OperandIsFloat(L) ? L : R);
+    const char* suffix = size == 4 ? "ss" : "sd";
+
+    if (cond == CONDITION_LT || cond == CONDITION_LE)
+    {
+        Operand T = L;
+
+        L = R;
+        R = T;
+        cond = cond == CONDITION_LT ? CONDITION_GT : CONDITION_GE;
+    }
+
+    if (L.tag == OPERAND_LITERAL) L = IrFloatConstant(ir, block->fn, (double) L.literal, size);
+    if (R.tag == OPERAND_LITERAL) R = IrFloatConstant(ir, block->fn, (double) R.literal, size);
+
+    int equality = cond == CONDITION_EQ || cond == CONDITION_NE;
+    int tempL = equality || L.tag != OPERAND_REG || !OperandIsFloat(L);
+    int tempR = R.tag == OPERAND_REG && !OperandIsFloat(R);
+    Operand X = tempL ? OperandCreateReg(RegAllocFloat(size)) : L;
+    Operand Y = tempR ? OperandCreateReg(RegAllocFloat(size)) : R;
+
+    if (tempL) AsmFloatMove(ir, block, X, L);
+    if (tempR) AsmFloatMove(ir, block, Y, R);
+    if (OperandIsMem(Y)) Y.size = size;
+
+    char* XStr = OperandToStr(X);
+    char* YStr = OperandToStr(Y);
+
+    if (equality)
+    {
+        Register* gpr = RegAlloc(4);
+
+        IrBlockOut(block, "cmp%s%s %s, %s", cond == CONDITION_EQ ? "eq" : "neq", suffix, XStr, YStr);
+        IrBlockOut(block, "movd %s, %s", gpr->names[2], XStr);
+        IrBlockOut(block, "test %s, %s", gpr->names[2], gpr->names[2]);
+        RegFree(gpr);
+        cond = CONDITION_NE;
+    }
+    else
+    {
+        IrBlockOut(block, "ucomi%s %s, %s", suffix, XStr, YStr);
+        cond = ConditionUnsigned(cond);
+    }
+
+    free(XStr);
+    free(YStr);
+
+    if (tempL) OperandFree(X);
+    if (tempR) OperandFree(Y);
+
+    return OperandCreateFlags(cond);
+}
+
 //бинарные операции
 void AsmBOP (IrCTX* ir, IrBLOCK* block, BIN_OPERATION Op, Operand L, Operand R)
 {
-    if (OperandIsMem(L) && OperandIsMem(R))
+    if (OperandIsFloat(L))
+        AsmFloatBOP(ir, block, Op, L, R);
+
+    else if (OperandIsMem(L) && OperandIsMem(R))
     {
         Operand intermediate = OperandCreateReg(RegAlloc(max(L.size, R.size)));
         
@@ -355,6 +770,12 @@ void AsmBOP (IrCTX* ir, IrBLOCK* block, BIN_OPERATION Op, Operand L, Operand R)
             OperandFree(tmp);
         }
     }
+    else if ((Op == BINOP_SHL || Op == BINOP_SHR) && R.tag != OPERAND_LITERAL)
+        AsmShift(ir, block, Op, L, R);
+
+    else if (Op == BINOP_ANDNOT)
+        AsmAndNot(ir, block, L, R);
+
     else
     {
         char* LStr = OperandToStr(L);
@@ -376,7 +797,7 @@ void AsmBOP (IrCTX* ir, IrBLOCK* block, BIN_OPERATION Op, Operand L, Operand R)
     }
 }
 
-//деление
+//деление: делимое в RDX:RAX уже подготовлено вызывающим
 void AsmDivision (IrCTX* ir, IrBLOCK* block, Operand R)
 {
     (void) ir;
@@ -386,10 +807,77 @@ void AsmDivision (IrCTX* ir, IrBLOCK* block, Operand R)
     free(RStr);
 }
 
+//L = L / R или L % R для целых 4 и 8 байт, как в C: частное к нулю.
+//На число - умножение на обратное (Granlund-Montgomery) и сдвиги,
+//на степень двойки - сдвиг или маска с поправкой знака, иначе div/idiv
+void AsmDivide (IrCTX* ir, IrBLOCK* block, Operand L, Operand R, int isUnsigned, int modulo)
+{
+    int size = OperandGetSize(ir->arch, L);
+
+    if (size != 4 && size != 8)
+    {
+        DebugErrorUnhandledInt("AsmDivide", "operand size", size);
+        return;
+    }
+    /*деление на ноль оставлено процессору*/
+    else if (R.tag != OPERAND_LITERAL || R.literal == 0)
+    {
+        AsmDivideGeneric(ir, block, L, R, isUnsigned, modulo);
+        return;
+    }
+
+    Operand X = L.tag == OPERAND_REG ? L : OperandCreateReg(RegAlloc(size));
+
+    if (L.tag != OPERAND_REG) AsmMove(ir, block, X, L);
+
+    if (isUnsigned) AsmDivideUnsigned(ir, block, X, R.literal, size, modulo);
+    else AsmDivideSigned(ir, block, X, R.literal, size, modulo);
+
+    if (L.tag != OPERAND_REG)
+    {
+        AsmMove(ir, block, L, X);
+        OperandFree(X);
+    }
+}
+
+//преобразование целого в float/double и обратно, float в double и обратно.
+//isUnsigned - беззнаковость целой стороны; дробная часть отбрасывается, как в C
+void AsmConvert (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src, int isUnsigned)
+{
+    int destFloat = OperandIsFloat(Dest), srcFloat = OperandIsFloat(Src);
+    int size = OperandGetSize(ir->arch, Dest);
+
+    if (!destFloat && !srcFloat)
+        AsmMove(ir, block, Dest, Src);
+
+    else if (destFloat && srcFloat && size == OperandGetSize(ir->arch, Src))
+        AsmFloatMove(ir, block, Dest, Src);
+
+    /*число известно при компиляции*/
+    else if (destFloat && Src.tag == OPERAND_LITERAL)
+        AsmFloatMove(ir, block, Dest, IrFloatConstant(ir, block->fn, isUnsigned ? (double) (unsigned) Src.literal : (double) Src.literal, size));
+
+    else if (destFloat)
+        AsmConvertToFloat(ir, block, Dest, Src, isUnsigned);
+
+    else
+        AsmConvertToInt(ir, block, Dest, Src, isUnsigned);
+}
+
 //унарные операции
 void AsmUOP (IrCTX* ir, IrBLOCK* block, UNARY_OPERATION Op, Operand R)
 {
-    (void) ir;
+    if (OperandIsFloat(R))
+    {
+        AsmFloatUOP(ir, block, Op, R);
+        return;
+    }
+    else if (Op == UNARY_POPCOUNT || Op == UNARY_CLZ || Op == UNARY_CTZ || Op == UNARY_BSWAP)
+    {
+        AsmBitUOP(ir, block, Op, R);
+        return;
+    }
+
     char* RStr = OperandToStr(R);
 
     if (Op == UNARY_INC) IrBlockOut(block, "add %s, 1", RStr);
@@ -434,6 +922,9 @@ void AsmFnPrologue (IrCTX* ir, IrBLOCK* block, int localSize)
 {
     AsmCTX* ctx = ir->assem;
 
+    /*после пролога стек выровнен для вызовов из тела*/
+    localSize = AbiFrameSize(ctx->arch, localSize);
+
     AsmPush(ir, block, ctx->basePtr);
     AsmMove(ir, block, ctx->basePtr, ctx->stackPtr);
 
@@ -445,27 +936,1474 @@ void AsmFnPrologue (IrCTX* ir, IrBLOCK* block, int localSize)
         REG_INDEX r = (REG_INDEX) VectorGet(&ctx->arch->calleeSaveRegs, i);
         AsmSaveReg(ir, block, r);
     }
+
+    AsmSaveFloatRegs(ir, block, &ctx->arch->calleeSaveXmms);
 }
 
-//извлечение регистров из стека после завершения функции
-void AsmFnEpilogue (IrCTX* ir, IrBLOCK* block)
+//сохранение параметров, пришедших в регистрах, в их место в кадре
+void AsmFnParams (IrCTX* ir, IrBLOCK* block, const AbiCall* call)
 {
     AsmCTX* ctx = ir->assem;
 
-    for (int i = ctx->arch->calleeSaveRegs.length-1; i >= 0 ; i--)
+    if (call->retPtr != REG_UNDEFINED)
+        IrBlockOut(block, "mov qword ptr [%s%+d], %s", RegIndexGetName(REG_RBP, 8), call->retHome, RegIndexGetName(call->retPtr, 8));
+
+    for (int i = 0; i < call->n; i++)
     {
-        REG_INDEX r = (REG_INDEX) VectorGet(&ctx->arch->calleeSaveRegs, i);
-        AsmRestoreReg(ir, block, r);
-    }
+        const AbiArg* arg = &call->args[i];
 
-    AsmMove(ir, block, ctx->stackPtr, ctx->basePtr);
-    AsmPop(ir, block, ctx->basePtr);
+        for (int k = 0; k < arg->eightbytes; k++)
+        {
+            Operand Home = OperandCreateMem(ctx->basePtr.base, arg->home + 8*k, 8);
+            char* HomeStr = OperandToStr(Home);
+
+            if (arg->classes[k] == ABI_SSE) IrBlockOut(block, "movq %s, xmm%d", HomeStr, arg->xmms[k]);
+            else
+                IrBlockOut(block, "mov %s, %s", HomeStr, RegIndexGetName(arg->regs[k], 8));
+
+            free(HomeStr);
+        }
+    }
 }
 
-//внутрении функции
-//проверка операнда на размещения в памяти
-static int OperandIsMem (Operand L)
+//возвращаемое значение Src в регистры соглашения перед переходом к эпилогу;
+//ABI_MEMORY - копия в буфер по скрытому указателю, он же возвращается в RAX.
+//На 32 битах float и double - в st0
+void AsmFnResult (IrCTX* ir, IrBLOCK* block, const AbiCall* call, Operand Src)
 {
-    return L.tag == OPERAND_MEM || L.tag == OPERAND_LABELMEM;
-}
+    AsmCTX* ctx = ir->assem;
+    const AbiArg* ret = &call->ret;
+    int word = ctx->arch->wordsize;
+
+    if (ret->classes[0] == ABI_MEMORY)
+    {
+        Register* ptr = RegRequest(REG_RAX, word);
+
+        IrBlockOut(block, "mov %s, %s ptr [%s%+d]", RegIndexGetName(REG_RAX, word), word == 8 ? "qword" : "dword",
+                   RegIndexGetName(REG_RBP, word), call->retHome);
+        AsmBlockMove(ir, block, OperandCreateMem(&Regs[REG_RAX], 0, ret->size), Src, OperandCreateLiteral(ret->size));
+
+        if (ptr) RegFree(ptr);
 
+        return;
+    }
+    else if (word != 8 && ret->size && ret->eightbytes == 0)
+    {
+        const char* sizeStr = ret->size == 4 ? "dword" : "qword";
+
+        if (OperandIsMem(Src))
+        {
+            Src.size = ret->size;
+
+            char* SrcStr = OperandToStr(Src);
+
+            IrBlockOut(block, "fld %s", SrcStr);
+            free(SrcStr);
+        }
+        else
+        {
+            IrBlockOut(block, "sub esp, 8");
+            AsmMove(ir, block, OperandAsFloat(OperandCreateMem(ctx->stackPtr.base, 0, ret->size)), Src);
+            IrBlockOut(block, "fld %s ptr [esp]", sizeStr);
+            IrBlockOut(block, "add esp, 8");
+        }
+
+        return;
+    }
+
+    for (int k = 0; k < ret->eightbytes; k++)
+    {
+        int size = ret->size - 8*k > 4 ? 8 : ret->size - 8*k == 3 ? 4 : ret->size - 8*k;
+        REG_INDEX r = ret->classes[k] == ABI_SSE ? REG_XMM0 + ret->xmms[k] : ret->regs[k];
+        Register* reg = RegRequest(r, size);
+        Operand Part = Src;
+
+        if (Part.tag == OPERAND_MEM)
+        {
+            Part.offset += 8*k;
+            Part.size = size;
+        }
+
+        if (ret->classes[k] == ABI_SSE) Part = OperandAsFloat(Part);
+
+        AsmMove(ir, block, OperandCreateReg(reg ? reg : &Regs[r]), Part);
+
+        if (reg) RegFree(reg);
+    }
+}
+
+//извлечение регистров из стека после завершения функции
+void AsmFnEpilogue (IrCTX* ir, IrBLOCK* block)
+{
+    AsmCTX* ctx = ir->assem;
+
+    AsmRestoreFloatRegs(ir, block, &ctx->arch->calleeSaveXmms);
+
+    for (int i = ctx->arch->calleeSaveRegs.length-1; i >= 0 ; i--)
+    {
+        REG_INDEX r = (REG_INDEX) VectorGet(&ctx->arch->calleeSaveRegs, i);
+        AsmRestoreReg(ir, block, r);
+    }
+
+    AsmMove(ir, block, ctx->stackPtr, ctx->basePtr);
+    AsmPop(ir, block, ctx->basePtr);
+}
+
+//приращение счетчика профиля index; флаги портятся, регистры нет
+void AsmProfileCount (IrCTX* ir, IrBLOCK* block, const char* label, int index)
+{
+    AsmCTX* ctx = ir->assem;
+
+    if (ctx->arch->wordsize == 8)
+        IrBlockOut(block, "inc qword ptr [rip + %s+%d]", label, 8*index);
+
+    else
+    {
+        IrBlockOut(block, "add dword ptr [%s+%d], 1", label, 8*index);
+        IrBlockOut(block, "adc dword ptr [%s+%d], 0", label, 8*index + 4);
+    }
+}
+
+//счетчики модуля, описание его функций и регистрация в среде выполнения
+//конструктором; формат описания - ScProfileModule из runtime/profile.c
+void AsmProfileData (AsmCTX* ctx, const ProfileModule* module)
+{
+    const char* word = ctx->arch->wordsize == 8 ? ".quad" : ".long";
+    const char* label = module->label;
+
+    AsmDataSection(ctx);
+    AsmOutLn(ctx, ".balign 8");
+    AsmOutLn(ctx, "%s:", label);
+    AsmOutLn(ctx, ".zero %d", 8*module->counters);
+
+    /*имена - словами файла профиля, путь к нему - как есть*/
+    char* name = ProfileEscape(module->name);
+
+    AsmOutLn(ctx, "%s_name:", label);
+    AsmAsciz(ctx, name);
+    AsmOutLn(ctx, "%s_output:", label);
+    AsmAsciz(ctx, module->output);
+    free(name);
+
+    for (int i = 0; i < module->fns.length; i++)
+    {
+        const ProfileRecord* record = VectorGet(&module->fns, i);
+        char* fn = ProfileEscape(record->fn);
+
+        AsmOutLn(ctx, "%s_fn%d:", label, i);
+        AsmAsciz(ctx, fn);
+        AsmOutLn(ctx, "%s_sum%d:", label, i);
+        AsmAsciz(ctx, record->checksum);
+        free(fn);
+    }
+
+    /*имя, контрольная сумма, первый счетчик, их число*/
+    AsmOutLn(ctx, ".balign 8");
+    AsmOutLn(ctx, "%s_fns:", label);
+
+    for (int i = 0; i < module->fns.length; i++)
+    {
+        const ProfileRecord* record = VectorGet(&module->fns, i);
+
+        AsmOutLn(ctx, "%s %s_fn%d, %s_sum%d, %d, %d", word, label, i, label, i, record->first, record->n);
+    }
+
+    /*имя, выходной файл, функции, их число, счетчики, следующий модуль*/
+    AsmOutLn(ctx, "%s_desc:", label);
+    AsmOutLn(ctx, "%s %s_name, %s_output, %s_fns, %d, %s, 0", word, label, label, label, module->fns.length, label);
+
+    if (ctx->arch->os == OS_WINDOWS) AsmOutLn(ctx, ".section .ctors,\"dw\"");
+    else
+        AsmOutLn(ctx, ".section .init_array,\"aw\"");
+
+    AsmOutLn(ctx, ".balign %d", ctx->arch->wordsize);
+    AsmOutLn(ctx, "%s %s_ctor", word, label);
+
+    AsmTextSection(ctx);
+    AsmOutLn(ctx, "%s_ctor:", label);
+
+    if (ctx->arch->wordsize == 8)
+    {
+        AsmOutLn(ctx, "lea %s, [rip + %s_desc]", RegIndexGetName((REG_INDEX) VectorGet(&ctx->arch->argRegs, 0), 8), label);
+        AsmOutLn(ctx, "jmp %s", PROFILE_Register);
+    }
+    else
+    {
+        AsmOutLn(ctx, "push offset %s_desc", label);
+        AsmOutLn(ctx, "call %s", PROFILE_Register);
+        AsmOutLn(ctx, "add esp, 4");
+        AsmOutLn(ctx, "ret");
+    }
+
+    AsmDataSection(ctx);
+}
+
+//внутрении функции
+//восьмерка аргумента с отступом offset и размером size в 64-битный регистр r
+//с нулевым расширением; хвост нечетного размера собирается по байтам
+static void AsmLoadEightbyte (IrCTX* ir, IrBLOCK* block, const Register* r, Operand Src, int offset, int size)
+{
+    (void) ir;
+
+    const char* wide = r->names[3];
+    char* SrcStr;
+
+    if (Src.tag == OPERAND_MEM)
+    {
+        Src.offset += offset;
+        Src.size = size;
+    }
+    else if (DebugAssert("AsmLoadEightbyte", "scalar in one eightbyte", offset == 0)) return;
+
+    /*значение в XMM регистре - биты через movd/movq*/
+    if (Src.tag == OPERAND_REG && OperandIsFloat(Src))
+    {
+        IrBlockOut(block, "mov%s %s, %s", size == 8 ? "q" : "d", size == 8 ? wide : r->names[2], RegGetStr(Src.base));
+        return;
+    }
+
+    if (size == 3 || size > 4 && size < 8)
+    {
+        IrBlockOut(block, "xor %s, %s", r->names[2], r->names[2]);
+
+        for (int i = size - 1; i >= 0; i--)
+        {
+            Operand Byte = Src;
+
+            Byte.offset += i;
+            Byte.size = 1;
+            SrcStr = OperandToStr(Byte);
+
+            IrBlockOut(block, "shl %s, 8", wide);
+            IrBlockOut(block, "mov %s, %s", r->names[0], SrcStr);
+            free(SrcStr);
+        }
+
+        return;
+    }
+
+    SrcStr = OperandToStr(Src);
+
+    if (Src.tag == OPERAND_LITERAL || Src.tag == OPERAND_LABELOFFSET || size == 8)
+        IrBlockOut(block, "mov %s, %s", wide, SrcStr);
+
+    /*запись в 32-битную часть обнуляет старшую*/
+    else if (size == 4)
+        IrBlockOut(block, "mov %s, %s", r->names[2], SrcStr);
+
+    else
+        IrBlockOut(block, "movzx %s, %s", r->names[2], SrcStr);
+
+    free(SrcStr);
+}
+
+//проверка операнда на размещения в памяти
+static int OperandIsMem (Operand L)
+{
+    return L.tag == OPERAND_MEM || L.tag == OPERAND_LABELMEM;
+}
+
+//битовые операции: внутренние функции
+//сдвиг на регистр или память. BMI2: shlx/sarx со счетчиком в любом регистре
+//и без записи флагов. Иначе счетчик в CL, занятый RCX переносится во временный
+static void AsmShift (IrCTX* ir, IrBLOCK* block, BIN_OPERATION Op, Operand L, Operand R)
+{
+    int size = OperandGetSize(ir->arch, L);
+    char* LStr;
+
+    if (ArchHas(ir->arch, ARCH_BMI2) && size >= 4)
+    {
+        Operand Count = R.tag == OPERAND_REG ? R : OperandCreateReg(RegAlloc(OperandGetSize(ir->arch, R)));
+        Operand Dest = L.tag == OPERAND_REG ? L : OperandCreateReg(RegAlloc(size));
+        char* DestStr = OperandToStr(Dest);
+
+        if (R.tag != OPERAND_REG) AsmMove(ir, block, Count, R);
+
+        /*счетчик берется по модулю разрядности, старшие биты регистра не важны*/
+        LStr = OperandToStr(L);
+        IrBlockOut(block, "%s %s, %s, %s", Op == BINOP_SHL ? "shlx" : "sarx", DestStr, LStr,
+                   RegIndexGetName((REG_INDEX) (Count.base - Regs), size));
+
+        if (L.tag != OPERAND_REG)
+        {
+            AsmMove(ir, block, L, Dest);
+            OperandFree(Dest);
+        }
+
+        if (R.tag != OPERAND_REG) OperandFree(Count);
+
+        free(DestStr);
+        free(LStr);
+        return;
+    }
+
+    Register* saved = 0;
+    int inRcx = R.tag == OPERAND_REG && R.base == &Regs[REG_RCX];
+
+    if (!inRcx)
+    {
+        /*L в RCX или адресуется через него - работа с копией*/
+        saved = AsmBorrowReg(ir, block, REG_RCX, &L, 1);
+
+        char* RStr = OperandToStr(R);
+
+        if (R.tag == OPERAND_REG) IrBlockOut(block, "mov ecx, %s", RegIndexGetName((REG_INDEX) (R.base - Regs), 4));
+        else IrBlockOut(block, "mov %s, %s", RegIndexGetName(REG_RCX, OperandGetSize(ir->arch, R)), RStr);
+
+        free(RStr);
+    }
+
+    LStr = AsmSizedStr(L, size);
+    IrBlockOut(block, "%s %s, cl", Op == BINOP_SHL ? "sal" : "sar", LStr);
+    free(LStr);
+
+    if (!inRcx) AsmReturnReg(ir, block, REG_RCX, saved);
+}
+
+//регистр r под команду с неявным операндом. Занятый - значение переносится
+//во временный, а Values, которые в r или адресуются через него, переводятся
+//на копию; возвращается копия, 0 - r был свободен и теперь занят
+static Register* AsmBorrowReg (IrCTX* ir, IrBLOCK* block, REG_INDEX r, Operand* Values, int n)
+{
+    int wordsize = ir->arch->wordsize;
+
+    if (!RegIsUsed(r))
+    {
+        RegRequest(r, wordsize);
+        return 0;
+    }
+
+    Register* saved = RegAlloc(wordsize);
+
+    IrBlockOut(block, "mov %s, %s", RegIndexGetName((REG_INDEX) (saved - Regs), wordsize), RegIndexGetName(r, wordsize));
+
+    for (int i = 0; i < n; i++)
+    {
+        Operand* V = &Values[i];
+
+        if ((V->tag == OPERAND_REG || V->tag == OPERAND_MEM) && V->base == &Regs[r]) V->base = saved;
+        if (V->tag == OPERAND_MEM && V->index == &Regs[r]) V->index = saved;
+    }
+
+    return saved;
+}
+
+//возврат регистра после AsmBorrowReg: прежнее значение из копии, если была
+static void AsmReturnReg (IrCTX* ir, IrBLOCK* block, REG_INDEX r, Register* saved)
+{
+    int wordsize = ir->arch->wordsize;
+
+    if (!saved)
+    {
+        RegFree(&Regs[r]);
+        return;
+    }
+
+    IrBlockOut(block, "mov %s, %s", RegIndexGetName(r, wordsize), RegIndexGetName((REG_INDEX) (saved - Regs), wordsize));
+    RegFree(saved);
+}
+
+//операнд с регистром нужного размера: копия из AsmBorrowReg выделена словом
+static char* AsmSizedStr (Operand Value, int size)
+{
+    if (Value.tag == OPERAND_REG) return strdup(RegIndexGetName((REG_INDEX) (Value.base - Regs), size));
+    else return OperandToStr(Value);
+}
+
+//L = L & ~R. BMI1: andn dest, a, b дает ~a & b без отдельного not
+static void AsmAndNot (IrCTX* ir, IrBLOCK* block, Operand L, Operand R)
+{
+    int size = OperandGetSize(ir->arch, L);
+    int andn = ArchHas(ir->arch, ARCH_BMI1) && size >= 4;
+    char* LStr = OperandToStr(L);
+
+    if (R.tag == OPERAND_LITERAL)
+        IrBlockOut(block, "and %s, %d", LStr, ~R.literal);
+
+    else if (andn && L.tag == OPERAND_REG && R.tag == OPERAND_REG)
+        IrBlockOut(block, "andn %s, %s, %s", LStr, RegIndexGetName((REG_INDEX) (R.base - Regs), size), LStr);
+
+    else
+    {
+        Operand Mask = OperandCreateReg(RegAlloc(size));
+        char* MaskStr = OperandToStr(Mask);
+
+        AsmMove(ir, block, Mask, R);
+
+        if (andn)
+        {
+            IrBlockOut(block, "andn %s, %s, %s", MaskStr, MaskStr, LStr);
+            AsmMove(ir, block, L, Mask);
+        }
+        else
+        {
+            IrBlockOut(block, "not %s", MaskStr);
+            IrBlockOut(block, "and %s, %s", LStr, MaskStr);
+        }
+
+        free(MaskStr);
+        OperandFree(Mask);
+    }
+
+    free(LStr);
+}
+
+//счет битов и перестановка байт на месте. popcnt, lzcnt, tzcnt пишут
+//только в регистр; без них - bsr/bsf и параллельный подсчет
+static void AsmBitUOP (IrCTX* ir, IrBLOCK* block, UNARY_OPERATION Op, Operand R)
+{
+    int size = OperandGetSize(ir->arch, R);
+
+    if (size != 2 && size != 4 && size != 8)
+    {
+        DebugErrorUnhandledInt("AsmBitUOP", "operand size", size);
+        return;
+    }
+    else if (Op == UNARY_BSWAP)
+    {
+        AsmByteSwap(ir, block, R, size);
+        return;
+    }
+
+    Operand X = R.tag == OPERAND_REG ? R : OperandCreateReg(RegAlloc(size));
+    char* XStr = OperandToStr(X);
+    char* RStr = OperandToStr(R);
+
+    if (Op == UNARY_POPCOUNT && ArchHas(ir->arch, ARCH_POPCNT))
+        IrBlockOut(block, "popcnt %s, %s", XStr, RStr);
+
+    else if (Op == UNARY_POPCOUNT)
+    {
+        if (R.tag != OPERAND_REG) AsmMove(ir, block, X, R);
+
+        AsmPopCount(ir, block, (REG_INDEX) (X.base - Regs), size);
+    }
+    else if (Op == UNARY_CLZ && ArchHas(ir->arch, ARCH_LZCNT))
+        IrBlockOut(block, "lzcnt %s, %s", XStr, RStr);
+
+    /*номер старшего бита в число нулей перед ним*/
+    else if (Op == UNARY_CLZ)
+    {
+        IrBlockOut(block, "bsr %s, %s", XStr, RStr);
+        IrBlockOut(block, "xor %s, %d", XStr, size * 8 - 1);
+    }
+    else
+        IrBlockOut(block, "%s %s, %s", ArchHas(ir->arch, ARCH_BMI1) ? "tzcnt" : "bsf", XStr, RStr);
+
+    if (R.tag != OPERAND_REG)
+    {
+        AsmMove(ir, block, R, X);
+        OperandFree(X);
+    }
+
+    free(XStr);
+    free(RStr);
+}
+
+//число единиц в x без popcnt: суммы по 2, 4 и 8 бит, затем байты
+//складываются умножением в старший
+static void AsmPopCount (IrCTX* ir, IrBLOCK* block, REG_INDEX x, int size)
+{
+    static const unsigned long long masks[4] = {
+        0x5555555555555555ull, 0x3333333333333333ull, 0x0F0F0F0F0F0F0F0Full, 0x0101010101010101ull
+    };
+    int wide = size == 8 ? 8 : 4;
+    Register* t = RegAlloc(wide);
+    Register* m = RegAlloc(wide);
+    const char* X = RegIndexGetName(x, wide);
+    const char* T = RegIndexGetName((REG_INDEX) (t - Regs), wide);
+    const char* M = RegIndexGetName((REG_INDEX) (m - Regs), wide);
+    unsigned long long keep = wide == 8 ? ~0ull : 0xFFFFFFFFull;
+
+    (void) ir;
+
+    if (size == 2) IrBlockOut(block, "movzx %s, %s", X, RegIndexGetName(x, 2));
+
+    IrBlockOut(block, "mov %s, %s", T, X);
+    IrBlockOut(block, "shr %s, 1", T);
+    IrBlockOut(block, "mov %s, %llu", M, masks[0] & keep);
+    IrBlockOut(block, "and %s, %s", T, M);
+    IrBlockOut(block, "sub %s, %s", X, T);
+
+    IrBlockOut(block, "mov %s, %s", T, X);
+    IrBlockOut(block, "shr %s, 2", T);
+    IrBlockOut(block, "mov %s, %llu", M, masks[1] & keep);
+    IrBlockOut(block, "and %s, %s", X, M);
+    IrBlockOut(block, "and %s, %s", T, M);
+    IrBlockOut(block, "add %s, %s", X, T);
+
+    IrBlockOut(block, "mov %s, %s", T, X);
+    IrBlockOut(block, "shr %s, 4", T);
+    IrBlockOut(block, "add %s, %s", X, T);
+    IrBlockOut(block, "mov %s, %llu", M, masks[2] & keep);
+    IrBlockOut(block, "and %s, %s", X, M);
+
+    IrBlockOut(block, "mov %s, %llu", M, masks[3] & keep);
+    IrBlockOut(block, "imul %s, %s", X, M);
+    IrBlockOut(block, "shr %s, %d", X, wide * 8 - 8);
+
+    RegFree(t);
+    RegFree(m);
+}
+
+//16 бит - поворот на байт прямо в памяти; в памяти с MOVBE перестановка
+//совмещена с записью
+static void AsmByteSwap (IrCTX* ir, IrBLOCK* block, Operand R, int size)
+{
+    char* RStr = OperandToStr(R);
+
+    if (size == 2)
+        IrBlockOut(block, "rol %s, 8", RStr);
+
+    else if (R.tag == OPERAND_REG)
+        IrBlockOut(block, "bswap %s", RStr);
+
+    else
+    {
+        Operand T = OperandCreateReg(RegAlloc(size));
+        char* TStr = OperandToStr(T);
+
+        AsmMove(ir, block, T, R);
+
+        if (ArchHas(ir->arch, ARCH_MOVBE)) IrBlockOut(block, "movbe %s, %s", RStr, TStr);
+        else
+        {
+            IrBlockOut(block, "bswap %s", TStr);
+            AsmMove(ir, block, R, T);
+        }
+
+        free(TStr);
+        OperandFree(T);
+    }
+
+    free(RStr);
+}
+
+
+//деление: внутренние функции
+//множитель m до N+1 бит и сдвиг post: n / d = mulhi(n, m) >> post для всех
+//n из precision бит; наименьший сдвиг, как choose_multiplier в GCC
+static unsigned __int128 AsmDivMagic (unsigned long long d, int N, int precision, int* post)
+{
+    int l = 0;
+
+    while ((1ull << l) < d) l++;
+
+    unsigned __int128 low = ((unsigned __int128) 1 << (N + l)) / d;
+    unsigned __int128 high = (((unsigned __int128) 1 << (N + l)) + ((unsigned __int128) 1 << (N + l - precision))) / d;
+
+    while (l > 0 && low / 2 < high / 2)
+    {
+        low /= 2;
+        high /= 2;
+        l--;
+    }
+
+    *post = l;
+    return high;
+}
+
+//x = x / d или x % d без знака; x - регистр
+static void AsmDivideUnsigned (IrCTX* ir, IrBLOCK* block, Operand X, int literal, int size, int modulo)
+{
+    int N = size * 8;
+    unsigned long long d = size == 4 ? (unsigned) literal : (unsigned long long) (long long) literal;
+    const char* XStr = RegIndexGetName((REG_INDEX) (X.base - Regs), size);
+
+    if (d == 1)
+    {
+        if (modulo) IrBlockOut(block, "xor %s, %s", RegIndexGetName((REG_INDEX) (X.base - Regs), 4), RegIndexGetName((REG_INDEX) (X.base - Regs), 4));
+    }
+    /*маска меньше 2^31 - литерал положителен*/
+    else if ((d & (d - 1)) == 0)
+    {
+        if (modulo) IrBlockOut(block, "and %s, %llu", XStr, d - 1);
+        else IrBlockOut(block, "shr %s, %d", XStr, __builtin_ctzll(d));
+    }
+    /*старший бит делителя: частное 0 или 1*/
+    else if (d >> (N - 1))
+    {
+        Register* t = RegAlloc(size);
+        const char* T = RegIndexGetName((REG_INDEX) (t - Regs), size);
+
+        if (modulo)
+        {
+            IrBlockOut(block, "mov %s, %s", T, XStr);
+            IrBlockOut(block, "sub %s, %d", T, literal);
+            IrBlockOut(block, "cmovae %s, %s", XStr, T);
+        }
+        else
+        {
+            IrBlockOut(block, "xor %s, %s", RegIndexGetName((REG_INDEX) (t - Regs), 4), RegIndexGetName((REG_INDEX) (t - Regs), 4));
+            IrBlockOut(block, "cmp %s, %d", XStr, literal);
+            IrBlockOut(block, "setae %s", RegIndexGetName((REG_INDEX) (t - Regs), 1));
+            IrBlockOut(block, "mov %s, %s", XStr, T);
+        }
+
+        RegFree(t);
+    }
+    else
+    {
+        int post, pre = 0;
+        unsigned __int128 m = AsmDivMagic(d, N, N, &post);
+
+        /*множитель в N+1 бит: четный делитель делится заранее на 2^pre*/
+        if (m >> N && (d & 1) == 0)
+        {
+            pre = __builtin_ctzll(d);
+            m = AsmDivMagic(d >> pre, N, N - pre, &post);
+        }
+
+        AsmDivideFinish(block, X, AsmDivideMagic(ir, block, X, m, N, pre, post, 1), literal, size, modulo);
+    }
+}
+
+//x = x / d или x % d со знаком; частное округляется к нулю
+static void AsmDivideSigned (IrCTX* ir, IrBLOCK* block, Operand X, int literal, int size, int modulo)
+{
+    int N = size * 8;
+    unsigned long long ad = literal < 0 ? -(unsigned long long) (long long) literal : (unsigned long long) literal;
+    const char* XStr = RegIndexGetName((REG_INDEX) (X.base - Regs), size);
+
+    if (ad == 1)
+    {
+        if (modulo) IrBlockOut(block, "xor %s, %s", RegIndexGetName((REG_INDEX) (X.base - Regs), 4), RegIndexGetName((REG_INDEX) (X.base - Regs), 4));
+        else if (literal < 0) IrBlockOut(block, "neg %s", XStr);
+    }
+    /*отрицательное делимое смещается на |d| - 1, чтобы сдвиг округлял к нулю*/
+    else if ((ad & (ad - 1)) == 0)
+    {
+        int k = __builtin_ctzll(ad);
+        Register* t = RegAlloc(size);
+        const char* T = RegIndexGetName((REG_INDEX) (t - Regs), size);
+
+        IrBlockOut(block, "mov %s, %s", T, XStr);
+        if (k > 1) IrBlockOut(block, "sar %s, %d", T, N - 1);
+        IrBlockOut(block, "shr %s, %d", T, N - k);
+
+        /*остаток: ((x + смещение) & маска) - смещение*/
+        if (modulo)
+        {
+            IrBlockOut(block, "add %s, %s", XStr, T);
+            IrBlockOut(block, "and %s, %llu", XStr, ad - 1);
+            IrBlockOut(block, "sub %s, %s", XStr, T);
+        }
+        else
+        {
+            IrBlockOut(block, "add %s, %s", XStr, T);
+            IrBlockOut(block, "sar %s, %d", XStr, k);
+
+            if (literal < 0) IrBlockOut(block, "neg %s", XStr);
+        }
+
+        RegFree(t);
+    }
+    else
+    {
+        int post;
+        unsigned __int128 m = AsmDivMagic(ad, N, N - 1, &post);
+
+        Register* q = AsmDivideMagic(ir, block, X, m, N, 0, post, 0);
+
+        if (literal < 0) IrBlockOut(block, "neg %s", RegIndexGetName((REG_INDEX) (q - Regs), size));
+
+        AsmDivideFinish(block, X, q, literal, size, modulo);
+    }
+}
+
+//частное по множителю m и сдвигам pre и post в новом регистре, X не
+//меняется. 32 бита на 64-битной машине - в одном регистре, иначе старшая
+//половина произведения в RDX. Множитель в N+1 бит: без знака
+//q = (t + ((x - t) >> 1)) >> (post - 1), со знаком t = mulhs(x, m - 2^N) + x
+static Register* AsmDivideMagic (IrCTX* ir, IrBLOCK* block, Operand X, unsigned __int128 m, int N, int pre, int post, int isUnsigned)
+{
+    int size = N / 8;
+    int wide = ir->arch->wordsize > size;
+    int add = isUnsigned ? (int) (m >> N) : (int) (m >> (N - 1));
+    long long multiplier = (long long) (add ? m - ((unsigned __int128) 1 << N) : m);
+    Register* saved[2] = {0, 0};
+    Register* q;
+    Register* t;
+
+    if (wide)
+    {
+        q = RegAlloc(8);
+        t = RegAlloc(size);
+    }
+    else
+    {
+        AsmBorrowPair(ir, block, saved, &X, 1);
+        q = &Regs[REG_RDX];
+        t = &Regs[REG_RAX];
+    }
+
+    const char* XStr = RegIndexGetName((REG_INDEX) (X.base - Regs), size);
+    const char* Q = RegIndexGetName((REG_INDEX) (q - Regs), size);
+    const char* T = RegIndexGetName((REG_INDEX) (t - Regs), size);
+
+    /*q = старшая половина x * multiplier*/
+    if (wide)
+    {
+        const char* Q8 = RegIndexGetName((REG_INDEX) (q - Regs), 8);
+
+        if (isUnsigned) IrBlockOut(block, "mov %s, %s", Q, XStr);
+        else IrBlockOut(block, "movsxd %s, %s", Q8, XStr);
+
+        if (pre) IrBlockOut(block, "shr %s, %d", Q8, pre);
+
+        if (multiplier == (int) multiplier) IrBlockOut(block, "imul %s, %s, %lld", Q8, Q8, multiplier);
+        else
+        {
+            Register* c = RegAlloc(8);
+
+            IrBlockOut(block, "mov %s, %lld", RegIndexGetName((REG_INDEX) (c - Regs), 8), multiplier);
+            IrBlockOut(block, "imul %s, %s", Q8, RegIndexGetName((REG_INDEX) (c - Regs), 8));
+            RegFree(c);
+        }
+
+        /*без поправки сдвиги объединяются*/
+        IrBlockOut(block, "%s %s, %d", isUnsigned ? "shr" : "sar", Q8, add ? 32 : 32 + post);
+    }
+    else
+    {
+        IrBlockOut(block, "mov %s, %lld", T, multiplier);
+
+        if (pre)
+        {
+            IrBlockOut(block, "mov %s, %s", Q, XStr);
+            IrBlockOut(block, "shr %s, %d", Q, pre);
+            IrBlockOut(block, "mul %s", Q);
+        }
+        else
+            IrBlockOut(block, "%s %s", isUnsigned ? "mul" : "imul", XStr);
+
+        if (!add) IrBlockOut(block, "%s %s, %d", isUnsigned ? "shr" : "sar", Q, post);
+    }
+
+    if (add && isUnsigned)
+    {
+        IrBlockOut(block, "mov %s, %s", T, XStr);
+        IrBlockOut(block, "sub %s, %s", T, Q);
+        IrBlockOut(block, "shr %s, 1", T);
+        IrBlockOut(block, "add %s, %s", Q, T);
+
+        if (post > 1) IrBlockOut(block, "shr %s, %d", Q, post - 1);
+    }
+    else if (add)
+    {
+        IrBlockOut(block, "add %s, %s", Q, XStr);
+        IrBlockOut(block, "sar %s, %d", Q, post);
+    }
+
+    /*со знаком: отрицательному делимому единица прибавляется*/
+    if (!isUnsigned)
+    {
+        IrBlockOut(block, "mov %s, %s", T, XStr);
+        IrBlockOut(block, "shr %s, %d", T, N - 1);
+        IrBlockOut(block, "add %s, %s", Q, T);
+    }
+
+    if (wide)
+    {
+        RegFree(t);
+        return q;
+    }
+
+    /*RDX и RAX возвращаются владельцам, частное - в свободный регистр*/
+    Register* result = RegAlloc(size);
+
+    IrBlockOut(block, "mov %s, %s", RegIndexGetName((REG_INDEX) (result - Regs), size), Q);
+    AsmReturnReg(ir, block, REG_RDX, saved[1]);
+    AsmReturnReg(ir, block, REG_RAX, saved[0]);
+    return result;
+}
+
+//x = q или остаток x - q*d; q освобождается
+static void AsmDivideFinish (IrBLOCK* block, Operand X, Register* q, int literal, int size, int modulo)
+{
+    const char* XStr = RegIndexGetName((REG_INDEX) (X.base - Regs), size);
+    const char* Q = RegIndexGetName((REG_INDEX) (q - Regs), size);
+
+    if (modulo)
+    {
+        IrBlockOut(block, "imul %s, %s, %d", Q, Q, literal);
+        IrBlockOut(block, "sub %s, %s", XStr, Q);
+    }
+    else
+        IrBlockOut(block, "mov %s, %s", XStr, Q);
+
+    RegFree(q);
+}
+
+//делитель не число: делимое в RDX:RAX, занятые RAX и RDX сохраняются.
+//Делитель-число (ноль) - в регистр, div его не принимает
+static void AsmDivideGeneric (IrCTX* ir, IrBLOCK* block, Operand L, Operand R, int isUnsigned, int modulo)
+{
+    int size = OperandGetSize(ir->arch, L);
+    Operand Values[2] = {L, R};
+    Register* saved[2];
+
+    AsmBorrowPair(ir, block, saved, Values, 2);
+
+    Operand Divisor = R.tag == OPERAND_LITERAL ? OperandCreateReg(RegAlloc(size)) : Values[1];
+    char* LStr = AsmSizedStr(Values[0], size);
+    char* DStr = AsmSizedStr(Divisor, size);
+
+    if (R.tag == OPERAND_LITERAL) IrBlockOut(block, "mov %s, %d", DStr, R.literal);
+
+    IrBlockOut(block, "mov %s, %s", RegIndexGetName(REG_RAX, size), LStr);
+
+    if (isUnsigned) IrBlockOut(block, "xor edx, edx");
+    else IrBlockOut(block, size == 8 ? "cqo" : "cdq");
+
+    IrBlockOut(block, "%s %s", isUnsigned ? "div" : "idiv", DStr);
+    IrBlockOut(block, "mov %s, %s", LStr, RegIndexGetName(modulo ? REG_RDX : REG_RAX, size));
+
+    if (R.tag == OPERAND_LITERAL) OperandFree(Divisor);
+
+    free(LStr);
+    free(DStr);
+
+    AsmReturnReg(ir, block, REG_RDX, saved[1]);
+    AsmReturnReg(ir, block, REG_RAX, saved[0]);
+}
+
+//RAX и RDX для mul/div: сначала занимаются свободные, чтобы копия одного
+//не попала в другой
+static void AsmBorrowPair (IrCTX* ir, IrBLOCK* block, Register** saved, Operand* Values, int n)
+{
+    int raxFree = !RegIsUsed(REG_RAX);
+    int rdxFree = !RegIsUsed(REG_RDX);
+
+    if (raxFree) saved[0] = AsmBorrowReg(ir, block, REG_RAX, Values, n);
+    if (rdxFree) saved[1] = AsmBorrowReg(ir, block, REG_RDX, Values, n);
+    if (!raxFree) saved[0] = AsmBorrowReg(ir, block, REG_RAX, Values, n);
+    if (!rdxFree) saved[1] = AsmBorrowReg(ir, block, REG_RDX, Values, n);
+}
+
+
+//блочные пересылки: внутренние функции
+enum {
+    ASM_BlockVector = 4,    //XMM4-5: не аргументы ни в SysV, ни в Win64, и не сохраняются
+    ASM_BlockUnroll = 4     //векторов за проход цикла
+};
+
+//глобальная переменная адресуется через регистр, чтобы к ней прибавлять смещения
+//возвращает занятый регистр, REG_UNDEFINED - адресация не менялась
+static int AsmBlockBase (IrCTX* ir, IrBLOCK* block, Operand* L)
+{
+    if (L->tag != OPERAND_LABELMEM) return REG_UNDEFINED;
+
+    Register* base = RegAlloc(ir->arch->wordsize);
+
+    IrBlockOut(block, "lea %s, [%s]", RegGetStr(base), L->label);
+    *L = OperandCreateMem(base, 0, L->size);
+    return (int) (base - Regs);
+}
+
+//ширина пересылки для блока size: наибольшая, не превышающая его
+static int AsmBlockWidth (const Arch* arch, int size)
+{
+    if (size >= arch->vectorSize) return arch->vectorSize;
+    else if (size >= 16) return 16;
+    else if (size >= 8) return 8;
+    else if (size >= 4) return 4;
+    else
+        return size >= 2 ? 2 : 1;
+}
+
+//в вектор, если ширина не помещается в регистр общего назначения
+static int AsmBlockIsVector (const Arch* arch, int width)
+{
+    return width > arch->wordsize;
+}
+
+static void AsmBlockVectorName (char* name, int width, int n)
+{
+    sprintf(name, "%s%d", width == 32 ? "ymm" : "xmm", ASM_BlockVector + n % 2);
+}
+
+//образец заполнения: байт, повторенный в векторе и в регистре gpr
+static void AsmBlockPattern (IrCTX* ir, IrBLOCK* block, Operand Value, Register* gpr, int vector)
+{
+    const Arch* arch = ir->arch;
+    int isZero = Value.tag == OPERAND_LITERAL && (Value.literal & 0xFF) == 0;
+
+    if (isZero)
+    {
+        if (gpr) IrBlockOut(block, "xor %s, %s", gpr->names[2], gpr->names[2]);
+
+        if (vector) IrBlockOut(block, arch->vectorSize == 32 ? "vpxor xmm%d, xmm%d, xmm%d" : "pxor xmm%d, xmm%d", ASM_BlockVector, ASM_BlockVector, ASM_BlockVector);
+
+        return;
+    }
+
+    /*0x01010101 * байт: сначала в двойном слове*/
+    Register* word = gpr ? gpr : RegAlloc(4);
+
+    if (Value.tag == OPERAND_LITERAL) IrBlockOut(block, "mov %s, %d", word->names[2], (int) (0x01010101u * (Value.literal & 0xFF)));
+    else
+    {
+        IrBlockOut(block, "movzx %s, %s", word->names[2], Value.base->names[0]);
+        IrBlockOut(block, "imul %s, %s, 0x01010101", word->names[2], word->names[2]);
+    }
+
+    if (vector)
+    {
+        IrBlockOut(block, "movd xmm%d, %s", ASM_BlockVector, word->names[2]);
+        IrBlockOut(block, "pshufd xmm%d, xmm%d, 0", ASM_BlockVector, ASM_BlockVector);
+
+        if (arch->vectorSize == 32)
+            IrBlockOut(block, "vinsertf128 ymm%d, ymm%d, xmm%d, 1", ASM_BlockVector, ASM_BlockVector, ASM_BlockVector);
+    }
+
+    if (gpr && arch->wordsize == 8)
+    {
+        Register* high = RegAlloc(8);
+
+        IrBlockOut(block, "mov %s, %s", high->names[2], gpr->names[2]);
+        IrBlockOut(block, "shl %s, 32", high->names[3]);
+        IrBlockOut(block, "or %s, %s", gpr->names[3], high->names[3]);
+        RegFree(high);
+    }
+
+    if (!gpr) RegFree(word);
+}
+
+//одна пересылка ширины width по смещению offset; n чередует векторные регистры
+static void AsmBlockChunk (IrCTX* ir, IrBLOCK* block, int fill, Operand Dest, Operand Src, Register* gpr, int offset, int width, int n)
+{
+    const Arch* arch = ir->arch;
+    char vector[8];
+
+    Dest.offset += offset;
+    Dest.size = width;
+    Src.offset += offset;
+    Src.size = width;
+
+    char* DestStr = OperandToStr(Dest);
+    char* SrcStr = fill ? 0 : OperandToStr(Src);
+
+    if (AsmBlockIsVector(arch, width))
+    {
+        /*8 байт в 32 битах - младшая половина XMM*/
+        const char* op = width == 32 ? "vmovdqu" : width == 16 ? "movups" : "movq";
+
+        AsmBlockVectorName(vector, width, fill ? 0 : n);
+
+        if (!fill) IrBlockOut(block, "%s %s, %s", op, vector, SrcStr);
+
+        IrBlockOut(block, "%s %s, %s", op, DestStr, vector);
+    }
+    else
+    {
+        const char* reg = gpr->names[width == 1 ? 0 : width == 2 ? 1 : width == 4 ? 2 : 3];
+
+        if (!fill) IrBlockOut(block, "mov %s, %s", reg, SrcStr);
+
+        IrBlockOut(block, "mov %s, %s", DestStr, reg);
+    }
+
+    free(DestStr);
+    free(SrcStr);
+}
+
+//блок известного малого размера: пересылки одной ширины подряд, последняя
+//сдвинута к концу блока и перекрывает предыдущую
+static void AsmBlockInline (IrCTX* ir, IrBLOCK* block, int fill, Operand Dest, Operand Src, int size)
+{
+    const Arch* arch = ir->arch;
+    int width = AsmBlockWidth(arch, size);
+    int vector = AsmBlockIsVector(arch, width);
+    Register* gpr = vector ? 0 : RegAlloc(arch->wordsize);
+    int n = 0;
+
+    if (size <= 0) return;
+
+    if (fill) AsmBlockPattern(ir, block, Src, gpr, vector);
+
+    for (int offset = 0; offset + width <= size; offset += width)
+        AsmBlockChunk(ir, block, fill, Dest, Src, gpr, offset, width, n++);
+
+    if (size % width)
+        AsmBlockChunk(ir, block, fill, Dest, Src, gpr, size - width, width, n++);
+
+    if (vector && arch->vectorSize == 32) IrBlockOut(block, "vzeroupper");
+
+    if (gpr) RegFree(gpr);
+}
+
+//средний блок: цикл по ASM_BlockUnroll векторов, хвост - последними
+//векторами, сдвинутыми к концу блока
+static void AsmBlockLoop (IrCTX* ir, IrBLOCK* block, int fill, Operand Dest, Operand Src, int size)
+{
+    const Arch* arch = ir->arch;
+    int vec = arch->vectorSize, step = ASM_BlockUnroll * vec;
+    Register* dest = RegAlloc(arch->wordsize);
+    Register* src = fill ? 0 : RegAlloc(arch->wordsize);
+    Register* count = RegAlloc(arch->wordsize);
+    const char* loopLabel = IrFnCreateLabel(block->fn);
+
+    AsmEvalAddress(ir, block, OperandCreateReg(dest), Dest);
+
+    if (src) AsmEvalAddress(ir, block, OperandCreateReg(src), Src);
+
+    IrBlockOut(block, "mov %s, %d", RegGetStr(count), size / step);
+
+    if (fill) AsmBlockPattern(ir, block, Src, 0, 1);
+
+    Operand D = OperandCreateMem(dest, 0, vec);
+    Operand S = src ? OperandCreateMem(src, 0, vec) : Src;
+
+    IrBlockOut(block, "%s:", loopLabel);
+
+    for (int k = 0; k < ASM_BlockUnroll; k++)
+        AsmBlockChunk(ir, block, fill, D, S, 0, k * vec, vec, k);
+
+    IrBlockOut(block, "add %s, %d", RegGetStr(dest), step);
+
+    if (src) IrBlockOut(block, "add %s, %d", RegGetStr(src), step);
+
+    IrBlockOut(block, "sub %s, 1", RegGetStr(count));
+    IrBlockOut(block, "jnz %s", loopLabel);
+
+    /*остаток меньше прохода: последний проход, сдвинутый назад*/
+    if (size % step)
+    {
+        for (int k = 0; k < ASM_BlockUnroll; k++)
+            AsmBlockChunk(ir, block, fill, D, S, 0, size % step - step + k * vec, vec, k);
+    }
+
+    if (vec == 32) IrBlockOut(block, "vzeroupper");
+
+    RegFree(count);
+    RegFree(dest);
+
+    if (src) RegFree(src);
+}
+
+//значение на вершину стека: адрес операнда в памяти, регистр или число;
+//адрес считается через RAX, который сохраняется на месте результата
+static void AsmBlockPushValue (IrCTX* ir, IrBLOCK* block, Operand V, int depth)
+{
+    AsmCTX* ctx = ir->assem;
+    const char* acc = RegIndexGetName(REG_RAX, ctx->arch->wordsize);
+    const char* sp = RegIndexGetName(REG_RSP, ctx->arch->wordsize);
+
+    if (V.tag == OPERAND_LITERAL) IrBlockOut(block, "push %d", V.literal);
+    else if (V.tag == OPERAND_REG) IrBlockOut(block, "push %s", V.base->names[ctx->arch->wordsize == 8 ? 3 : 2]);
+    else
+    {
+        /*смещения от RSP сдвигаются на уже положенное в стек и на сам RAX*/
+        if (V.base == ctx->stackPtr.base) V.offset += depth + ctx->arch->wordsize;
+
+        V.size = ctx->arch->wordsize;
+
+        char* VStr = OperandToStr(V);
+
+        IrBlockOut(block, "push %s", acc);
+        IrBlockOut(block, "lea %s, %s", acc, VStr);
+        IrBlockOut(block, "xchg %s, [%s]", acc, sp);
+        free(VStr);
+    }
+}
+
+//значения vals в регистры targets через стек: загрузка одного не затирает
+//источник другого, как и в AsmCallArgs
+static void AsmBlockArgs (IrCTX* ir, IrBLOCK* block, const REG_INDEX* targets, const Operand* vals, int n, int depth)
+{
+    for (int i = 0; i < n; i++)
+        AsmBlockPushValue(ir, block, vals[i], depth + i * ir->arch->wordsize);
+
+    for (int i = n - 1; i >= 0; i--)
+        IrBlockOut(block, "pop %s", RegIndexGetName(targets[i], ir->arch->wordsize));
+}
+
+//большой или неизвестный блок: rep movsb/stosb при быстрых строковых командах,
+//иначе memcpy/memset с сохранением занятых временных регистров
+static void AsmBlockString (IrCTX* ir, IrBLOCK* block, int fill, Operand Dest, Operand Src, Operand Size)
+{
+    const Arch* arch = ir->arch;
+    int word = arch->wordsize;
+    REG_INDEX saved[REG_MAX];
+    int savedNo = 0;
+
+    Operand vals[3] = {Dest, Src, Size};
+
+    if (arch->fastStrings)
+    {
+        REG_INDEX targets[3] = {REG_RDI, fill ? REG_RAX : REG_RSI, REG_RCX};
+
+        for (int i = 0; i < 3; i++)
+            if (RegIsUsed(targets[i])) saved[savedNo++] = targets[i];
+
+        for (int i = 0; i < savedNo; i++)
+            IrBlockOut(block, "push %s", RegIndexGetName(saved[i], word));
+
+        AsmBlockArgs(ir, block, targets, vals, 3, savedNo * word);
+        IrBlockOut(block, fill ? "rep stosb" : "rep movsb");
+    }
+    else
+    {
+        const char* fn = fill ? "memset" : "memcpy";
+        Vector xmms;
+
+        VectorInit(&xmms, 4);
+
+        for (int i = 0; i < arch->scratchRegs.length; i++)
+        {
+            REG_INDEX r = (REG_INDEX) VectorGet(&arch->scratchRegs, i);
+
+            if (RegIsUsed(r)) saved[savedNo++] = r;
+        }
+
+        /*занятые XMM, кроме сохраняемых вызываемой*/
+        for (REG_INDEX r = REG_XMM0; r <= REG_XMM15; r++)
+            if (RegIsUsed(r) && VectorFind((Vector*) &arch->calleeSaveXmms, (void*) r) < 0) VectorPush(&xmms, (void*) r);
+
+        for (int i = 0; i < savedNo; i++)
+            IrBlockOut(block, "push %s", RegIndexGetName(saved[i], word));
+
+        AsmSaveFloatRegs(ir, block, &xmms);
+
+        int depth = savedNo * word + 16 * xmms.length;
+
+        if (word == 8)
+        {
+            /*стек в точке вызова выровнен, как и в теле функции*/
+            int pad = (savedNo % 2) * 8 + arch->shadowSpace;
+            REG_INDEX targets[3];
+
+            for (int i = 0; i < 3; i++)
+                targets[i] = (REG_INDEX) VectorGet(&arch->argRegs, i);
+
+            AsmBlockArgs(ir, block, targets, vals, 3, depth);
+
+            if (pad) IrBlockOut(block, "sub rsp, %d", pad);
+
+            IrBlockOut(block, "call %s%s", arch->os == OS_WINDOWS ? "_" : "", fn);
+
+            if (pad) IrBlockOut(block, "add rsp, %d", pad);
+        }
+        else
+        {
+            for (int i = 2; i >= 0; i--)
+                AsmBlockPushValue(ir, block, vals[i], depth + (2 - i) * word);
+
+            IrBlockOut(block, "call %s%s", arch->os == OS_WINDOWS ? "_" : "", fn);
+            IrBlockOut(block, "add esp, 12");
+        }
+
+        AsmRestoreFloatRegs(ir, block, &xmms);
+        VectorFree(&xmms);
+    }
+
+    for (int i = savedNo - 1; i >= 0; i--)
+        IrBlockOut(block, "pop %s", RegIndexGetName(saved[i], word));
+}
+
+//плавающая точка: внутренние функции
+//XMM регистры целиком в стек и обратно, по 16 байт - выравнивание не меняется
+static void AsmSaveFloatRegs (IrCTX* ir, IrBLOCK* block, const Vector* xmms)
+{
+    const char* sp = RegIndexGetName(REG_RSP, ir->arch->wordsize);
+
+    if (xmms->length == 0) return;
+
+    IrBlockOut(block, "sub %s, %d", sp, 16 * xmms->length);
+
+    for (int i = 0; i < xmms->length; i++)
+        IrBlockOut(block, "movdqu xmmword ptr [%s%+d], %s", sp, 16*i, RegIndexGetName((REG_INDEX) VectorGet(xmms, i), 8));
+}
+
+static void AsmRestoreFloatRegs (IrCTX* ir, IrBLOCK* block, const Vector* xmms)
+{
+    const char* sp = RegIndexGetName(REG_RSP, ir->arch->wordsize);
+
+    if (xmms->length == 0) return;
+
+    for (int i = 0; i < xmms->length; i++)
+        IrBlockOut(block, "movdqu %s, xmmword ptr [%s%+d]", RegIndexGetName((REG_INDEX) VectorGet(xmms, i), 8), sp, 16*i);
+
+    IrBlockOut(block, "add %s, %d", sp, 16 * xmms->length);
+}
+
+//movss/movsd с памятью, movaps между XMM, movd/movq с целочисленным регистром;
+//целое число становится константой в .rodata, ноль - xorps
+static void AsmFloatMove (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src)
+{
+    int size = OperandGetSize(ir->arch, OperandIsFloat(Dest) ? Dest : Src);
+    int destX = Dest.tag == OPERAND_REG && OperandIsFloat(Dest);
+    int srcX = Src.tag == OPERAND_REG && OperandIsFloat(Src);
+
+    if (Src.tag == OPERAND_LITERAL && !(destX && Src.literal == 0))
+    {
+        AsmFloatMove(ir, block, Dest, IrFloatConstant(ir, block->fn, (double) Src.literal, size));
+        return;
+    }
+    else if (OperandIsMem(Dest) && OperandIsMem(Src))
+    {
+        Operand intermediate = OperandCreateReg(RegAllocFloat(size));
+
+        AsmFloatMove(ir, block, intermediate, Src);
+        AsmFloatMove(ir, block, Dest, intermediate);
+        OperandFree(intermediate);
+        return;
+    }
+
+    if (OperandIsMem(Dest)) Dest.size = size;
+    if (OperandIsMem(Src)) Src.size = size;
+
+    char* DestStr = OperandToStr(Dest);
+    char* SrcStr = OperandToStr(Src);
+
+    if (Src.tag == OPERAND_LITERAL)
+        IrBlockOut(block, "xorps %s, %s", DestStr, DestStr);
+
+    else if (destX && srcX)
+    {
+        if (Dest.base != Src.base) IrBlockOut(block, "movaps %s, %s", DestStr, SrcStr);
+    }
+    /*биты значения между XMM и целочисленным регистром*/
+    else if ((destX && Src.tag == OPERAND_REG) || (srcX && Dest.tag == OPERAND_REG))
+    {
+        Operand Gpr = destX ? Src : Dest;
+        const char* GprStr = RegIndexGetName((REG_INDEX) (Gpr.base - Regs), size);
+
+        IrBlockOut(block, "mov%s %s, %s", size == 8 ? "q" : "d", destX ? DestStr : GprStr, destX ? GprStr : SrcStr);
+    }
+    /*целочисленный регистр и память: те же биты*/
+    else if (!destX && !srcX)
+        IrBlockOut(block, "mov %s, %s", DestStr, SrcStr);
+
+    else
+        IrBlockOut(block, "mov%s %s, %s", size == 4 ? "ss" : "sd", DestStr, SrcStr);
+
+    free(DestStr);
+    free(SrcStr);
+}
+
+//L = L op R для float/double: addss/addsd и т.д., приемник - XMM регистр
+static void AsmFloatBOP (IrCTX* ir, IrBLOCK* block, BIN_OPERATION Op, Operand L, Operand R)
+{
+    int size = OperandGetSize(ir->arch, L);
+    const char* OpStr = Op == BINOP_ADD ? "add" :
+                        Op == BINOP_SUB ? "sub" :
+                        Op == BINOP_MUL ? "mul" :
+                        Op == BINOP_DIV ? "div" : 0;
+
+    if (!OpStr)
+    {
+        DebugErrorUnhandledInt("AsmFloatBOP", "operator", Op);
+        return;
+    }
+    else if (L.tag != OPERAND_REG)
+    {
+        Operand intermediate = OperandCreateReg(RegAllocFloat(size));
+
+        AsmFloatMove(ir, block, intermediate, L);
+        AsmFloatBOP(ir, block, Op, intermediate, R);
+        AsmFloatMove(ir, block, L, intermediate);
+        OperandFree(intermediate);
+        return;
+    }
+    else if (R.tag == OPERAND_LITERAL)
+        R = IrFloatConstant(ir, block->fn, (double) R.literal, size);
+
+    else if (R.tag == OPERAND_REG && !OperandIsFloat(R))
+    {
+        Operand intermediate = OperandCreateReg(RegAllocFloat(size));
+
+        AsmFloatMove(ir, block, intermediate, R);
+        AsmFloatBOP(ir, block, Op, L, intermediate);
+        OperandFree(intermediate);
+        return;
+    }
+
+    if (OperandIsMem(R)) R.size = size;
+
+    char* LStr = OperandToStr(L);
+    char* RStr = OperandToStr(R);
+
+    IrBlockOut(block, "%s%s %s, %s", OpStr, size == 4 ? "ss" : "sd", LStr, RStr);
+    free(LStr);
+    free(RStr);
+}
+
+//смена знака - xorps с -0.0; у xorps операнд в памяти должен быть выровнен
+//на 16, поэтому маска через регистр
+static void AsmFloatUOP (IrCTX* ir, IrBLOCK* block, UNARY_OPERATION Op, Operand R)
+{
+    int size = OperandGetSize(ir->arch, R);
+
+    if (Op == UNARY_INC || Op == UNARY_DEC)
+        AsmFloatBOP(ir, block, Op == UNARY_INC ? BINOP_ADD : BINOP_SUB, R, OperandCreateLiteral(1));
+
+    else if (Op != UNARY_NEG)
+        DebugErrorUnhandledInt("AsmFloatUOP", "operator", Op);
+
+    else if (R.tag != OPERAND_REG)
+    {
+        Operand intermediate = OperandCreateReg(RegAllocFloat(size));
+
+        AsmFloatMove(ir, block, intermediate, R);
+        AsmFloatUOP(ir, block, Op, intermediate);
+        AsmFloatMove(ir, block, R, intermediate);
+        OperandFree(intermediate);
+    }
+    else
+    {
+        Operand Mask = OperandCreateReg(RegAllocFloat(size));
+        char* RStr = OperandToStr(R);
+        char* MaskStr = OperandToStr(Mask);
+
+        AsmFloatMove(ir, block, Mask, IrFloatConstant(ir, block->fn, -0.0, size));
+        IrBlockOut(block, "xorps %s, %s", RStr, MaskStr);
+        free(RStr);
+        free(MaskStr);
+        OperandFree(Mask);
+    }
+}
+
+//целое или float/double другого размера в float/double
+static void AsmConvertToFloat (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src, int isUnsigned)
+{
+    const Arch* arch = ir->arch;
+    int size = OperandGetSize(arch, Dest), srcSize = OperandGetSize(arch, Src);
+    const char* suffix = size == 4 ? "ss" : "sd";
+    int temp = Dest.tag != OPERAND_REG;
+    Operand X = temp ? OperandCreateReg(RegAllocFloat(size)) : Dest;
+    char* XStr = OperandToStr(X);
+
+    if (OperandIsFloat(Src))
+    {
+        if (OperandIsMem(Src)) Src.size = srcSize;
+
+        char* SrcStr = OperandToStr(Src);
+
+        IrBlockOut(block, "cvt%s2%s %s, %s", srcSize == 4 ? "ss" : "sd", suffix, XStr, SrcStr);
+        free(SrcStr);
+    }
+    else
+    {
+        /*беззнаковое двойное слово - в четверное с нулевым расширением*/
+        int wide = srcSize == 8 || (isUnsigned && srcSize == 4 && arch->wordsize == 8) ? 8 : 4;
+        Register* gpr = RegAlloc(wide);
+        const char* G = gpr->names[wide == 8 ? 3 : 2];
+        char* SrcStr = OperandToStr(Src);
+
+        if (srcSize < 4) IrBlockOut(block, "%s %s, %s", isUnsigned ? "movzx" : "movsx", gpr->names[2], SrcStr);
+        else if (srcSize == 4) IrBlockOut(block, "mov %s, %s", gpr->names[2], SrcStr);
+        else
+            IrBlockOut(block, "mov %s, %s", G, SrcStr);
+
+        free(SrcStr);
+
+        /*cvtsi2sd пишет только младшую часть: обнуление снимает зависимость*/
+        IrBlockOut(block, "xorps %s, %s", XStr, XStr);
+
+        const char* done = IrFnCreateLabel(block->fn);
+        const char* big = IrFnCreateLabel(block->fn);
+
+        if (isUnsigned && srcSize == 8)
+        {
+            /*старший бит: половина с сохранением младшего бита для
+              правильного округления, затем удвоение*/
+            Register* half = RegAlloc(8);
+
+            IrBlockOut(block, "test %s, %s", G, G);
+            IrBlockOut(block, "js %s", big);
+            IrBlockOut(block, "cvtsi2%s %s, %s", suffix, XStr, G);
+            IrBlockOut(block, "jmp %s", done);
+            IrBlockOut(block, "%s:", big);
+            IrBlockOut(block, "mov %s, %s", half->names[3], G);
+            IrBlockOut(block, "shr %s, 1", half->names[3]);
+            IrBlockOut(block, "and %s, 1", G);
+            IrBlockOut(block, "or %s, %s", half->names[3], G);
+            IrBlockOut(block, "cvtsi2%s %s, %s", suffix, XStr, half->names[3]);
+            IrBlockOut(block, "add%s %s, %s", suffix, XStr, XStr);
+            IrBlockOut(block, "%s:", done);
+            RegFree(half);
+        }
+        else if (isUnsigned && srcSize == 4 && arch->wordsize != 8)
+        {
+            /*32 бита: знаковое преобразование и поправка на 2^32*/
+            char* BiasStr = OperandToStr(IrFloatConstant(ir, block->fn, 4294967296.0, size));
+
+            IrBlockOut(block, "cvtsi2%s %s, %s", suffix, XStr, G);
+            IrBlockOut(block, "test %s, %s", G, G);
+            IrBlockOut(block, "jns %s", done);
+            IrBlockOut(block, "add%s %s, %s", suffix, XStr, BiasStr);
+            IrBlockOut(block, "%s:", done);
+            free(BiasStr);
+        }
+        else
+            IrBlockOut(block, "cvtsi2%s %s, %s", suffix, XStr, G);
+
+        RegFree(gpr);
+    }
+
+    free(XStr);
+
+    if (temp)
+    {
+        AsmFloatMove(ir, block, Dest, X);
+        OperandFree(X);
+    }
+}
+
+//float/double в целое с отбрасыванием дробной части
+static void AsmConvertToInt (IrCTX* ir, IrBLOCK* block, Operand Dest, Operand Src, int isUnsigned)
+{
+    const Arch* arch = ir->arch;
+    int size = OperandGetSize(arch, Dest), srcSize = OperandGetSize(arch, Src);
+    const char* suffix = srcSize == 4 ? "ss" : "sd";
+
+    /*беззнаковое двойное слово - через знаковое четверное, малые - через двойное*/
+    int wide = size == 8 || (isUnsigned && size == 4 && arch->wordsize == 8) ? 8 : 4;
+
+    if (DebugAssert("AsmConvertToInt", "64-bit integer on a 64-bit target", wide <= arch->wordsize)) return;
+
+    /*малый регистр, чтобы у него были имена всех частей*/
+    Register* gpr = RegAlloc(size < wide ? size : wide);
+    const char* G = gpr->names[wide == 8 ? 3 : 2];
+
+    if (OperandIsMem(Src)) Src.size = srcSize;
+
+    if (isUnsigned && size == 8)
+    {
+        /*от 2^63 и выше: вычитание 2^63, затем установка старшего бита*/
+        Operand X = OperandCreateReg(RegAllocFloat(srcSize));
+        char* LimitStr = OperandToStr(IrFloatConstant(ir, block->fn, 9223372036854775808.0, srcSize));
+        char* XStr = OperandToStr(X);
+        const char* done = IrFnCreateLabel(block->fn);
+        const char* big = IrFnCreateLabel(block->fn);
+
+        AsmFloatMove(ir, block, X, Src);
+        IrBlockOut(block, "ucomi%s %s, %s", suffix, XStr, LimitStr);
+        IrBlockOut(block, "jae %s", big);
+        IrBlockOut(block, "cvtt%s2si %s, %s", suffix, G, XStr);
+        IrBlockOut(block, "jmp %s", done);
+        IrBlockOut(block, "%s:", big);
+        IrBlockOut(block, "sub%s %s, %s", suffix, XStr, LimitStr);
+        IrBlockOut(block, "cvtt%s2si %s, %s", suffix, G, XStr);
+        IrBlockOut(block, "btc %s, 63", G);
+        IrBlockOut(block, "%s:", done);
+
+        free(LimitStr);
+        free(XStr);
+        OperandFree(X);
+    }
+    else
+    {
+        char* SrcStr = OperandToStr(Src);
+
+        IrBlockOut(block, "cvtt%s2si %s, %s", suffix, G, SrcStr);
+        free(SrcStr);
+    }
+
+    /*в приемник - младшая часть*/
+    gpr->allocatedAs = size;
+    AsmMove(ir, block, Dest, OperandCreateReg(gpr));
+    RegFree(gpr);
+}
@@ -0,0 +1,326 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "..\include\ast-pool.h"
+#include "..\include\debug.h"
+
+enum {
+    ASTPOOL_InitialCapacity = 256
+};
+
+//куда записать номер узла, когда он будет выделен
+typedef enum ASTPOOL_SLOT {
+    ASTPOOL_SLOT_ROOT,
+    ASTPOOL_SLOT_L,
+    ASTPOOL_SLOT_R,
+    ASTPOOL_SLOT_CHILD
+} ASTPOOL_SLOT;
+
+typedef struct AstPoolPending {
+    const Ast* node;
+    ASTPOOL_SLOT slot;
+    uint32_t index;
+} AstPoolPending;
+
+//внутренние функции
+static void* AstPoolGrow (void* array, int capacity, int elementSize)
+{
+    return realloc(array, (size_t) capacity * elementSize);
+}
+
+static void AstPoolReserve (AstPool* pool, int length)
+{
+    if (length <= pool->capacity) return;
+
+    int capacity = pool->capacity * 2 > length ? pool->capacity * 2 : length;
+
+    pool->tags = AstPoolGrow(pool->tags, capacity, sizeof(uint8_t));
+    pool->ops = AstPoolGrow(pool->ops, capacity, sizeof(uint8_t));
+    pool->subs = AstPoolGrow(pool->subs, capacity, sizeof(uint8_t));
+    pool->l = AstPoolGrow(pool->l, capacity, sizeof(AstId));
+    pool->r = AstPoolGrow(pool->r, capacity, sizeof(AstId));
+    pool->end = AstPoolGrow(pool->end, capacity, sizeof(AstId));
+    pool->firstChild = AstPoolGrow(pool->firstChild, capacity, sizeof(uint32_t));
+    pool->childNo = AstPoolGrow(pool->childNo, capacity, sizeof(uint32_t));
+    pool->location = AstPoolGrow(pool->location, capacity, sizeof(uint32_t));
+    pool->extra = AstPoolGrow(pool->extra, capacity, sizeof(uint32_t));
+    pool->capacity = capacity;
+}
+
+//узлы одного токена идут подряд: одинаковые позиции подряд не дублируются
+static uint32_t AstPoolAddLocation (AstPool* pool, TokenLocation location)
+{
+    if (pool->locationNo)
+    {
+        const TokenLocation* last = &pool->locations[pool->locationNo - 1];
+
+        if (last->fileId == location.fileId && last->line == location.line && last->lineChar == location.lineChar)
+            return pool->locationNo - 1;
+    }
+
+    if (pool->locationNo == pool->locationCapacity)
+    {
+        pool->locationCapacity *= 2;
+        pool->locations = realloc(pool->locations, sizeof(TokenLocation) * pool->locationCapacity);
+    }
+
+    pool->locations[pool->locationNo] = location;
+    return pool->locationNo++;
+}
+
+static uint32_t AstPoolAddExtra (AstPool* pool, Symbol* Symbol, Type* dt, void* literal)
+{
+    if (!Symbol && !dt && !literal) return 0;
+
+    if (pool->extraNo == pool->extraCapacity)
+    {
+        pool->extraCapacity *= 2;
+        pool->extras = realloc(pool->extras, sizeof(AstPoolExtra) * pool->extraCapacity);
+    }
+
+    pool->extras[pool->extraNo] = (AstPoolExtra) {Symbol, dt, literal};
+    return pool->extraNo++;
+}
+
+static uint32_t AstPoolReserveChildren (AstPool* pool, int count)
+{
+    uint32_t start = pool->childLength;
+
+    if (pool->childLength + count > pool->childCapacity)
+    {
+        while (pool->childLength + count > pool->childCapacity)
+            pool->childCapacity *= 2;
+
+        pool->children = realloc(pool->children, sizeof(AstId) * pool->childCapacity);
+    }
+
+    pool->childLength += count;
+    return start;
+}
+
+static int AstPoolSub (const Ast* Node)
+{
+    if (Node->tag == AST_MARKER) return Node->marker;
+    else if (Node->tag == AST_LOOP) return Node->isDo;
+    else if (Node->tag == AST_LITERAL || Node->tag == AST_USING) return Node->litTag;
+    else
+        return 0;
+}
+
+static void AstPoolPush (AstPoolPending** stack, int* length, int* capacity, AstPoolPending pending)
+{
+    if (*length == *capacity)
+        *stack = realloc(*stack, sizeof(AstPoolPending) * (*capacity *= 2));
+
+    (*stack)[(*length)++] = pending;
+}
+
+//конец поддерева: номера детей больше номера родителя, поэтому
+//достаточно одного прохода с конца
+static void AstPoolSetEnds (AstPool* pool, AstId first)
+{
+    for (AstId id = pool->length - 1; id >= first; id--)
+    {
+        AstId end = id + 1;
+
+        if (pool->l[id] && pool->end[pool->l[id]] > end) end = pool->end[pool->l[id]];
+        if (pool->r[id] && pool->end[pool->r[id]] > end) end = pool->end[pool->r[id]];
+
+        for (uint32_t i = 0; i < pool->childNo[id]; i++)
+        {
+            AstId child = pool->children[pool->firstChild[id] + i];
+
+            if (pool->end[child] > end) end = pool->end[child];
+        }
+
+        pool->end[id] = end;
+    }
+}
+
+void AstPoolInit (AstPool* pool)
+{
+    memset(pool, 0, sizeof(AstPool));
+
+    pool->childCapacity = ASTPOOL_InitialCapacity;
+    pool->children = malloc(sizeof(AstId) * pool->childCapacity);
+
+    pool->locationCapacity = ASTPOOL_InitialCapacity;
+    pool->locations = malloc(sizeof(TokenLocation) * pool->locationCapacity);
+
+    pool->extraCapacity = ASTPOOL_InitialCapacity;
+    pool->extras = malloc(sizeof(AstPoolExtra) * pool->extraCapacity);
+
+    /*нулевой узел - "нет узла"*/
+    AstPoolReserve(pool, ASTPOOL_InitialCapacity);
+    pool->tags[0] = AST_UNDEFINED;
+    pool->ops[0] = OP_UNDEFINED;
+    pool->subs[0] = 0;
+    pool->l[0] = pool->r[0] = 0;
+    pool->end[0] = 1;
+    pool->firstChild[0] = pool->childNo[0] = 0;
+    pool->location[0] = AstPoolAddLocation(pool, (TokenLocation) {0, 0, 0});
+    pool->extra[0] = 0;
+    pool->length = 1;
+
+    /*нулевая запись extras тоже занята: 0 значит "нет"*/
+    pool->extraNo = 1;
+    pool->extras[0] = (AstPoolExtra) {0, 0, 0};
+}
+
+//литералы и типы принадлежат пулу
+void AstPoolFree (AstPool* pool)
+{
+    free(pool->tags);
+    free(pool->ops);
+    free(pool->subs);
+    free(pool->l);
+    free(pool->r);
+    free(pool->end);
+    free(pool->firstChild);
+    free(pool->childNo);
+    free(pool->location);
+    free(pool->extra);
+
+    free(pool->children);
+    free(pool->locations);
+    free(pool->extras);
+}
+
+//копия дерева в пуле; дерево не меняется, его литералы и типы пул только
+//читает, так что дерево освобождается после пула
+AstId AstPoolAdd (AstPool* pool, const Ast* Node)
+{
+    if (!Node) return 0;
+
+    AstId first = pool->length;
+    int length = 0, capacity = 32;
+    AstPoolPending* stack = malloc(sizeof(AstPoolPending) * capacity);
+
+    AstPoolPush(&stack, &length, &capacity, (AstPoolPending) {Node, ASTPOOL_SLOT_ROOT, 0});
+
+    while (length)
+    {
+        AstPoolPending pending = stack[--length];
+        const Ast* Current = pending.node;
+        AstId id = pool->length;
+
+        AstPoolReserve(pool, pool->length + 1);
+        pool->length++;
+
+        if (pending.slot == ASTPOOL_SLOT_L) pool->l[pending.index] = id;
+        else if (pending.slot == ASTPOOL_SLOT_R) pool->r[pending.index] = id;
+        else if (pending.slot == ASTPOOL_SLOT_CHILD) pool->children[pending.index] = id;
+
+        int isLiteral = Current->tag == AST_LITERAL || Current->tag == AST_USING;
+
+        pool->tags[id] = Current->tag;
+        pool->ops[id] = Current->o;
+        pool->subs[id] = AstPoolSub(Current);
+        pool->l[id] = pool->r[id] = 0;
+        pool->location[id] = AstPoolAddLocation(pool, Current->location);
+        pool->extra[id] = AstPoolAddExtra(pool, Current->symbol, Current->dt, isLiteral ? Current->literal : 0);
+
+        pool->childNo[id] = Current->children;
+        pool->firstChild[id] = AstPoolReserveChildren(pool, Current->children);
+
+        /*в стек в обратном порядке: первым выделяются номера детей, затем l, затем r*/
+        if (Current->r && Current->tag != AST_USING)
+            AstPoolPush(&stack, &length, &capacity, (AstPoolPending) {Current->r, ASTPOOL_SLOT_R, id});
+
+        if (Current->l)
+            AstPoolPush(&stack, &length, &capacity, (AstPoolPending) {Current->l, ASTPOOL_SLOT_L, id});
+
+        uint32_t index = pool->firstChild[id] + Current->children;
+
+        for (const Ast* Child = Current->lastChild; Child; Child = Child->prevSibling)
+            AstPoolPush(&stack, &length, &capacity, (AstPoolPending) {Child, ASTPOOL_SLOT_CHILD, --index});
+    }
+
+    free(stack);
+
+    AstPoolSetEnds(pool, first);
+    return first;
+}
+
+AST_TAG AstPoolTag (const AstPool* pool, AstId id)
+{
+    return pool->tags[id];
+}
+
+OP_TAG AstPoolOp (const AstPool* pool, AstId id)
+{
+    return pool->ops[id];
+}
+
+MARKER_TAG AstPoolMarker (const AstPool* pool, AstId id)
+{
+    return pool->tags[id] == AST_MARKER ? pool->subs[id] : MARKER_UNDEFINED;
+}
+
+LITERAL_TAG AstPoolLitTag (const AstPool* pool, AstId id)
+{
+    return pool->tags[id] == AST_LITERAL || pool->tags[id] == AST_USING ? pool->subs[id] : LITERAL_UNDEFINED;
+}
+
+int AstPoolIsDo (const AstPool* pool, AstId id)
+{
+    return pool->tags[id] == AST_LOOP && pool->subs[id];
+}
+
+AstId AstPoolL (const AstPool* pool, AstId id)
+{
+    return pool->l[id];
+}
+
+AstId AstPoolR (const AstPool* pool, AstId id)
+{
+    return pool->r[id];
+}
+
+//дети узла - отрезок подряд идущих номеров
+const AstId* AstPoolChildren (const AstPool* pool, AstId id, int* count)
+{
+    *count = pool->childNo[id];
+    return pool->children + pool->firstChild[id];
+}
+
+TokenLocation AstPoolLocation (const AstPool* pool, AstId id)
+{
+    return pool->locations[pool->location[id]];
+}
+
+Symbol* AstPoolSymbol (const AstPool* pool, AstId id)
+{
+    return pool->extras[pool->extra[id]].symbol;
+}
+
+Type* AstPoolDT (const AstPool* pool, AstId id)
+{
+    return pool->extras[pool->extra[id]].dt;
+}
+
+void* AstPoolLiteral (const AstPool* pool, AstId id)
+{
+    return pool->extras[pool->extra[id]].literal;
+}
+
+//обход поддерева - проход по отрезку номеров: порядок тот же, что у
+//рекурсивного обхода "дети, l, r"
+void AstPoolIterInit (AstPoolIter* iter, const AstPool* pool, AstId root)
+{
+    iter->pool = pool;
+    iter->next = root;
+    iter->end = root ? pool->end[root] : 0;
+}
+
+AstId AstPoolIterNext (AstPoolIter* iter)
+{
+    return iter->next < iter->end ? iter->next++ : 0;
+}
+
+//не заходить в поддерево только что возвращенного узла
+void AstPoolIterSkip (AstPoolIter* iter, AstId id)
+{
+    if (id && iter->pool->end[id] > iter->next)
+        iter->next = iter->pool->end[id];
+}
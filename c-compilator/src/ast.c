@@ -252,6 +252,9 @@ const char* AstTagGetStr (AST_TAG tag)
     else if (tag == AST_RETURN) return "AST_RETURN";
     else if (tag == AST_BREAK) return "AST_BREAK";
     else if (tag == AST_CONTINUE) return "AST_CONTINUE";
+    else if (tag == AST_SWITCH) return "AST_SWITCH";
+    else if (tag == AST_CASE) return "AST_CASE";
+    else if (tag == AST_DEFAULT) return "AST_DEFAULT";
     else if (tag == AST_BOP) return "AST_BOP";
     else if (tag == AST_UOP) return "AST_UOP";
     else if (tag == AST_TOP) return "AST_TOP";
@@ -282,6 +285,8 @@ const char* LiteralTagGetStr (LITERAL_TAG tag)
     if (tag == LITERAL_UNDEFINED) return "LITERAL_UNDEFINED";
     else if (tag == LITERAL_IDENT) return "LITERAL_IDENT";
     else if (tag == LITERAL_INT) return "LITERAL_INT";
+    else if (tag == LITERAL_FLOAT) return "LITERAL_FLOAT";
+    else if (tag == LITERAL_DOUBLE) return "LITERAL_DOUBLE";
     else if (tag == LITERAL_CHAR) return "LITERAL_CHAR";
     else if (tag == LITERAL_STR) return "LITERAL_STR";
     else if (tag == LITERAL_BOOL) return "LITERAL_BOOL";
@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "..\include\cache.h"
+#include "..\include\vector.h"
+#include "..\include\debug.h"
+
+//запись кеша при вытеснении
+typedef struct CacheEntry {
+    char* path;
+    time_t used;
+    long long size;
+} CacheEntry;
+
+static const uint32_t HasherRounds[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t HasherRotate (uint32_t x, int n)
+{
+    return x >> n | x << (32 - n);
+}
+
+//сжатие одного блока в 64 байта
+static void HasherBlock (uint32_t state[8], const unsigned char* block)
+{
+    uint32_t w[64], s[8];
+
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t) block[4*i] << 24 | (uint32_t) block[4*i + 1] << 16 | (uint32_t) block[4*i + 2] << 8 | block[4*i + 3];
+
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = HasherRotate(w[i - 15], 7) ^ HasherRotate(w[i - 15], 18) ^ w[i - 15] >> 3;
+        uint32_t s1 = HasherRotate(w[i - 2], 17) ^ HasherRotate(w[i - 2], 19) ^ w[i - 2] >> 10;
+
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    memcpy(s, state, sizeof(s));
+
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t t1 = s[7] + (HasherRotate(s[4], 6) ^ HasherRotate(s[4], 11) ^ HasherRotate(s[4], 25))
+                    + ((s[4] & s[5]) ^ (~s[4] & s[6])) + HasherRounds[i] + w[i];
+        uint32_t t2 = (HasherRotate(s[0], 2) ^ HasherRotate(s[0], 13) ^ HasherRotate(s[0], 22))
+                    + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+
+        memmove(s + 1, s, 7*sizeof(uint32_t));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+
+    for (int i = 0; i < 8; i++)
+        state[i] += s[i];
+}
+
+//--- хеш ---
+void HasherInit (Hasher* h)
+{
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    memcpy(h->state, initial, sizeof(initial));
+    h->length = 0;
+}
+
+void HasherAdd (Hasher* h, const void* data, int length)
+{
+    const unsigned char* bytes = data;
+
+    while (length > 0)
+    {
+        int used = h->length % 64;
+        int chunk = 64 - used < length ? 64 - used : length;
+
+        memcpy(h->block + used, bytes, chunk);
+        h->length += chunk;
+        bytes += chunk;
+        length -= chunk;
+
+        if (used + chunk == 64) HasherBlock(h->state, h->block);
+    }
+}
+
+//строки хешируются вместе с длиной, чтобы "ab"+"c" != "a"+"bc"
+void HasherAddStr (Hasher* h, const char* str)
+{
+    int length = str ? strlen(str) : -1;
+
+    HasherAddInt(h, length);
+
+    if (str) HasherAdd(h, str, length);
+}
+
+void HasherAddInt (Hasher* h, long long value)
+{
+    HasherAdd(h, &value, sizeof(value));
+}
+
+//дополнение и длина в битах; h не меняется, хешировать можно дальше
+void HasherDigest (const Hasher* h, char key[CACHE_KeyLength + 1])
+{
+    Hasher last = *h;
+    uint64_t bits = (uint64_t) h->length * 8;
+    unsigned char tail[72] = {0x80};
+    unsigned char length[8];
+
+    for (int i = 0; i < 8; i++)
+        length[i] = (unsigned char) (bits >> (56 - 8*i));
+
+    HasherAdd(&last, tail, 1 + (119 - h->length % 64) % 64);
+    HasherAdd(&last, length, 8);
+
+    for (int i = 0; i < 8; i++)
+        sprintf(key + 8*i, "%08x", (unsigned) last.state[i]);
+}
+
+//--- кеш ---
+//внутренние функции
+static char* CacheGetPath (const CacheCTX* ctx, const char* key, const char* ext)
+{
+    char* path = malloc(strlen(ctx->dir) + strlen(key) + strlen(ext) + 2);
+
+    sprintf(path, "%s/%s%s", ctx->dir, key, ext);
+    return path;
+}
+
+static int CacheCopyFile (const char* from, const char* to)
+{
+    FILE* in = fopen(from, "rb");
+
+    if (!in) return 0;
+
+    FILE* out = fopen(to, "wb");
+
+    if (!out)
+    {
+        fclose(in);
+        return 0;
+    }
+
+    char buffer[8192];
+    size_t length;
+    int ok = 1;
+
+    while ((length = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        ok &= fwrite(buffer, 1, length, out) == length;
+
+    fclose(in);
+    ok &= fclose(out) == 0;
+    return ok;
+}
+
+static void CachePrintFile (const char* path)
+{
+    FILE* file = fopen(path, "rb");
+
+    if (!file) return;
+
+    char buffer[4096];
+    size_t length;
+
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        fwrite(buffer, 1, length, stdout);
+
+    fclose(file);
+}
+
+//запись через временный файл, чтобы параллельные процессы не видели половину
+static int CachePut (const char* from, const char* to)
+{
+    char* tmp = malloc(strlen(to) + 24);
+
+    sprintf(tmp, "%s.tmp%d", to, (int) getpid());
+
+    int ok = CacheCopyFile(from, tmp) && rename(tmp, to) == 0;
+
+    if (!ok) unlink(tmp);
+
+    free(tmp);
+    return ok;
+}
+
+/*размер кеша ведется в файле .size под блокировкой: иначе узнать его можно
+  только обходом каталога, а это каждая запись. Число может быть больше
+  настоящего (перезапись того же ключа), CacheEvict его уточняет.
+  add - прибавить delta, иначе записать delta; результат - новый размер*/
+static long long CacheUpdateSize (const CacheCTX* ctx, long long delta, int add)
+{
+    char* path = CacheGetPath(ctx, ".size", "");
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    long long size = delta;
+
+    free(path);
+
+    if (fd < 0) return add ? ctx->maxSize + 1 : size;
+
+    flock(fd, LOCK_EX);
+
+    char buffer[32] = {0};
+
+    if (add && pread(fd, buffer, sizeof(buffer) - 1, 0) > 0)
+        size += atoll(buffer);
+
+    int length = snprintf(buffer, sizeof(buffer), "%lld\n", size);
+
+    if (ftruncate(fd, 0) != 0 || pwrite(fd, buffer, length, 0) != length)
+        size = ctx->maxSize + 1;
+
+    flock(fd, LOCK_UN);
+    close(fd);
+    return size;
+}
+
+static long long CacheFileSize (const char* path)
+{
+    struct stat info;
+
+    return stat(path, &info) == 0 ? info.st_size : 0;
+}
+
+static int CacheEntryCmp (const void* L, const void* R)
+{
+    const CacheEntry* l = *(const CacheEntry**) L;
+    const CacheEntry* r = *(const CacheEntry**) R;
+
+    return (l->used > r->used) - (l->used < r->used);
+}
+
+static void CacheEntryDestroy (CacheEntry* entry)
+{
+    free(entry->path);
+    free(entry);
+}
+
+static void CacheMkdirs (const char* dir)
+{
+    char* path = strdup(dir);
+
+    for (char* slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/'))
+    {
+        *slash = 0;
+        mkdir(path, 0777);
+        *slash = '/';
+    }
+
+    if (mkdir(path, 0777) != 0 && errno != EEXIST)
+        DebugError("CacheMkdirs", "не удалось создать каталог кеша %s", path);
+
+    free(path);
+}
+
+void CacheInit (CacheCTX* ctx, const char* dir, long long maxSize)
+{
+    ctx->dir = strdup(dir);
+    ctx->maxSize = maxSize;
+
+    CacheMkdirs(ctx->dir);
+}
+
+void CacheFree (CacheCTX* ctx)
+{
+    free(ctx->dir);
+    ctx->dir = 0;
+}
+
+//попадание: результат с расширением ext (".s", ".o") копируется в output,
+//сообщения компиляции повторяются в stdout
+int CacheFetch (CacheCTX* ctx, const char* key, const char* ext, const char* output)
+{
+    char* path = CacheGetPath(ctx, key, ext);
+    char* logPath = CacheGetPath(ctx, key, ".log");
+
+    int hit = access(logPath, R_OK) == 0 && CacheCopyFile(path, output);
+
+    if (hit)
+    {
+        CachePrintFile(logPath);
+
+        /*время изменения служит отметкой последнего использования*/
+        utime(path, 0);
+        utime(logPath, 0);
+    }
+
+    free(path);
+    free(logPath);
+    return hit;
+}
+
+//diagnostics 0 - сообщения уже записаны вместе с другим результатом
+void CacheStore (CacheCTX* ctx, const char* key, const char* ext, const char* output, const char* diagnostics)
+{
+    char* path = CacheGetPath(ctx, key, ext);
+    char* logPath = CacheGetPath(ctx, key, ".log");
+
+    long long added = 0;
+
+    /*.log пишется последним: по нему определяется полнота записи*/
+    if (CachePut(output, path))
+    {
+        added += CacheFileSize(path);
+
+        if (diagnostics && CachePut(diagnostics, logPath))
+            added += CacheFileSize(logPath);
+    }
+
+    free(path);
+    free(logPath);
+
+    /*каталог обходится, только когда предел превышен*/
+    if (ctx->maxSize > 0 && CacheUpdateSize(ctx, added, 1) > ctx->maxSize)
+        CacheEvict(ctx);
+}
+
+//удаление давно не использованных записей до 90% от предела
+void CacheEvict (CacheCTX* ctx)
+{
+    if (ctx->maxSize <= 0) return;
+
+    DIR* dir = opendir(ctx->dir);
+
+    if (!dir) return;
+
+    Vector entries;
+    VectorInit(&entries, 64);
+
+    long long total = 0;
+
+    for (struct dirent* ent = readdir(dir); ent; ent = readdir(dir))
+    {
+        if (ent->d_name[0] == '.') continue;
+
+        CacheEntry* entry = malloc(sizeof(CacheEntry));
+        struct stat info;
+
+        entry->path = CacheGetPath(ctx, ent->d_name, "");
+
+        if (stat(entry->path, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            CacheEntryDestroy(entry);
+            continue;
+        }
+
+        entry->used = info.st_mtime;
+        entry->size = info.st_size;
+        total += entry->size;
+        VectorPush(&entries, entry);
+    }
+
+    closedir(dir);
+
+    if (total > ctx->maxSize)
+    {
+        qsort(entries.buffer, entries.length, sizeof(void*), CacheEntryCmp);
+
+        for (int i = 0; i < entries.length && total > ctx->maxSize / 10 * 9; i++)
+        {
+            CacheEntry* entry = VectorGet(&entries, i);
+
+            if (unlink(entry->path) == 0)
+                total -= entry->size;
+        }
+    }
+
+    CacheUpdateSize(ctx, total, 0);
+
+    VectorFreeObjs(&entries, (VectorDtor) CacheEntryDestroy);
+}
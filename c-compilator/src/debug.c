@@ -1,12 +1,40 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
+#include <pthread.h>
 #include <debug.h>
 
+enum {
+    DEBUG_RingSize = 1 << 16,   //последние байты трассы в одном кольце
+    DEBUG_LineSize = 512        //длиннее строки обрезаются
+};
+
+//кольцевой журнал трассы, в d_log выдается DebugFlush
+typedef struct DebugRing {
+    char* buffer;
+    int pos;        //место следующей записи
+    int wrapped;    //буфер уже заполнялся целиком, старое начинается с pos
+
+    struct DebugRing* next;
+} DebugRing;
+
 FILE* d_log;
 DEBUG_MODE d_mode;
-int d_depth;
+_Thread_local int d_depth;  //глубина своя у каждого потока
 int d_errors;
 
+static int d_perThread;             //у каждого потока свое кольцо, без блокировки
+static DebugRing* d_rings;          //все кольца, для DebugFlush
+static DebugRing* d_shared;         //общее кольцо, пишется под d_lock
+static _Thread_local DebugRing* d_ring;
+static pthread_mutex_t d_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void DebugRingWrite (const char* text, int length);
+static DebugRing* DebugRingCreate (int locked);
+static void DebugRingFlush (DebugRing* ring);
+static void DebugFlushOwn (void);
+
 //установка режима отладки
 DEBUG_MODE DebugSetMode (DEBUG_MODE nmode)
 {
@@ -15,80 +43,98 @@ DEBUG_MODE DebugSetMode (DEBUG_MODE nmode)
     return old;
 }
 
-// инициализация отладки
+// инициализация отладки; после fork трасса родителя отбрасывается
 void DebugInit (FILE* nlog)
 {
     d_log = nlog;
     DebugSetMode(DEBUG_MINIMAL);
-}
-
-//запись переменных в файл
-void DebugVarOut (const char* format, va_list args)
-{
-    (void) args, (void) format;
 
-    #ifdef SCC_DEBUGMODE
-    if (mode == DEBUG_SILENT) return;
-
-    vfprintf(d_log, format, args);
-    #endif
+    for (DebugRing* ring = d_rings; ring; ring = ring->next)
+    {
+        ring->pos = 0;
+        ring->wrapped = 0;
+    }
 }
 
-//общая запись в файл
-void DebugOut (const char* format, ...)
+//кольцо на каждый поток вместо общего; задается до первой трассы
+void DebugSetRing (int perThread)
 {
-    va_list args;
-    va_start(args, format);
-    DebugVarOut(format, args);
-    va_end(args);
+    d_perThread = perThread;
 }
 
-//запись сообщения в файл с глубиной
-void DebugVarMsg (const char* format, va_list args)
+//строка трассы с глубиной, вызывается через DebugMsg и DebugIsOn
+void DebugTraceV (const char* format, va_list args)
 {
-    for (int i = 0; i < d_depth; i++)
-        DebugOut("| ");
+    char line[DEBUG_LineSize];
+    int length = 0;
 
-    DebugVarOut(format, args);
-    DebugOut("\n");
+    for (int i = 0; i < d_depth && length < DEBUG_LineSize / 2; i++)
+    {
+        line[length++] = '|';
+        line[length++] = ' ';
+    }
+
+    /*место под '\n' остается всегда*/
+    int n = vsnprintf(line + length, DEBUG_LineSize - length - 1, format, args);
+
+    if (n > 0) length += n < DEBUG_LineSize - length - 2 ? n : DEBUG_LineSize - length - 2;
+
+    line[length++] = '\n';
+    DebugRingWrite(line, length);
 }
 
-//общая запись сообщения в файл с глубиной
-void DebugMsg (const char* format, ...)
+void DebugTrace (const char* format, ...)
 {
     va_list args;
     va_start(args, format);
-    DebugVarMsg(format, args);
+    DebugTraceV(format, args);
     va_end(args);
 }
 
 //добавить строку c глубиной
-void DebugEnter (const char* str)
+void DebugTraceEnter (const char* str)
 {
-    if (d_mode <= DEBUG_COMPRESSED)
-    {
-        DebugMsg("+ %s", str);
-        d_depth++;
-    }
+    DebugTrace("+ %s", str);
+    d_depth++;
 }
 
 //удалить глубину
-void DebugLeave ()
+void DebugTraceLeave (void)
+{
+    d_depth--;
+
+    if (d_mode == DEBUG_FULL) DebugTrace("-");
+}
+
+//выдать трассу всех колец в d_log, от старых строк к новым; потоки со
+//своими кольцами в это время писать не должны
+void DebugFlush (void)
 {
-    if (d_mode <= DEBUG_COMPRESSED) d_depth--;
-    if (d_mode == DEBUG_FULL) DebugMsg("-");
+    pthread_mutex_lock(&d_lock);
+
+    for (DebugRing* ring = d_rings; ring; ring = ring->next)
+        DebugRingFlush(ring);
+
+    pthread_mutex_unlock(&d_lock);
 }
 
 //ждать ввода
 void DebugWait ()
 {
     #ifdef SCC_DEBUGMODE
-    if (d_mode <= DEBUG_FULL) getchar();
+    if (d_mode <= DEBUG_FULL)
+    {
+        DebugFlush();
+        getchar();
+    }
     #endif
 }
 
+//перед сообщением - трасса своего потока, она объясняет ошибку
 void DebugError (const char* functionName, const char* format, ...)
 {
+    DebugFlushOwn();
+
     fprintf(d_log, "internal error(%s): ", functionName);
 
     va_list args;
@@ -123,4 +169,79 @@ void DebugErrorUnhandledInt (const char* functionName, const char* className, in
 void DebugErrorUnhandledChar (const char* functionName, const char* className, char classChar)
 {
     DebugError(functionName, "необработанное %s: '%c'", className, classChar);
-}
\ No newline at end of file
+}
+
+//внутренние функции
+static void DebugRingWrite (const char* text, int length)
+{
+    int shared = !d_perThread;
+
+    if (shared) pthread_mutex_lock(&d_lock);
+
+    DebugRing** slot = shared ? &d_shared : &d_ring;
+
+    if (!*slot) *slot = DebugRingCreate(shared);
+
+    DebugRing* ring = *slot;
+
+    while (length > 0)
+    {
+        int part = length < DEBUG_RingSize - ring->pos ? length : DEBUG_RingSize - ring->pos;
+
+        memcpy(ring->buffer + ring->pos, text, part);
+        ring->pos += part;
+        text += part;
+        length -= part;
+
+        if (ring->pos == DEBUG_RingSize)
+        {
+            ring->pos = 0;
+            ring->wrapped = 1;
+        }
+    }
+
+    if (shared) pthread_mutex_unlock(&d_lock);
+}
+
+//кольца не освобождаются: трасса завершившегося потока еще выдается
+static DebugRing* DebugRingCreate (int locked)
+{
+    DebugRing* ring = calloc(1, sizeof(DebugRing));
+    ring->buffer = malloc(DEBUG_RingSize);
+
+    if (!locked) pthread_mutex_lock(&d_lock);
+
+    ring->next = d_rings;
+    d_rings = ring;
+
+    if (!locked) pthread_mutex_unlock(&d_lock);
+
+    return ring;
+}
+
+static void DebugRingFlush (DebugRing* ring)
+{
+    if (ring->wrapped) fwrite(ring->buffer + ring->pos, 1, DEBUG_RingSize - ring->pos, d_log);
+
+    fwrite(ring->buffer, 1, ring->pos, d_log);
+    fflush(d_log);
+
+    ring->pos = 0;
+    ring->wrapped = 0;
+}
+
+static void DebugFlushOwn (void)
+{
+    if (d_perThread)
+    {
+        if (d_ring) DebugRingFlush(d_ring);
+    }
+    else
+    {
+        pthread_mutex_lock(&d_lock);
+
+        if (d_shared) DebugRingFlush(d_shared);
+
+        pthread_mutex_unlock(&d_lock);
+    }
+}
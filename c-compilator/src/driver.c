@@ -0,0 +1,1047 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+#include "..\include\driver.h"
+#include "..\include\vector.h"
+#include "..\include\arch.h"
+#include "..\include\symbol.h"
+#include "..\include\lexer.h"
+#include "..\include\pp.h"
+#include "..\include\parser.h"
+#include "..\include\analyzer.h"
+#include "..\include\layout.h"
+#include "..\include\file.h"
+#include "..\include\pch.h"
+#include "..\include\ir.h"
+#include "..\include\profile.h"
+#include "..\include\cache.h"
+#include "..\include\incremental.h"
+#include "..\include\error.h"
+#include "..\include\timer.h"
+#include "..\include\debug.h"
+#include "..\include\util.h"
+
+//клиент GNU make jobserver: один токен у процесса есть всегда,
+//за каждым следующим параллельным заданием надо сходить в канал
+typedef struct Jobserver {
+    int rfd;
+    int wfd;
+    int active;
+} Jobserver;
+
+//внутренние функции
+static void JobserverInit (Jobserver* js)
+{
+    js->rfd = js->wfd = -1;
+    js->active = 0;
+
+    const char* flags = getenv("MAKEFLAGS");
+
+    if (!flags) return;
+
+    /*--jobserver-fds - название в make до 4.2*/
+    const char* option = strstr(flags, "--jobserver-auth=") ? "--jobserver-auth=" : "--jobserver-fds=";
+    const char* auth = strstr(flags, option);
+
+    if (!auth) return;
+
+    auth += strlen(option);
+
+    /*make 4.4: именованный канал*/
+    if (!strncmp(auth, "fifo:", 5))
+    {
+        char path[1024];
+        int length = strcspn(auth + 5, " ");
+
+        snprintf(path, sizeof(path), "%.*s", length, auth + 5);
+        js->rfd = js->wfd = open(path, O_RDWR);
+    }
+    else if (sscanf(auth, "%d,%d", &js->rfd, &js->wfd) != 2)
+        js->rfd = js->wfd = -1;
+
+    /*make мог не передать нам дескрипторы (правило без +)*/
+    js->active = js->rfd >= 0 && fcntl(js->rfd, F_GETFD) != -1 && fcntl(js->wfd, F_GETFD) != -1;
+}
+
+//попытаться взять токен, не блокируясь надолго
+static int JobserverTryAcquire (Jobserver* js, char* token)
+{
+    struct pollfd fd = {js->rfd, POLLIN, 0};
+
+    if (poll(&fd, 1, 10) <= 0) return 0;
+
+    return read(js->rfd, token, 1) == 1;
+}
+
+static void JobserverRelease (Jobserver* js, char token)
+{
+    while (write(js->wfd, &token, 1) < 0 && errno == EINTR);
+}
+
+//препроцессор с путями и определениями из командной строки
+static void DriverPPInit (const Config* config, PPCTX* pp, const char* input)
+{
+    PPInit(pp, input);
+
+    for (int i = 0; i < config->includes.length; i++)
+        PPAddPath(pp, VectorGet(&config->includes, i));
+
+    PPDefine(pp, config->wordsize == 8 ? "__x86_64__" : "__i386__");
+
+    if (config->os == OS_WINDOWS) PPDefine(pp, "_WIN32");
+    else PPDefine(pp, "__linux__");
+
+    for (int i = 0; i < config->defines.length; i++)
+        PPDefine(pp, VectorGet(&config->defines, i));
+}
+
+//цель по настройкам: ОС, разрядность и процессор. Освобождать ArchFree
+static void DriverSetupArch (const Config* config, Arch* arch)
+{
+    ArchInit(arch);
+    ArchSetup(arch, config->os, config->wordsize);
+    ArchSetupCpu(arch, config->march, config->mtune, config->featuresOn, config->featuresOff);
+}
+
+//настройки, при которых символы заголовка те же: цель и макросы командной строки
+static char* DriverPchKey (const Config* config)
+{
+    int length = strlen(SCC_VERSION) + 32;
+
+    for (int i = 0; i < config->defines.length; i++)
+        length += strlen(VectorGet(&config->defines, i)) + 3;
+
+    char* key = malloc(length);
+    int pos = sprintf(key, "%s w%d os%d", SCC_VERSION, config->wordsize, config->os);
+
+    for (int i = 0; i < config->defines.length; i++)
+        pos += sprintf(key + pos, " -D%s", (const char*) VectorGet(&config->defines, i));
+
+    return key;
+}
+
+static char* DriverReplaceExt (const char* input, const char* ext)
+{
+    const char* base = strrchr(input, '/');
+    base = base ? base + 1 : input;
+
+    const char* dot = strrchr(base, '.');
+    int length = dot ? dot - base : (int) strlen(base);
+
+    char* name = malloc(length + strlen(ext) + 1);
+    sprintf(name, "%.*s%s", length, base, ext);
+    return name;
+}
+
+static char* DriverTempFile (const char* ext)
+{
+    const char* dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char* name = malloc(strlen(dir) + strlen(ext) + 12);
+
+    sprintf(name, "%s/sccXXXXXX%s", dir, ext);
+
+    int fd = mkstemps(name, strlen(ext));
+
+    if (fd < 0)
+    {
+        DebugError("DriverTempFile", "не удалось создать временный файл %s", name);
+        return name;
+    }
+
+    close(fd);
+    return name;
+}
+
+//запуск cc без оболочки: пути с пробелами, ';' и $() доходят как есть.
+//flags - флаги цели через пробел, args - остальные аргументы
+static int DriverRunCC (const char* flags, char** args, int n)
+{
+    char* words = strdup(flags ? flags : "");
+    char** argv = malloc((strlen(words) / 2 + n + 3) * sizeof(char*));
+    int k = 0;
+
+    argv[k++] = "cc";
+
+    for (char* word = strtok(words, " "); word; word = strtok(0, " "))
+        argv[k++] = word;
+
+    for (int i = 0; i < n; i++)
+        argv[k++] = args[i];
+
+    argv[k] = 0;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    int status = -1;
+    int pid = fork();
+
+    if (pid == 0)
+    {
+        execvp(argv[0], argv);
+        ErrorF("$h: $r: не удалось запустить\n", argv[0], "ошибка");
+        fflush(stdout);
+        _exit(127);
+    }
+    else if (pid > 0)
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+
+    free(argv);
+    free(words);
+    return !(pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static int DriverAssemble (const Config* config, const char* asmInput, const char* objOutput)
+{
+    Arch arch;
+    ArchInit(&arch);
+    ArchSetup(&arch, config->os, config->wordsize);
+
+    char* args[] = {"-c", (char*) asmInput, "-o", (char*) objOutput};
+    int status = DriverRunCC(arch.asflags, args, 4);
+
+    ArchFree(&arch);
+    return status;
+}
+
+static int DriverLink (const Config* config, DriverUnit* units, int n)
+{
+    Arch arch;
+    ArchInit(&arch);
+    ArchSetup(&arch, config->os, config->wordsize);
+
+    const char* output = config->output ? config->output : "a.out";
+    char** parts = malloc((n + 3) * sizeof(char*));
+    char* runtime = 0;
+    int k = 0;
+
+    for (int i = 0; i < n; i++)
+        parts[k++] = units[i].objOutput;
+
+    /*счетчики сбрасывает среда выполнения, она собирается вместе с программой*/
+    if (config->profileGenerate)
+    {
+        const char* dir = getenv("SCC_RUNTIME_DIR") ? getenv("SCC_RUNTIME_DIR") : "runtime";
+
+        runtime = malloc(strlen(dir) + 12);
+        sprintf(runtime, "%s/profile.c", dir);
+        parts[k++] = runtime;
+    }
+
+    parts[k++] = "-o";
+    parts[k++] = (char*) output;
+
+    int status = DriverRunCC(arch.ldflags, parts, k);
+
+    free(runtime);
+    free(parts);
+    ArchFree(&arch);
+    return status;
+}
+
+static void DriverUnitSetup (const Config* config, DriverUnit* unit, const char* input)
+{
+    int single = config->inputs.length == 1 && config->output;
+
+    unit->input = input;
+    unit->pid = 0;
+    unit->status = 0;
+    unit->done = 0;
+    unit->diagnostics = DriverTempFile(".log");
+
+    if (config->mode == DRIVER_COMPILE)
+        unit->asmOutput = single ? strdup(config->output) : DriverReplaceExt(input, ".s");
+    else
+        unit->asmOutput = DriverTempFile(".s");
+
+    if (config->mode == DRIVER_ASSEMBLE)
+        unit->objOutput = single ? strdup(config->output) : DriverReplaceExt(input, ".o");
+    else if (config->mode == DRIVER_LINK)
+        unit->objOutput = DriverTempFile(".o");
+    else
+        unit->objOutput = 0;
+}
+
+static void DriverUnitFree (const Config* config, DriverUnit* unit)
+{
+    if (config->mode != DRIVER_COMPILE) unlink(unit->asmOutput);
+
+    if (config->mode == DRIVER_LINK) unlink(unit->objOutput);
+
+    unlink(unit->diagnostics);
+
+    free(unit->asmOutput);
+    free(unit->objOutput);
+    free(unit->diagnostics);
+}
+
+//дочерний процесс: своя Arch, свои символы и IR, сообщения - в свой файл
+static void DriverUnitStart (const Config* config, DriverUnit* unit)
+{
+    fflush(stdout);
+    fflush(stderr);
+
+    int pid = fork();
+
+    if (pid == 0)
+    {
+        if (freopen(unit->diagnostics, "w", stdout)) dup2(fileno(stdout), fileno(stderr));
+
+        /*функции обходит пул потоков: у каждого свое кольцо трассы,
+          строки разных функций не перемешиваются*/
+        DebugInit(stderr);
+        DebugSetRing(1);
+
+        CacheCTX cache;
+        char key[CACHE_KeyLength + 1];
+        int status = -1;
+
+        int assemble = config->mode != DRIVER_COMPILE;
+
+        if (config->cacheDir)
+        {
+            CacheInit(&cache, config->cacheDir, config->cacheSize);
+            DriverHashUnit(config, unit->input, key);
+
+            /*при попадании разбор и генерация кода не выполняются вовсе,
+              а с объектным файлом - и ассемблер*/
+            if (assemble && CacheFetch(&cache, key, ".o", unit->objOutput))
+                status = assemble = 0;
+
+            else if (CacheFetch(&cache, key, ".s", unit->asmOutput))
+                status = 0;
+        }
+
+        if (status < 0)
+        {
+            status = DriverCompileUnit(config, unit->input, unit->asmOutput);
+            fflush(stdout);
+
+            if (status == 0 && config->cacheDir)
+                CacheStore(&cache, key, ".s", unit->asmOutput, unit->diagnostics);
+        }
+
+        if (status == 0 && assemble)
+        {
+            status = DriverAssemble(config, unit->asmOutput, unit->objOutput);
+
+            /*сообщения ассемблера не повторяются: .log уже записан с .s*/
+            if (status == 0 && config->cacheDir)
+                CacheStore(&cache, key, ".o", unit->objOutput, 0);
+        }
+
+        if (config->cacheDir) CacheFree(&cache);
+
+        DebugFlush();
+        fflush(stdout);
+        _exit(status != 0);
+    }
+    else if (pid < 0)
+    {
+        ErrorF("$h: $r: не удалось запустить процесс\n", unit->input, "ошибка");
+        unit->status = 1;
+        unit->done = 1;
+    }
+
+    unit->pid = pid;
+}
+
+static void DriverUnitPrint (DriverUnit* unit)
+{
+    FILE* file = fopen(unit->diagnostics, "r");
+
+    if (!file) return;
+
+    char buffer[4096];
+    size_t length;
+
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        fwrite(buffer, 1, length, stdout);
+
+    fclose(file);
+    fflush(stdout);
+}
+
+static DriverUnit* DriverUnitFind (DriverUnit* units, int n, int pid)
+{
+    for (int i = 0; i < n; i++)
+        if (units[i].pid == pid) return &units[i];
+
+    return 0;
+}
+
+//версия, настройки цели и оптимизации: все, кроме исходного текста, от
+//чего зависит код
+static void DriverHashOptions (const Config* config, Hasher* h)
+{
+    HasherAddStr(h, SCC_VERSION);
+
+    Arch arch;
+    DriverSetupArch(config, &arch);
+
+    /*с -march=native ключ зависит от машины сборки*/
+    HasherAddInt(h, arch.wordsize);
+    HasherAddInt(h, config->os);
+    HasherAddStr(h, arch.asflags);
+    HasherAddStr(h, arch.ldflags);
+    HasherAddInt(h, arch.features);
+    HasherAddInt(h, arch.vectorSize);
+    HasherAddInt(h, arch.fastStrings);
+    ArchFree(&arch);
+
+    HasherAddInt(h, config->optimise);
+    HasherAddInt(h, config->warnPadded);
+
+    /*подключенный заголовок: его содержимое в поток лексем не попадает*/
+    struct stat st;
+    HasherAddStr(h, config->includePch);
+
+    if (config->includePch && stat(config->includePch, &st) == 0)
+    {
+        HasherAddInt(h, st.st_size);
+        HasherAddInt(h, st.st_mtime);
+    }
+
+    /*профиль меняет разметку блоков, а значит и код*/
+    HasherAddStr(h, config->profileGenerate);
+    HasherAddStr(h, config->profileUse);
+
+    if (config->profileUse && stat(config->profileUse, &st) == 0)
+    {
+        HasherAddInt(h, st.st_size);
+        HasherAddInt(h, st.st_mtime);
+    }
+}
+
+//ключ кеша: настройки и поток лексем после препроцессора, так что
+//изменения в заголовках его меняют. Позиции лексем тоже входят в ключ:
+//сохраненные сообщения повторяются при попадании как есть
+void DriverHashUnit (const Config* config, const char* input, char* key)
+{
+    Hasher h;
+    HasherInit(&h);
+    DriverHashOptions(config, &h);
+
+    /*имя файла попадает в .file, поэтому тоже часть ключа*/
+    HasherAddStr(&h, input);
+
+    if (access(input, R_OK) == 0)
+    {
+        PPCTX pp;
+        DriverPPInit(config, &pp, input);
+
+        /*сообщения выдаст сама компиляция*/
+        pp.silent = 1;
+
+        LexerCTX* lexer = LexerInitPP(&pp);
+        int file = -1;
+
+        for (LexerNext(lexer); lexer->token != TOK_EOF; LexerNext(lexer))
+        {
+            HasherAddInt(&h, lexer->token);
+            HasherAdd(&h, lexer->text, lexer->textLength);
+            HasherAddInt(&h, lexer->space);
+
+            if (lexer->file != file)
+            {
+                file = lexer->file;
+                HasherAddStr(&h, FileName(file));
+            }
+
+            HasherAddInt(&h, lexer->line);
+            HasherAddInt(&h, lexer->lineChar);
+        }
+
+        LexerEnd(lexer);
+        PPFree(&pp);
+    }
+
+    HasherDigest(&h, key);
+}
+
+//-ftime-report - в сообщения единицы, -ftime-trace - в файл
+static void DriverTimeReport (const Config* config, const char* input)
+{
+    if (!config->timeReport && !config->timeTrace) return;
+
+    if (config->timeReport) TimerReport(stderr);
+
+    if (config->timeTrace)
+    {
+        char* name = config->timeTraceFile ? strdup(config->timeTraceFile) : DriverReplaceExt(input, ".json");
+
+        if (TimerWriteTrace(name)) ErrorF("$h: $r: не удалось записать трассу\n", name, "предупреждение");
+
+        free(name);
+    }
+
+    TimerFree();
+}
+
+//компиляция одной единицы трансляции в ассемблерный файл
+int DriverCompileUnit (const Config* config, const char* input, const char* asmOutput)
+{
+    if (access(input, R_OK) != 0)
+    {
+        ErrorF("$h: $r: не удалось открыть файл\n", input, "ошибка");
+        return 1;
+    }
+
+    /*вся единица - один интервал, фазы и функции вложены в него*/
+    if (config->timeReport || config->timeTrace) TimerInit();
+
+    TimerEnter(TIMER_TOTAL, input);
+
+    Arch arch;
+    DriverSetupArch(config, &arch);
+
+    Symbol* global = SymbolInit();
+    char* pchKey = DriverPchKey(config);
+    PchCTX pch;
+    int errors = 0;
+
+    PPCTX pp;
+    DriverPPInit(config, &pp, input);
+
+    /*символы заголовка подключаются как модуль: SymbolEnd их не освобождает;
+      его макросы и защиты файлов переходят в препроцессор*/
+    if (config->includePch)
+    {
+        TimerEnter(TIMER_PCH, config->includePch);
+
+        if (PchLoad(&pch, config->includePch, pchKey, &pp)) SymbolCreateModuleLink(global, pch.global);
+        else
+        {
+            ErrorF("$h: $r: предкомпилированный заголовок поврежден или устарел\n", config->includePch, "ошибка");
+            errors++;
+        }
+
+        TimerLeave();
+    }
+
+    IrCTX ir;
+    IrInit(&ir, asmOutput, &arch);
+    ir.jobs = config->threads;
+
+    /*встроенные типы уже есть в подключенном заголовке*/
+    if (!config->includePch) ParserBuiltins(global, &arch, config->os);
+
+    /*лексер и препроцессор вызываются парсером, их время вычитается*/
+    TimerEnter(TIMER_PARSE, input);
+
+    LexerCTX* lexer = LexerInitPP(&pp);
+    /*тела функций разбирает анализатор, по мере обхода*/
+    ParserResult parsed = ParserLazy(lexer, global, input);
+
+    LexerEnd(lexer);
+    TimerLeave();
+
+    errors += parsed.errors + pp.errors;
+
+    /*код с -fprofile-generate ссылается на счетчики модуля, а с -fprofile-use
+      зависит от профиля всех функций: такой код не переносится*/
+    int incremental = errors == 0 && config->incremental && !config->profileGenerate && !config->profileUse;
+    IncrCTX incr;
+
+    /*отпечатки считает анализатор: тела неизменных функций он не разбирает*/
+    if (incremental)
+    {
+        Hasher h;
+        char options[CACHE_KeyLength + 1];
+
+        HasherInit(&h);
+        DriverHashOptions(config, &h);
+        HasherDigest(&h, options);
+
+        IncrInit(&incr, input, options);
+    }
+
+    if (errors == 0)
+    {
+        TimerEnter(TIMER_ANALYZE, input);
+        errors += Analyzer(&parsed, global, &arch, incremental ? &incr : 0);
+        TimerLeave();
+    }
+
+    if (errors == 0 && config->warnPadded) LayoutReport(&arch, global);
+
+    /*перевода AST в IR еще нет: модуль выдается пустым*/
+
+    if (incremental && errors == 0) IncrPrepare(&incr, &ir);
+
+    if (errors == 0)
+    {
+        /*тела функций - в пуле потоков, кроме взятых из прошлой сборки*/
+        IrBuild(&ir);
+
+        if (config->optimise)
+        {
+            TimerEnter(TIMER_OPTIMISE, input);
+            IrBlockLevelAnalysis(&ir);
+            TimerLeave();
+        }
+
+        /*профиль размечает блоки до раскладки, счетчики ставятся на готовый CFG*/
+        int profiled = config->profileUse || config->profileGenerate;
+
+        if (profiled) TimerEnter(TIMER_PROFILE, input);
+
+        if (config->profileUse)
+        {
+            ProfileData profile;
+            ProfileInit(&profile);
+
+            if (ProfileRead(&profile, config->profileUse)) ProfileAnnotate(&ir, &profile, input);
+            else
+                ErrorF("$h: $r: не удалось прочитать профиль\n", config->profileUse, "предупреждение");
+
+            ProfileFree(&profile);
+        }
+
+        if (config->profileGenerate) ProfileInstrument(&ir, input, config->profileGenerate);
+
+        if (profiled) TimerLeave();
+
+        TimerEnter(TIMER_EMIT, input);
+        IrEmit(&ir);
+        TimerLeave();
+    }
+
+    /*с ошибками манифест прошлой сборки остается как был*/
+    if (incremental)
+    {
+        if (errors == 0) IncrCommit(&incr, &ir);
+
+        IncrFree(&incr);
+    }
+
+    /*-emit-pch: <вход>.pch рядом с заголовком*/
+    if (errors == 0 && config->emitPch)
+    {
+        char* name = malloc(strlen(input) + 5);
+        sprintf(name, "%s.pch", input);
+
+        TimerEnter(TIMER_PCH, name);
+        errors += PchWrite(name, global, &pp, pchKey) != 0;
+        TimerLeave();
+
+        free(name);
+    }
+
+    /*макросы нужны -emit-pch*/
+    PPFree(&pp);
+    IrFree(&ir);
+    ParserFree(&parsed);
+    SymbolEnd(global);
+
+    if (config->includePch) PchFree(&pch);
+
+    free(pchKey);
+    ArchFree(&arch);
+
+    TimerLeave();
+    DriverTimeReport(config, input);
+    return errors != 0;
+}
+
+//слияние профилей: входы - сырые или индексированные профили, счетчики
+//одной функции складываются
+int DriverMergeProfiles (const Config* config)
+{
+    const char* output = config->output ? config->output : "scc.profdata";
+    ProfileData profile;
+    int failed = 0;
+
+    ProfileInit(&profile);
+
+    for (int i = 0; i < config->inputs.length; i++)
+    {
+        const char* input = VectorGet(&config->inputs, i);
+
+        if (!ProfileRead(&profile, input))
+        {
+            ErrorF("$h: $r: профиль поврежден или не открывается\n", input, "ошибка");
+            failed = 1;
+        }
+    }
+
+    if (!failed && ProfileWrite(&profile, output))
+    {
+        ErrorF("$h: $r: не удалось записать профиль\n", output, "ошибка");
+        failed = 1;
+    }
+
+    ProfileFree(&profile);
+    return failed;
+}
+
+//сборка всех единиц трансляции, не более jobs процессов одновременно
+int DriverRun (Config* config)
+{
+    int n = config->inputs.length;
+    DriverUnit* units = calloc(n, sizeof(DriverUnit));
+
+    for (int i = 0; i < n; i++)
+        DriverUnitSetup(config, &units[i], VectorGet(&config->inputs, i));
+
+    Jobserver js;
+    JobserverInit(&js);
+
+    int useJobserver = config->jobs == 0 && js.active;
+    int jobs = config->jobs > 0 ? config->jobs : 1;
+
+    /*токены, взятые у jobserver, по pid процесса*/
+    Vector tokens;
+    VectorInit(&tokens, 4);
+
+    /*процесс на собственном токене, 0 - токен свободен*/
+    int implicitPid = 0;
+
+    int next = 0, running = 0, printed = 0;
+
+    while (printed < n)
+    {
+        /*запустить столько, сколько позволено*/
+        while (next < n)
+        {
+            char token = 0;
+            int acquired = 0, implicit = 0;
+
+            if (useJobserver ? implicitPid == 0 : running == 0)
+                implicit = 1;
+            else if (!useJobserver && running < jobs)
+                ;
+            else if (useJobserver && JobserverTryAcquire(&js, &token))
+                acquired = 1;
+            else
+                break;
+
+            DriverUnitStart(config, &units[next]);
+
+            if (units[next].pid > 0)
+            {
+                running++;
+
+                if (implicit) implicitPid = units[next].pid;
+                else if (acquired)
+                {
+                    VectorPush(&tokens, (void*) (intptr_t) units[next].pid);
+                    VectorPush(&tokens, (void*) (intptr_t) token);
+                }
+            }
+            else if (acquired)
+                JobserverRelease(&js, token);
+
+            next++;
+        }
+
+        /*дождаться завершения; пока есть что запускать - не блокироваться*/
+        if (running > 0)
+        {
+            int status;
+            int pid = waitpid(-1, &status, useJobserver && next < n ? WNOHANG : 0);
+
+            if (pid > 0)
+            {
+                DriverUnit* unit = DriverUnitFind(units, n, pid);
+
+                running--;
+
+                if (unit)
+                {
+                    unit->status = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+                    unit->done = 1;
+                }
+
+                if (pid == implicitPid) implicitPid = 0;
+
+                for (int i = 0; i < tokens.length; i += 2)
+                {
+                    if ((intptr_t) VectorGet(&tokens, i) != pid) continue;
+
+                    JobserverRelease(&js, (char) (intptr_t) VectorGet(&tokens, i + 1));
+                    VectorRemoveReorder(&tokens, i + 1);
+                    VectorRemoveReorder(&tokens, i);
+                    break;
+                }
+            }
+            else if (pid < 0 && errno != EINTR)
+            {
+                /*дождаться остальных нельзя: их результат неизвестен*/
+                for (; printed < n; printed++)
+                {
+                    if (!units[printed].done) units[printed].status = 1;
+
+                    DriverUnitPrint(&units[printed]);
+                }
+
+                break;
+            }
+        }
+
+        /*сообщения выводятся строго в порядке входных файлов*/
+        while (printed < n && units[printed].done)
+            DriverUnitPrint(&units[printed++]);
+    }
+
+    /*при выходе по ошибке токены еще у нас: make без них не продолжит*/
+    for (int i = 1; i < tokens.length; i += 2)
+        JobserverRelease(&js, (char) (intptr_t) VectorGet(&tokens, i));
+
+    int failed = 0;
+
+    for (int i = 0; i < n; i++)
+        failed |= units[i].status;
+
+    if (!failed && config->mode == DRIVER_LINK)
+        failed = DriverLink(config, units, n) != 0;
+
+    for (int i = 0; i < n; i++)
+        DriverUnitFree(config, &units[i]);
+
+    VectorFree(&tokens);
+    free(units);
+    return failed;
+}
+
+//настройки
+void ConfigInit (Config* config)
+{
+    config->mode = DRIVER_LINK;
+    VectorInit(&config->inputs, 4);
+    config->output = 0;
+    VectorInit(&config->includes, 4);
+    VectorInit(&config->defines, 4);
+    config->jobs = 0;
+    config->threads = -1;
+    config->optimise = 0;
+    config->warnPadded = 0;
+    config->cacheDir = 0;
+    config->cacheSize = 5ll << 30;
+    config->includePch = 0;
+    config->emitPch = 0;
+    config->profileGenerate = 0;
+    config->profileUse = 0;
+    config->timeReport = 0;
+    config->timeTrace = 0;
+    config->timeTraceFile = 0;
+    config->incremental = 0;
+    config->os = OS_LINUX;
+    config->wordsize = 8;
+    config->march = 0;
+    config->mtune = 0;
+    config->featuresOn = 0;
+    config->featuresOff = 0;
+    config->fail = 0;
+}
+
+void ConfigFree (Config* config)
+{
+    VectorFree(&config->inputs);
+    free(config->output);
+    VectorFree(&config->includes);
+    VectorFree(&config->defines);
+    free(config->cacheDir);
+    free(config->includePch);
+    free(config->profileGenerate);
+    free(config->profileUse);
+    free(config->timeTraceFile);
+    free(config->march);
+    free(config->mtune);
+}
+
+void ConfigParse (Config* config, int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        if (!strcmp(arg, "-S")) config->mode = DRIVER_COMPILE;
+        else if (!strcmp(arg, "-c")) config->mode = DRIVER_ASSEMBLE;
+        else if (!strcmp(arg, "-merge-profile")) config->mode = DRIVER_MERGE;
+        else if (!strcmp(arg, "-m32")) config->wordsize = 4;
+        else if (!strcmp(arg, "-m64")) config->wordsize = 8;
+        else if (!strcmp(arg, "-mwindows")) config->os = OS_WINDOWS;
+        else if (!strncmp(arg, "-march=", 7) || !strncmp(arg, "-mtune=", 7))
+        {
+            char** cpu = arg[2] == 'a' ? &config->march : &config->mtune;
+
+            if (!ArchIsCpu(arg + 7))
+            {
+                ErrorF("$r: неизвестный процессор $h\n", "ошибка", arg + 7);
+                config->fail = 1;
+            }
+
+            free(*cpu);
+            *cpu = strdup(arg + 7);
+        }
+        else if (!strncmp(arg, "-mno-", 5) && ArchFeatureByName(arg + 5))
+        {
+            config->featuresOff |= ArchFeatureByName(arg + 5);
+            config->featuresOn &= ~ArchFeatureByName(arg + 5);
+        }
+        else if (!strncmp(arg, "-m", 2) && ArchFeatureByName(arg + 2))
+        {
+            config->featuresOn |= ArchFeatureByName(arg + 2);
+            config->featuresOff &= ~ArchFeatureByName(arg + 2);
+        }
+        else if (!strcmp(arg, "-O")) config->optimise = 1;
+        else if (!strcmp(arg, "-O0")) config->optimise = 0;
+        else if (!strcmp(arg, "-Wpadded")) config->warnPadded = 1;
+        else if (!strcmp(arg, "-fno-cache"))
+        {
+            free(config->cacheDir);
+            config->cacheDir = 0;
+        }
+        else if (!strcmp(arg, "-fcache") || !strncmp(arg, "-fcache=", 8))
+        {
+            const char* home = getenv("HOME") ? getenv("HOME") : ".";
+            const char* dir = arg[7] == '=' ? arg + 8 : getenv("SCC_CACHE_DIR");
+
+            free(config->cacheDir);
+
+            if (dir) config->cacheDir = strdup(dir);
+            else
+            {
+                config->cacheDir = malloc(strlen(home) + 16);
+                sprintf(config->cacheDir, "%s/.cache/scc", home);
+            }
+        }
+        else if (!strncmp(arg, "-fcache-size=", 13))
+            config->cacheSize = atoll(arg + 13) << 20;
+        else if (!strcmp(arg, "-o"))
+        {
+            if (i + 1 == argc)
+            {
+                ErrorF("$r: -o без имени файла\n", "ошибка");
+                config->fail = 1;
+            }
+            else
+            {
+                free(config->output);
+                config->output = strdup(argv[++i]);
+            }
+        }
+        else if (!strcmp(arg, "-fprofile-generate") || !strncmp(arg, "-fprofile-generate=", 19))
+        {
+            free(config->profileGenerate);
+            config->profileGenerate = strdup(arg[18] == '=' ? arg + 19 : "scc.profraw");
+        }
+        else if (!strcmp(arg, "-fprofile-use") || !strncmp(arg, "-fprofile-use=", 14))
+        {
+            free(config->profileUse);
+            config->profileUse = strdup(arg[13] == '=' ? arg + 14 : "scc.profdata");
+        }
+        else if (!strcmp(arg, "-ftime-report")) config->timeReport = 1;
+        else if (!strcmp(arg, "-ftime-trace") || !strncmp(arg, "-ftime-trace=", 13))
+        {
+            config->timeTrace = 1;
+            free(config->timeTraceFile);
+            config->timeTraceFile = arg[12] == '=' ? strdup(arg + 13) : 0;
+        }
+        else if (!strcmp(arg, "-fincremental")) config->incremental = 1;
+        else if (!strcmp(arg, "-emit-pch")) config->emitPch = 1;
+        else if (!strcmp(arg, "-include-pch"))
+        {
+            if (i + 1 == argc)
+            {
+                ErrorF("$r: -include-pch без имени файла\n", "ошибка");
+                config->fail = 1;
+            }
+            else
+            {
+                free(config->includePch);
+                config->includePch = strdup(argv[++i]);
+            }
+        }
+        else if (!strncmp(arg, "-I", 2) || !strncmp(arg, "-D", 2))
+        {
+            Vector* list = arg[1] == 'I' ? &config->includes : &config->defines;
+            const char* value = arg[2] ? arg + 2 : i + 1 < argc ? argv[++i] : 0;
+
+            if (value) VectorPush(list, (void*) value);
+            else
+            {
+                ErrorF("$r: $s без значения\n", "ошибка", arg);
+                config->fail = 1;
+            }
+        }
+        else if (!strncmp(arg, "-fthreads=", 10))
+        {
+            config->threads = atoi(arg + 10);
+
+            if (config->threads < 0)
+            {
+                ErrorF("$r: неверное число потоков '$s'\n", "ошибка", arg + 10);
+                config->fail = 1;
+            }
+        }
+        else if (!strncmp(arg, "-j", 2))
+        {
+            const char* count = arg[2] ? arg + 2 : i + 1 < argc ? argv[++i] : "";
+            config->jobs = atoi(count);
+
+            if (config->jobs <= 0)
+            {
+                ErrorF("$r: неверное число заданий '$s'\n", "ошибка", count);
+                config->fail = 1;
+            }
+        }
+        else if (arg[0] == '-')
+        {
+            ErrorF("$r: неизвестный параметр '$s'\n", "ошибка", arg);
+            config->fail = 1;
+        }
+        else
+            VectorPush(&config->inputs, (void*) arg);
+    }
+
+    if (config->inputs.length == 0)
+    {
+        ErrorF("$r: нет входных файлов\n", "ошибка");
+        config->fail = 1;
+    }
+    else if (config->output && config->inputs.length > 1 && config->mode != DRIVER_LINK && config->mode != DRIVER_MERGE)
+    {
+        ErrorF("$r: -o с -S или -c допустим только для одного файла\n", "ошибка");
+        config->fail = 1;
+    }
+    else if (config->timeTraceFile && config->inputs.length > 1)
+    {
+        ErrorF("$r: -ftime-trace=файл допустим только для одного входа\n", "ошибка");
+        config->fail = 1;
+    }
+
+    /*несколько единиц и так собираются параллельными процессами*/
+    if (config->threads < 0) config->threads = config->inputs.length == 1 ? 0 : 1;
+
+    /*при попадании в кеш компиляция не выполняется и заголовок не записался
+      бы, а замеры были бы старыми и попали бы в сообщения из кеша*/
+    if (config->emitPch || config->timeReport || config->timeTrace)
+    {
+        free(config->cacheDir);
+        config->cacheDir = 0;
+    }
+}
+
+int main (int argc, char** argv)
+{
+    DebugInit(stderr);
+
+    Config config;
+    ConfigInit(&config);
+    ConfigParse(&config, argc, argv);
+
+    int failed = config.fail ? 1 : config.mode == DRIVER_MERGE ? DriverMergeProfiles(&config) : DriverRun(&config);
+
+    ConfigFree(&config);
+    DebugFlush();
+    return failed;
+}
@@ -7,7 +7,9 @@
 #include "..\include\type.h"
 #include "..\include\error.h"
 #include "..\include\lexer.h"
-#include "..\include\parser-internal.h"
+#include "..\include\parser-token.h"
+#include "..\include\analyzer.h"
+#include "..\include\file.h"
 
 static void VErrorF (const char* format, va_list args)
 {
@@ -143,4 +145,50 @@ void ErrorF (const char* format, ...)
     va_start(args, format);
     VErrorF(format, args);
     va_end(args);
-}
\ No newline at end of file
+}
+
+//ошибка разбора; после первой ошибки в строке и до синхронизации
+//потока (ctx->panic) остальные сообщения были бы следствиями - молчим
+void ErrorParser (ParserCTX* ctx, const char* format, ...)
+{
+    if (ctx->panic || ctx->location.line == ctx->lastErrorLine) return;
+
+    ErrorF("$h:$d:$d: $r: ", FileName(ctx->location.fileId), ctx->location.line, ctx->location.lineChar, "ошибка");
+
+    va_list args;
+    va_start(args, format);
+    VErrorF(format, args);
+    va_end(args);
+
+    printf("\n");
+
+    ctx->errors++;
+    ctx->lastErrorLine = ctx->location.line;
+}
+
+void ErrorExpected (ParserCTX* ctx, const char* expected)
+{
+    int length;
+    const char* text = TokenText(ctx, &length);
+    char* found = TokenIsEOF(ctx) ? strdup("конец файла") : strndup(text, length);
+
+    ErrorParser(ctx, "ожидалось $s, найдено '$h'", expected, found);
+    free(found);
+
+    ctx->panic = 1;
+}
+
+//ошибка анализа: позиция - у узла дерева
+void ErrorAnalyzer (AnalyzerCTX* ctx, const Ast* Node, const char* format, ...)
+{
+    ErrorF("$h:$d:$d: $r: ", FileName(Node->location.fileId), Node->location.line, Node->location.lineChar, "ошибка");
+
+    va_list args;
+    va_start(args, format);
+    VErrorF(format, args);
+    va_end(args);
+
+    printf("\n");
+
+    ctx->errors++;
+}
@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "..\include\file.h"
+#include "..\include\hashmap.h"
+
+enum {
+    FILE_MapSize = 64
+};
+
+//записи не перемещаются, номер - индекс в entries
+typedef struct FileTable {
+    FileEntry** entries;
+    int length;
+    int capacity;
+
+    HashMap byPath;     //полный путь или имя -> номер + 1
+    int init;
+} FileTable;
+
+static FileTable table;
+static pthread_mutex_t tableLock = PTHREAD_MUTEX_INITIALIZER;
+
+//внутренние функции
+static void FileTableInit (void)
+{
+    if (table.init) return;
+
+    table.capacity = 16;
+    table.entries = malloc(sizeof(FileEntry*) * table.capacity);
+    table.length = 0;
+    HashMapInit(&table.byPath, FILE_MapSize);
+    table.init = 1;
+}
+
+static int FileAdd (const char* key, const char* name, const char* text, int length)
+{
+    if (table.length == table.capacity)
+        table.entries = realloc(table.entries, sizeof(FileEntry*) * (table.capacity *= 2));
+
+    FileEntry* entry = calloc(1, sizeof(FileEntry));
+    entry->name = strdup(name);
+    entry->text = text;
+    entry->length = length;
+
+    const char* slash = strrchr(name, '/');
+    entry->dir = slash ? strndup(name, slash - name) : strdup(".");
+
+    int id = table.length++;
+    table.entries[id] = entry;
+
+    if (key) HashMapAdd(&table.byPath, strdup(key), (void*) (intptr_t) (id + 1));
+
+    return id;
+}
+
+//содержимое отображается в память и не освобождается до конца процесса
+static const char* FileMap (const char* name, int* length, int* mapped)
+{
+    int fd = open(name, O_RDONLY);
+    struct stat info;
+
+    if (fd < 0) return 0;
+
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        close(fd);
+        return 0;
+    }
+
+    *length = info.st_size;
+    *mapped = info.st_size > 0;
+
+    /*пустой файл отобразить нельзя*/
+    const char* text = info.st_size > 0 ? 0 : strdup("");
+
+    if (info.st_size > 0)
+    {
+        void* map = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        text = map != MAP_FAILED ? map : 0;
+    }
+
+    close(fd);
+    return text;
+}
+
+static void FileKeyDtor (char* key, const void* value)
+{
+    (void) value;
+    free(key);
+}
+
+//номер файла по пути; разные пути к одному файлу дают один номер
+int FileOpen (const char* name)
+{
+    char resolved[PATH_MAX];
+    const char* key = realpath(name, resolved) ? resolved : name;
+
+    pthread_mutex_lock(&tableLock);
+    FileTableInit();
+
+    intptr_t found = (intptr_t) HashMapMap(&table.byPath, key);
+    int id = (int) found - 1;
+
+    if (!found || !table.entries[id]->text)
+    {
+        int length, mapped;
+        const char* text = FileMap(name, &length, &mapped);
+
+        if (!text) id = -1;
+        else if (!found) id = FileAdd(key, name, text, length);
+        else
+        {
+            table.entries[id]->text = text;
+            table.entries[id]->length = length;
+        }
+
+        if (id >= 0) table.entries[id]->mapped = mapped;
+    }
+
+    pthread_mutex_unlock(&tableLock);
+    return id;
+}
+
+//имя без содержимого, например из #line
+int FileIntern (const char* name)
+{
+    pthread_mutex_lock(&tableLock);
+    FileTableInit();
+
+    intptr_t found = (intptr_t) HashMapMap(&table.byPath, name);
+    int id = found ? (int) found - 1 : FileAdd(name, name, 0, 0);
+
+    pthread_mutex_unlock(&tableLock);
+    return id;
+}
+
+//текст, созданный в памяти; переходит во владение таблицы
+int FileAddText (const char* name, char* text, int length)
+{
+    pthread_mutex_lock(&tableLock);
+    FileTableInit();
+
+    int id = FileAdd(0, name, text, length);
+    table.entries[id]->guardKnown = 1;
+
+    pthread_mutex_unlock(&tableLock);
+    return id;
+}
+
+int FileCount (void)
+{
+    pthread_mutex_lock(&tableLock);
+    int length = table.length;
+    pthread_mutex_unlock(&tableLock);
+
+    return length;
+}
+
+const FileEntry* FileGet (int id)
+{
+    pthread_mutex_lock(&tableLock);
+    const FileEntry* entry = id >= 0 && id < table.length ? table.entries[id] : 0;
+    pthread_mutex_unlock(&tableLock);
+
+    return entry;
+}
+
+const char* FileName (int id)
+{
+    const FileEntry* entry = FileGet(id);
+    return entry ? entry->name : "<unknown>";
+}
+
+void FileSetGuard (int id, const char* guard)
+{
+    pthread_mutex_lock(&tableLock);
+
+    FileEntry* entry = table.entries[id];
+
+    if (!entry->guardKnown)
+    {
+        entry->guard = guard ? strdup(guard) : 0;
+        entry->guardKnown = 1;
+    }
+
+    pthread_mutex_unlock(&tableLock);
+}
+
+void FileSetOnce (int id)
+{
+    pthread_mutex_lock(&tableLock);
+    table.entries[id]->once = 1;
+    pthread_mutex_unlock(&tableLock);
+}
+
+void FileTableFree (void)
+{
+    pthread_mutex_lock(&tableLock);
+
+    for (int i = 0; i < table.length; i++)
+    {
+        FileEntry* entry = table.entries[i];
+
+        if (entry->mapped) munmap((void*) entry->text, entry->length);
+        else free((void*) entry->text);
+
+        free(entry->name);
+        free(entry->dir);
+        free(entry->guard);
+        free(entry);
+    }
+
+    if (table.init)
+    {
+        free(table.entries);
+        HashMapFreeObjs(&table.byPath, FileKeyDtor, 0);
+    }
+
+    table.init = 0;
+    table.length = 0;
+
+    pthread_mutex_unlock(&tableLock);
+}
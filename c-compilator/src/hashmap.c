@@ -11,6 +11,8 @@ typedef intptr_t (*hashmapHash)(const char* key, int mapsize);
 typedef int (*hashmapCmp)(const char* actual, const char* key);
 typedef char* (*hashmapDup)(const char* key);
 
+static void GHashMapMerge (GHashMap* dest, const GHashMap* src, hashmapHash hash, hashmapCmp cmp, hashmapDup dup, int values);
+
 
 static intptr_t HashStr (const char* key, int mapsize)
 {
@@ -47,7 +49,7 @@ static intptr_t HashInt (intptr_t element, int mapsize)
 
 static int Pow2ize (int x)
 {
-    if (sizeof(x) <= 8) return -1;
+    if (sizeof(x) > 8) return -1;
     
     x--;
     x |= x >> 1;
@@ -107,6 +109,10 @@ static void GHashMapFreeObjs (GHashMap* map, hashmapKeyDtor keyDtor, hashmapValu
 
 static int GHashMapIsMatch (const GHashMap* map, int index, const char* key, int hash, hashmapCmp cmp)
 {
+    /*пустое место: ключа там нет, а сравнивать его через cmp нельзя*/
+    if (map->values[index] == 0)
+        return 0;
+
     if (cmp)
         return map->hashes[index] == hash && !cmp(map->keysStr[index], key);
     else
@@ -191,6 +197,53 @@ static int GHashMapTest (const GHashMap* map, const char* key, hashmapHash hashf
     return GHashMapIsMatch(map, index, key, hash, cmp);
 }
 
+//--- hashmap ---
+HashMap* HashMapInit (HashMap* map, int size)
+{
+    return GHashMapInit(map, size, 1);
+}
+
+void HashMapFree (HashMap* map)
+{
+    GHashMapFree(map, 1);
+}
+
+void HashMapFreeObjs (HashMap* map, hashmapKeyDtor keyDtor, hashmapValueDtor valueDtor)
+{
+    GHashMapFreeObjs(map, keyDtor, valueDtor, 1);
+}
+
+int HashMapAdd (HashMap* map, const char* key, void* value)
+{
+    return GHashMapAdd(map, key, value, HashStr, strcmp, 1);
+}
+
+void* HashMapMap (const HashMap* map, const char* key)
+{
+    return GHashMapMap(map, key, HashStr, strcmp);
+}
+
+//--- intmap ---
+IntMap* IntMapInit (IntMap* map, int size)
+{
+    return GHashMapInit(map, size, 0);
+}
+
+void IntMapFree (IntMap* map)
+{
+    GHashMapFree(map, 0);
+}
+
+int IntMapAdd (IntMap* map, intptr_t key, void* value)
+{
+    return GHashMapAdd(map, (void*) key, value, (hashmapHash) HashInt, 0, 1);
+}
+
+void* IntMapMap (const IntMap* map, intptr_t key)
+{
+    return GHashMapMap(map, (void*) key, (hashmapHash) HashInt, 0);
+}
+
 //--- intset ---
 IntSet* IntSetInit (IntSet* set, int size)
 {
@@ -0,0 +1,517 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "..\include\incremental.h"
+#include "..\include\ast.h"
+#include "..\include\type.h"
+#include "..\include\symbol.h"
+#include "..\include\hashmap.h"
+#include "..\include\vector.h"
+#include "..\include\debug.h"
+
+enum {
+    INCR_MapSize = 64
+};
+
+//состояние отпечатка: символы учитываются однажды, в порядке первого появления
+typedef struct IncrHashCTX {
+    Hasher* h;
+    const Symbol* global;
+    const Symbol* fn;
+    IntSet done;
+} IncrHashCTX;
+
+static void IncrSymbolHash (IncrHashCTX* ctx, const Symbol* Symbol);
+
+//внутренние функции
+static char* IncrGetPath (const IncrCTX* ctx, const char* name)
+{
+    char* path = malloc(strlen(ctx->dir) + strlen(name) + 2);
+
+    sprintf(path, "%s/%s", ctx->dir, name);
+    return path;
+}
+
+//файл кода функции с отпечатком key
+static char* IncrGetCodePath (const IncrCTX* ctx, const char* key)
+{
+    char* name = malloc(strlen(key) + 3);
+    sprintf(name, "%s.s", key);
+
+    char* path = IncrGetPath(ctx, name);
+
+    free(name);
+    return path;
+}
+
+static void IncrKeyDtor (char* key, const void* value)
+{
+    free(key);
+    free((void*) value);
+}
+
+static void IncrMapSet (HashMap* map, const char* name, const char* key)
+{
+    char* old = HashMapMap(map, name);
+
+    /*HashMapAdd не заменяет существующее значение*/
+    if (old) strcpy(old, key);
+    else
+        HashMapAdd(map, strdup(name), strdup(key));
+}
+
+static void IncrLoadManifest (IncrCTX* ctx)
+{
+    char* path = IncrGetPath(ctx, "manifest");
+    FILE* file = fopen(path, "r");
+
+    free(path);
+
+    if (!file) return;
+
+    char name[1024], key[CACHE_KeyLength + 1];
+
+    while (fscanf(file, "%1023s %64s", name, key) == 2)
+        IncrMapSet(&ctx->fns, name, key);
+
+    fclose(file);
+}
+
+static int IncrIsLocal (const Symbol* sym, const Symbol* fn)
+{
+    for (const Symbol* scope = sym; scope; scope = scope->parent)
+        if (scope == fn) return 1;
+
+    return 0;
+}
+
+static void TypeHash (Hasher* h, const Type* dt)
+{
+    if (!dt)
+    {
+        HasherAddInt(h, -1);
+        return;
+    }
+
+    char* str = TypeToStr(dt);
+
+    HasherAddStr(h, str);
+    free(str);
+}
+
+//отпечаток внешнего символа: все, от чего зависит код использующей функции
+static void SymbolHash (Hasher* h, const Symbol* Symbol)
+{
+    HasherAddInt(h, Symbol->tag);
+    HasherAddStr(h, Symbol->ident);
+
+    if (Symbol->tag == SYMBOL_ID || Symbol->tag == SYMBOL_PARAM || Symbol->tag == SYMBOL_TYPEDEF)
+    {
+        TypeHash(h, Symbol->dt);
+        HasherAddInt(h, Symbol->storage);
+
+        if (Symbol->tag == SYMBOL_ID && (Symbol->storage == STORAGE_STATIC || Symbol->storage == STORAGE_EXTERN))
+            HasherAddStr(h, Symbol->label);
+        else if (Symbol->tag != SYMBOL_TYPEDEF)
+            HasherAddInt(h, Symbol->offset);
+    }
+    else if (Symbol->tag == SYMBOL_ENUMCONSTANT)
+        HasherAddInt(h, Symbol->constValue);
+
+    /*раскладка записи: размер и смещения полей*/
+    else if (Symbol->tag == SYMBOL_STRUCT || Symbol->tag == SYMBOL_UNION || Symbol->tag == SYMBOL_ENUM || Symbol->tag == SYMBOL_TYPE)
+    {
+        HasherAddInt(h, Symbol->size);
+        HasherAddInt(h, Symbol->complete);
+
+        for (int i = 0; i < Symbol->children.length; i++)
+        {
+            const struct Symbol* field = VectorGet(&Symbol->children, i);
+
+            HasherAddStr(h, field->ident);
+
+            if (field->tag == SYMBOL_ENUMCONSTANT) HasherAddInt(h, field->constValue);
+            else if (field->tag == SYMBOL_ID)
+            {
+                TypeHash(h, field->dt);
+                HasherAddInt(h, field->offset);
+            }
+        }
+    }
+
+    for (int i = 0; i < Symbol->decls.length; i++)
+        AstHash(h, VectorGet(&Symbol->decls, i));
+
+    /*тело другой функции на код вызывающей не влияет, инициализатор - влияет*/
+    if (Symbol->impl && !(Symbol->tag == SYMBOL_ID && Symbol->dt && TypeIsFunction(Symbol->dt)))
+        AstHash(h, Symbol->impl);
+}
+
+//хеш структуры дерева, без позиций в исходном тексте
+void AstHash (Hasher* h, const Ast* Node)
+{
+    Vector stack;
+    VectorInit(&stack, 32);
+    VectorPush(&stack, (void*) Node);
+
+    while (stack.length)
+    {
+        const Ast* Current = VectorPop(&stack);
+
+        if (!Current)
+        {
+            HasherAddInt(h, -1);
+            continue;
+        }
+
+        HasherAddInt(h, Current->tag);
+        HasherAddInt(h, Current->o);
+        HasherAddInt(h, Current->children);
+
+        if (Current->tag == AST_MARKER)
+            HasherAddInt(h, Current->marker);
+
+        else if (Current->tag == AST_LOOP)
+            HasherAddInt(h, Current->isDo);
+
+        else if (Current->tag == AST_LITERAL || Current->tag == AST_USING)
+        {
+            HasherAddInt(h, Current->litTag);
+
+            if (!Current->literal) HasherAddInt(h, -1);
+            else if (Current->litTag == LITERAL_IDENT || Current->litTag == LITERAL_STR)
+                HasherAddStr(h, Current->literal);
+            else if (Current->litTag == LITERAL_INT)
+            {
+                const IntLiteral* literal = Current->literal;
+
+                HasherAddInt(h, (long long) literal->value);
+                HasherAddInt(h, literal->isUnsigned);
+                HasherAddInt(h, literal->longs);
+                HasherAddInt(h, literal->isDecimal);
+            }
+            else if (Current->litTag == LITERAL_CHAR || Current->litTag == LITERAL_BOOL)
+                HasherAddInt(h, *(int*) Current->literal);
+            else if (Current->litTag == LITERAL_FLOAT || Current->litTag == LITERAL_DOUBLE)
+                HasherAdd(h, Current->literal, sizeof(double));
+        }
+
+        VectorPush(&stack, Current->tag == AST_USING ? 0 : Current->r);
+        VectorPush(&stack, Current->l);
+
+        for (const Ast* Child = Current->lastChild; Child; Child = Child->prevSibling)
+            VectorPush(&stack, (void*) Child);
+    }
+
+    VectorFree(&stack);
+}
+
+//записи, до которых доходит тип: поле в теле видно лишь по имени,
+//поэтому раскладка берется от типов символов
+static void IncrTypeHash (IncrHashCTX* ctx, const Type* dt)
+{
+    if (!dt) return;
+
+    if (dt->tag == TYPE_PTR || dt->tag == TYPE_ARRAY) IncrTypeHash(ctx, dt->base);
+    else if (dt->tag == TYPE_FUNCTION)
+    {
+        IncrTypeHash(ctx, dt->returnType);
+
+        for (int i = 0; i < dt->params; i++)
+            IncrTypeHash(ctx, dt->paramTypes[i]);
+    }
+    else if (dt->tag == TYPE_BASIC && dt->basic)
+        IncrSymbolHash(ctx, dt->basic);
+}
+
+static void IncrSymbolHash (IncrHashCTX* ctx, const Symbol* Symbol)
+{
+    if (IncrIsLocal(Symbol, ctx->fn) || IntSetAdd(&ctx->done, (intptr_t) Symbol)) return;
+
+    SymbolHash(ctx->h, Symbol);
+
+    if (Symbol->tag == SYMBOL_STRUCT || Symbol->tag == SYMBOL_UNION)
+    {
+        for (int i = 0; i < Symbol->children.length; i++)
+        {
+            const struct Symbol* field = VectorGet(&Symbol->children, i);
+
+            if (field->tag == SYMBOL_ID) IncrTypeHash(ctx, field->dt);
+        }
+    }
+    else if (Symbol->tag == SYMBOL_ID || Symbol->tag == SYMBOL_PARAM || Symbol->tag == SYMBOL_TYPEDEF)
+        IncrTypeHash(ctx, Symbol->dt);
+}
+
+//имя, которое может сослаться на символ модуля: обычное или тег
+static void IncrNameHash (IncrHashCTX* ctx, const char* ident)
+{
+    const Symbol* Found = SymbolChildNs(ctx->global, ident, SYMBOL_NS_ORDINARY);
+
+    if (Found) IncrSymbolHash(ctx, Found);
+
+    Found = SymbolChildNs(ctx->global, ident, SYMBOL_NS_TAG);
+
+    if (Found) IncrSymbolHash(ctx, Found);
+}
+
+static void IncrTokenHash (void* data, const Token* token, const char* text)
+{
+    IncrHashCTX* ctx = data;
+
+    HasherAddInt(ctx->h, token->tag);
+    HasherAddInt(ctx->h, token->sub);
+    HasherAddInt(ctx->h, token->length);
+    HasherAdd(ctx->h, text, token->length);
+
+    if (token->tag != TOK_IDENT) return;
+
+    char* ident = malloc(token->length + 1);
+    memcpy(ident, text, token->length);
+    ident[token->length] = 0;
+
+    IncrNameHash(ctx, ident);
+    free(ident);
+}
+
+//отпечаток функции до разбора ее тела: дерево объявления, токены тела и
+//внешние символы, на которые могут ссылаться объявление и имена в теле.
+//Локальное имя, совпавшее с внешним, дает лишь лишнюю пересборку.
+//0 - тело не отложено ленивым разбором, отпечатка нет
+int IncrFingerprint (ParserResult* parsed, const Symbol* Global, const Ast* impl, char key[CACHE_KeyLength + 1])
+{
+    Hasher h;
+    HasherInit(&h);
+    AstHash(&h, impl->l);
+
+    IncrHashCTX ctx = {&h, Global, impl->symbol};
+    IntSetInit(&ctx.done, INCR_MapSize);
+
+    Vector stack;
+    VectorInit(&stack, 32);
+    VectorPush(&stack, impl->l);
+
+    while (stack.length)
+    {
+        const Ast* Current = VectorPop(&stack);
+
+        if (!Current) continue;
+
+        if (Current->symbol) IncrSymbolHash(&ctx, Current->symbol);
+
+        if (Current->tag == AST_LITERAL && Current->litTag == LITERAL_IDENT && Current->literal)
+            IncrNameHash(&ctx, Current->literal);
+
+        if (Current->tag != AST_USING) VectorPush(&stack, Current->r);
+
+        VectorPush(&stack, Current->l);
+
+        for (const Ast* Child = Current->lastChild; Child; Child = Child->prevSibling)
+            VectorPush(&stack, (void*) Child);
+    }
+
+    int lazy = ParserBodyTokens(parsed, impl, IncrTokenHash, &ctx);
+
+    VectorFree(&stack);
+    IntSetFree(&ctx.done);
+
+    HasherDigest(&h, key);
+    return lazy;
+}
+
+//каталог <вход>.fn рядом с исходным файлом, как <вход>.pch у -emit-pch
+void IncrInit (IncrCTX* ctx, const char* input, const char* options)
+{
+    ctx->dir = malloc(strlen(input) + 4);
+    sprintf(ctx->dir, "%s.fn", input);
+
+    mkdir(ctx->dir, 0777);
+
+    strcpy(ctx->options, options);
+    HashMapInit(&ctx->fns, INCR_MapSize);
+    HashMapInit(&ctx->next, INCR_MapSize);
+    HashMapInit(&ctx->keys, INCR_MapSize);
+
+    ctx->reused = 0;
+    ctx->rebuilt = 0;
+
+    IncrLoadManifest(ctx);
+}
+
+void IncrFree (IncrCTX* ctx)
+{
+    HashMapFreeObjs(&ctx->fns, IncrKeyDtor, 0);
+    HashMapFreeObjs(&ctx->next, IncrKeyDtor, 0);
+    HashMapFreeObjs(&ctx->keys, IncrKeyDtor, 0);
+    free(ctx->dir);
+}
+
+//подставить код с прошлой сборки, если отпечаток не изменился;
+//функции с fn->code не выдаются IrEmit повторно
+int IncrReuse (IncrCTX* ctx, IrFN* fn, const char* key)
+{
+    const char* old = HashMapMap(&ctx->fns, fn->name);
+
+    if (!old || strcmp(old, key)) return 0;
+
+    char* path = IncrGetCodePath(ctx, key);
+    FILE* file = fopen(path, "rb");
+
+    free(path);
+
+    if (!file) return 0;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* code = malloc(length + 1);
+
+    if (fread(code, 1, length, file) != (size_t) length)
+    {
+        free(code);
+        fclose(file);
+        return 0;
+    }
+
+    fclose(file);
+
+    code[length] = 0;
+    free(fn->code);
+    fn->code = code;
+    fn->codeLength = length;
+
+    IncrMapSet(&ctx->next, fn->name, key);
+    ctx->reused++;
+    return 1;
+}
+
+//сохранить код функции, выданной заново
+void IncrUpdate (IncrCTX* ctx, const IrFN* fn, const char* key)
+{
+    const char* old = HashMapMap(&ctx->next, fn->name);
+
+    if (old && !strcmp(old, key)) return;
+
+    char* path = IncrGetCodePath(ctx, key);
+    FILE* file = fopen(path, "wb");
+
+    if (file)
+    {
+        if (fn->code) fwrite(fn->code, 1, fn->codeLength, file);
+
+        fclose(file);
+        IncrMapSet(&ctx->next, fn->name, key);
+        ctx->rebuilt++;
+    }
+    else
+        DebugError("IncrUpdate", "не удалось записать %s", path);
+
+    free(path);
+}
+
+//записать манифест текущей сборки и удалить код, на который он не ссылается
+void IncrSave (IncrCTX* ctx)
+{
+    char* path = IncrGetPath(ctx, "manifest");
+    FILE* file = fopen(path, "w");
+
+    free(path);
+
+    if (!file) return;
+
+    HashSet live;
+    HashSetInit(&live, ctx->next.size);
+
+    for (int i = 0; i < ctx->next.size; i++)
+    {
+        if (!ctx->next.values[i]) continue;
+
+        fprintf(file, "%s %s\n", ctx->next.keysStr[i], (const char*) ctx->next.values[i]);
+        HashSetAdd(&live, ctx->next.values[i]);
+    }
+
+    fclose(file);
+
+    DIR* dir = opendir(ctx->dir);
+
+    for (struct dirent* ent = dir ? readdir(dir) : 0; ent; ent = readdir(dir))
+    {
+        char* dot = strrchr(ent->d_name, '.');
+
+        if (!dot || strcmp(dot, ".s")) continue;
+
+        *dot = 0;
+
+        if (!HashSetTest(&live, ent->d_name))
+        {
+            *dot = '.';
+            path = IncrGetPath(ctx, ent->d_name);
+            unlink(path);
+            free(path);
+        }
+    }
+
+    if (dir) closedir(dir);
+
+    HashSetFree(&live);
+}
+
+//вызывается анализатором перед телом функции: запоминает ключ функции в
+//этой сборке; 1 - отпечаток не изменился и код прошлой сборки на месте,
+//тело можно не разбирать и не анализировать
+int IncrUnchanged (IncrCTX* ctx, ParserResult* parsed, const Symbol* Global, const Ast* impl)
+{
+    char fingerprint[CACHE_KeyLength + 1], key[CACHE_KeyLength + 1];
+
+    if (!impl->symbol || !IncrFingerprint(parsed, Global, impl, fingerprint)) return 0;
+
+    Hasher h;
+    HasherInit(&h);
+    HasherAddStr(&h, ctx->options);
+    HasherAddStr(&h, fingerprint);
+    HasherDigest(&h, key);
+
+    IncrMapSet(&ctx->keys, impl->symbol->ident, key);
+
+    const char* old = HashMapMap(&ctx->fns, impl->symbol->ident);
+
+    if (!old || strcmp(old, key)) return 0;
+
+    char* path = IncrGetCodePath(ctx, key);
+    int found = access(path, R_OK) == 0;
+
+    free(path);
+    return found;
+}
+
+//функции IR с неизменным отпечатком получают код прошлой сборки
+//и не выдаются заново
+void IncrPrepare (IncrCTX* ctx, IrCTX* ir)
+{
+    for (int i = 0; i < ir->fns.length; i++)
+    {
+        IrFN* fn = VectorGet(&ir->fns, i);
+        const char* key = HashMapMap(&ctx->keys, fn->name);
+
+        if (key) IncrReuse(ctx, fn, key);
+    }
+}
+
+//после IrEmit: сохранить код выданных заново функций и манифест
+void IncrCommit (IncrCTX* ctx, const IrCTX* ir)
+{
+    for (int i = 0; i < ir->fns.length; i++)
+    {
+        const IrFN* fn = VectorGet(&ir->fns, i);
+        const char* key = HashMapMap(&ctx->keys, fn->name);
+
+        if (key) IncrUpdate(ctx, fn, key);
+    }
+
+    IncrSave(ctx);
+}
@@ -3,52 +3,39 @@
 
 #include "..\include\ir.h"
 #include "..\include\vector.h"
-#include "..\include\hashmap.h"
 #include "..\include\debug.h"
 #include "..\include\operand.h"
 #include "..\include\asm.h"
 #include "..\include\asm64.h"
+#include "..\include\timer.h"
 
 //внутренние функции
-static void IrEmitBlock (IrCTX* ctx, FILE* file, const IrBLOCK* prevblock, const IrBLOCK* block, const IrBLOCK* nextblock)
+static void IrEmitBlock (AsmCTX* assem, const IrBLOCK* prevblock, const IrBLOCK* block, const IrBLOCK* nextblock)
 {
     DebugEnter(block->label);
 
-    if (!(block->preds.length <= 1 && (block->preds.length == 1 ? VectorGet(&block->preds, 0) == prevblock : 1)))
-        AsmLabel(ctx->assem, block->label);
+    /*метка не нужна, если сюда входят только проходом насквозь. Из switch
+      переходят по таблице, маске и jmp default и в следующий блок*/
+    int fallsThrough = block->preds.length == 1 && VectorGet(&block->preds, 0) == prevblock
+                       && prevblock->term && prevblock->term->tag != TERM_SWITCH;
 
-    fputs(block->str, file);
-    DebugMsg(block->str);
+    if (!(block->preds.length == 0 || fallsThrough))
+        AsmLabel(assem, block->label);
 
-    if (block->term) IrEmitTerm(ctx, file, block->term, nextblock);
+    fputs(block->str, assem->file);
+    DebugMsg("%s", block->str);
+
+    if (block->term) IrEmitTerm(assem, block, nextblock);
     else
         DebugError("IrEmitBlock", "незакрытый блок %s", block->label);
 
-    fputs("\n", file);
+    fputs("\n", assem->file);
     DebugLeave();
 }
 
-static void IrEmitBlockChain (IrCTX* ctx, FILE* file, IntSet* done, Vector* priority, const IrBLOCK* block)
-{
-    /*Already put in the priority list, leave*/
-    if (IntSetAdd(done, (intptr_t) block)) return;
-
-    /*Add all the predecessors and their predecessors to the list*/
-    for (int j = 0; j < block->preds.length; j++)
-    {
-        IrBLOCK* pred = VectorGet(&block->preds, j);
-        
-        IrEmitBlockChain(ctx, file, done, priority, pred);
-    }
-
-    /*Followed by this block*/
-    VectorPush(priority, (void*) block);
-}
-
-static void IrEmitTerm (IrCTX* ctx, FILE* file, const IrTERM* term, const IrBLOCK* nextblock)
+static void IrEmitTerm (AsmCTX* assem, const IrBLOCK* block, const IrBLOCK* nextblock)
 {
-    (void) file;
-
+    const IrTERM* term = block->term;
     IrBLOCK* jumpTo = 0;
 
     if (term->tag == TERM_JUMP) jumpTo = term->to;
@@ -58,18 +45,18 @@ static void IrEmitTerm (IrCTX* ctx, FILE* file, const IrTERM* term, const IrBLOC
         {
             Operand cond = OperandCreateFlags(ConditionNegate(term->cond.condition));
             
-            AsmBranch(ctx->assem, cond, term->ifFalse->label);
+            AsmBranch(assem, cond, term->ifFalse->label);
             jumpTo = term->ifTrue;
         }
         else
         {
-            AsmBranch(ctx->assem, term->cond, term->ifTrue->label);
+            AsmBranch(assem, term->cond, term->ifTrue->label);
             jumpTo = term->ifFalse;
         }
     }
     else if (term->tag == TERM_CALL)
     {
-        AsmCall(ctx->assem, term->toAsSym->label);
+        AsmCall(assem, term->toAsSym->label);
         jumpTo = term->ret;
     }
     else if (term->tag == TERM_CALLINDIRECT)
@@ -77,55 +64,103 @@ static void IrEmitTerm (IrCTX* ctx, FILE* file, const IrTERM* term, const IrBLOC
         //asmCallIndirect(ctx->asm, term->toAsOperand);
         jumpTo = term->ret;
     }
-    else if (term->tag == TERM_RETURN) AsmReturn(ctx->assem);
+    else if (term->tag == TERM_RETURN) AsmReturn(assem);
+    else if (term->tag == TERM_SWITCH)
+    {
+        IrSwitchEmit(assem, block);
+        jumpTo = term->ifDefault;
+    }
     else DebugErrorUnhandledInt("IrEmitTerm", "terminal tag", term->tag);
 
     /*выполнить прыжок, если он не дублирующий*/
     if (jumpTo && jumpTo != nextblock)
-        AsmJump(ctx->assem, jumpTo->label);
+        AsmJump(assem, jumpTo->label);
 }
 
-static void IrEmitFn (IrCTX* ctx, FILE* file, const IrFN* fn)
+static void IrEmitFn (AsmCTX* assem, const IrFN* fn)
 {
     DebugEnter(fn->name);
 
-    IntSet done;
-    IntSetInit(&done, fn->blocks.length * 2);
-
     Vector priority;
     VectorInit(&priority, fn->blocks.length);
 
-    /*Decide an order to emit the blocks in to minimize unnecessary jumps*/
-    IrEmitBlockChain(ctx, file, &done, &priority, fn->epilogue);
+    /*горячие пути проходят насквозь, холодные блоки - в конце*/
+    int firstCold = IrLayoutFn(fn, &priority);
+    int split = firstCold < priority.length && assem->arch->os == OS_LINUX;
 
     /*Emit*/
-    AsmFnLinkageBegin(file, fn->name);
+    AsmFnLinkageBegin(assem->file, fn->name);
 
     for (int j = 0; j < priority.length; j++)
     {
         IrBLOCK *prevblock = VectorGet(&priority, j - 1);
         IrBLOCK *block = VectorGet(&priority, j);
         IrBLOCK *nextblock = VectorGet(&priority, j + 1);
-        
-        IrEmitBlock(ctx, file, prevblock, block, nextblock);
+
+        /*в ELF холодные блоки уходят в .text.unlikely, через границу секций
+          нет ни прохода насквозь, ни пропуска метки*/
+        if (split && j == firstCold)
+        {
+            AsmColdSection(assem);
+            prevblock = 0;
+        }
+
+        if (split && j + 1 == firstCold) nextblock = 0;
+
+        IrEmitBlock(assem, prevblock, block, nextblock);
     }
 
-    AsmFnLinkageEnd(file, fn->name);
+    if (split) AsmTextSection(assem);
+
+    AsmFnLinkageEnd(assem->file, fn->name);
+
+    /*константы функции - в ее тексте: код, взятый из прошлой сборки,
+      приносит их с собой*/
+    if (fn->rodata.length)
+    {
+        AsmRODataSection(assem);
+
+        for (int i = 0; i < fn->rodata.length; i++)
+            IrEmitStaticData(assem, VectorGet(&fn->rodata, i));
+
+        AsmTextSection(assem);
+    }
 
     VectorFree(&priority);
-    IntSetFree(&done);
     DebugLeave();
 }
 
-static void IrEmitStaticData (IrCTX* ctx, FILE* file, const IrSTATICDATA* data)
+//выдача функции в собственный буфер, выполняется в потоке пула
+static void IrEmitFnWorker (IrCTX* ctx, IrFN* fn, void* data)
 {
-    (void) file;
+    (void) data;
+
+    /*код уже есть: функция взята из инкрементальной сборки*/
+    if (fn->code) return;
+
+    TimerEnterFn(TIMER_EMIT, fn->name);
 
+    AsmCTX* assem = AsmInitBuffer(ctx->assem, &fn->code, &fn->codeLength);
+
+    IrEmitFn(assem, fn);
+    AsmEndBuffer(assem);
+
+    TimerLeave();
+}
+
+static void IrEmitStaticData (AsmCTX* assem, const IrSTATICDATA* data)
+{
     if (data->tag == STATICDATA_REGULAR)
-        AsmStaticData(ctx->asm, data->label, data->global, data->size, data->initial);
+        AsmStaticData(assem, data->label, data->global, data->size, data->initial);
 
     else if (data->tag == STATICDATA_STRINGCONSTANT)
-        AsmStringConstant(ctx->asm, data->strlabel, data->str);
+        AsmStringConstant(assem, data->strlabel, data->str);
+
+    else if (data->tag == STATICDATA_PROFILE)
+        AsmProfileData(assem, data->profile);
+
+    else if (data->tag == STATICDATA_FLOAT)
+        AsmFloatConstant(assem, data->fplabel, data->fpvalue, data->fpsize);
 
     else
         DebugErrorUnhandledInt("IrEmitStaticData", "static data tag", data->tag);
@@ -138,11 +173,14 @@ void IrEmit (IrCTX* ctx)
 
     AsmFilePrologue(ctx->assem);
 
+    /*функции выдаются параллельно, а склеиваются в исходном порядке*/
+    IrForEachFn(ctx, IrEmitFnWorker, 0);
+
     for (int i = 0; i < ctx->fns.length; i++)
     {
         IrFN* fn = VectorGet(&ctx->fns, i);
         
-        IrEmitFn(ctx, file, fn);
+        if (fn->code) fwrite(fn->code, 1, fn->codeLength, file);
     }
 
     AsmDataSection(ctx->assem);
@@ -151,7 +189,7 @@ void IrEmit (IrCTX* ctx)
     {
         IrSTATICDATA* data = VectorGet(&ctx->data, i);
         
-        IrEmitStaticData(ctx, file, data);
+        IrEmitStaticData(ctx->assem, data);
     }
 
     AsmRODataSection(ctx->assem);
@@ -160,7 +198,7 @@ void IrEmit (IrCTX* ctx)
     {
         IrSTATICDATA* data = VectorGet(&ctx->rodata, i);
         
-        IrEmitStaticData(ctx, file, data);
+        IrEmitStaticData(ctx->assem, data);
     }
 
     AsmFileEpilogue(ctx->assem);
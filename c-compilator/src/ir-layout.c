@@ -0,0 +1,432 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "..\include\ir.h"
+#include "..\include\vector.h"
+#include "..\include\debug.h"
+
+//раскладка блоков функции цепочками Петтиса-Хансена: самые тяжелые ребра
+//становятся проходами насквозь, холодные блоки уходят в конец. Вес ребер -
+//счетчики профиля, если они есть, иначе статические эвристики Болла-Ларуса
+
+enum {
+    IRLAYOUT_EntryFreq = 1 << 10,   //частота входа в функцию без профиля
+    IRLAYOUT_LoopScale = 3,     //тело цикла в 2^3 раз чаще окружающего кода
+    IRLAYOUT_MaxDepth = 8,
+    /*вероятности перехода по ребру в процентах*/
+    IRLAYOUT_Even = 50,
+    IRLAYOUT_BackEdge = 88,     //обратное ребро цикла
+    IRLAYOUT_LoopExit = 12,     //выход из цикла
+    IRLAYOUT_ExitPath = 10,     //ранний выход из функции
+    IRLAYOUT_Certain = 100
+};
+
+typedef struct IrLayoutEdge {
+    int from, to;
+    int back;           //обратное ребро цикла
+    int prob;           //вероятность в процентах
+    long weight;
+    int order;          //номер для устойчивой сортировки
+} IrLayoutEdge;
+
+typedef struct IrLayoutCTX {
+    const IrFN* fn;
+    int n;
+    int profiled;
+
+    IrLayoutEdge* edges;
+    int edgeNo;
+    int* edgeStart;     //первое исходящее ребро блока
+
+    int* depth;         //вложенность циклов
+    long* freq;         //частота блока
+    char* cold;
+    int* rpo;           //обратный порядок обхода в глубину
+    int rpoNo;
+} IrLayoutCTX;
+
+//внутренние функции
+static IrBLOCK* IrLayoutBlock (const IrLayoutCTX* ctx, int nth)
+{
+    return VectorGet(&ctx->fn->blocks, nth);
+}
+
+//блок только передает управление в эпилог
+static int IrLayoutIsExit (const IrLayoutCTX* ctx, int nth)
+{
+    const IrBLOCK* block = IrLayoutBlock(ctx, nth);
+
+    return block != ctx->fn->epilogue && block->term && block->term->tag == TERM_JUMP && block->term->to == ctx->fn->epilogue;
+}
+
+static void IrLayoutEdges (IrLayoutCTX* ctx)
+{
+    ctx->edgeNo = 0;
+
+    for (int i = 0; i < ctx->n; i++)
+        ctx->edgeNo += IrLayoutBlock(ctx, i)->succs.length;
+
+    ctx->edges = malloc(sizeof(IrLayoutEdge) * (ctx->edgeNo + 1));
+    ctx->edgeNo = 0;
+
+    for (int i = 0; i < ctx->n; i++)
+    {
+        const IrBLOCK* block = IrLayoutBlock(ctx, i);
+
+        ctx->edgeStart[i] = ctx->edgeNo;
+
+        for (int k = 0; k < block->succs.length; k++, ctx->edgeNo++)
+        {
+            const IrBLOCK* succ = VectorGet(&block->succs, k);
+
+            ctx->edges[ctx->edgeNo] = (IrLayoutEdge) {i, succ->nthChild, 0, IRLAYOUT_Certain, 0, ctx->edgeNo};
+        }
+    }
+
+    ctx->edgeStart[ctx->n] = ctx->edgeNo;
+}
+
+//обход в глубину от пролога без рекурсии: обратные ребра и порядок
+static void IrLayoutSearch (IrLayoutCTX* ctx)
+{
+    int* stack = malloc(sizeof(int) * ctx->n);
+    int* nextSucc = calloc(ctx->n, sizeof(int));
+    char* state = calloc(ctx->n, sizeof(char));     /*0 - не был, 1 - на стеке, 2 - пройден*/
+    int* post = malloc(sizeof(int) * ctx->n);
+    int top = 0, postNo = 0;
+
+    stack[top++] = ctx->fn->prologue->nthChild;
+    state[ctx->fn->prologue->nthChild] = 1;
+
+    while (top > 0)
+    {
+        int nth = stack[top - 1];
+        const IrBLOCK* block = IrLayoutBlock(ctx, nth);
+
+        if (nextSucc[nth] < block->succs.length)
+        {
+            int k = nextSucc[nth]++;
+            int succ = ((IrBLOCK*) VectorGet(&block->succs, k))->nthChild;
+
+            if (state[succ] == 1) ctx->edges[ctx->edgeStart[nth] + k].back = 1;
+            else if (state[succ] == 0)
+            {
+                state[succ] = 1;
+                stack[top++] = succ;
+            }
+        }
+        else
+        {
+            state[nth] = 2;
+            post[postNo++] = nth;
+            top--;
+        }
+    }
+
+    ctx->rpoNo = postNo;
+
+    for (int i = 0; i < postNo; i++)
+        ctx->rpo[i] = post[postNo - 1 - i];
+
+    free(post);
+    free(state);
+    free(nextSucc);
+    free(stack);
+}
+
+//естественные циклы: тела всех обратных ребер одного заголовка вместе
+static void IrLayoutLoops (IrLayoutCTX* ctx)
+{
+    int* mark = calloc(ctx->n, sizeof(int));
+    char* done = calloc(ctx->n, sizeof(char));
+    int* work = malloc(sizeof(int) * (ctx->n + 1));
+
+    for (int e = 0; e < ctx->edgeNo; e++)
+    {
+        int header = ctx->edges[e].to;
+        int stamp = e + 1, top = 0;
+
+        /*заголовок уже обработан с более ранним ребром*/
+        if (!ctx->edges[e].back || done[header]) continue;
+
+        mark[header] = stamp;
+
+        for (int j = e; j < ctx->edgeNo; j++)
+        {
+            if (ctx->edges[j].back && ctx->edges[j].to == header && mark[ctx->edges[j].from] != stamp)
+            {
+                mark[ctx->edges[j].from] = stamp;
+                work[top++] = ctx->edges[j].from;
+            }
+        }
+
+        while (top > 0)
+        {
+            const IrBLOCK* block = IrLayoutBlock(ctx, work[--top]);
+
+            for (int i = 0; i < block->preds.length; i++)
+            {
+                int pred = ((IrBLOCK*) VectorGet(&block->preds, i))->nthChild;
+
+                if (mark[pred] != stamp)
+                {
+                    mark[pred] = stamp;
+                    work[top++] = pred;
+                }
+            }
+        }
+
+        for (int i = 0; i < ctx->n; i++)
+            if (mark[i] == stamp && ctx->depth[i] < IRLAYOUT_MaxDepth) ctx->depth[i]++;
+
+        done[header] = 1;
+    }
+
+    free(work);
+    free(done);
+    free(mark);
+}
+
+//мнение эвристик о ребре в процентах, IRLAYOUT_Even - нет мнения
+static int IrLayoutHint (const IrLayoutCTX* ctx, const IrLayoutEdge* edge)
+{
+    if (edge->back) return IRLAYOUT_BackEdge;
+    else if (ctx->depth[edge->to] < ctx->depth[edge->from]) return IRLAYOUT_LoopExit;
+    else if (IrLayoutIsExit(ctx, edge->to)) return IRLAYOUT_ExitPath;
+    else
+        return IRLAYOUT_Even;
+}
+
+//мнения о ребре и о соседнем ребре ветвления складываются по Демпстеру-Шаферу
+static int IrLayoutCombine (int mine, int sibling)
+{
+    long a = mine, b = IRLAYOUT_Certain - sibling;
+    long taken = a * b, notTaken = (IRLAYOUT_Certain - a) * (IRLAYOUT_Certain - b);
+
+    return taken + notTaken == 0 ? IRLAYOUT_Even : (int) (taken * IRLAYOUT_Certain / (taken + notTaken));
+}
+
+static void IrLayoutWeights (IrLayoutCTX* ctx)
+{
+    for (int i = 0; i < ctx->n; i++)
+    {
+        const IrBLOCK* block = IrLayoutBlock(ctx, i);
+
+        ctx->freq[i] = ctx->profiled ? (block->count > 0 ? block->count : 0) : (long) IRLAYOUT_EntryFreq << (IRLAYOUT_LoopScale * ctx->depth[i]);
+    }
+
+    for (int i = 0; i < ctx->n; i++)
+    {
+        const IrBLOCK* block = IrLayoutBlock(ctx, i);
+        int first = ctx->edgeStart[i];
+
+        for (int e = first; e < ctx->edgeStart[i + 1]; e++)
+        {
+            IrLayoutEdge* edge = &ctx->edges[e];
+            int isBranch = block->term && block->term->tag == TERM_BRANCH && ctx->edgeStart[i + 1] - first == 2;
+
+            if (isBranch && ctx->profiled)
+            {
+                const IrTERM* term = block->term;
+                long taken = edge->to == term->ifTrue->nthChild && (term->ifTrue != term->ifFalse || e == first)
+                             ? term->trueCount : term->falseCount;
+
+                edge->weight = taken > 0 ? taken : 0;
+                edge->prob = ctx->freq[i] > 0 ? (int) (edge->weight * IRLAYOUT_Certain / ctx->freq[i]) : 0;
+            }
+            else if (isBranch)
+            {
+                const IrLayoutEdge* sibling = &ctx->edges[e == first ? first + 1 : first];
+
+                edge->prob = IrLayoutCombine(IrLayoutHint(ctx, edge), IrLayoutHint(ctx, sibling));
+                edge->weight = ctx->freq[i] * edge->prob / IRLAYOUT_Certain;
+            }
+            /*switch без профиля: поровну на каждый блок назначения*/
+            else
+                edge->weight = ctx->freq[i] / (ctx->edgeStart[i + 1] - first);
+        }
+    }
+}
+
+//холодный блок: не выполнялся по профилю, либо в него ведут только ранние
+//выходы и другие холодные блоки; недостижимые блоки тоже холодные
+static void IrLayoutCold (IrLayoutCTX* ctx)
+{
+    for (int i = 0; i < ctx->n; i++)
+        ctx->cold[i] = 1;
+
+    for (int r = 0; r < ctx->rpoNo; r++)
+    {
+        int nth = ctx->rpo[r];
+        const IrBLOCK* block = IrLayoutBlock(ctx, nth);
+
+        if (block == ctx->fn->prologue || block == ctx->fn->epilogue) ctx->cold[nth] = 0;
+        else if (ctx->profiled) ctx->cold[nth] = block->count <= 0;
+        else
+        {
+            ctx->cold[nth] = 1;
+
+            for (int i = 0; i < block->preds.length && ctx->cold[nth]; i++)
+            {
+                int pred = ((IrBLOCK*) VectorGet(&block->preds, i))->nthChild;
+
+                for (int e = ctx->edgeStart[pred]; e < ctx->edgeStart[pred + 1]; e++)
+                {
+                    const IrLayoutEdge* edge = &ctx->edges[e];
+
+                    if (edge->to == nth && !edge->back && !ctx->cold[pred] && edge->prob > IRLAYOUT_ExitPath)
+                        ctx->cold[nth] = 0;
+                }
+            }
+        }
+    }
+}
+
+static int IrLayoutCompareEdges (const void* left, const void* right)
+{
+    const IrLayoutEdge *L = left, *R = right;
+
+    if (L->weight != R->weight) return L->weight < R->weight ? 1 : -1;
+    else
+        return L->order - R->order;
+}
+
+typedef struct IrLayoutChain {
+    int head;
+    int cold;
+    long freq;
+} IrLayoutChain;
+
+static int IrLayoutCompareChains (const void* left, const void* right)
+{
+    const IrLayoutChain *L = left, *R = right;
+
+    if (L->cold != R->cold) return L->cold - R->cold;
+    else if (L->freq != R->freq) return L->freq < R->freq ? 1 : -1;
+    else
+        return L->head - R->head;
+}
+
+//слияние цепочек по ребрам от тяжелых к легким: конец одной цепочки и
+//начало другой становятся соседями, если ребро соединяет именно их
+static int IrLayoutChains (IrLayoutCTX* ctx, Vector* order)
+{
+    int n = ctx->n, entry = ctx->fn->prologue->nthChild;
+    int* chainOf = malloc(sizeof(int) * n);
+    int* tail = malloc(sizeof(int) * n);
+    int* next = malloc(sizeof(int) * n);
+    IrLayoutChain* chains = malloc(sizeof(IrLayoutChain) * n);
+    int chainNo = 0, firstCold;
+
+    for (int i = 0; i < n; i++)
+    {
+        chainOf[i] = tail[i] = i;
+        next[i] = -1;
+    }
+
+    qsort(ctx->edges, ctx->edgeNo, sizeof(IrLayoutEdge), IrLayoutCompareEdges);
+
+    for (int e = 0; e < ctx->edgeNo; e++)
+    {
+        const IrLayoutEdge* edge = &ctx->edges[e];
+        int from = chainOf[edge->from], to = chainOf[edge->to];
+
+        if (from == to || edge->to != to || tail[from] != edge->from || edge->to == entry || ctx->cold[edge->from] != ctx->cold[edge->to])
+            continue;
+
+        next[edge->from] = edge->to;
+        tail[from] = tail[to];
+
+        for (int i = edge->to; i >= 0; i = next[i])
+            chainOf[i] = from;
+    }
+
+    /*цепочки: со входом первой, затем горячие по частоте, холодные в конце*/
+    for (int i = 0; i < n; i++)
+    {
+        if (chainOf[i] != i || i == entry) continue;
+
+        chains[chainNo++] = (IrLayoutChain) {i, ctx->cold[i], ctx->freq[i]};
+    }
+
+    qsort(chains, chainNo, sizeof(IrLayoutChain), IrLayoutCompareChains);
+
+    for (int i = entry; i >= 0; i = next[i])
+        VectorPush(order, IrLayoutBlock(ctx, i));
+
+    firstCold = -1;
+
+    for (int c = 0; c < chainNo; c++)
+    {
+        if (chains[c].cold && firstCold < 0) firstCold = order->length;
+
+        for (int i = chains[c].head; i >= 0; i = next[i])
+            VectorPush(order, IrLayoutBlock(ctx, i));
+    }
+
+    free(chains);
+    free(next);
+    free(tail);
+    free(chainOf);
+
+    return firstCold < 0 ? order->length : firstCold;
+}
+
+static void IrLayoutInit (IrLayoutCTX* ctx, const IrFN* fn, int profiled)
+{
+    int n = fn->blocks.length;
+
+    ctx->fn = fn;
+    ctx->n = n;
+    ctx->profiled = profiled;
+    ctx->edgeStart = malloc(sizeof(int) * (n + 1));
+    ctx->depth = calloc(n, sizeof(int));
+    ctx->freq = calloc(n, sizeof(long));
+    ctx->cold = calloc(n, sizeof(char));
+    ctx->rpo = malloc(sizeof(int) * n);
+
+    IrLayoutEdges(ctx);
+    IrLayoutSearch(ctx);
+    IrLayoutLoops(ctx);
+    IrLayoutWeights(ctx);
+    IrLayoutCold(ctx);
+}
+
+static void IrLayoutFree (IrLayoutCTX* ctx)
+{
+    free(ctx->rpo);
+    free(ctx->cold);
+    free(ctx->freq);
+    free(ctx->depth);
+    free(ctx->edgeStart);
+    free(ctx->edges);
+}
+
+//порядок выдачи блоков функции; возвращает индекс первого холодного блока
+int IrLayoutFn (const IrFN* fn, Vector* order)
+{
+    DebugEnter("IrLayoutFn");
+
+    IrLayoutCTX ctx;
+    IrLayoutInit(&ctx, fn, fn->prologue->count >= 0);
+
+    int firstCold = IrLayoutChains(&ctx, order);
+
+    IrLayoutFree(&ctx);
+
+    DebugLeave();
+    return firstCold;
+}
+
+//статический вес ребер без профиля: блоки по порядку в fn->blocks, ребра
+//каждого - в порядке succs
+void IrLayoutEstimate (const IrFN* fn, long* weights)
+{
+    IrLayoutCTX ctx;
+    IrLayoutInit(&ctx, fn, 0);
+
+    for (int e = 0; e < ctx.edgeNo; e++)
+        weights[e] = ctx.edges[e].weight;
+
+    IrLayoutFree(&ctx);
+}
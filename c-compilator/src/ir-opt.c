@@ -2,6 +2,7 @@
 
 #include "..\include\ir.h"
 #include "..\include\hashmap.h"
+#include "..\include\timer.h"
 
 static int UbrBlock (IrFN* fn, IrBLOCK* block)
 {
@@ -43,20 +44,22 @@ static int BlaBlock (IrFN* fn, IntSet* done, IrBLOCK* block)
     return UbrBlock(fn, block) || LbcBlock(fn, block);
 }
 
-static void BlaFn (IrFN* fn)
+static void BlaFn (IrCTX* ctx, IrFN* fn, void* data)
 {
+    (void) ctx, (void) data;
+
     IntSet done;
-    
+
+    TimerEnterFn(TIMER_OPTIMISE, fn->name);
+
     IntSetInit(&done, fn->blocks.length);
     BlaBlock(fn, &done, fn->epilogue);
     IntSetFree(&done);
+
+    TimerLeave();
 }
 
 void IrBlockLevelAnalysis (IrCTX* ctx)
 {
-    for (int i = 0; i < ctx->fns.length; i++)
-    {
-        IrFN* fn = VectorGet(&ctx->fns, i);
-        BlaFn(fn);
-    }
+    IrForEachFn(ctx, BlaFn, 0);
 }
\ No newline at end of file
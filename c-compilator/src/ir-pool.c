@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "..\include\ir.h"
+#include "..\include\vector.h"
+#include "..\include\debug.h"
+
+//пул потоков для независимой обработки функций
+
+enum {
+    IRPOOL_MaxJobs = 256
+};
+
+//очередь рабочего потока: диапазон индексов функций [lo, hi)
+typedef struct IrPoolQueue {
+    pthread_mutex_t lock;
+    int lo;
+    int hi;
+} IrPoolQueue;
+
+typedef struct IrPool {
+    IrCTX* ctx;
+    IrFnWorker worker;
+    void* data;
+
+    int workers;
+    IrPoolQueue* queues;
+} IrPool;
+
+typedef struct IrPoolThread {
+    IrPool* pool;
+    int n;
+} IrPoolThread;
+
+//внутренние функции
+static int IrPoolTake (IrPoolQueue* queue)
+{
+    int index = -1;
+
+    pthread_mutex_lock(&queue->lock);
+
+    if (queue->lo < queue->hi)
+        index = queue->lo++;
+
+    pthread_mutex_unlock(&queue->lock);
+    return index;
+}
+
+//забрать у другого потока вторую половину его диапазона
+static int IrPoolSteal (IrPool* pool, IrPoolQueue* own, int n)
+{
+    for (int i = 1; i < pool->workers; i++)
+    {
+        IrPoolQueue* victim = &pool->queues[(n + i) % pool->workers];
+        int lo = 0, hi = 0;
+
+        pthread_mutex_lock(&victim->lock);
+
+        if (victim->lo < victim->hi)
+        {
+            int half = (victim->hi - victim->lo + 1) / 2;
+
+            hi = victim->hi;
+            lo = hi - half;
+            victim->hi = lo;
+        }
+
+        pthread_mutex_unlock(&victim->lock);
+
+        if (lo < hi)
+        {
+            pthread_mutex_lock(&own->lock);
+            own->lo = lo + 1;
+            own->hi = hi;
+            pthread_mutex_unlock(&own->lock);
+            return lo;
+        }
+    }
+
+    return -1;
+}
+
+static void* IrPoolRun (void* arg)
+{
+    IrPoolThread* thread = arg;
+    IrPool* pool = thread->pool;
+    IrPoolQueue* own = &pool->queues[thread->n];
+
+    while (1)
+    {
+        int index = IrPoolTake(own);
+
+        if (index < 0) index = IrPoolSteal(pool, own, thread->n);
+
+        if (index < 0) break;
+
+        pool->worker(pool->ctx, VectorGet(&pool->ctx->fns, index), pool->data);
+    }
+
+    return 0;
+}
+
+static int IrPoolGetJobs (const IrCTX* ctx)
+{
+    int jobs = ctx->jobs;
+
+    if (jobs <= 0)
+        jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (jobs > ctx->fns.length) jobs = ctx->fns.length;
+
+    return jobs < 1 ? 1 : jobs > IRPOOL_MaxJobs ? IRPOOL_MaxJobs : jobs;
+}
+
+//применение прохода ко всем функциям, порядок вызовов не определен
+void IrForEachFn (IrCTX* ctx, IrFnWorker worker, void* data)
+{
+    int jobs = IrPoolGetJobs(ctx);
+
+    if (jobs == 1)
+    {
+        for (int i = 0; i < ctx->fns.length; i++)
+            worker(ctx, VectorGet(&ctx->fns, i), data);
+
+        return;
+    }
+
+    IrPool pool = {ctx, worker, data, jobs, calloc(jobs, sizeof(IrPoolQueue))};
+    IrPoolThread* threads = calloc(jobs, sizeof(IrPoolThread));
+    pthread_t* handles = calloc(jobs, sizeof(pthread_t));
+
+    /*изначально функции делятся поровну, дальше потоки воруют друг у друга*/
+    for (int i = 0; i < jobs; i++)
+    {
+        pthread_mutex_init(&pool.queues[i].lock, 0);
+        pool.queues[i].lo = (int) ((long) ctx->fns.length * i / jobs);
+        pool.queues[i].hi = (int) ((long) ctx->fns.length * (i + 1) / jobs);
+
+        threads[i] = (IrPoolThread) {&pool, i};
+    }
+
+    /*нулевой поток - вызывающий*/
+    for (int i = 1; i < jobs; i++)
+    {
+        if (pthread_create(&handles[i], 0, IrPoolRun, &threads[i]))
+        {
+            DebugError("IrForEachFn", "не удалось создать поток %d", i);
+            handles[i] = 0;
+        }
+    }
+
+    IrPoolRun(&threads[0]);
+
+    for (int i = 1; i < jobs; i++)
+        if (handles[i]) pthread_join(handles[i], 0);
+
+    for (int i = 0; i < jobs; i++)
+        pthread_mutex_destroy(&pool.queues[i].lock);
+
+    free(handles);
+    free(threads);
+    free(pool.queues);
+}
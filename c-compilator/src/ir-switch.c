@@ -0,0 +1,319 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "..\include\ir.h"
+#include "..\include\vector.h"
+#include "..\include\debug.h"
+#include "..\include\asm.h"
+#include "..\include\asm64.h"
+
+//выдача TERM_SWITCH. Отсортированные метки делятся на группы:
+//  плотные участки - таблица переходов в .rodata,
+//  узкие участки с 1-3 блоками назначения - проверка бита в маске,
+//  остальное - одиночные значения и диапазоны с одним блоком.
+//Между группами - сбалансированный двоичный поиск, мелкие части подряд
+
+enum {
+    IRSWITCH_TableMin = 4,          //меньше меток - сравнения дешевле косвенного перехода
+    IRSWITCH_TableDensity = 40,     //процент заполнения таблицы
+    IRSWITCH_TableSpan = 1 << 16,   //наибольшая таблица
+    IRSWITCH_BitDests = 3,          //блоков назначения в группе проверки бита
+    IRSWITCH_LinearMax = 3          //групп, проверяемых подряд без деления
+};
+
+typedef enum IRSWITCH_KIND {
+    IRSWITCH_RANGE,     //low..high в один блок
+    IRSWITCH_TABLE,
+    IRSWITCH_BITS
+} IRSWITCH_KIND;
+
+typedef struct IrSwitchCluster {
+    IRSWITCH_KIND kind;
+    long long low;
+    long long high;
+    int first;          //метки cases[first..first+n)
+    int n;
+} IrSwitchCluster;
+
+typedef struct IrSwitchCTX {
+    AsmCTX* assem;
+    const IrBLOCK* block;
+    const IrTERM* term;
+    int size;           //размер значения после расширения
+    int labelNo;
+
+    IrSwitchCluster* clusters;
+    int clusterNo;
+} IrSwitchCTX;
+
+//выдача перехода switch; после него выполнение идет в ifDefault,
+//этот переход добавляет IrEmitTerm
+void IrSwitchEmit (AsmCTX* assem, const IrBLOCK* block)
+{
+    const IrTERM* term = block->term;
+    IrSwitchCTX ctx = {assem, block, term, term->valueSize < 8 ? 4 : 8, 0, 0, 0};
+
+    if (term->caseNo == 0) return;
+
+    ctx.clusters = malloc(sizeof(IrSwitchCluster) * term->caseNo);
+
+    IrSwitchClusterise(&ctx);
+    AsmSwitchWiden(assem, term->value, term->valueSize, term->isSigned);
+    IrSwitchEmitTree(&ctx, 0, ctx.clusterNo);
+
+    free(ctx.clusters);
+}
+
+//внутренние функции
+static unsigned long long IrSwitchSpan (const IrTERM* term, int first, int last)
+{
+    return (unsigned long long) term->cases[last].value - (unsigned long long) term->cases[first].value;
+}
+
+static int IrSwitchIsDense (const IrTERM* term, int first, int last)
+{
+    unsigned long long span = IrSwitchSpan(term, first, last);
+
+    return span < IRSWITCH_TableSpan && 100ull * (last - first + 1) >= IRSWITCH_TableDensity * (span + 1);
+}
+
+static void IrSwitchPush (IrSwitchCTX* ctx, IRSWITCH_KIND kind, int first, int n)
+{
+    const IrTERM* term = ctx->term;
+
+    ctx->clusters[ctx->clusterNo++] = (IrSwitchCluster) {kind, term->cases[first].value, term->cases[first + n - 1].value, first, n};
+}
+
+//одиночные значения и диапазоны: соседние значения с одним блоком сливаются
+static void IrSwitchRanges (IrSwitchCTX* ctx, int first, int last)
+{
+    const IrCASE* cases = ctx->term->cases;
+
+    for (int i = first, start = first; i <= last; i++)
+    {
+        if (i == last || cases[i + 1].to != cases[i].to || cases[i + 1].value != cases[i].value + 1)
+        {
+            IrSwitchPush(ctx, IRSWITCH_RANGE, start, i - start + 1);
+            start = i + 1;
+        }
+    }
+}
+
+//жадно: группа растет, пока помещается в слово и блоков назначения не больше
+//трех; выгодна, если заменяет достаточно сравнений
+static void IrSwitchBits (IrSwitchCTX* ctx, int from)
+{
+    int end = ctx->clusterNo, out = from;
+    int bits = ctx->assem->arch->wordsize * 8;
+
+    for (int i = from; i < end; )
+    {
+        const IrBLOCK* dests[IRSWITCH_BitDests];
+        int destNo = 0, j = i;
+
+        for (; j < end; j++)
+        {
+            const IrSwitchCluster* c = &ctx->clusters[j];
+            const IrBLOCK* to = ctx->term->cases[c->first].to;
+            int known = 0;
+
+            if ((unsigned long long) c->high - (unsigned long long) ctx->clusters[i].low >= (unsigned long long) bits) break;
+
+            for (int k = 0; k < destNo; k++)
+                known |= dests[k] == to;
+
+            if (!known && destNo == IRSWITCH_BitDests) break;
+
+            if (!known) dests[destNo++] = to;
+        }
+
+        /*порог из LLVM: 3 сравнения на один блок, 5 на два, 6 на три*/
+        int compares = j - i;
+        int worth = destNo == 1 ? compares >= 3 : destNo == 2 ? compares >= 5 : compares >= 6;
+
+        if (worth)
+        {
+            IrSwitchCluster merged = ctx->clusters[i];
+
+            merged.kind = IRSWITCH_BITS;
+            merged.high = ctx->clusters[j - 1].high;
+            merged.n = ctx->clusters[j - 1].first + ctx->clusters[j - 1].n - merged.first;
+
+            ctx->clusters[out++] = merged;
+            i = j;
+        }
+        else
+            ctx->clusters[out++] = ctx->clusters[i++];
+    }
+
+    ctx->clusterNo = out;
+}
+
+//разбиение на таблицы с наименьшим числом групп (динамика по суффиксам,
+//как в LLVM), затем проверки бита на участках между таблицами
+static void IrSwitchClusterise (IrSwitchCTX* ctx)
+{
+    const IrTERM* term = ctx->term;
+    int n = term->caseNo;
+
+    /*все метки в одной таблице - самый частый случай для декодеров*/
+    if (n >= IRSWITCH_TableMin && IrSwitchIsDense(term, 0, n - 1))
+    {
+        IrSwitchPush(ctx, IRSWITCH_TABLE, 0, n);
+        return;
+    }
+
+    int* best = malloc(sizeof(int) * (n + 1));
+    int* next = malloc(sizeof(int) * (n + 1));
+
+    best[n] = 0;
+
+    for (int i = n - 1; i >= 0; i--)
+    {
+        best[i] = best[i + 1] + 1;
+        next[i] = i + 1;
+
+        for (int j = i + IRSWITCH_TableMin - 1; j < n && IrSwitchSpan(term, i, j) < IRSWITCH_TableSpan; j++)
+        {
+            if (IrSwitchIsDense(term, i, j) && best[j + 1] + 1 < best[i])
+            {
+                best[i] = best[j + 1] + 1;
+                next[i] = j + 1;
+            }
+        }
+    }
+
+    for (int i = 0; i < n; )
+    {
+        if (next[i] - i >= IRSWITCH_TableMin)
+        {
+            IrSwitchPush(ctx, IRSWITCH_TABLE, i, next[i] - i);
+            i = next[i];
+            continue;
+        }
+
+        int j = i;
+
+        while (j < n && next[j] - j < IRSWITCH_TableMin) j++;
+
+        int from = ctx->clusterNo;
+
+        IrSwitchRanges(ctx, i, j - 1);
+        IrSwitchBits(ctx, from);
+        i = j;
+    }
+
+    free(next);
+    free(best);
+}
+
+static char* IrSwitchCreateLabel (IrSwitchCTX* ctx)
+{
+    char* label = malloc(strlen(ctx->block->label) + 16);
+
+    sprintf(label, "%s_S%d", ctx->block->label, ctx->labelNo++);
+    return label;
+}
+
+//проверка одной группы: при попадании переход, иначе выполнение идет дальше
+static void IrSwitchEmitLeaf (IrSwitchCTX* ctx, const IrSwitchCluster* c)
+{
+    AsmCTX* assem = ctx->assem;
+    const IrTERM* term = ctx->term;
+    const IrCASE* cases = term->cases + c->first;
+
+    if (c->kind == IRSWITCH_RANGE && c->n == 1)
+    {
+        AsmSwitchCompare(assem, term->value, ctx->size, term->scratch, c->low);
+        AsmSwitchJump(assem, "e", cases[0].to->label);
+        return;
+    }
+
+    unsigned long long span = (unsigned long long) c->high - (unsigned long long) c->low;
+
+    AsmSwitchIndex(assem, term->value, ctx->size, term->scratch, c->low);
+    AsmSwitchCompare(assem, term->scratch, ctx->size, REG_UNDEFINED, (long long) span);
+
+    if (c->kind == IRSWITCH_RANGE)
+    {
+        AsmSwitchJump(assem, "be", cases[0].to->label);
+        return;
+    }
+
+    char* miss = IrSwitchCreateLabel(ctx);
+
+    AsmSwitchJump(assem, "a", miss);
+
+    if (c->kind == IRSWITCH_TABLE)
+    {
+        char* table = IrSwitchCreateLabel(ctx);
+        char** labels = malloc(sizeof(char*) * (span + 1));
+
+        /*дыры в таблице ведут в default*/
+        for (unsigned long long v = 0, k = 0; v <= span; v++)
+        {
+            int hit = k < (unsigned long long) c->n && (unsigned long long) cases[k].value - (unsigned long long) c->low == v;
+
+            labels[v] = hit ? cases[k++].to->label : term->ifDefault->label;
+        }
+
+        AsmSwitchTable(assem, term->value, term->scratch, table, labels, (int) span + 1);
+
+        free(labels);
+        free(table);
+    }
+    else
+    {
+        /*маска на каждый блок назначения, в порядке первого появления*/
+        for (int i = 0; i < c->n; i++)
+        {
+            unsigned long long mask = 0;
+            int seen = 0;
+
+            for (int k = 0; k < i; k++)
+                seen |= cases[k].to == cases[i].to;
+
+            if (seen) continue;
+
+            for (int k = i; k < c->n; k++)
+                if (cases[k].to == cases[i].to) mask |= 1ull << ((unsigned long long) cases[k].value - (unsigned long long) c->low);
+
+            AsmSwitchBitTest(assem, term->value, term->scratch, mask, cases[i].to->label);
+        }
+
+        /*значение в диапазоне группы, но не метка: других групп здесь нет.
+          К тому же маска затерла регистр значения*/
+        AsmJump(assem, term->ifDefault->label);
+    }
+
+    AsmLabel(assem, miss);
+    free(miss);
+}
+
+//группы [first, last): мелкие части подряд, крупные делятся пополам сравнением
+//с нижней границей средней группы; промах любой группы уходит в default
+static void IrSwitchEmitTree (IrSwitchCTX* ctx, int first, int last)
+{
+    if (last - first <= IRSWITCH_LinearMax)
+    {
+        for (int i = first; i < last; i++)
+            IrSwitchEmitLeaf(ctx, &ctx->clusters[i]);
+
+        return;
+    }
+
+    int mid = (first + last) / 2;
+    char* right = IrSwitchCreateLabel(ctx);
+
+    AsmSwitchCompare(ctx->assem, ctx->term->value, ctx->size, ctx->term->scratch, ctx->clusters[mid].low);
+    AsmSwitchJump(ctx->assem, ctx->term->isSigned ? "ge" : "ae", right);
+
+    IrSwitchEmitTree(ctx, first, mid);
+    AsmJump(ctx->assem, ctx->term->ifDefault->label);
+
+    AsmLabel(ctx->assem, right);
+    IrSwitchEmitTree(ctx, mid, last);
+
+    free(right);
+}
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
 
 #include "..\include\ir.h"
 #include "..\include\vector.h"
@@ -8,6 +9,17 @@
 #include "..\include\operand.h"
 #include "..\include\asm.h"
 #include "..\include\asm64.h"
+#include "..\include\profile.h"
+#include "..\include\abi.h"
+#include "..\include\timer.h"
+
+static IrFN* IrFnCreateWith (IrCTX* ctx, const char* name, int stacksize, AbiCall* call);
+static char* IrFnLabel (IrFN* fn);
+static void IrBuildFnWorker (IrCTX* ctx, IrFN* fn, void* data);
+static void IrSwitchChain (IrCTX* ctx, IrBLOCK* block, Operand value, const IrCASE* cases, int n, IrBLOCK* ifDefault);
+static void IrFnDestroy (IrFN* fn);
+static IrSTATICDATA* IrStaticDataCreate (IrCTX* ctx, IrFN* fn, int ro, STATICDATA_TAG tag);
+static void IrStaticDataDestroy (IrSTATICDATA* data);
 
 //размеры векторов 
 enum {
@@ -15,6 +27,8 @@ enum {
     IRCTX_DataNo = 8,
     IRCTX_RODataNo = 64,
     IRFN_BlockNo = 8,
+    IRFN_LabelNo = 8,
+    IRFN_RODataNo = 4,
     IRBLOCK_InstrNo = 8,
     IRBLOCK_StrSize = 1024,
     IRBLOCK_PredNo = 2,
@@ -29,6 +43,7 @@ void IrInit (IrCTX* ctx, const char* output, const Arch* arch)
     VectorInit(&ctx->rodata, IRCTX_RODataNo);
 
     ctx->labelNo = 0;
+    ctx->jobs = 1;
 
     ctx->assem = AsmInit(output, arch);
     ctx->arch = arch;
@@ -68,17 +83,96 @@ static char* IrCreateLabel (IrCTX* ctx)
 
 //создание функции
 IrFN* IrFnCreate (IrCTX* ctx, const char* name, int stacksize)
+{
+    return IrFnCreateWith(ctx, name, stacksize, 0);
+}
+
+//функция по символу: параметры, пришедшие в регистрах, сохраняются после
+//пролога в свою область, она добавляется к localSize
+IrFN* IrFnCreateAbi (IrCTX* ctx, Symbol* Fn, int localSize)
+{
+    AbiCall* call = malloc(sizeof(AbiCall));
+
+    Fn->paramHome = AbiParams(ctx->arch, Fn, call);
+
+    return IrFnCreateWith(ctx, Fn->ident, localSize + Fn->paramHome, call);
+}
+
+//возврат значения Src из функции, созданной IrFnCreateAbi: block
+//закрывается переходом к эпилогу
+void IrFnReturn (IrCTX* ctx, IrFN* fn, IrBLOCK* block, Operand Src)
+{
+    if (fn->abi && fn->abi->ret.size) AsmFnResult(ctx, block, fn->abi, Src);
+
+    IrJump(block, fn->epilogue);
+}
+
+//тело функции наполняется позже, в IrBuild: выбор команд, распределение
+//регистров и метки у каждой функции свои, так что функции строятся
+//параллельно. build может трогать только fn, ее блоки и Regs своего потока
+void IrFnDefer (IrFN* fn, IrFnWorker build, void* data)
+{
+    fn->build = build;
+    fn->buildData = data;
+}
+
+//наполнение отложенных функций в пуле потоков; функции, код которых взят
+//из прошлой сборки, не строятся
+void IrBuild (IrCTX* ctx)
+{
+    IrForEachFn(ctx, IrBuildFnWorker, 0);
+}
+
+static void IrBuildFnWorker (IrCTX* ctx, IrFN* fn, void* data)
+{
+    (void) data;
+
+    if (!fn->build || fn->code) return;
+
+    TimerEnterFn(TIMER_SELECT, fn->name);
+
+    fn->build(ctx, fn, fn->buildData);
+    fn->build = 0;
+
+    /*регистры switch заняты до конца наполнения: в цикле значение, выбранное
+      позже, иначе получило бы регистр, который портит выдача перехода*/
+    for (int i = 0; i < fn->blocks.length; i++)
+    {
+        const IrBLOCK* block = VectorGet(&fn->blocks, i);
+
+        if (!block->term || block->term->tag != TERM_SWITCH) continue;
+
+        RegFree(&Regs[block->term->value]);
+        RegFree(&Regs[block->term->scratch]);
+    }
+
+    TimerLeave();
+}
+
+static IrFN* IrFnCreateWith (IrCTX* ctx, const char* name, int stacksize, AbiCall* call)
 {
     IrFN* fn = malloc(sizeof(IrFN));
     
     fn->name = name ? strdup(name) : IrCreateLabel(ctx);
     VectorInit(&fn->blocks, IRFN_BlockNo);
 
+    fn->labelNo = 0;
+    VectorInit(&fn->labels, IRFN_LabelNo);
+    VectorInit(&fn->rodata, IRFN_RODataNo);
+    fn->abi = call;
+    fn->build = 0;
+    fn->buildData = 0;
+    fn->code = 0;
+    fn->codeLength = 0;
+
     fn->prologue = IrBlockCreate(ctx, fn);
     fn->entryPoint = IrBlockCreate(ctx, fn);
     fn->epilogue = IrBlockCreate(ctx, fn);
 
     AsmFnPrologue(ctx, fn->prologue, stacksize);
+
+    if (call) AsmFnParams(ctx, fn->prologue, call);
+
     AsmFnEpilogue(ctx, fn->epilogue);
 
     IrJump(fn->prologue, fn->entryPoint);
@@ -88,24 +182,57 @@ IrFN* IrFnCreate (IrCTX* ctx, const char* name, int stacksize)
     return fn;
 }
 
+//локальная метка функции: имя функции и ее собственный счетчик, так что
+//метки не зависят от других функций и потоков, а код функции переносится
+//между сборками. Строка принадлежит функции
+const char* IrFnCreateLabel (IrFN* fn)
+{
+    char* label = IrFnLabel(fn);
+
+    VectorPush(&fn->labels, label);
+    return label;
+}
+
+static char* IrFnLabel (IrFN* fn)
+{
+    char* label = malloc(strlen(fn->name) + 12);
+
+    sprintf(label, ".%s_%X", fn->name, fn->labelNo++);
+    return label;
+}
+
 static void IrFnDestroy (IrFN* fn)
 {
     VectorFreeObjs(&fn->blocks, (VectorDtor) IrBlockDestroy);
+    VectorFreeObjs(&fn->labels, free);
+    VectorFreeObjs(&fn->rodata, (VectorDtor) IrStaticDataDestroy);
     free(fn->name);
+    free(fn->code);
+
+    if (fn->abi)
+    {
+        AbiCallFree(fn->abi);
+        free(fn->abi);
+    }
+
     free(fn);
 }
 
 //функции для вывода блока в поток
 void IrBlockOut (IrBLOCK* block, const char* format, ...)
 {
-    va_list args[2];
-    va_start(args[0], format);
-    va_copy(args[1], args[0]);
-    DebugVarMsg(format, args[1]);
-    va_end(args[1]);
+    va_list args;
+
+    if (DebugIsOn(DEBUG_FULL))
+    {
+        va_start(args, format);
+        DebugTraceV(format, args);
+        va_end(args);
+    }
 
-    int length = vsnprintf(block->str + block->length, block->capacity - block->length, format, args[0]);
-    va_end(args[0]);
+    va_start(args, format);
+    int length = vsnprintf(block->str + block->length, block->capacity - block->length, format, args);
+    va_end(args);
 
     if (length < 0 || block->length + length >= block->capacity)
     {
@@ -113,9 +240,9 @@ void IrBlockOut (IrBLOCK* block, const char* format, ...)
         block->capacity += length + 2;
         block->str = realloc(block->str, block->capacity);
 
-        va_start(args[0], format);
-        vsnprintf(block->str + block->length, block->capacity, format, args[0]);
-        va_end(args[0]);
+        va_start(args, format);
+        vsnprintf(block->str + block->length, block->capacity, format, args);
+        va_end(args);
     }
 
     block->length += length;
@@ -129,7 +256,8 @@ IrBLOCK* IrBlockCreate (IrCTX* ctx, IrFN* fn)
     
     VectorInit(&block->instrs, IRBLOCK_InstrNo);
     block->term = 0;
-    block->label = IrCreateLabel(ctx);
+    block->label = IrFnLabel(fn);
+    block->fn = fn;
 
     block->str = calloc(IRBLOCK_StrSize, sizeof(char*));
     block->length = 0;
@@ -137,6 +265,7 @@ IrBLOCK* IrBlockCreate (IrCTX* ctx, IrFN* fn)
 
     VectorInit(&block->preds, IRBLOCK_PredNo);
     VectorInit(&block->succs, IRBLOCK_SuccNo);
+    block->count = -1;
 
     IrAddBlock(fn, block);
     return block;
@@ -209,6 +338,38 @@ void IrBlocksCombine (IrFN* fn, IrBLOCK* pred, IrBLOCK* succ)
     IrBlockDelete(fn, succ);
 }
 
+//новый блок на ребре from -> to: переход from перенаправляется в него,
+//а из него - безусловно в to
+IrBLOCK* IrEdgeSplit (IrCTX* ctx, IrFN* fn, IrBLOCK* from, IrBLOCK* to)
+{
+    IrBLOCK* middle = IrBlockCreate(ctx, fn);
+    IrTERM* term = from->term;
+
+    if (term->tag == TERM_JUMP) term->to = middle;
+    else if (term->tag == TERM_BRANCH)
+    {
+        if (term->ifTrue == to) term->ifTrue = middle;
+        else
+            term->ifFalse = middle;
+    }
+    else if (term->tag == TERM_CALL || term->tag == TERM_CALLINDIRECT) term->ret = middle;
+    else if (term->tag == TERM_SWITCH)
+    {
+        /*у switch каждый блок в succs один раз, метки с ним переносятся все*/
+        for (int i = 0; i < term->caseNo; i++)
+            if (term->cases[i].to == to) term->cases[i].to = middle;
+
+        if (term->ifDefault == to) term->ifDefault = middle;
+    }
+
+    VectorSet(&from->succs, VectorFind(&from->succs, to), middle);
+    VectorRemoveReorder(&to->preds, VectorFind(&to->preds, from));
+    VectorPush(&middle->preds, from);
+
+    IrJump(middle, to);
+    return middle;
+}
+
 int IrBlockGetPredNo (IrFN* fn, IrBLOCK* block)
 {
     return block->preds.length + (block == fn->prologue ? 1 : 0);
@@ -287,6 +448,19 @@ void IrCall (IrBLOCK* block, Symbol* to, IrBLOCK* ret)
     IrBlockLink(block, ret);
 }
 
+//вызов по соглашению call: аргументы args раскладываются в конце block,
+//в начале ret снимается область аргументов и результат переносится в Dest.
+//Dest же - буфер для результата, возвращаемого в памяти; ret - новый блок
+void IrCallAbi (IrCTX* ctx, IrBLOCK* block, Symbol* to, const AbiCall* call, const Operand* args, Operand Dest, IrBLOCK* ret)
+{
+    AsmCallArgs(ctx, block, call, args, Dest);
+    IrCall(block, to, ret);
+
+    AsmCallCleanup(ctx, ret, call);
+
+    if (call->ret.size) AsmCallResult(ctx, ret, call, Dest);
+}
+
 void IrCallIndirect (IrBLOCK* block, Operand to, IrBLOCK* ret)
 {
     IrTERM* term = IrTermCreate(TERM_CALLINDIRECT, block);
@@ -298,6 +472,114 @@ void IrCallIndirect (IrBLOCK* block, Operand to, IrBLOCK* ret)
     AsmCallIndirect(block, to);
 }
 
+static int IrCaseCompareSigned (const void* left, const void* right)
+{
+    long long L = ((const IrCASE*) left)->value, R = ((const IrCASE*) right)->value;
+
+    return L < R ? -1 : L > R;
+}
+
+static int IrCaseCompareUnsigned (const void* left, const void* right)
+{
+    unsigned long long L = ((const IrCASE*) left)->value, R = ((const IrCASE*) right)->value;
+
+    return L < R ? -1 : L > R;
+}
+
+//многовариантный переход по значению value; метки копируются и сортируются,
+//повторяющиеся значения должен отсеять анализатор. Два регистра перехода
+//освобождает IrBuild, когда функция наполнена
+void IrSwitch (IrCTX* ctx, IrBLOCK* block, Operand value, int isSigned, const IrCASE* cases, int n, IrBLOCK* ifDefault)
+{
+    int size = OperandGetSize(ctx->arch, value);
+
+    /*выдача расширяет значение, кладет в его регистр адрес таблицы и маски,
+      поэтому работает с копией: переменная в регистре остается живой.
+      Выдача идет в другом потоке, там распределение регистров свое:
+      запоминаются номера, а свободный регистр выбирается сейчас*/
+    Register* copy = RegAlloc(size);
+    Register* scratch = copy ? RegAlloc(ctx->arch->wordsize) : 0;
+
+    if (!scratch)
+    {
+        if (copy) RegFree(copy);
+
+        IrSwitchChain(ctx, block, value, cases, n, ifDefault);
+        return;
+    }
+
+    AsmMove(ctx, block, OperandCreateReg(copy), value);
+
+    IrTERM* term = IrTermCreate(TERM_SWITCH, block);
+
+    term->value = (REG_INDEX) (copy - Regs);
+    term->valueSize = size;
+    term->scratch = (REG_INDEX) (scratch - Regs);
+    term->isSigned = isSigned;
+    term->caseNo = n;
+    term->cases = malloc(sizeof(IrCASE) * (n + 1));
+    term->ifDefault = ifDefault;
+
+    memcpy(term->cases, cases, sizeof(IrCASE) * n);
+    qsort(term->cases, n, sizeof(IrCASE), isSigned ? IrCaseCompareSigned : IrCaseCompareUnsigned);
+
+    IrBlockLink(block, ifDefault);
+
+    for (int i = 0; i < n; i++)
+    {
+        if (VectorFind(&block->succs, term->cases[i].to) < 0)
+            IrBlockLink(block, term->cases[i].to);
+    }
+}
+
+/*регистров нет: по сравнению на блок. Значение за пределами int в cmp не
+  помещается, его кладет в регистр, сохраненный в стеке; pop флаги не меняет*/
+static void IrSwitchChain (IrCTX* ctx, IrBLOCK* block, Operand value, const IrCASE* cases, int n, IrBLOCK* ifDefault)
+{
+    if (value.tag == OPERAND_LITERAL)
+    {
+        IrBLOCK* to = ifDefault;
+
+        for (int i = 0; i < n; i++)
+            if (cases[i].value == value.literal) to = cases[i].to;
+
+        IrJump(block, to);
+        return;
+    }
+
+    int size = OperandGetSize(ctx->arch, value);
+    char* valueStr = OperandToStr(value);
+
+    for (int i = 0; i < n; i++)
+    {
+        IrBLOCK* next = i + 1 < n ? IrBlockCreate(ctx, block->fn) : ifDefault;
+        long long v = cases[i].value;
+
+        /*у 32-битного значения важны лишь младшие 32 бита метки*/
+        if (size < 8 || (v >= INT_MIN && v <= INT_MAX))
+            AsmCompare(ctx, block, value, OperandCreateLiteral((int) v));
+
+        else
+        {
+            /*rbx или, если он в значении, rcx*/
+            int busy = value.base == &Regs[REG_RBX] || (value.tag == OPERAND_MEM && value.index == &Regs[REG_RBX]);
+            const char* spill = RegIndexGetName(busy ? REG_RCX : REG_RBX, 8);
+
+            IrBlockOut(block, "push %s", spill);
+            IrBlockOut(block, "mov %s, %lld", spill, v);
+            IrBlockOut(block, "cmp %s, %s", valueStr, spill);
+            IrBlockOut(block, "pop %s", spill);
+        }
+
+        IrBranch(block, OperandCreateFlags(CONDITION_EQ), cases[i].to, next);
+        block = next;
+    }
+
+    if (n == 0) IrJump(block, ifDefault);
+
+    free(valueStr);
+}
+
 static void IrReturn (IrBLOCK* block)
 {
     IrTermCreate(TERM_RETURN, block);
@@ -312,9 +594,18 @@ static IrTERM* IrTermCreate (TERM_TAG tag, IrBLOCK* block)
     term->cond = OperandCreate(OPERAND_UNDEFINED);
     term->ifTrue = 0;
     term->ifFalse = 0;
+    term->trueCount = 0;
+    term->falseCount = 0;
     term->ret = 0;
     term->toAsSym = 0;
     term->toAsOperand = OperandCreate(OPERAND_UNDEFINED);
+    term->value = REG_UNDEFINED;
+    term->valueSize = 0;
+    term->scratch = REG_UNDEFINED;
+    term->cases = 0;
+    term->caseNo = 0;
+    term->isSigned = 0;
+    term->ifDefault = 0;
     
     IrBlockTerminate(block, term);
     return term;
@@ -322,6 +613,8 @@ static IrTERM* IrTermCreate (TERM_TAG tag, IrBLOCK* block)
 
 static void IrTermDestroy (IrTERM* term)
 {
+    if (term && term->tag == TERM_SWITCH) free(term->cases);
+
     free(term);
 }
 
@@ -353,7 +646,7 @@ static void IrAddInstr (IrBLOCK* block, IrINSTR* instr)
 //статические данные
 void IrStaticValue (IrCTX* ctx, const char* label, int global, int size, intptr_t initial)
 {
-    IrSTATICDATA* data = IrStaticDataCreate(ctx, 0, STATICDATA_REGULAR);
+    IrSTATICDATA* data = IrStaticDataCreate(ctx, 0, 0, STATICDATA_REGULAR);
     
     data->label = label;
     data->global = global;
@@ -361,22 +654,61 @@ void IrStaticValue (IrCTX* ctx, const char* label, int global, int size, intptr_
     data->initial = initial;
 }
 
-Operand IrStringConstant (IrCTX* ctx, const char* str)
+//строка в .rodata; fn - функция, которая на нее ссылается, ее константы
+//выдаются вместе с ее кодом и получают ее метки. 0 - константа модуля
+Operand IrStringConstant (IrCTX* ctx, IrFN* fn, const char* str)
 {
-    IrSTATICDATA* data = IrStaticDataCreate(ctx, 1, STATICDATA_STRINGCONSTANT);
+    IrSTATICDATA* data = IrStaticDataCreate(ctx, fn, 1, STATICDATA_STRINGCONSTANT);
     
-    data->strlabel = IrCreateLabel(ctx);
+    data->strlabel = fn ? IrFnLabel(fn) : IrCreateLabel(ctx);
     data->str = (void*) strdup(str);
     return OperandCreateLabelOffset(data->label);
 }
 
+//константа с плавающей точкой в .rodata, одинаковые в одной функции
+//выдаются один раз; size 4 - float, 8 - double. fn - как у IrStringConstant
+Operand IrFloatConstant (IrCTX* ctx, IrFN* fn, double value, int size)
+{
+    const Vector* rodata = fn ? &fn->rodata : &ctx->rodata;
+
+    if (size == 4) value = (float) value;
+
+    for (int i = 0; i < rodata->length; i++)
+    {
+        IrSTATICDATA* data = VectorGet(rodata, i);
+
+        /*по битам: 0.0 и -0.0 разные, NaN равен себе*/
+        if (data->tag == STATICDATA_FLOAT && data->fpsize == size && !memcmp(&data->fpvalue, &value, sizeof(double)))
+            return OperandAsFloat(OperandCreateLabelMem(data->fplabel, size));
+    }
+
+    IrSTATICDATA* data = IrStaticDataCreate(ctx, fn, 1, STATICDATA_FLOAT);
+
+    data->fplabel = fn ? IrFnLabel(fn) : IrCreateLabel(ctx);
+    data->fpvalue = value;
+    data->fpsize = size;
+    return OperandAsFloat(OperandCreateLabelMem(data->fplabel, size));
+}
+
+//описание модуля для профилирования, выдается вместе с данными
+void IrStaticProfile (IrCTX* ctx, struct ProfileModule* profile)
+{
+    IrSTATICDATA* data = IrStaticDataCreate(ctx, 0, 0, STATICDATA_PROFILE);
+
+    data->profile = profile;
+}
+
 //статические данные - внутренние функции
-static IrSTATICDATA* IrStaticDataCreate (IrCTX* ctx, int ro, STATICDATA_TAG tag)
+static IrSTATICDATA* IrStaticDataCreate (IrCTX* ctx, IrFN* fn, int ro, STATICDATA_TAG tag)
 {
     IrSTATICDATA* data = malloc(sizeof(IrSTATICDATA));
     
     data->tag = tag;
-    (ro ? IrAddROData : IrAddData)(ctx, data);
+
+    if (fn) VectorPush(&fn->rodata, data);
+    else
+        (ro ? IrAddROData : IrAddData)(ctx, data);
+
     return data;
 }
 
@@ -387,6 +719,11 @@ static void IrStaticDataDestroy (IrSTATICDATA* data)
         free(data->strlabel);
         free(data->str);
     }
+    else if (data->tag == STATICDATA_PROFILE)
+        ProfileModuleFree(data->profile);
+
+    else if (data->tag == STATICDATA_FLOAT)
+        free(data->fplabel);
 
     free(data);
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "..\include\layout.h"
+#include "..\include\type.h"
+#include "..\include\ast.h"
+#include "..\include\file.h"
+#include "..\include\error.h"
+#include "..\include\debug.h"
+
+//член записи: поле или анонимная вложенная запись
+typedef struct LayoutMember {
+    Symbol* symbol;
+    int size;
+    int align;
+    int order;          //номер в порядке объявления
+} LayoutMember;
+
+//внутренние функции
+static int LayoutRound (int offset, int align)
+{
+    return (offset + align - 1) / align * align;
+}
+
+//тип поля построен из записи: сама запись, указатель на нее, массив
+static int LayoutMentions (const Type* dt, const Symbol* Record)
+{
+    while (!TypeIsInvalid(dt) && TypeGetBase(dt)) dt = TypeGetBase(dt);
+
+    return TypeGetBasic(dt) == Record;
+}
+
+//запись без имени - член, только если она не задает тип какого-то поля
+int LayoutIsAnonMember (const Symbol* Record, const Symbol* Child)
+{
+    if ((Child->tag != SYMBOL_STRUCT && Child->tag != SYMBOL_UNION) || !Child->ident || Child->ident[0]) return 0;
+
+    for (int i = 0; i < Record->children.length; i++)
+    {
+        const Symbol* Field = VectorGet(&Record->children, i);
+
+        if (Field->tag == SYMBOL_ID && Field->dt && LayoutMentions(Field->dt, Child)) return 0;
+    }
+
+    return 1;
+}
+
+//члены в порядке объявления; packed снимает естественное выравнивание,
+//но не _Alignas
+static int LayoutMembers (const Arch* arch, const Symbol* Record, LayoutMember** members)
+{
+    int n = 0;
+
+    *members = malloc(sizeof(LayoutMember) * (Record->children.length + 1));
+
+    for (int i = 0; i < Record->children.length; i++)
+    {
+        Symbol* Child = VectorGet(&Record->children, i);
+        int natural;
+
+        if (Child->tag == SYMBOL_ID && Child->dt)
+        {
+            natural = Record->packed ? 1 : TypeGetAlign(arch, Child->dt);
+            (*members)[n] = (LayoutMember) {Child, TypeGetSize(arch, Child->dt), Child->alignAs ? Child->alignAs : natural, n};
+            n++;
+        }
+        else if (LayoutIsAnonMember(Record, Child))
+        {
+            natural = Record->packed ? 1 : Child->align > 0 ? Child->align : 1;
+            (*members)[n] = (LayoutMember) {Child, Child->size, natural, n};
+            n++;
+        }
+    }
+
+    return n;
+}
+
+//члены подряд с выравниванием; у объединения все начинаются с нуля
+static int LayoutPlace (const LayoutMember* members, int n, int isUnion, int align, int* offsets)
+{
+    int end = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        int at = isUnion ? 0 : LayoutRound(end, members[i].align);
+
+        if (offsets) offsets[i] = at;
+
+        if (at + members[i].size > end) end = at + members[i].size;
+    }
+
+    return LayoutRound(end, align);
+}
+
+//поля анонимного члена получают смещения от начала внешней записи
+static void LayoutShift (Symbol* Record, int offset)
+{
+    for (int i = 0; i < Record->children.length; i++)
+    {
+        Symbol* Child = VectorGet(&Record->children, i);
+
+        if (Child->tag == SYMBOL_ID) Child->offset += offset;
+        else if (LayoutIsAnonMember(Record, Child))
+            LayoutShift(Child, offset);
+    }
+}
+
+//сначала строже выровненные, при равенстве - большие, иначе как объявлены
+static int LayoutCompare (const void* left, const void* right)
+{
+    const LayoutMember *L = left, *R = right;
+
+    if (L->align != R->align) return R->align - L->align;
+    else if (L->size != R->size) return R->size - L->size;
+    else
+        return L->order - R->order;
+}
+
+static const char* LayoutMemberName (const LayoutMember* member)
+{
+    return member->symbol->tag == SYMBOL_ID ? member->symbol->ident : "<анонимный член>";
+}
+
+static int LayoutReportRecord (const Arch* arch, const Symbol* Record)
+{
+    int padding = LayoutPadding(arch, Record);
+
+    if (padding == 0) return 0;
+
+    LayoutMember* members;
+    int n = LayoutMembers(arch, Record, &members);
+    int* offsets = malloc(sizeof(int) * (n + 1));
+    int end = 0;
+
+    LayoutPlace(members, n, 0, Record->align, offsets);
+
+    const Ast* Impl = Record->impl;
+    const char* name = Record->ident && Record->ident[0] ? Record->ident : "<без имени>";
+
+    ErrorF("$h:$d:$d: $r: в struct $h $d байт заполнения, размер $d\n", FileName(Impl->location.fileId),
+           Impl->location.line, Impl->location.lineChar, "предупреждение", name, padding, Record->size);
+
+    for (int i = 0; i < n; i++)
+    {
+        if (offsets[i] > end)
+            ErrorF("    $d байт перед '$h' (смещение $d)\n", offsets[i] - end, LayoutMemberName(&members[i]), offsets[i]);
+
+        end = offsets[i] + members[i].size;
+    }
+
+    if (Record->size > end) ErrorF("    $d байт в конце\n", Record->size - end);
+
+    /*порядок по убыванию выравнивания убирает дыры между полями*/
+    qsort(members, n, sizeof(LayoutMember), LayoutCompare);
+
+    int reordered = LayoutPlace(members, n, 0, Record->align, 0);
+
+    if (reordered < Record->size)
+    {
+        ErrorF("    порядок");
+
+        for (int i = 0; i < n; i++)
+            ErrorF(i ? ", $h" : " $h", LayoutMemberName(&members[i]));
+
+        ErrorF(" дает размер $d\n", reordered);
+    }
+
+    free(offsets);
+    free(members);
+    return 1;
+}
+
+//смещения полей, размер и выравнивание записи; в Record->align до вызова -
+//выравнивание, запрошенное aligned, анонимные члены уже разложены
+void LayoutRecord (const Arch* arch, Symbol* Record)
+{
+    DebugEnter("LayoutRecord");
+
+    LayoutMember* members;
+    int n = LayoutMembers(arch, Record, &members);
+    int* offsets = malloc(sizeof(int) * (n + 1));
+    int align = Record->align > 0 ? Record->align : 1;
+
+    for (int i = 0; i < n; i++)
+        if (members[i].align > align) align = members[i].align;
+
+    Record->size = LayoutPlace(members, n, Record->tag == SYMBOL_UNION, align, offsets);
+    Record->align = align;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (members[i].symbol->tag == SYMBOL_ID) members[i].symbol->offset = offsets[i];
+        else
+            LayoutShift(members[i].symbol, offsets[i]);
+    }
+
+    free(offsets);
+    free(members);
+
+    DebugLeave();
+}
+
+//байты записи, не занятые ни одним членом
+int LayoutPadding (const Arch* arch, const Symbol* Record)
+{
+    LayoutMember* members;
+    int n = LayoutMembers(arch, Record, &members);
+    int used = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (Record->tag == SYMBOL_UNION) used = members[i].size > used ? members[i].size : used;
+        else
+            used += members[i].size;
+    }
+
+    free(members);
+    return Record->size > used ? Record->size - used : 0;
+}
+
+//-Wpadded: структуры с заполнением и порядок полей, при котором его
+//меньше; символы подключенных модулей не просматриваются
+int LayoutReport (const Arch* arch, const Symbol* Scope)
+{
+    int warnings = 0;
+
+    for (int i = 0; i < Scope->children.length; i++)
+    {
+        const Symbol* Child = VectorGet(&Scope->children, i);
+
+        if (Child->tag == SYMBOL_MODULELINK || Child->tag == SYMBOL_LINK) continue;
+
+        if (Child->tag == SYMBOL_STRUCT && Child->complete && Child->impl)
+            warnings += LayoutReportRecord(arch, Child);
+
+        warnings += LayoutReport(arch, Child);
+    }
+
+    return warnings;
+}
@@ -3,11 +3,19 @@
 #include <ctype.h>
 
 #include "..\include\lexer.h"
+#include "..\include\pp.h"
+#include "..\include\file.h"
+#include "..\include\timer.h"
 
-LexerCTX* LexerInit (const char* filename)
+//лексер над потоком, поток принадлежит лексеру
+LexerCTX* LexerInitStream (StreamCTX* stream, int directives)
 {
     LexerCTX* ctx = (LexerCTX *)malloc(sizeof(LexerCTX));
-    ctx->stream = StreamInit(filename);
+    ctx->stream = stream;
+    ctx->pp = 0;
+    ctx->directives = directives;
+
+    ctx->file = -1;
     ctx->line = 1;
     ctx->lineChar = 1;
 
@@ -15,14 +23,44 @@ LexerCTX* LexerInit (const char* filename)
     ctx->keyword = KEYWORD_UNDEFINED;
     ctx->punct = PUNCT_UNDEFINED;
 
+    ctx->text = 0;
+    ctx->textLength = 0;
+    ctx->bol = 1;
+    ctx->space = 0;
+
     ctx->buffsz = 128;
     ctx->buffer = (char *)malloc(sizeof(char)*ctx->buffsz);
+    ctx->length = 0;
+    ctx->buffer[0] = 0;
+    return ctx;
+}
+
+//без препроцессора: директивы пропускаются как комментарии
+LexerCTX* LexerInit (const char* filename)
+{
+    int file = FileOpen(filename);
+
+    if (file < 0) return 0;
+
+    const FileEntry* entry = FileGet(file);
+
+    LexerCTX* ctx = LexerInitStream(StreamInitText(entry->text, entry->length), 0);
+    ctx->file = file;
+    return ctx;
+}
+
+//токены после препроцессора; pp остается за вызывающим
+LexerCTX* LexerInitPP (PPCTX* pp)
+{
+    LexerCTX* ctx = LexerInitStream(0, 1);
+    ctx->pp = pp;
     return ctx;
 }
 
 void LexerEnd (LexerCTX* ctx)
 {
-    StreamEnd(ctx->stream);
+    if (ctx->stream) StreamEnd(ctx->stream);
+
     free(ctx->buffer);
     free(ctx);
 }
@@ -55,30 +93,48 @@ static void LexerSkipInsignificants (LexerCTX* ctx)
         switch (ctx->stream->current)
         {
             /*Whitespace*/
+            case '\n':
+                ctx->bol = 1;
+                //fall through
             case ' ':
             case '\t':
-            case '\n':
             case '\r':
+            case '\v':
+            case '\f':
+                StreamNext(ctx->stream);
+                ctx->space = 1;
+                break;
+
+            /*Line continuation*/
+            case '\\':
+                if (StreamPeek(ctx->stream) != '\n' && StreamPeek(ctx->stream) != '\r')
+                    return;
+
                 StreamNext(ctx->stream);
+
+                if (ctx->stream->current == '\r') StreamNext(ctx->stream);
+                if (ctx->stream->current == '\n') StreamNext(ctx->stream);
+
+                ctx->space = 1;
                 break;
 
-            /*C preprocessor is treated as a comment*/
+            /*Without a preprocessor, directives are treated as a comment*/
             case '#':
+                if (ctx->directives) return;
+
                 /*Eat until a new line*/
                 while (ctx->stream->current != '\n' && ctx->stream->current != 0)
                     StreamNext(ctx->stream);
 
-                StreamNext(ctx->stream);
                 break;
 
             /*Comment?*/
             case '/':
-                StreamNext(ctx->stream);
-
                 /*C comment*/
-                if (ctx->stream->current == '*')
+                if (StreamPeek(ctx->stream) == '*')
                 {
                     StreamNext(ctx->stream);
+                    StreamNext(ctx->stream);
 
                     do {
                         while (ctx->stream->current != '*' && ctx->stream->current != 0)
@@ -94,21 +150,19 @@ static void LexerSkipInsignificants (LexerCTX* ctx)
                     
                 /*C++ Comment*/
                 }
-                else if (ctx->stream->current == '/')
+                else if (StreamPeek(ctx->stream) == '/')
                 {
                     StreamNext(ctx->stream);
 
                     while (ctx->stream->current != '\n' && ctx->stream->current != '\r' && ctx->stream->current != 0)
                         StreamNext(ctx->stream);
 
-                /*Fuck, we just ate an important character. Backtrack!*/
+                /*Just a slash: the division operator*/
                 }
                 else
-                {
-                    StreamNext(ctx->stream);
                     return;
-                }
 
+                ctx->space = 1;
                 break;
 
         /*Not insignificant, leave*/
@@ -134,21 +188,12 @@ static void LexerPunct (LexerCTX* ctx)
         case '.':
             ctx->punct = PUNCT_PERIOD;
 
-            if (ctx->stream->current == '.')
+            /*Two dots are two periods: look ahead instead of backtracking*/
+            if (ctx->stream->current == '.' && StreamPeek(ctx->stream) == '.')
             {
                 LexerEatNext(ctx);
-
-                if (ctx->stream->current == '.')
-                {
-                    ctx->punct = PUNCT_ELLIPSIS;
-                    LexerEatNext(ctx);
-                /*Oops, it's just two dots, backtrack*/
-                }
-                else
-                {
-                    StreamPrev(ctx->stream);
-                    ctx->length--;
-                }
+                LexerEatNext(ctx);
+                ctx->punct = PUNCT_ELLIPSIS;
             }
 
             break;
@@ -158,16 +203,16 @@ static void LexerPunct (LexerCTX* ctx)
         case '=': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_EQ : PUNCT_ASSIGN; break;
         case '!': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_NEQ : PUNCT_NOT; break;
         case '>': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_GE 
-                                : LexerTryEatNext(ctx, '>') ? (LexerTryEatNext(ctx, '=') ? PUNCT_SHRASSIGN : PUNCT_SHR) : PUNCT_GE; break;
+                                : LexerTryEatNext(ctx, '>') ? (LexerTryEatNext(ctx, '=') ? PUNCT_SHRASSIGN : PUNCT_SHR) : PUNCT_GT; break;
         case '<': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_LE
-                                : LexerTryEatNext(ctx, '<') ? (LexerTryEatNext(ctx, '=') ? PUNCT_SHLASSIGN : PUNCT_SHL) : PUNCT_LE; break;
+                                : LexerTryEatNext(ctx, '<') ? (LexerTryEatNext(ctx, '=') ? PUNCT_SHLASSIGN : PUNCT_SHL) : PUNCT_LT; break;
 
         case '?': ctx->punct = PUNCT_QUESTION; break;
         case ':': ctx->punct = PUNCT_COLON; break;
 
         case '&': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_ANDASSIGN : LexerTryEatNext(ctx, '&') ? PUNCT_ANDAND : PUNCT_AND; break;
         case '|': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_ORASSIGN : LexerTryEatNext(ctx, '|') ? PUNCT_OROR : PUNCT_OR; break;
-        case '^': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_XORASSIGN : PUNCT_TILDE; break;
+        case '^': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_XORASSIGN : PUNCT_XOR; break;
         case '~': ctx->punct = PUNCT_TILDE; break;
 
         case '+': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_PLUSASSIGN : LexerTryEatNext(ctx, '+') ? PUNCT_PLUSPLUS : PUNCT_PLUS; break;
@@ -178,10 +223,42 @@ static void LexerPunct (LexerCTX* ctx)
         case '/': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_DIVASSIGN : PUNCT_DIV; break;
         case '%': ctx->punct = LexerTryEatNext(ctx, '=') ? PUNCT_MODASSIGN : PUNCT_MOD; break;
 
+        case '#': ctx->punct = LexerTryEatNext(ctx, '#') ? PUNCT_HASHHASH : PUNCT_HASH; break;
+
         default: ctx->token = TOK_OTHER;
     }
 }
 
+/*pp-number: цифры, буквы, точки и знак после e/E/p/P. Плавающей константой
+  его делает точка или показатель: e в десятичной, p в шестнадцатеричной*/
+static void LexerNumber (LexerCTX* ctx)
+{
+    int hex = ctx->stream->current == '0' && (StreamPeek(ctx->stream) == 'x' || StreamPeek(ctx->stream) == 'X');
+    int floating = 0;
+
+    while (1)
+    {
+        char c = ctx->stream->current;
+
+        if (c == 'e' || c == 'E' || c == 'p' || c == 'P')
+        {
+            floating |= hex ? c == 'p' || c == 'P' : c == 'e' || c == 'E';
+            LexerEatNext(ctx);
+
+            if (ctx->stream->current == '+' || ctx->stream->current == '-')
+                LexerEatNext(ctx);
+
+            continue;
+        }
+        else if (c == '.') floating = 1;
+        else if (!isalnum(c) && c != '_') break;
+
+        LexerEatNext(ctx);
+    }
+
+    ctx->token = floating ? TOK_FLOAT : TOK_INT;
+}
+
 static KEYWORD_TAG KeywordMatch (const char* str, int n, const char* look, KEYWORD_TAG kw)
 {
     return !strcmp(str + n + 1, look + n + 1) ? kw : KEYWORD_UNDEFINED;
@@ -194,28 +271,39 @@ static KEYWORD_TAG KeywordMatch2 (const char* str, int n, const char* look, KEYW
 
 static KEYWORD_TAG LookKeyword (const char* str, int length)
 {
-    int longest = strlen("immutable")+1;
+    int longest = strlen("__attribute__")+1;
 
     if (length > longest) return KEYWORD_UNDEFINED;
 
     switch (str[0])
     {
-        case 'd': return KeywordMatch(str, 0, "do", KEYWORD_DO);
-        case 'r': return KeywordMatch(str, 0, "return", KEYWORD_RETURN);
+        case 'd':
+            switch (str[1])
+            {
+                case 'o': return KeywordMatch2(str, 1, "do", KEYWORD_DO, "double", KEYWORD_DOUBLE);
+                case 'e': return KeywordMatch(str, 1, "default", KEYWORD_DEFAULT);
+                default: return KEYWORD_UNDEFINED;
+            }
+
+        case 'r': return KeywordMatch2(str, 0, "return", KEYWORD_RETURN, "register", KEYWORD_REGISTER);
         case 'w': return KeywordMatch(str, 0, "while", KEYWORD_WHILE);
 
         case 'a': return KeywordMatch(str, 0, "auto", KEYWORD_AUTO);
+        case '_': return KeywordMatch2(str, 0, "_Alignas", KEYWORD_ALIGN, "__attribute__", KEYWORD_ATTRIBUTE);
         case 'b': return KeywordMatch(str, 0, "break", KEYWORD_BREAK);
-        case 't': return KeywordMatch(str, 0, "typedef", KEYWORD_BREAK);
+        case 't': return KeywordMatch(str, 0, "typedef", KEYWORD_TYPEDEF);
+        case 'g': return KeywordMatch(str, 0, "goto", KEYWORD_GOTO);
+        case 'l': return KeywordMatch(str, 0, "long", KEYWORD_LONG);
         
         //case 'a': return keywordMatch2(str, 0, "assert", keywordAssert, "auto", keywordAuto);
         //case 'b': return keywordMatch2(str, 0, "bool", keywordBool, "break", keywordBreak);
         //case 't': return keywordMatch2(str, 0, "true", keywordTrue, "typedef", keywordTypedef);
-        case 'u': return KeywordMatch(str, 0, "union", KEYWORD_UNION);
+        case 'u': return KeywordMatch2(str, 0, "union", KEYWORD_UNION, "unsigned", KEYWORD_UNSIGNED);
 
         case 'c':
             switch (str[1])
             {
+                case 'a': return KeywordMatch(str, 1, "case", KEYWORD_CASE);
                 case 'h': return KeywordMatch(str, 1, "char", KEYWORD_CHAR);
                 case 'o':
                     if (str[2] != 'n') return KEYWORD_UNDEFINED;
@@ -234,14 +322,16 @@ static KEYWORD_TAG LookKeyword (const char* str, int length)
                 default: return KEYWORD_UNDEFINED;
             }
 
-        case 'f': return KeywordMatch(str, 0, "for", KEYWORD_FOR);
+        case 'f': return KeywordMatch2(str, 0, "for", KEYWORD_FOR, "float", KEYWORD_FLOAT);
         case 'i': return KeywordMatch2(str, 0, "if", KEYWORD_IF, "int", KEYWORD_INT);
 
         case 's':
             switch (str[1])
             {
-                case 'i': return KeywordMatch(str, 1, "sizeof", KEYWORD_SIZEOF);
+                case 'h': return KeywordMatch(str, 1, "short", KEYWORD_SHORT);
+                case 'i': return KeywordMatch2(str, 1, "sizeof", KEYWORD_SIZEOF, "signed", KEYWORD_SIGNED);
                 case 't': return KeywordMatch2(str, 1, "static", KEYWORD_STATIC, "struct", KEYWORD_STRUCT);
+                case 'w': return KeywordMatch(str, 1, "switch", KEYWORD_SWITCH);
                 default: return KEYWORD_UNDEFINED;
             }
 
@@ -270,10 +360,69 @@ static KEYWORD_TAG LookKeyword (const char* str, int length)
     }
 }
 
+//токен от препроцессора: текст копируется только в buffer
+static void LexerNextPP (LexerCTX* ctx)
+{
+    PPToken token;
+
+    ctx->length = 0;
+    ctx->keyword = KEYWORD_UNDEFINED;
+    ctx->punct = PUNCT_UNDEFINED;
+
+    if (!PPNext(ctx->pp, &token))
+    {
+        ctx->token = TOK_EOF;
+        ctx->text = "";
+        ctx->textLength = 0;
+        LexerEat(ctx, 0);
+        return;
+    }
+
+    ctx->token = token.tag;
+
+    if (token.tag == TOK_KEYWORD) ctx->keyword = token.sub;
+    else if (token.tag == TOK_PUNCT) ctx->punct = token.sub;
+
+    ctx->file = token.file;
+    ctx->line = token.line;
+    ctx->lineChar = token.lineChar;
+
+    ctx->text = token.text;
+    ctx->textLength = token.length;
+    ctx->bol = (token.flags & PPTOKEN_BOL) != 0;
+    ctx->space = (token.flags & PPTOKEN_SPACE) != 0;
+
+    /*в buffer у строк и символов нет кавычек, как и без препроцессора*/
+    const char* text = token.text;
+    int length = token.length;
+
+    if (token.tag == TOK_STR || token.tag == TOK_CHR)
+    {
+        text++;
+        length -= length >= 2 && text[length - 2] == text[-1] ? 2 : 1;
+    }
+
+    for (int i = 0; i < length; i++)
+        LexerEat(ctx, text[i]);
+
+    LexerEat(ctx, 0);
+}
+
 void LexerNext (LexerCTX* ctx)
 {
     if (ctx->token == TOK_EOF) return;
 
+    if (ctx->pp)
+    {
+        TimerEnter(TIMER_LEX, 0);
+        LexerNextPP(ctx);
+        TimerLeave();
+        return;
+    }
+
+    ctx->bol = ctx->token == TOK_UNDEFINED;
+    ctx->space = 0;
+
     LexerSkipInsignificants(ctx);
 
     ctx->line = ctx->stream->line;
@@ -282,6 +431,8 @@ void LexerNext (LexerCTX* ctx)
     ctx->length = 0;
     ctx->keyword = KEYWORD_UNDEFINED;
     ctx->punct = PUNCT_UNDEFINED;
+
+    int start = ctx->stream->pos;
     
     // конец потока
     if (ctx->stream->current == 0) ctx->token = TOK_EOF;
@@ -299,23 +450,22 @@ void LexerNext (LexerCTX* ctx)
         ctx->keyword = LookKeyword(ctx->buffer, ctx->length);
         ctx->token = ctx->keyword != KEYWORD_UNDEFINED ? TOK_KEYWORD : TOK_IDENT;
         
-    /*Number*/
+    /*Number, with suffixes, 0x and exponent as one pp-number; .5 too*/
     }
-    else if (isdigit(ctx->stream->current))
+    else if (isdigit(ctx->stream->current) || (ctx->stream->current == '.' && isdigit(StreamPeek(ctx->stream))))
     {
-        ctx->token = TOK_INT;
-
-        while (isdigit(ctx->stream->current))
-            LexerEatNext(ctx);
+        LexerNumber(ctx);
 
-    /*String/character*/
+    /*String/character, unterminated ones end at the end of the line*/
     }
     else if (ctx->stream->current == '"' || ctx->stream->current == '\'')
     {
-        ctx->token = ctx->stream->current == '"' ? TOK_STR : TOK_CHR;
+        char quote = ctx->stream->current;
+
+        ctx->token = quote == '"' ? TOK_STR : TOK_CHR;
         StreamNext(ctx->stream);
 
-        while (ctx->stream->current != (ctx->token == TOK_STR ? '"' : '\'') && ctx->stream->current != 0)
+        while (ctx->stream->current != quote && ctx->stream->current != '\n' && ctx->stream->current != 0)
         {
             if (ctx->stream->current == '\\')
                 LexerEatNext(ctx);
@@ -323,7 +473,8 @@ void LexerNext (LexerCTX* ctx)
             LexerEatNext(ctx);
         }
 
-        StreamNext(ctx->stream);
+        if (ctx->stream->current == quote)
+            StreamNext(ctx->stream);
 
     /*Punctuation or an unrecognised character*/
     }
@@ -336,4 +487,7 @@ void LexerNext (LexerCTX* ctx)
     }
 
     LexerEat(ctx, 0);
+
+    ctx->text = ctx->stream->text + start;
+    ctx->textLength = ctx->stream->pos - start;
 }
\ No newline at end of file
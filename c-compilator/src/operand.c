@@ -18,6 +18,7 @@ Operand OperandCreate (OPERAND_TAG tag)
     ret.label = 0;
     ret.array = 0;
     ret.size = 0;
+    ret.floating = 0;
     return ret;
 }
 
@@ -89,6 +90,13 @@ Operand OperandCreateLabelOffset (const char* label)
     return ret;
 }
 
+//то же место, но значение с плавающей точкой: пересылки movss/movsd
+Operand OperandAsFloat (Operand Value)
+{
+    Value.floating = 1;
+    return Value;
+}
+
 void OperandFree (Operand Value)
 {
     if (Value.tag == OPERAND_REG)
@@ -139,6 +147,12 @@ int OperandIsEqual (Operand L, Operand R)
     }
 }
 
+int OperandIsFloat (Operand Value)
+{
+    if (Value.tag == OPERAND_REG) return RegIsFloat((REG_INDEX) (Value.base - Regs));
+    else return Value.floating;
+}
+
 int OperandGetSize (const Arch* arch, Operand Value)
 {
     if (Value.tag == OPERAND_UNDEFINED || Value.tag == OPERAND_INVALID || Value.tag == OPERAND_VOID) return 0;
@@ -158,7 +172,7 @@ char* OperandToStr (Operand Value)
     else if (Value.tag == OPERAND_VOID) return strdup("<void>");
     else if (Value.tag == OPERAND_FLAGS)
     {
-        const char* conditions[7] = {"condition", "e", "ne", "g", "ge", "l", "le"};
+        const char* conditions[11] = {"condition", "e", "ne", "g", "ge", "l", "le", "a", "ae", "b", "be"};
         
         return strdup(conditions[Value.condition]);
     }
@@ -173,6 +187,7 @@ char* OperandToStr (Operand Value)
         else if (Value.size == 4) sizeStr = "dword";
         else if (Value.size == 8) sizeStr = "qword";
         else if (Value.size == 16) sizeStr = "oword";
+        else if (Value.size == 32) sizeStr = "ymmword";
         else sizeStr = "dword";
 
         if (Value.tag == OPERAND_LABELMEM)
@@ -280,5 +295,19 @@ CONDITION_TAG ConditionNegate (CONDITION_TAG cond)
     else if (cond == CONDITION_GE) return CONDITION_LT;
     else if (cond == CONDITION_LT) return CONDITION_GE;
     else if (cond == CONDITION_LE) return CONDITION_GT;
+    else if (cond == CONDITION_A) return CONDITION_BE;
+    else if (cond == CONDITION_AE) return CONDITION_B;
+    else if (cond == CONDITION_B) return CONDITION_AE;
+    else if (cond == CONDITION_BE) return CONDITION_A;
     else return CONDITION_UNDEFINED;
 }
+
+//условие для беззнакового сравнения или ucomiss/ucomisd
+CONDITION_TAG ConditionUnsigned (CONDITION_TAG cond)
+{
+    if (cond == CONDITION_GT) return CONDITION_A;
+    else if (cond == CONDITION_GE) return CONDITION_AE;
+    else if (cond == CONDITION_LT) return CONDITION_B;
+    else if (cond == CONDITION_LE) return CONDITION_BE;
+    else return cond;
+}
@@ -0,0 +1,731 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "..\include\parser.h"
+#include "..\include\parser-decl.h"
+#include "..\include\parser-value.h"
+#include "..\include\parser-token.h"
+#include "..\include\symbol.h"
+#include "..\include\error.h"
+#include "..\include\debug.h"
+#include "..\include\timer.h"
+
+enum {
+    PARSER_IdentLength = 128
+};
+
+static Ast* ParserDeclBasic (ParserCTX* ctx, MARKER_TAG* storage, int* isTypedef, Ast* Align);
+static Ast* ParserAlignAs (ParserCTX* ctx);
+static void ParserAttributes (ParserCTX* ctx, Ast* Align, int* packed);
+static Ast* ParserDeclUnary (ParserCTX* ctx, SYMBOL_TAG tag, int optional);
+static Ast* ParserStructUnion (ParserCTX* ctx);
+static Ast* ParserEnum (ParserCTX* ctx);
+static Ast* ParserFnImpl (ParserCTX* ctx, Ast* Decl, Ast* Call);
+static void ParserFnCode (ParserCTX* ctx, Ast* Node, Ast* Call);
+static Ast* ParserDeclFunction (Ast* Node);
+static Symbol* ParserFindToken (ParserCTX* ctx, int k);
+
+//начинается ли объявление: класс хранения, тип или имя typedef
+int ParserIsDecl (ParserCTX* ctx)
+{
+    const Token* token = TokenPeek(ctx, 0);
+
+    if (token->tag == TOK_KEYWORD)
+        switch (token->sub)
+        {
+            case KEYWORD_TYPEDEF:
+            case KEYWORD_EXTERN:
+            case KEYWORD_STATIC:
+            case KEYWORD_AUTO:
+            case KEYWORD_REGISTER:
+            case KEYWORD_ALIGN:
+                return 1;
+        }
+
+    return ParserIsTypeAt(ctx, 0);
+}
+
+//начинает ли k-й токен имя типа
+int ParserIsTypeAt (ParserCTX* ctx, int k)
+{
+    const Token* token = TokenPeek(ctx, k);
+
+    if (token->tag == TOK_KEYWORD)
+        return (token->sub >= KEYWORD_VOID && token->sub <= KEYWORD_UNSIGNED)
+               || token->sub == KEYWORD_CONST || token->sub == KEYWORD_STRUCT
+               || token->sub == KEYWORD_UNION || token->sub == KEYWORD_ENUM;
+
+    else if (token->tag == TOK_IDENT)
+    {
+        Symbol* Symbol = ParserFindToken(ctx, k);
+        return Symbol && Symbol->tag == SYMBOL_TYPEDEF;
+    }
+
+    return 0;
+}
+
+//объявление: спецификаторы, затем деклараторы через запятую; на уровне
+//модуля за первым декларатором функции может идти ее тело
+Ast* ParserDecl (ParserCTX* ctx, int module)
+{
+    DebugEnter("Decl");
+
+    TokenLocation loc = ctx->location;
+    MARKER_TAG storage = MARKER_UNDEFINED;
+    int isTypedef = 0;
+    Ast* Storage = AstCreateMarker(loc, MARKER_UNDEFINED);
+    Ast* Node = AstCreateDecl(loc, ParserDeclBasic(ctx, &storage, &isTypedef, Storage));
+    SYMBOL_TAG tag = isTypedef ? SYMBOL_TYPEDEF : SYMBOL_ID;
+
+    /*класс хранения; дети маркера - _Alignas*/
+    Storage->marker = storage;
+
+    if (storage != MARKER_UNDEFINED || Storage->children) Node->r = Storage;
+    else
+        AstDestroy(Storage);
+
+    if (!TokenIsPunct(ctx, PUNCT_SEMICOLON))
+    {
+        do
+        {
+            Ast* decl = ParserDeclUnary(ctx, tag, 0);
+            Ast* call = module && Node->children == 0 && !isTypedef ? ParserDeclFunction(decl) : 0;
+
+            if (call && TokenIsPunct(ctx, PUNCT_LBRACE))
+            {
+                AstAddChild(Node, decl);
+                DebugLeave();
+                return ParserFnImpl(ctx, Node, call);
+            }
+
+            if (TokenIsPunct(ctx, PUNCT_ASSIGN))
+            {
+                TokenLocation opLoc = ctx->location;
+                TokenMatch(ctx);
+                decl = AstCreateBOP(opLoc, decl, OP_ASSIGN, ParserInitializer(ctx));
+            }
+
+            AstAddChild(Node, decl);
+        } while (TokenTryMatchPunct(ctx, PUNCT_COMMA));
+    }
+
+    TokenMatchPunct(ctx, PUNCT_SEMICOLON);
+
+    DebugLeave();
+    return Node;
+}
+
+//имя типа для приведения и sizeof: декларатор без имени
+Ast* ParserType (ParserCTX* ctx)
+{
+    TokenLocation loc = ctx->location;
+    Ast* basic = ParserDeclBasic(ctx, 0, 0, 0);
+
+    return AstCreateType(loc, basic, ParserDeclUnary(ctx, SYMBOL_UNDEFINED, 1));
+}
+
+//отложенное тело функции: разбор с запомненного токена, затем возврат
+//на прежнее место. Имена модуля, объявленные после функции, на это время
+//снимаются с модуля, как будто тело разбирается на своем месте
+Ast* ParserFnBody (ParserCTX* ctx, Ast* Impl)
+{
+    if (Impl->r) return Impl->r;
+
+    DebugEnter("FnBody");
+
+    int pos = ctx->tokens.pos, line = ctx->tokens.line, panic = ctx->panic;
+    Vector later;
+    VectorInit(&later, 8);
+
+    while (ctx->module->children.length > Impl->bodyScope)
+        VectorPush(&later, VectorPop(&ctx->module->children));
+
+    TokenSeek(ctx, Impl->bodyToken, Impl->bodyLine);
+    ctx->panic = 0;
+
+    ParserFnCode(ctx, Impl, ParserDeclFunction(Impl->l->firstChild));
+
+    TokenSeek(ctx, pos, line);
+    ctx->panic = panic;
+
+    /*созданные при разборе тела имена модуля встают перед скрытыми*/
+    while (later.length)
+    {
+        Symbol* Symbol = VectorPop(&later);
+        Symbol->nthChild = VectorPush(&ctx->module->children, Symbol);
+    }
+
+    VectorFree(&later);
+
+    DebugLeave();
+    return Impl->r;
+}
+
+//внутренние функции
+static Symbol* ParserFindToken (ParserCTX* ctx, int k)
+{
+    const Token* token = TokenPeek(ctx, k);
+    char ident[PARSER_IdentLength];
+
+    if (token->length >= PARSER_IdentLength)
+    {
+        char* str = TokenBufferDup(&ctx->tokens, token);
+        Symbol* Found = SymbolFindNs(ctx->scope, str, SYMBOL_NS_ORDINARY);
+
+        free(str);
+        return Found;
+    }
+
+    memcpy(ident, TokenBufferText(&ctx->tokens, token), token->length);
+    ident[token->length] = 0;
+    return SymbolFindNs(ctx->scope, ident, SYMBOL_NS_ORDINARY);
+}
+
+//объявление имени в текущей области; повторное объявление в области
+//модуля (прототипы, extern) дает тот же символ
+static Symbol* ParserDeclareIdent (ParserCTX* ctx, SYMBOL_TAG tag, Ast* Atom)
+{
+    const char* ident = Atom->literal;
+    Symbol* Symbol = SymbolChildNs(ctx->scope, ident, SYMBOL_NS_ORDINARY);
+
+    if (!Symbol || Symbol->tag != tag || ctx->scope != ctx->module || (tag != SYMBOL_ID && tag != SYMBOL_TYPEDEF))
+    {
+        if (Symbol) ErrorParser(ctx, "повторное объявление '$h'", ident);
+
+        Symbol = SymbolCreateNamed(tag, ctx->scope, ident);
+    }
+
+    VectorPush(&Symbol->decls, Atom);
+    Atom->symbol = Symbol;
+    return Symbol;
+}
+
+//тег struct/union/enum: с телом - в текущей области, без тела - ссылка на
+//видимый тег или его предварительное объявление
+static Symbol* ParserDeclareTag (ParserCTX* ctx, SYMBOL_TAG tag, Ast* Name, int isImpl)
+{
+    if (!Name) return SymbolCreateNamed(tag, ctx->scope, "");
+
+    const char* ident = Name->literal;
+    Symbol* Symbol = isImpl ? SymbolChildNs(ctx->scope, ident, SYMBOL_NS_TAG)
+                            : SymbolFindNs(ctx->scope, ident, SYMBOL_NS_TAG);
+
+    if (Symbol && Symbol->tag != tag)
+    {
+        ErrorParser(ctx, "'$h' объявлен как тег другого вида", ident);
+        Symbol = 0;
+    }
+    else if (Symbol && isImpl && (Symbol->impl || Symbol->complete))
+    {
+        ErrorParser(ctx, "повторное определение '$h'", ident);
+        Symbol = 0;
+    }
+
+    if (!Symbol) Symbol = SymbolCreateNamed(tag, ctx->scope, ident);
+
+    Name->symbol = Symbol;
+    return Symbol;
+}
+
+//встроенный тип по набору ключевых слов; long double считается double
+static const char* ParserBuiltinName (ParserCTX* ctx, const int* n)
+{
+    int kinds = !!n[KEYWORD_VOID] + !!n[KEYWORD_CHAR] + !!n[KEYWORD_SHORT] + !!n[KEYWORD_FLOAT] + !!n[KEYWORD_DOUBLE]
+                + (!!n[KEYWORD_LONG] && !n[KEYWORD_DOUBLE]);
+    int sign = n[KEYWORD_SIGNED] + n[KEYWORD_UNSIGNED];
+    int noInt = n[KEYWORD_VOID] || n[KEYWORD_FLOAT] || n[KEYWORD_DOUBLE] || n[KEYWORD_CHAR];
+
+    if (kinds > 1 || sign > 1 || n[KEYWORD_LONG] > 2 || n[KEYWORD_INT] > 1 || n[KEYWORD_SHORT] > 1
+        || (noInt && n[KEYWORD_INT]) || ((n[KEYWORD_VOID] || n[KEYWORD_FLOAT] || n[KEYWORD_DOUBLE]) && sign))
+        ErrorParser(ctx, "неверное сочетание спецификаторов типа");
+
+    int isUnsigned = n[KEYWORD_UNSIGNED] > 0;
+
+    if (n[KEYWORD_VOID]) return "void";
+    else if (n[KEYWORD_FLOAT]) return "float";
+    else if (n[KEYWORD_DOUBLE]) return "double";
+    else if (n[KEYWORD_CHAR]) return isUnsigned ? "unsigned char" : "char";
+    else if (n[KEYWORD_SHORT]) return isUnsigned ? "unsigned short" : "short";
+    else if (n[KEYWORD_LONG] > 1) return isUnsigned ? "unsigned long long" : "long long";
+    else if (n[KEYWORD_LONG]) return isUnsigned ? "unsigned long" : "long";
+    else
+        return isUnsigned ? "unsigned int" : "int";
+}
+
+//спецификаторы объявления; storage == 0 - класс хранения не допускается,
+//Align == 0 - _Alignas не допускается, иначе они добавляются детьми Align
+static Ast* ParserDeclBasic (ParserCTX* ctx, MARKER_TAG* storage, int* isTypedef, Ast* Align)
+{
+    TokenLocation loc = ctx->location;
+    int n[KEYWORD_SIZEOF] = {0};
+    int builtin = 0, isConst = 0;
+    Ast* Node = 0;
+
+    for (;;)
+    {
+        const Token* token = TokenPeek(ctx, 0);
+        KEYWORD_TAG keyword = token->tag == TOK_KEYWORD ? token->sub : KEYWORD_UNDEFINED;
+
+        if (keyword == KEYWORD_REGISTER) TokenMatch(ctx);
+        else if (keyword == KEYWORD_TYPEDEF || keyword == KEYWORD_EXTERN || keyword == KEYWORD_STATIC || keyword == KEYWORD_AUTO)
+        {
+            if (!storage) ErrorParser(ctx, "класс хранения здесь недопустим");
+            else if (*storage != MARKER_UNDEFINED || *isTypedef) ErrorParser(ctx, "несколько классов хранения");
+            else if (keyword == KEYWORD_TYPEDEF) *isTypedef = 1;
+            else
+                *storage = keyword == KEYWORD_STATIC ? MARKER_STATIC : keyword == KEYWORD_EXTERN ? MARKER_EXTERN : MARKER_AUTO;
+
+            TokenMatch(ctx);
+        }
+        else if (keyword == KEYWORD_CONST)
+        {
+            isConst = 1;
+            TokenMatch(ctx);
+        }
+        else if (keyword == KEYWORD_ALIGN)
+        {
+            if (!Align) ErrorParser(ctx, "_Alignas здесь недопустим");
+
+            Ast* Spec = ParserAlignAs(ctx);
+
+            if (Align) AstAddChild(Align, Spec);
+            else
+                AstDestroy(Spec);
+        }
+        else if (keyword >= KEYWORD_VOID && keyword <= KEYWORD_UNSIGNED)
+        {
+            n[keyword]++;
+            builtin = 1;
+            TokenMatch(ctx);
+        }
+        else if (keyword == KEYWORD_STRUCT || keyword == KEYWORD_UNION || keyword == KEYWORD_ENUM)
+        {
+            if (Node || builtin) ErrorParser(ctx, "неверное сочетание спецификаторов типа");
+
+            Ast* Tagged = keyword == KEYWORD_ENUM ? ParserEnum(ctx) : ParserStructUnion(ctx);
+
+            if (Node) AstDestroy(Tagged);
+            else
+                Node = Tagged;
+        }
+        /*имя typedef - только пока тип еще не назван*/
+        else if (token->tag == TOK_IDENT && !Node && !builtin && ParserIsTypeAt(ctx, 0))
+        {
+            Node = AstCreateLiteralIdent(ctx->location, TokenBufferDup(&ctx->tokens, token));
+            Node->symbol = ParserFindToken(ctx, 0);
+            TokenMatch(ctx);
+        }
+        else
+            break;
+    }
+
+    if (builtin && !Node)
+    {
+        const char* name = ParserBuiltinName(ctx, n);
+
+        Node = AstCreateLiteralIdent(loc, strdup(name));
+        Node->symbol = SymbolFindNs(ctx->scope, name, SYMBOL_NS_ANY);
+
+        if (!Node->symbol) DebugError("ParserDeclBasic", "нет встроенного типа %s", name);
+    }
+    else if (builtin)
+        ErrorParser(ctx, "неверное сочетание спецификаторов типа");
+
+    if (!Node)
+    {
+        ErrorExpected(ctx, "тип");
+        Node = AstCreateInvalid(loc);
+    }
+
+    return isConst ? AstCreateConst(loc, Node) : Node;
+}
+
+//_Alignas (тип) или _Alignas (константа)
+static Ast* ParserAlignAs (ParserCTX* ctx)
+{
+    TokenMatch(ctx);
+    TokenMatchPunct(ctx, PUNCT_LPAREN);
+
+    Ast* Node = ParserIsTypeAt(ctx, 0) ? ParserType(ctx) : ParserAssignValue(ctx);
+
+    TokenMatchPunct(ctx, PUNCT_RPAREN);
+    return Node;
+}
+
+static int ParserIsAttribute (const char* text, int length, const char* name)
+{
+    int nameLength = strlen(name);
+
+    /*packed и __packed__ - одно и то же*/
+    if (length == nameLength + 4 && !strncmp(text, "__", 2) && !strncmp(text + length - 2, "__", 2))
+    {
+        text += 2;
+        length -= 4;
+    }
+
+    return length == nameLength && !strncmp(text, name, length);
+}
+
+//__attribute__((...)): packed и aligned(n); aligned без аргумента - в Align
+//пустым узлом, незнакомые атрибуты пропускаются вместе с аргументами
+static void ParserAttributes (ParserCTX* ctx, Ast* Align, int* packed)
+{
+    while (TokenTryMatchKeyword(ctx, KEYWORD_ATTRIBUTE))
+    {
+        TokenMatchPunct(ctx, PUNCT_LPAREN);
+        TokenMatchPunct(ctx, PUNCT_LPAREN);
+
+        while (TokenIsIdent(ctx))
+        {
+            TokenLocation loc = ctx->location;
+            int length;
+            const char* text = TokenText(ctx, &length);
+            int isAligned = ParserIsAttribute(text, length, "aligned");
+
+            if (ParserIsAttribute(text, length, "packed")) *packed = 1;
+
+            TokenMatch(ctx);
+
+            if (isAligned && TokenTryMatchPunct(ctx, PUNCT_LPAREN))
+            {
+                AstAddChild(Align, ParserAssignValue(ctx));
+                TokenMatchPunct(ctx, PUNCT_RPAREN);
+            }
+            else if (isAligned)
+                AstAddChild(Align, AstCreateEmpty(loc));
+
+            else if (TokenTryMatchPunct(ctx, PUNCT_LPAREN))
+            {
+                for (int depth = 1; depth && !TokenIsEOF(ctx); TokenMatch(ctx))
+                {
+                    if (TokenIsPunct(ctx, PUNCT_LPAREN)) depth++;
+                    else if (TokenIsPunct(ctx, PUNCT_RPAREN)) depth--;
+                }
+            }
+
+            if (!TokenTryMatchPunct(ctx, PUNCT_COMMA)) break;
+        }
+
+        TokenMatchPunct(ctx, PUNCT_RPAREN);
+        TokenMatchPunct(ctx, PUNCT_RPAREN);
+    }
+}
+
+static Ast* ParserParam (ParserCTX* ctx)
+{
+    TokenLocation loc = ctx->location;
+    Ast* basic = ParserDeclBasic(ctx, 0, 0, 0);
+
+    return AstCreateParam(loc, basic, ParserDeclUnary(ctx, SYMBOL_PARAM, 1));
+}
+
+//список параметров; у объявляемой функции параметры - дети ее символа,
+//если их там еще нет, иначе (повторное объявление, указатели на функции)
+//- своя анонимная область, записанная в AST_CALL
+static Ast* ParserDeclParams (ParserCTX* ctx, Ast* Node)
+{
+    Ast* Call = AstCreateCall(ctx->location, Node);
+    Symbol* fn = Node->tag == AST_LITERAL ? Node->symbol : 0;
+
+    TokenMatch(ctx);
+
+    Call->symbol = fn && fn->tag == SYMBOL_ID && !SymbolGetNthParam(fn, 0)
+                   ? fn : SymbolCreateScope(ctx->scope);
+
+    Symbol* old = ctx->scope;
+    ctx->scope = Call->symbol;
+
+    /*(void) - без параметров*/
+    if (TokenIsKeyword(ctx, KEYWORD_VOID) && TokenPeekIsPunct(ctx, 1, PUNCT_RPAREN))
+        TokenMatch(ctx);
+
+    else if (!TokenIsPunct(ctx, PUNCT_RPAREN))
+    {
+        do
+        {
+            if (TokenIsPunct(ctx, PUNCT_ELLIPSIS))
+            {
+                AstAddChild(Call, AstCreate(AST_ELLIPSIS, ctx->location));
+                TokenMatch(ctx);
+                break;
+            }
+
+            AstAddChild(Call, ParserParam(ctx));
+        } while (TokenTryMatchPunct(ctx, PUNCT_COMMA));
+    }
+
+    ctx->scope = old;
+    TokenMatchPunct(ctx, PUNCT_RPAREN);
+    return Call;
+}
+
+//'(' после начала декларатора: группировка, а не параметры
+static int ParserIsGrouping (ParserCTX* ctx, SYMBOL_TAG tag)
+{
+    const Token* next = TokenPeek(ctx, 1);
+
+    if (next->tag == TOK_PUNCT) return next->sub == PUNCT_MUL || next->sub == PUNCT_LPAREN;
+    else if (next->tag == TOK_IDENT) return tag != SYMBOL_UNDEFINED && !ParserIsTypeAt(ctx, 1);
+    else
+        return 0;
+}
+
+//имя или группировка, затем суффиксы [] и ()
+static Ast* ParserDeclObject (ParserCTX* ctx, SYMBOL_TAG tag, int optional)
+{
+    TokenLocation loc = ctx->location;
+    Ast* Node;
+
+    if (TokenIsPunct(ctx, PUNCT_LPAREN) && ParserIsGrouping(ctx, tag))
+    {
+        TokenMatch(ctx);
+        Node = ParserDeclUnary(ctx, tag, optional);
+        TokenMatchPunct(ctx, PUNCT_RPAREN);
+    }
+    else if (TokenIsIdent(ctx) && tag != SYMBOL_UNDEFINED)
+    {
+        Node = AstCreateLiteralIdent(loc, TokenDupMatch(ctx));
+        ParserDeclareIdent(ctx, tag, Node);
+    }
+    else if (optional)
+        Node = AstCreateEmpty(loc);
+    else
+    {
+        ErrorExpected(ctx, "имя");
+        Node = AstCreateInvalid(loc);
+    }
+
+    for (;;)
+    {
+        loc = ctx->location;
+
+        if (TokenTryMatchPunct(ctx, PUNCT_LBRACKET))
+        {
+            Ast* size = TokenIsPunct(ctx, PUNCT_RBRACKET) ? AstCreateEmpty(ctx->location) : ParserAssignValue(ctx);
+
+            Node = AstCreateIndex(loc, Node, size);
+            TokenMatchPunct(ctx, PUNCT_RBRACKET);
+        }
+        else if (TokenIsPunct(ctx, PUNCT_LPAREN))
+            Node = ParserDeclParams(ctx, Node);
+        else
+            return Node;
+    }
+}
+
+//декларатор: указатели (const после '*' относится к самому указателю)
+static Ast* ParserDeclUnary (ParserCTX* ctx, SYMBOL_TAG tag, int optional)
+{
+    if (TokenIsPunct(ctx, PUNCT_MUL))
+    {
+        TokenLocation loc = ctx->location;
+        int isConst = 0;
+
+        TokenMatch(ctx);
+
+        while (TokenTryMatchKeyword(ctx, KEYWORD_CONST))
+            isConst = 1;
+
+        Ast* r = ParserDeclUnary(ctx, tag, optional);
+        return AstCreateUOP(loc, OP_DEREF, isConst ? AstCreateConst(loc, r) : r);
+    }
+
+    return ParserDeclObject(ctx, tag, optional);
+}
+
+//AST_CALL, если декларатор объявляет функцию, иначе 0
+static Ast* ParserDeclFunction (Ast* Node)
+{
+    for (;;)
+    {
+        if (Node->tag == AST_UOP || Node->tag == AST_CONST) Node = Node->r;
+        else if (Node->tag == AST_INDEX) Node = Node->l;
+        else if (Node->tag == AST_CALL)
+        {
+            if (Node->l->tag == AST_LITERAL) return Node;
+
+            Node = Node->l;
+        }
+        else
+            return 0;
+    }
+}
+
+//тело видит параметры именно этого определения
+static void ParserFnCode (ParserCTX* ctx, Ast* Node, Ast* Call)
+{
+    TimerEnterFn(TIMER_PARSE, Node->symbol ? Node->symbol->ident : 0);
+
+    Symbol* old = ctx->scope;
+    ctx->scope = Call->symbol;
+    Node->r = ParserCode(ctx);
+    ctx->scope = old;
+
+    TimerLeave();
+}
+
+static Ast* ParserFnImpl (ParserCTX* ctx, Ast* Decl, Ast* Call)
+{
+    DebugEnter("FnImpl");
+
+    Ast* Node = AstCreateFnImpl(Decl->location, Decl);
+    Symbol* fn = Call->l->symbol;
+
+    Node->symbol = fn;
+
+    if (fn->impl) ErrorParser(ctx, "повторное определение функции '$h'", fn->ident);
+    else
+        fn->impl = Node;
+
+    /*ленивый разбор: запоминается только начало тела*/
+    if (ctx->lazy)
+    {
+        Node->bodyToken = ctx->tokens.pos;
+        Node->bodyLine = ctx->tokens.line;
+        Node->bodyScope = ctx->module->children.length;
+        TokenSkipBlock(ctx);
+    }
+    else
+        ParserFnCode(ctx, Node, Call);
+
+    DebugLeave();
+    return Node;
+}
+
+static Ast* ParserField (ParserCTX* ctx)
+{
+    TokenLocation loc = ctx->location;
+    Ast* Align = AstCreateMarker(loc, MARKER_UNDEFINED);
+    Ast* Node = AstCreateDecl(loc, ParserDeclBasic(ctx, 0, 0, Align));
+
+    if (Align->children) Node->r = Align;
+    else
+        AstDestroy(Align);
+
+    if (!TokenIsPunct(ctx, PUNCT_SEMICOLON))
+        do
+        {
+            AstAddChild(Node, ParserDeclUnary(ctx, SYMBOL_ID, 0));
+        } while (TokenTryMatchPunct(ctx, PUNCT_COMMA));
+
+    TokenMatchPunct(ctx, PUNCT_SEMICOLON);
+    return Node;
+}
+
+//поля - дети символа struct/union; анонимные вложенные struct/union
+//тоже, с пустым именем, и их поля находит SymbolChild; атрибуты - после
+//ключевого слова или после тела, aligned попадает в r маркером
+static Ast* ParserStructUnion (ParserCTX* ctx)
+{
+    DebugEnter("StructUnion");
+
+    TokenLocation loc = ctx->location;
+    int isStruct = TokenIsKeyword(ctx, KEYWORD_STRUCT);
+    Ast* Name = 0;
+    Ast* Align = AstCreateMarker(loc, MARKER_UNDEFINED);
+    int packed = 0;
+
+    TokenMatch(ctx);
+    ParserAttributes(ctx, Align, &packed);
+
+    if (TokenIsIdent(ctx))
+    {
+        Name = AstCreateLiteralIdent(ctx->location, 0);
+        Name->literal = TokenDupMatch(ctx);
+    }
+
+    Ast* Node = isStruct ? AstCreateStruct(loc, Name) : AstCreateUnion(loc, Name);
+    int isImpl = TokenIsPunct(ctx, PUNCT_LBRACE);
+
+    Node->symbol = ParserDeclareTag(ctx, isStruct ? SYMBOL_STRUCT : SYMBOL_UNION, Name, isImpl);
+
+    if (!Name && !isImpl) ErrorExpected(ctx, "имя или тело");
+
+    if (isImpl)
+    {
+        Node->symbol->impl = Node;
+        TokenMatch(ctx);
+
+        Symbol* old = ctx->scope;
+        ctx->scope = Node->symbol;
+
+        while (!TokenIsPunct(ctx, PUNCT_RBRACE) && !TokenIsEOF(ctx))
+        {
+            AstAddChild(Node, ParserField(ctx));
+
+            if (ctx->panic) TokenSkipStatement(ctx);
+        }
+
+        ctx->scope = old;
+        TokenMatchPunct(ctx, PUNCT_RBRACE);
+        ParserAttributes(ctx, Align, &packed);
+
+        Node->symbol->packed = packed;
+    }
+
+    /*у ссылки на тег атрибуты ни на что не влияют*/
+    if (isImpl && Align->children) Node->r = Align;
+    else
+        AstDestroy(Align);
+
+    DebugLeave();
+    return Node;
+}
+
+//константы перечисления видны в окружающей области, как в C
+static Ast* ParserEnum (ParserCTX* ctx)
+{
+    DebugEnter("Enum");
+
+    TokenLocation loc = ctx->location;
+    Ast* Name = 0;
+
+    TokenMatch(ctx);
+
+    if (TokenIsIdent(ctx))
+    {
+        Name = AstCreateLiteralIdent(ctx->location, 0);
+        Name->literal = TokenDupMatch(ctx);
+    }
+
+    Ast* Node = AstCreateEnum(loc, Name);
+    int isImpl = TokenIsPunct(ctx, PUNCT_LBRACE);
+
+    Node->symbol = ParserDeclareTag(ctx, SYMBOL_ENUM, Name, isImpl);
+
+    if (!Name && !isImpl) ErrorExpected(ctx, "имя или тело");
+
+    if (isImpl)
+    {
+        Node->symbol->impl = Node;
+        TokenMatch(ctx);
+
+        /*после последней константы допускается запятая*/
+        while (!TokenIsPunct(ctx, PUNCT_RBRACE))
+        {
+            TokenLocation constLoc = ctx->location;
+            char* ident = TokenMatchIdent(ctx);
+
+            if (!ident) break;
+
+            Ast* Const = AstCreateLiteralIdent(constLoc, ident);
+            ParserDeclareIdent(ctx, SYMBOL_ENUMCONSTANT, Const);
+
+            if (TokenIsPunct(ctx, PUNCT_ASSIGN))
+            {
+                TokenLocation opLoc = ctx->location;
+                TokenMatch(ctx);
+                Const = AstCreateBOP(opLoc, Const, OP_ASSIGN, ParserAssignValue(ctx));
+            }
+
+            AstAddChild(Node, Const);
+
+            if (!TokenTryMatchPunct(ctx, PUNCT_COMMA)) break;
+        }
+
+        TokenMatchPunct(ctx, PUNCT_RBRACE);
+    }
+
+    DebugLeave();
+    return Node;
+}
@@ -2,63 +2,208 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "..\include\parser-internal.h"
-#include "..\include\tokens.h"
+#include "..\include\parser-token.h"
 #include "..\include\debug.h"
 #include "..\include\error.h"
+#include "..\include\util.h"
 
-int TokenIsKeyword (const ParserCTX* ctx, KEYWORD_TAG keyword)
+//k-й токен после текущего
+const Token* TokenPeek (ParserCTX* ctx, int k)
 {
-    return ctx->lexer->keyword == keyword;
+    return TokenBufferPeek(&ctx->tokens, k);
 }
 
-int TokenIsPunct (const ParserCTX* ctx, PUNCT_TAG punct)
+int TokenPeekIsPunct (ParserCTX* ctx, int k, PUNCT_TAG punct)
 {
-    return ctx->lexer->punct == punct;
+    const Token* token = TokenPeek(ctx, k);
+    return token->tag == TOK_PUNCT && token->sub == punct;
 }
 
-int TokenIsIdent (const ParserCTX* ctx)
+int TokenIsKeyword (ParserCTX* ctx, KEYWORD_TAG keyword)
 {
-    return ctx->lexer->token == TOK_IDENT;
+    const Token* token = TokenPeek(ctx, 0);
+    return token->tag == TOK_KEYWORD && token->sub == keyword;
 }
 
-int TokenIsInt (const ParserCTX* ctx)
+int TokenIsPunct (ParserCTX* ctx, PUNCT_TAG punct)
 {
-    return ctx->lexer->token == TOK_INT;
+    return TokenPeekIsPunct(ctx, 0, punct);
 }
 
-int TokenIsString (const ParserCTX* ctx)
+int TokenIsIdent (ParserCTX* ctx)
 {
-    return ctx->lexer->token == TOK_STR;
+    return TokenPeek(ctx, 0)->tag == TOK_IDENT;
 }
 
-int TokenIsChar (const ParserCTX* ctx)
+int TokenIsInt (ParserCTX* ctx)
 {
-    return ctx->lexer->token == TOK_CHR;
+    return TokenPeek(ctx, 0)->tag == TOK_INT;
+}
+
+int TokenIsFloat (ParserCTX* ctx)
+{
+    return TokenPeek(ctx, 0)->tag == TOK_FLOAT;
+}
+
+int TokenIsString (ParserCTX* ctx)
+{
+    return TokenPeek(ctx, 0)->tag == TOK_STR;
+}
+
+int TokenIsChar (ParserCTX* ctx)
+{
+    return TokenPeek(ctx, 0)->tag == TOK_CHR;
+}
+
+int TokenIsEOF (ParserCTX* ctx)
+{
+    return TokenPeek(ctx, 0)->tag == TOK_EOF;
 }
 
 void TokenNext (ParserCTX* ctx)
 {
-    LexerNext(ctx->lexer);
-    ctx->location = (TokenLocation) {ctx->filename,
-                                     ctx->lexer->line,
-                                     ctx->lexer->lineChar};
+    TokenBufferNext(&ctx->tokens);
+    ctx->location = (TokenLocation) {ctx->tokens.file,
+                                     ctx->tokens.line,
+                                     TokenPeek(ctx, 0)->lineChar};
 }
 
 void TokenMatch (ParserCTX* ctx)
 {
-    DebugMsg("совпадение:%d:%d: '%s'", ctx->location.line, ctx->location.lineChar, ctx->lexer->buffer);
+    const Token* token = TokenPeek(ctx, 0);
+
+    DebugMsg("совпадение:%d:%d: '%.*s'", ctx->location.line, ctx->location.lineChar, token->length, TokenBufferText(&ctx->tokens, token));
     TokenNext(ctx);
 }
 
+//текст токена прямо в исходном буфере, без копирования
+const char* TokenText (ParserCTX* ctx, int* length)
+{
+    const Token* token = TokenPeek(ctx, 0);
+
+    *length = token->length;
+    return TokenBufferText(&ctx->tokens, token);
+}
+
 char* TokenDupMatch (ParserCTX* ctx)
 {
-    char* old = strdup(ctx->lexer->buffer);
+    char* old = TokenBufferDup(&ctx->tokens, TokenPeek(ctx, 0));
 
     TokenMatch(ctx);
     return old;
 }
 
+static const char* PunctTagGetStr (PUNCT_TAG punct)
+{
+    static const char* str[] = {
+        [PUNCT_LBRACE] = "'{'", [PUNCT_RBRACE] = "'}'",
+        [PUNCT_LPAREN] = "'('", [PUNCT_RPAREN] = "')'",
+        [PUNCT_LBRACKET] = "'['", [PUNCT_RBRACKET] = "']'",
+        [PUNCT_SEMICOLON] = "';'", [PUNCT_COMMA] = "','",
+        [PUNCT_COLON] = "':'", [PUNCT_ASSIGN] = "'='"
+    };
+
+    return punct < sizeof(str)/sizeof(*str) && str[punct] ? str[punct] : "знак пунктуации";
+}
+
+void TokenMatchPunct (ParserCTX* ctx, PUNCT_TAG punct)
+{
+    if (TokenIsPunct(ctx, punct))
+    {
+        TokenMatch(ctx);
+
+        /*поток снова синхронизирован*/
+        if (punct == PUNCT_SEMICOLON || punct == PUNCT_RBRACE) ctx->panic = 0;
+    }
+    else
+        ErrorExpected(ctx, PunctTagGetStr(punct));
+}
+
+void TokenMatchKeyword (ParserCTX* ctx, KEYWORD_TAG keyword)
+{
+    if (TokenIsKeyword(ctx, keyword)) TokenMatch(ctx);
+    else
+        ErrorExpected(ctx, "ключевое слово");
+}
+
+//имя или 0, если на месте имени что-то другое
+char* TokenMatchIdent (ParserCTX* ctx)
+{
+    if (TokenIsIdent(ctx)) return TokenDupMatch(ctx);
+
+    ErrorExpected(ctx, "идентификатор");
+    return 0;
+}
+
+int TokenTryMatchPunct (ParserCTX* ctx, PUNCT_TAG punct)
+{
+    if (!TokenIsPunct(ctx, punct)) return 0;
+
+    TokenMatchPunct(ctx, punct);
+    return 1;
+}
+
+int TokenTryMatchKeyword (ParserCTX* ctx, KEYWORD_TAG keyword)
+{
+    if (!TokenIsKeyword(ctx, keyword)) return 0;
+
+    TokenMatch(ctx);
+    return 1;
+}
+
+//восстановление после ошибки: пропуск до конца оператора - за ';' или
+//за закрытый блок, но не дальше '}' внешнего блока
+void TokenSkipStatement (ParserCTX* ctx)
+{
+    int depth = 0;
+
+    while (!TokenIsEOF(ctx))
+    {
+        if (TokenIsPunct(ctx, PUNCT_LBRACE)) depth++;
+        else if (TokenIsPunct(ctx, PUNCT_RBRACE))
+        {
+            if (depth == 0) break;
+            else if (--depth == 0)
+            {
+                TokenMatch(ctx);
+                break;
+            }
+        }
+        else if (TokenIsPunct(ctx, PUNCT_SEMICOLON) && depth == 0)
+        {
+            TokenMatch(ctx);
+            break;
+        }
+
+        TokenMatch(ctx);
+    }
+
+    ctx->panic = 0;
+}
+
+//блок в фигурных скобках целиком, без разбора; незакрытый - до конца файла
+void TokenSkipBlock (ParserCTX* ctx)
+{
+    int depth = 0;
+
+    do
+    {
+        if (TokenIsPunct(ctx, PUNCT_LBRACE)) depth++;
+        else if (TokenIsPunct(ctx, PUNCT_RBRACE)) depth--;
+
+        TokenNext(ctx);
+    } while (depth > 0 && !TokenIsEOF(ctx));
+}
+
+//перейти к ранее пройденному токену
+void TokenSeek (ParserCTX* ctx, int pos, int line)
+{
+    TokenBufferSeek(&ctx->tokens, pos, line);
+    ctx->location = (TokenLocation) {ctx->tokens.file,
+                                     ctx->tokens.line,
+                                     TokenPeek(ctx, 0)->lineChar};
+}
+
 static char* TokenTagGetStr (TOKEN_TAG tag)
 {
     if (tag == TOK_UNDEFINED) return "<undefined>";
@@ -67,10 +212,11 @@ static char* TokenTagGetStr (TOKEN_TAG tag)
     else if (tag == TOK_KEYWORD) return "keyword";
     else if (tag == TOK_IDENT) return "identifier";
     else if (tag == TOK_INT) return "integer";
+    else if (tag == TOK_FLOAT) return "floating";
     else if (tag == TOK_STR) return "string";
     else if (tag == TOK_CHR) return "character";
     else {
-        char* str = malloc(logi(tag, 10)+2);
+        char* str = malloc(LogI(tag, 10)+2);
         sprintf(str, "%d", tag);
         DebugErrorUnhandled("tokenTagGetStr", "token tag", str);
         free(str);
@@ -0,0 +1,484 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "..\include\parser-value.h"
+#include "..\include\parser-decl.h"
+#include "..\include\parser-token.h"
+#include "..\include\symbol.h"
+#include "..\include\error.h"
+
+//бинарный оператор: тег и приоритет, чем больше - тем крепче связывает
+typedef struct ParserOp {
+    OP_TAG o;
+    int prec;
+} ParserOp;
+
+enum {
+    PARSER_PrecLowest = 1,      //||
+    PARSER_NumberLength = 64
+};
+
+static const ParserOp ParserBinaryOps[] = {
+    [PUNCT_OROR] = {OP_OROR, 1},
+    [PUNCT_ANDAND] = {OP_ANDAND, 2},
+    [PUNCT_OR] = {OP_OR, 3},
+    [PUNCT_XOR] = {OP_XOR, 4},
+    [PUNCT_AND] = {OP_AND, 5},
+    [PUNCT_EQ] = {OP_EQ, 6}, [PUNCT_NEQ] = {OP_NEQ, 6},
+    [PUNCT_LT] = {OP_LT, 7}, [PUNCT_GT] = {OP_GT, 7}, [PUNCT_LE] = {OP_LE, 7}, [PUNCT_GE] = {OP_GE, 7},
+    [PUNCT_SHL] = {OP_SHL, 8}, [PUNCT_SHR] = {OP_SHR, 8},
+    [PUNCT_PLUS] = {OP_PLUS, 9}, [PUNCT_MIN] = {OP_MIN, 9},
+    [PUNCT_MUL] = {OP_MUL, 10}, [PUNCT_DIV] = {OP_DIV, 10}, [PUNCT_MOD] = {OP_MOD, 10}
+};
+
+static const OP_TAG ParserAssignOps[] = {
+    [PUNCT_ASSIGN] = OP_ASSIGN,
+    [PUNCT_PLUSASSIGN] = OP_PLUSASSIGN, [PUNCT_MINASSIGN] = OP_MINASSIGN,
+    [PUNCT_MULASSIGN] = OP_MULASSIGN, [PUNCT_DIVASSIGN] = OP_DIVASSIGN, [PUNCT_MODASSIGN] = OP_MODASSIGN,
+    [PUNCT_ANDASSIGN] = OP_ANDASSIGN, [PUNCT_ORASSIGN] = OP_ORASSIGN, [PUNCT_XORASSIGN] = OP_XORASSIGN,
+    [PUNCT_SHLASSIGN] = OP_SHLASSIGN, [PUNCT_SHRASSIGN] = OP_SHRASSIGN
+};
+
+static const OP_TAG ParserPrefixOps[] = {
+    [PUNCT_PLUS] = OP_UNARYPLUS, [PUNCT_MIN] = OP_UNARYMIN,
+    [PUNCT_NOT] = OP_NOT, [PUNCT_TILDE] = OP_TILDE,
+    [PUNCT_MUL] = OP_DEREF, [PUNCT_AND] = OP_ADDRESS,
+    [PUNCT_PLUSPLUS] = OP_PREPLUSPLUS, [PUNCT_MINMIN] = OP_PREMINMIN
+};
+
+#define PARSER_TableHas(table, punct) ((unsigned) (punct) < sizeof(table)/sizeof(*(table)))
+
+static Ast* ParserTernary (ParserCTX* ctx);
+static Ast* ParserBinary (ParserCTX* ctx, int minPrec);
+static Ast* ParserUnary (ParserCTX* ctx);
+static Ast* ParserPostfix (ParserCTX* ctx, Ast* Node);
+/*суффикс f/F - float, без суффикса и l/L - double: long double
+  не отличается от double*/
+static Ast* ParserFloat (ParserCTX* ctx)
+{
+    int length;
+    const char* text = TokenText(ctx, &length);
+
+    char number[PARSER_NumberLength];
+    char* end;
+
+    if (length >= PARSER_NumberLength) length = PARSER_NumberLength - 1;
+
+    memcpy(number, text, length);
+    number[length] = 0;
+
+    double value = strtod(number, &end);
+    int isFloat = *end == 'f' || *end == 'F';
+
+    if (*end && (end[1] != 0 || !strchr("fFlL", *end)))
+        ErrorParser(ctx, "неверная плавающая константа '$h'", number);
+
+    Ast* Node = AstCreateLiteral(ctx->location, isFloat ? LITERAL_FLOAT : LITERAL_DOUBLE);
+    Node->literal = malloc(sizeof(double));
+    *(double*) Node->literal = value;
+
+    TokenMatch(ctx);
+    return Node;
+}
+
+static Ast* ParserPrimary (ParserCTX* ctx);
+
+//выражение с запятыми
+Ast* ParserValue (ParserCTX* ctx)
+{
+    Ast* Node = ParserAssignValue(ctx);
+
+    while (TokenIsPunct(ctx, PUNCT_COMMA))
+    {
+        TokenLocation loc = ctx->location;
+        TokenMatch(ctx);
+        Node = AstCreateBOP(loc, Node, OP_COMMA, ParserAssignValue(ctx));
+    }
+
+    return Node;
+}
+
+//присваивание правоассоциативно
+Ast* ParserAssignValue (ParserCTX* ctx)
+{
+    Ast* Node = ParserTernary(ctx);
+    const Token* token = TokenPeek(ctx, 0);
+
+    if (token->tag == TOK_PUNCT && PARSER_TableHas(ParserAssignOps, token->sub) && ParserAssignOps[token->sub])
+    {
+        TokenLocation loc = ctx->location;
+        OP_TAG o = ParserAssignOps[token->sub];
+
+        TokenMatch(ctx);
+        Node = AstCreateBOP(loc, Node, o, ParserAssignValue(ctx));
+    }
+
+    return Node;
+}
+
+//значение или список в фигурных скобках, с указателями .поле = и [индекс] =
+Ast* ParserInitializer (ParserCTX* ctx)
+{
+    if (!TokenIsPunct(ctx, PUNCT_LBRACE)) return ParserAssignValue(ctx);
+
+    Ast* Node = AstCreateLiteral(ctx->location, LITERAL_INIT);
+    TokenMatch(ctx);
+
+    while (!TokenIsPunct(ctx, PUNCT_RBRACE) && !TokenIsEOF(ctx))
+    {
+        TokenLocation loc = ctx->location;
+        Ast* element;
+
+        if (TokenTryMatchPunct(ctx, PUNCT_PERIOD))
+        {
+            TokenLocation fieldLoc = ctx->location;
+            char* field = TokenMatchIdent(ctx);
+
+            element = AstCreateMarker(loc, MARKER_StructDesignatedInit);
+            element->l = field ? AstCreateLiteralIdent(fieldLoc, field) : AstCreateInvalid(fieldLoc);
+            TokenMatchPunct(ctx, PUNCT_ASSIGN);
+            element->r = ParserInitializer(ctx);
+        }
+        else if (TokenTryMatchPunct(ctx, PUNCT_LBRACKET))
+        {
+            element = AstCreateMarker(loc, MARKER_ArrayDesignatedInit);
+            element->l = ParserAssignValue(ctx);
+            TokenMatchPunct(ctx, PUNCT_RBRACKET);
+            TokenMatchPunct(ctx, PUNCT_ASSIGN);
+            element->r = ParserInitializer(ctx);
+        }
+        else
+            element = ParserInitializer(ctx);
+
+        AstAddChild(Node, element);
+
+        if (!TokenTryMatchPunct(ctx, PUNCT_COMMA)) break;
+    }
+
+    TokenMatchPunct(ctx, PUNCT_RBRACE);
+    return Node;
+}
+
+//внутренние функции
+static Ast* ParserTernary (ParserCTX* ctx)
+{
+    Ast* Node = ParserBinary(ctx, PARSER_PrecLowest);
+
+    if (TokenIsPunct(ctx, PUNCT_QUESTION))
+    {
+        TokenLocation loc = ctx->location;
+        TokenMatch(ctx);
+
+        Ast* l = ParserValue(ctx);
+        TokenMatchPunct(ctx, PUNCT_COLON);
+        Node = AstCreateTOP(loc, Node, l, ParserTernary(ctx));
+    }
+
+    return Node;
+}
+
+static ParserOp ParserBinaryOp (ParserCTX* ctx)
+{
+    const Token* token = TokenPeek(ctx, 0);
+
+    if (token->tag == TOK_PUNCT && PARSER_TableHas(ParserBinaryOps, token->sub))
+        return ParserBinaryOps[token->sub];
+
+    return (ParserOp) {OP_UNDEFINED, 0};
+}
+
+//подъем по приоритетам: операнд разбирается один раз, правая часть -
+//только операторами сильнее текущего, так что глубина вызовов не зависит
+//от числа уровней грамматики; все бинарные операторы левоассоциативны
+static Ast* ParserBinary (ParserCTX* ctx, int minPrec)
+{
+    Ast* Node = ParserUnary(ctx);
+
+    for (ParserOp op = ParserBinaryOp(ctx); op.prec >= minPrec; op = ParserBinaryOp(ctx))
+    {
+        TokenLocation loc = ctx->location;
+        TokenMatch(ctx);
+
+        Node = AstCreateBOP(loc, Node, op.o, ParserBinary(ctx, op.prec + 1));
+    }
+
+    return Node;
+}
+
+static Ast* ParserUnary (ParserCTX* ctx)
+{
+    TokenLocation loc = ctx->location;
+    const Token* token = TokenPeek(ctx, 0);
+
+    if (token->tag == TOK_PUNCT && PARSER_TableHas(ParserPrefixOps, token->sub) && ParserPrefixOps[token->sub])
+    {
+        OP_TAG o = ParserPrefixOps[token->sub];
+
+        TokenMatch(ctx);
+        return AstCreateUOP(loc, o, ParserUnary(ctx));
+    }
+    /*приведение типа или составной литерал*/
+    else if (TokenIsPunct(ctx, PUNCT_LPAREN) && ParserIsTypeAt(ctx, 1))
+    {
+        TokenMatch(ctx);
+        Ast* type = ParserType(ctx);
+        TokenMatchPunct(ctx, PUNCT_RPAREN);
+
+        if (TokenIsPunct(ctx, PUNCT_LBRACE))
+        {
+            Ast* Node = AstCreateLiteral(loc, LITERAL_COMPOUND);
+
+            Node->l = type;
+            Node->r = ParserInitializer(ctx);
+            return ParserPostfix(ctx, Node);
+        }
+
+        return AstCreateCast(loc, type, ParserUnary(ctx));
+    }
+    else if (TokenTryMatchKeyword(ctx, KEYWORD_SIZEOF))
+    {
+        if (TokenIsPunct(ctx, PUNCT_LPAREN) && ParserIsTypeAt(ctx, 1))
+        {
+            TokenMatch(ctx);
+            Ast* type = ParserType(ctx);
+            TokenMatchPunct(ctx, PUNCT_RPAREN);
+            return AstCreateSizeof(loc, type);
+        }
+
+        return AstCreateSizeof(loc, ParserUnary(ctx));
+    }
+
+    return ParserPostfix(ctx, ParserPrimary(ctx));
+}
+
+static Ast* ParserPostfix (ParserCTX* ctx, Ast* Node)
+{
+    for (;;)
+    {
+        TokenLocation loc = ctx->location;
+
+        if (TokenTryMatchPunct(ctx, PUNCT_LBRACKET))
+        {
+            Node = AstCreateIndex(loc, Node, ParserValue(ctx));
+            TokenMatchPunct(ctx, PUNCT_RBRACKET);
+        }
+        else if (TokenTryMatchPunct(ctx, PUNCT_LPAREN))
+        {
+            Node = AstCreateCall(loc, Node);
+
+            if (!TokenIsPunct(ctx, PUNCT_RPAREN))
+                do
+                {
+                    AstAddChild(Node, ParserAssignValue(ctx));
+                } while (TokenTryMatchPunct(ctx, PUNCT_COMMA));
+
+            TokenMatchPunct(ctx, PUNCT_RPAREN);
+        }
+        else if (TokenIsPunct(ctx, PUNCT_PERIOD) || TokenIsPunct(ctx, PUNCT_ARROW))
+        {
+            OP_TAG o = TokenIsPunct(ctx, PUNCT_PERIOD) ? OP_MEMBER : OP_MEMBERDEREF;
+            TokenMatch(ctx);
+
+            TokenLocation fieldLoc = ctx->location;
+            char* field = TokenMatchIdent(ctx);
+
+            Node = AstCreateBOP(loc, Node, o, field ? AstCreateLiteralIdent(fieldLoc, field) : AstCreateInvalid(fieldLoc));
+        }
+        else if (TokenIsPunct(ctx, PUNCT_PLUSPLUS) || TokenIsPunct(ctx, PUNCT_MINMIN))
+        {
+            OP_TAG o = TokenIsPunct(ctx, PUNCT_PLUSPLUS) ? OP_PLUSPLUS : OP_MINMIN;
+
+            TokenMatch(ctx);
+            Node = AstCreateUOP(loc, o, Node);
+        }
+        else
+            return Node;
+    }
+}
+
+//значение escape-последовательности; *str сдвигается за нее
+int ParserEscape (const char** str)
+{
+    const char* c = *str;
+    int value = 0;
+
+    if (*c != '\\')
+    {
+        *str = c + 1;
+        return *c;
+    }
+
+    switch (*++c)
+    {
+        case 'n': value = '\n'; c++; break;
+        case 't': value = '\t'; c++; break;
+        case 'r': value = '\r'; c++; break;
+        case 'a': value = '\a'; c++; break;
+        case 'b': value = '\b'; c++; break;
+        case 'f': value = '\f'; c++; break;
+        case 'v': value = '\v'; c++; break;
+
+        case 'x':
+            for (c++; *c && strchr("0123456789abcdefABCDEF", *c); c++)
+                value = value*16 + (*c <= '9' ? *c - '0' : (*c | 0x20) - 'a' + 10);
+
+            break;
+
+        default:
+            if (*c >= '0' && *c <= '7')
+                for (int i = 0; i < 3 && *c >= '0' && *c <= '7'; i++, c++)
+                    value = value*8 + *c - '0';
+
+            /*\\ \' \" \? и прочие - сам символ*/
+            else if (*c)
+                value = *c++;
+    }
+
+    *str = c;
+    return value;
+}
+
+//значение и суффикс целой константы; тип по ним выбирает анализатор
+static Ast* ParserInt (ParserCTX* ctx)
+{
+    Ast* Node = AstCreateLiteral(ctx->location, LITERAL_INT);
+    int length;
+    const char* text = TokenText(ctx, &length);
+
+    /*текст токена не завершен нулем*/
+    char number[PARSER_NumberLength];
+    char* end;
+
+    if (length >= PARSER_NumberLength) length = PARSER_NumberLength - 1;
+
+    memcpy(number, text, length);
+    number[length] = 0;
+
+    IntLiteral* literal = calloc(1, sizeof(IntLiteral));
+    Node->literal = literal;
+
+    errno = 0;
+    literal->value = strtoull(number, &end, 0);
+    literal->isDecimal = number[0] != '0';
+
+    if (errno == ERANGE)
+        ErrorParser(ctx, "целая константа '$h' не помещается ни в один тип", number);
+
+    /*u и l, ll в любом порядке; ll - одного регистра*/
+    if (*end == 'u' || *end == 'U')
+    {
+        literal->isUnsigned = 1;
+        end++;
+    }
+
+    if (!strncmp(end, "ll", 2) || !strncmp(end, "LL", 2))
+    {
+        literal->longs = 2;
+        end += 2;
+    }
+    else if (*end == 'l' || *end == 'L')
+    {
+        literal->longs = 1;
+        end++;
+    }
+
+    if (!literal->isUnsigned && (*end == 'u' || *end == 'U'))
+    {
+        literal->isUnsigned = 1;
+        end++;
+    }
+
+    if (*end != 0)
+        ErrorParser(ctx, "неверная целая константа '$h'", number);
+
+    TokenMatch(ctx);
+    return Node;
+}
+
+static Ast* ParserChar (ParserCTX* ctx)
+{
+    Ast* Node = AstCreateLiteral(ctx->location, LITERAL_CHAR);
+    char* text = TokenDupMatch(ctx);
+    const char* c = text;
+
+    Node->literal = malloc(sizeof(int));
+    *(int*) Node->literal = (signed char) ParserEscape(&c);
+
+    free(text);
+    return Node;
+}
+
+/*соседние строки склеиваются (фаза 6) после перевода escape-последовательностей
+  (фаза 5): "\x4" "1" - два символа, а не 'A'. Результат снова записан
+  escape-последовательностями, непечатаемые байты - \ooo ровно из трех
+  цифр, так что следующий символ их не продолжит*/
+static Ast* ParserString (ParserCTX* ctx)
+{
+    Ast* Node = AstCreateLiteral(ctx->location, LITERAL_STR);
+    char* bytes = 0;
+    int length = 0;
+
+    do
+    {
+        char* piece = TokenDupMatch(ctx);
+
+        bytes = realloc(bytes, length + strlen(piece) + 1);
+
+        for (const char* c = piece; *c;)
+            bytes[length++] = (char) ParserEscape(&c);
+
+        free(piece);
+    } while (TokenIsString(ctx));
+
+    char* str = malloc(4*length + 1);
+    char* out = str;
+
+    for (int i = 0; i < length; i++)
+    {
+        unsigned char c = bytes[i];
+
+        if (c == '"' || c == '\\') out += sprintf(out, "\\%c", c);
+        else if (c < ' ' || c >= 0x7f) out += sprintf(out, "\\%03o", c);
+        else
+            *out++ = c;
+    }
+
+    *out = 0;
+    free(bytes);
+
+    Node->literal = str;
+    return Node;
+}
+
+static Ast* ParserPrimary (ParserCTX* ctx)
+{
+    TokenLocation loc = ctx->location;
+
+    if (TokenIsInt(ctx)) return ParserInt(ctx);
+    else if (TokenIsFloat(ctx)) return ParserFloat(ctx);
+    else if (TokenIsChar(ctx)) return ParserChar(ctx);
+    else if (TokenIsString(ctx)) return ParserString(ctx);
+    else if (TokenIsIdent(ctx))
+    {
+        Ast* Node = AstCreateLiteralIdent(loc, TokenBufferDup(&ctx->tokens, TokenPeek(ctx, 0)));
+
+        Node->symbol = SymbolFindNs(ctx->scope, Node->literal, SYMBOL_NS_ORDINARY);
+
+        if (!Node->symbol) ErrorParser(ctx, "'$h' не объявлен", (char*) Node->literal);
+
+        TokenMatch(ctx);
+        return Node;
+    }
+    else if (TokenTryMatchPunct(ctx, PUNCT_LPAREN))
+    {
+        Ast* Node = ParserValue(ctx);
+
+        TokenMatchPunct(ctx, PUNCT_RPAREN);
+        return Node;
+    }
+
+    ErrorExpected(ctx, "выражение");
+    return AstCreateInvalid(loc);
+}
@@ -0,0 +1,412 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "..\include\parser.h"
+#include "..\include\parser-decl.h"
+#include "..\include\parser-value.h"
+#include "..\include\parser-token.h"
+#include "..\include\symbol.h"
+#include "..\include\error.h"
+#include "..\include\debug.h"
+
+static void ParserInit (ParserCTX* ctx, LexerCTX* lexer, Symbol* Global, const char* filename);
+static void ParserEnd (ParserCTX* ctx);
+static Ast* ParserModule (ParserCTX* ctx);
+static Ast* ParserStatement (ParserCTX* ctx);
+
+//разбор единицы трансляции; символы объявлений создаются в Global сразу,
+//иначе не отличить имя typedef от переменной
+ParserResult Parser (LexerCTX* lexer, Symbol* Global, const char* filename)
+{
+    ParserCTX ctx;
+    ParserInit(&ctx, lexer, Global, filename);
+
+    Ast* Module = ParserModule(&ctx);
+    ParserResult result = {Module, ctx.errors, ctx.warnings, 0};
+
+    ParserEnd(&ctx);
+    return result;
+}
+
+//то же, но тела функций только пропускаются по скобкам и разбираются
+//по требованию ParserBody; все токены остаются в буфере, так что
+//лексер после разбора уже не нужен
+ParserResult ParserLazy (LexerCTX* lexer, Symbol* Global, const char* filename)
+{
+    ParserCTX* ctx = malloc(sizeof(ParserCTX));
+    ParserInit(ctx, lexer, Global, filename);
+    ctx->lazy = 1;
+
+    Ast* Module = ParserModule(ctx);
+    return (ParserResult) {Module, ctx->errors, ctx->warnings, ctx};
+}
+
+//тело AST_FNIMPL, при ленивом разборе - разбираемое при первом обращении;
+//проходы, которым нужно тело, берут его отсюда
+Ast* ParserBody (ParserResult* result, Ast* Impl)
+{
+    if (Impl->r || !result->lazy) return Impl->r;
+
+    Ast* Node = ParserFnBody(result->lazy, Impl);
+
+    result->errors = result->lazy->errors;
+    result->warnings = result->lazy->warnings;
+    return Node;
+}
+
+//токены отложенного тела, от '{' до парной '}', без разбора: по ним
+//IncrFingerprint решает, разбирать ли тело. 0 - тело не отложено
+int ParserBodyTokens (ParserResult* result, const Ast* Impl, ParserTokenFn visit, void* data)
+{
+    if (Impl->r || !result->lazy) return 0;
+
+    const TokenBuffer* tokens = &result->lazy->tokens;
+    int depth = 0;
+
+    /*ParserLazy уже прошел тело, все его токены в буфере*/
+    for (int i = Impl->bodyToken; i < tokens->length; i++)
+    {
+        const Token* token = &tokens->tokens[i];
+
+        if (token->tag == TOK_EOF) break;
+
+        visit(data, token, TokenBufferText(tokens, token));
+
+        if (token->tag == TOK_PUNCT && token->sub == PUNCT_LBRACE) depth++;
+        else if (token->tag == TOK_PUNCT && token->sub == PUNCT_RBRACE) depth--;
+
+        if (depth == 0) break;
+    }
+
+    return 1;
+}
+
+void ParserFree (ParserResult* result)
+{
+    AstDestroy(result->tree);
+
+    if (result->lazy)
+    {
+        ParserEnd(result->lazy);
+        free(result->lazy);
+    }
+}
+
+//встроенные типы; размер long - по модели данных цели: LP64 или LLP64
+void ParserBuiltins (Symbol* Global, const Arch* arch, OS_TAG os)
+{
+    int longSize = os == OS_WINDOWS ? 4 : arch->wordsize;
+
+    /*i386 SysV выравнивает 8-байтовые скаляры на 4, Win32 - на 8*/
+    int wideAlign = os == OS_LINUX && arch->wordsize == 4 ? 4 : 8;
+
+    const int unsignedMask = TYPEMASK_INTEGRAL | TYPEMASK_UNSIGNED;
+    const int floatingMask = TYPEMASK_INTEGRAL | TYPEMASK_FLOATING;
+
+    const struct {
+        const char* ident;
+        int size;
+        int align;
+        int typeMask;
+    } builtins[] = {
+        {"char", 1, 1, TYPEMASK_INTEGRAL}, {"unsigned char", 1, 1, unsignedMask},
+        {"short", 2, 2, TYPEMASK_INTEGRAL}, {"unsigned short", 2, 2, unsignedMask},
+        {"int", 4, 4, TYPEMASK_INTEGRAL}, {"unsigned int", 4, 4, unsignedMask},
+        {"long", longSize, longSize, TYPEMASK_INTEGRAL}, {"unsigned long", longSize, longSize, unsignedMask},
+        {"long long", 8, wideAlign, TYPEMASK_INTEGRAL}, {"unsigned long long", 8, wideAlign, unsignedMask},
+        {"float", 4, 4, floatingMask}, {"double", 8, wideAlign, floatingMask}
+    };
+
+    SymbolCreateType(Global, "void", 0, TYPEMASK_NONE);
+
+    for (int i = 0; i < (int) (sizeof(builtins)/sizeof(*builtins)); i++)
+        SymbolCreateType(Global, builtins[i].ident, builtins[i].size, builtins[i].typeMask)->align = builtins[i].align;
+}
+
+//блок со своей областью видимости
+Ast* ParserCode (ParserCTX* ctx)
+{
+    DebugEnter("Code");
+
+    Ast* Node = AstCreate(AST_CODE, ctx->location);
+    Symbol* old = ctx->scope;
+
+    TokenMatchPunct(ctx, PUNCT_LBRACE);
+    Node->symbol = ctx->scope = SymbolCreateScope(ctx->scope);
+
+    while (!TokenIsPunct(ctx, PUNCT_RBRACE) && !TokenIsEOF(ctx))
+    {
+        AstAddChild(Node, ParserStatement(ctx));
+
+        /*восстановление: остаток оператора пропускается*/
+        if (ctx->panic) TokenSkipStatement(ctx);
+    }
+
+    ctx->scope = old;
+    TokenMatchPunct(ctx, PUNCT_RBRACE);
+
+    DebugLeave();
+    return Node;
+}
+
+//внутренние функции
+static void ParserInit (ParserCTX* ctx, LexerCTX* lexer, Symbol* Global, const char* filename)
+{
+    ctx->lexer = lexer;
+    TokenBufferInit(&ctx->tokens, lexer);
+    ctx->location = (TokenLocation) {ctx->tokens.file, ctx->tokens.line, TokenPeek(ctx, 0)->lineChar};
+
+    ctx->filename = strdup(filename);
+    ctx->fullname = ctx->filename;
+
+    const char* slash = strrchr(filename, '/');
+    ctx->path = slash ? strndup(filename, slash - filename + 1) : strdup("");
+
+    ctx->module = Global;
+    ctx->scope = Global;
+
+    ctx->breakLevel = 0;
+    ctx->continueLevel = 0;
+
+    ctx->errors = 0;
+    ctx->warnings = 0;
+
+    ctx->lazy = 0;
+
+    ctx->lastErrorLine = -1;
+    ctx->panic = 0;
+}
+
+static void ParserEnd (ParserCTX* ctx)
+{
+    TokenBufferFree(&ctx->tokens);
+    free(ctx->filename);
+    free(ctx->path);
+}
+
+static Ast* ParserModule (ParserCTX* ctx)
+{
+    DebugEnter("Module");
+
+    Ast* Module = AstCreate(AST_MODULE, ctx->location);
+    Module->symbol = ctx->module;
+
+    while (!TokenIsEOF(ctx))
+    {
+        if (TokenTryMatchPunct(ctx, PUNCT_SEMICOLON)) continue;
+        else if (ParserIsDecl(ctx)) AstAddChild(Module, ParserDecl(ctx, 1));
+        else
+        {
+            ErrorExpected(ctx, "объявление");
+
+            /*лишняя '}' сама по себе не пропустится; за ней поток уже синхронизирован*/
+            if (TokenIsPunct(ctx, PUNCT_RBRACE))
+            {
+                TokenMatch(ctx);
+                ctx->panic = 0;
+            }
+        }
+
+        if (ctx->panic) TokenSkipStatement(ctx);
+    }
+
+    DebugLeave();
+    return Module;
+}
+
+static Ast* ParserBranch (ParserCTX* ctx)
+{
+    Ast* Node = AstCreate(AST_BRANCH, ctx->location);
+
+    TokenMatch(ctx);
+    TokenMatchPunct(ctx, PUNCT_LPAREN);
+    AstAddChild(Node, ParserValue(ctx));
+    TokenMatchPunct(ctx, PUNCT_RPAREN);
+
+    Node->l = ParserStatement(ctx);
+
+    if (TokenTryMatchKeyword(ctx, KEYWORD_ELSE)) Node->r = ParserStatement(ctx);
+
+    return Node;
+}
+
+static Ast* ParserLoopBody (ParserCTX* ctx)
+{
+    ctx->breakLevel++;
+    ctx->continueLevel++;
+
+    Ast* Node = ParserStatement(ctx);
+
+    ctx->breakLevel--;
+    ctx->continueLevel--;
+    return Node;
+}
+
+//while: условие в l, тело в r
+static Ast* ParserWhile (ParserCTX* ctx)
+{
+    Ast* Node = AstCreate(AST_LOOP, ctx->location);
+
+    TokenMatch(ctx);
+    TokenMatchPunct(ctx, PUNCT_LPAREN);
+    Node->l = ParserValue(ctx);
+    TokenMatchPunct(ctx, PUNCT_RPAREN);
+
+    Node->r = ParserLoopBody(ctx);
+    return Node;
+}
+
+static Ast* ParserDoWhile (ParserCTX* ctx)
+{
+    Ast* Node = AstCreate(AST_LOOP, ctx->location);
+    Node->isDo = 1;
+
+    TokenMatch(ctx);
+    Node->l = ParserLoopBody(ctx);
+
+    TokenMatchKeyword(ctx, KEYWORD_WHILE);
+    TokenMatchPunct(ctx, PUNCT_LPAREN);
+    Node->r = ParserValue(ctx);
+    TokenMatchPunct(ctx, PUNCT_RPAREN);
+    TokenMatchPunct(ctx, PUNCT_SEMICOLON);
+    return Node;
+}
+
+//for: дети - инициализация, условие, шаг (пустые - AST_EMPTY), тело в l
+static Ast* ParserFor (ParserCTX* ctx)
+{
+    Ast* Node = AstCreate(AST_ITER, ctx->location);
+    Symbol* old = ctx->scope;
+
+    TokenMatch(ctx);
+    TokenMatchPunct(ctx, PUNCT_LPAREN);
+
+    Node->symbol = ctx->scope = SymbolCreateScope(ctx->scope);
+
+    /*объявление само съедает ';'*/
+    if (ParserIsDecl(ctx)) AstAddChild(Node, ParserDecl(ctx, 0));
+    else
+    {
+        AstAddChild(Node, TokenIsPunct(ctx, PUNCT_SEMICOLON) ? AstCreateEmpty(ctx->location) : ParserValue(ctx));
+        TokenMatchPunct(ctx, PUNCT_SEMICOLON);
+    }
+
+    AstAddChild(Node, TokenIsPunct(ctx, PUNCT_SEMICOLON) ? AstCreateEmpty(ctx->location) : ParserValue(ctx));
+    TokenMatchPunct(ctx, PUNCT_SEMICOLON);
+
+    AstAddChild(Node, TokenIsPunct(ctx, PUNCT_RPAREN) ? AstCreateEmpty(ctx->location) : ParserValue(ctx));
+    TokenMatchPunct(ctx, PUNCT_RPAREN);
+
+    Node->l = ParserLoopBody(ctx);
+
+    ctx->scope = old;
+    return Node;
+}
+
+//switch: значение в l, тело в r; метки case/default - операторы тела
+static Ast* ParserSwitch (ParserCTX* ctx)
+{
+    Ast* Node = AstCreate(AST_SWITCH, ctx->location);
+
+    TokenMatch(ctx);
+    TokenMatchPunct(ctx, PUNCT_LPAREN);
+    Node->l = ParserValue(ctx);
+    TokenMatchPunct(ctx, PUNCT_RPAREN);
+
+    ctx->breakLevel++;
+    Node->r = ParserStatement(ctx);
+    ctx->breakLevel--;
+    return Node;
+}
+
+//case: константа в l, помеченный оператор в r
+static Ast* ParserCase (ParserCTX* ctx)
+{
+    Ast* Node;
+
+    if (TokenIsKeyword(ctx, KEYWORD_CASE))
+    {
+        Node = AstCreate(AST_CASE, ctx->location);
+        TokenMatch(ctx);
+        Node->l = ParserAssignValue(ctx);
+    }
+    else
+    {
+        Node = AstCreate(AST_DEFAULT, ctx->location);
+        TokenMatch(ctx);
+    }
+
+    TokenMatchPunct(ctx, PUNCT_COLON);
+
+    /*метка в конце блока*/
+    Node->r = TokenIsPunct(ctx, PUNCT_RBRACE) ? AstCreateEmpty(ctx->location) : ParserStatement(ctx);
+    return Node;
+}
+
+static Ast* ParserReturn (ParserCTX* ctx)
+{
+    Ast* Node = AstCreate(AST_RETURN, ctx->location);
+
+    TokenMatch(ctx);
+
+    if (!TokenIsPunct(ctx, PUNCT_SEMICOLON)) Node->r = ParserValue(ctx);
+
+    TokenMatchPunct(ctx, PUNCT_SEMICOLON);
+    return Node;
+}
+
+static Ast* ParserBreak (ParserCTX* ctx)
+{
+    int isBreak = TokenIsKeyword(ctx, KEYWORD_BREAK);
+    Ast* Node = AstCreate(isBreak ? AST_BREAK : AST_CONTINUE, ctx->location);
+
+    if (isBreak && ctx->breakLevel == 0) ErrorParser(ctx, "break вне цикла или switch");
+    else if (!isBreak && ctx->continueLevel == 0) ErrorParser(ctx, "continue вне цикла");
+
+    TokenMatch(ctx);
+    TokenMatchPunct(ctx, PUNCT_SEMICOLON);
+    return Node;
+}
+
+static Ast* ParserStatement (ParserCTX* ctx)
+{
+    TokenLocation loc = ctx->location;
+    const Token* token = TokenPeek(ctx, 0);
+
+    if (token->tag == TOK_KEYWORD)
+        switch (token->sub)
+        {
+            case KEYWORD_IF: return ParserBranch(ctx);
+            case KEYWORD_WHILE: return ParserWhile(ctx);
+            case KEYWORD_DO: return ParserDoWhile(ctx);
+            case KEYWORD_FOR: return ParserFor(ctx);
+            case KEYWORD_SWITCH: return ParserSwitch(ctx);
+            case KEYWORD_CASE:
+            case KEYWORD_DEFAULT: return ParserCase(ctx);
+            case KEYWORD_RETURN: return ParserReturn(ctx);
+            case KEYWORD_BREAK:
+            case KEYWORD_CONTINUE: return ParserBreak(ctx);
+
+            case KEYWORD_GOTO:
+                ErrorParser(ctx, "goto не поддерживается");
+                ctx->panic = 1;
+                return AstCreateInvalid(loc);
+        }
+
+    if (TokenIsPunct(ctx, PUNCT_LBRACE)) return ParserCode(ctx);
+    else if (TokenTryMatchPunct(ctx, PUNCT_SEMICOLON)) return AstCreateEmpty(loc);
+    else if (ParserIsDecl(ctx)) return ParserDecl(ctx, 0);
+
+    /*метки без goto не нужны: пропускаем с ошибкой*/
+    else if (TokenIsIdent(ctx) && TokenPeekIsPunct(ctx, 1, PUNCT_COLON))
+    {
+        ErrorParser(ctx, "метки не поддерживаются");
+        TokenMatch(ctx);
+        TokenMatch(ctx);
+        return ParserStatement(ctx);
+    }
+
+    Ast* Node = ParserValue(ctx);
+    TokenMatchPunct(ctx, PUNCT_SEMICOLON);
+    return Node;
+}
@@ -0,0 +1,684 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "..\include\pch.h"
+#include "..\include\pp.h"
+#include "..\include\type.h"
+#include "..\include\symbol.h"
+#include "..\include\hashmap.h"
+#include "..\include\vector.h"
+#include "..\include\file.h"
+#include "..\include\debug.h"
+
+enum {
+    PCH_Version = 3,
+    PCH_MapSize = 256,
+    PCH_None = -1           //нет символа, типа или строки
+};
+
+static const char pchMagic[8] = "SCCPCH\r\n";
+
+//все поля - 32-битные индексы или смещения, секции выровнены на 8
+typedef struct PchSection {
+    int32_t offset;         //от начала файла
+    int32_t count;          //число записей
+} PchSection;
+
+typedef struct PchHeader {
+    char magic[8];
+    int32_t version;
+    int32_t size;           //длина файла целиком
+    int32_t config;         //строка с настройками, при которых файл записан
+    int32_t global;         //индекс глобальной области
+    int32_t macros;         //строка с #define и #undef заголовка
+    int32_t pad;
+
+    PchSection symbols;     //PchSymbol
+    PchSection types;       //PchType
+    PchSection refs;        //int32_t: дети символов и параметры функций
+    PchSection deps;        //PchDep: файлы, из которых собран заголовок
+    PchSection strings;     //char, строки оканчиваются нулем
+} PchHeader;
+
+typedef struct PchSymbol {
+    int32_t tag;
+    int32_t ident;          //смещение в секции строк
+    int32_t parent;
+    int32_t nthChild;
+    int32_t children;       //начало в refs
+    int32_t childNo;
+
+    /*symId symParam symTypedef symEnumConstant*/
+    int32_t dt;
+    int32_t storage;
+    /*symType symStruct symUnion symEnum*/
+    int32_t size;
+    int32_t typeMask;
+    int32_t complete;
+    int32_t packed;
+
+    int32_t align;          //align или alignAs
+    int32_t label;          //symId static/extern
+    int32_t value;          //offset, constValue или hasConstFields
+} PchSymbol;
+
+typedef struct PchType {
+    int32_t tag;
+    int32_t isConst;
+    int32_t ref;            //basic: символ; ptr, array: base; function: returnType
+    int32_t params;         //начало в refs
+    int32_t paramNo;
+    int32_t variadic;
+    int64_t array;
+} PchType;
+
+//файл заголовка и его защита: повторный #include после -include-pch
+//пропускается так же, как в сборке заголовка
+typedef struct PchDep {
+    int32_t path;
+    int32_t guard;          //макрос защиты или PCH_None
+    int64_t size;
+    int64_t mtime;
+    int32_t once;           //#pragma once
+    int32_t pad;
+} PchDep;
+
+//запись: символы и типы нумеруются, затем выводятся одним блоком
+typedef struct PchWriter {
+    Vector symbols;
+    Vector types;
+    IntMap symbolNo;        //Symbol* -> индекс + 1
+    IntMap typeNo;          //Type* -> индекс + 1
+
+    HashMap stringNo;       //строка -> смещение + 1
+    char* strings;
+    int stringsLength;
+    int stringsCapacity;
+
+    int32_t* refs;
+    int refsLength;
+    int refsCapacity;
+
+    int fail;
+} PchWriter;
+
+//внутренние функции
+static int PchIsDep (const FileEntry* entry)
+{
+    /*текст в памяти, например <command-line>, на диске не проверить*/
+    return entry->text && entry->name[0] != '<';
+}
+
+static int PchAlign (int offset)
+{
+    return (offset + 7) & ~7;
+}
+
+static int PchHasType (const Symbol* Symbol)
+{
+    return Symbol->tag == SYMBOL_ID || Symbol->tag == SYMBOL_PARAM || Symbol->tag == SYMBOL_TYPEDEF || Symbol->tag == SYMBOL_ENUMCONSTANT;
+}
+
+static int PchHasLabel (const Symbol* Symbol)
+{
+    return Symbol->tag == SYMBOL_ID && (Symbol->storage == STORAGE_STATIC || Symbol->storage == STORAGE_EXTERN);
+}
+
+static int PchString (PchWriter* w, const char* str)
+{
+    if (!str) return PCH_None;
+
+    intptr_t found = (intptr_t) HashMapMap(&w->stringNo, str);
+
+    if (found) return found - 1;
+
+    int length = strlen(str) + 1;
+
+    if (w->stringsLength + length > w->stringsCapacity)
+    {
+        w->stringsCapacity = 2*w->stringsCapacity + length;
+        w->strings = realloc(w->strings, w->stringsCapacity);
+    }
+
+    int offset = w->stringsLength;
+    memcpy(w->strings + offset, str, length);
+    w->stringsLength += length;
+
+    HashMapAdd(&w->stringNo, str, (void*) (intptr_t) (offset + 1));
+    return offset;
+}
+
+static int PchRef (PchWriter* w, int32_t ref)
+{
+    if (w->refsLength == w->refsCapacity)
+    {
+        w->refsCapacity = 2*w->refsCapacity + 16;
+        w->refs = realloc(w->refs, w->refsCapacity*sizeof(int32_t));
+    }
+
+    w->refs[w->refsLength] = ref;
+    return w->refsLength++;
+}
+
+static int PchSymbolNo (const PchWriter* w, const Symbol* Symbol)
+{
+    return Symbol ? (int) (intptr_t) IntMapMap(&w->symbolNo, (intptr_t) Symbol) - 1 : PCH_None;
+}
+
+static int PchTypeNo (const PchWriter* w, const Type* dt)
+{
+    return dt ? (int) (intptr_t) IntMapMap(&w->typeNo, (intptr_t) dt) - 1 : PCH_None;
+}
+
+//обход в глубину; цели LINK и MODULELINK попадают в файл вместе с деревом
+static void PchNumberSymbols (PchWriter* w, const Symbol* Global)
+{
+    Vector stack;
+    VectorInit(&stack, 32);
+    VectorPush(&stack, (void*) Global);
+
+    while (stack.length)
+    {
+        const Symbol* Current = VectorPop(&stack);
+
+        if (IntMapMap(&w->symbolNo, (intptr_t) Current)) continue;
+
+        IntMapAdd(&w->symbolNo, (intptr_t) Current, (void*) (intptr_t) (VectorPush(&w->symbols, (void*) Current) + 1));
+
+        for (int i = Current->children.length - 1; i >= 0; i--)
+            VectorPush(&stack, VectorGet(&Current->children, i));
+    }
+
+    VectorFree(&stack);
+}
+
+static void PchNumberType (PchWriter* w, const Type* dt)
+{
+    if (!dt || IntMapMap(&w->typeNo, (intptr_t) dt)) return;
+
+    IntMapAdd(&w->typeNo, (intptr_t) dt, (void*) (intptr_t) (VectorPush(&w->types, (void*) dt) + 1));
+
+    if (dt->tag == TYPE_BASIC)
+    {
+        if (PchSymbolNo(w, dt->basic) == PCH_None)
+        {
+            DebugError("PchWrite", "базовый тип %s не принадлежит записываемой области", dt->basic ? dt->basic->ident : "<0>");
+            w->fail = 1;
+        }
+    }
+    else if (dt->tag == TYPE_PTR || dt->tag == TYPE_ARRAY)
+        PchNumberType(w, dt->base);
+
+    else if (dt->tag == TYPE_FUNCTION)
+    {
+        PchNumberType(w, dt->returnType);
+
+        for (int i = 0; i < dt->params; i++)
+            PchNumberType(w, dt->paramTypes[i]);
+    }
+}
+
+static void PchPutSymbol (PchWriter* w, PchSymbol* r, const Symbol* Symbol)
+{
+    r->tag = Symbol->tag;
+    r->ident = PchString(w, Symbol->ident);
+    r->parent = PchSymbolNo(w, Symbol->parent);
+    r->nthChild = Symbol->nthChild;
+
+    r->childNo = Symbol->children.length;
+    r->children = w->refsLength;
+
+    for (int i = 0; i < Symbol->children.length; i++)
+        PchRef(w, PchSymbolNo(w, VectorGet(&Symbol->children, i)));
+
+    r->dt = PCH_None;
+    r->label = PCH_None;
+
+    if (PchHasType(Symbol))
+    {
+        r->dt = PchTypeNo(w, Symbol->dt);
+        r->storage = Symbol->storage;
+        r->align = Symbol->alignAs;
+    }
+    else
+    {
+        r->size = Symbol->size;
+        r->typeMask = Symbol->typeMask;
+        r->complete = Symbol->complete;
+        r->align = Symbol->align;
+        r->packed = Symbol->packed;
+    }
+
+    if (PchHasLabel(Symbol)) r->label = PchString(w, Symbol->label);
+    else
+        r->value = Symbol->offset;
+}
+
+static void PchPutType (PchWriter* w, PchType* r, const Type* dt)
+{
+    r->tag = dt->tag;
+    r->isConst = dt->qual.isConst;
+    r->ref = PCH_None;
+
+    if (dt->tag == TYPE_BASIC) r->ref = PchSymbolNo(w, dt->basic);
+    else if (dt->tag == TYPE_PTR || dt->tag == TYPE_ARRAY)
+    {
+        r->ref = PchTypeNo(w, dt->base);
+        r->array = dt->array;
+    }
+    else if (dt->tag == TYPE_FUNCTION)
+    {
+        r->ref = PchTypeNo(w, dt->returnType);
+        r->paramNo = dt->params;
+        r->params = w->refsLength;
+        r->variadic = dt->variadic;
+
+        for (int i = 0; i < dt->params; i++)
+            PchRef(w, PchTypeNo(w, dt->paramTypes[i]));
+    }
+}
+
+static void PchWriterFree (PchWriter* w)
+{
+    VectorFree(&w->symbols);
+    VectorFree(&w->types);
+    IntMapFree(&w->symbolNo);
+    IntMapFree(&w->typeNo);
+    HashMapFree(&w->stringNo);
+    free(w->strings);
+    free(w->refs);
+}
+
+//секция целиком внутри файла
+static int PchSectionValid (const PchCTX* ctx, PchSection s, int elementSize)
+{
+    return s.offset >= (int) sizeof(PchHeader) && s.count >= 0 && (s.offset & 7) == 0
+        && (long long) s.offset + (long long) s.count*elementSize <= ctx->size;
+}
+
+static const char* PchStr (const PchCTX* ctx, const PchHeader* header, int32_t offset, int* fail)
+{
+    if (offset == PCH_None) return 0;
+
+    if (offset < 0 || offset >= header->strings.count)
+    {
+        *fail = 1;
+        return 0;
+    }
+
+    return (const char*) ctx->map + header->strings.offset + offset;
+}
+
+//отрезок refs, все элементы которого - индексы меньше limit
+static int PchRefsValid (const PchHeader* header, const int32_t* refs, int32_t start, int32_t count, int limit)
+{
+    if (count < 0 || start < 0 || (long long) start + count > header->refs.count) return 0;
+
+    for (int i = 0; i < count; i++)
+        if (refs[start + i] < 0 || refs[start + i] >= limit) return 0;
+
+    return 1;
+}
+
+//файлы, из которых собран заголовок, не менялись
+static int PchDepsFresh (const PchCTX* ctx, const PchHeader* header)
+{
+    const PchDep* deps = (const PchDep*) ((const char*) ctx->map + header->deps.offset);
+    int fail = 0;
+
+    for (int i = 0; i < header->deps.count; i++)
+    {
+        const char* path = PchStr(ctx, header, deps[i].path, &fail);
+        struct stat st;
+
+        if (fail || !path || stat(path, &st) != 0) return 0;
+
+        if ((int64_t) st.st_size != deps[i].size || (int64_t) st.st_mtime != deps[i].mtime) return 0;
+    }
+
+    return 1;
+}
+
+//директивы заголовка выполняются перед входным файлом, а его файлы
+//считаются уже включенными
+static void PchRestorePP (const PchCTX* ctx, const PchHeader* header, const char* macros, PPCTX* pp)
+{
+    const PchDep* deps = (const PchDep*) ((const char*) ctx->map + header->deps.offset);
+    int fail = 0;
+
+    PPPredefine(pp, macros, strlen(macros));
+
+    for (int i = 0; i < header->deps.count; i++)
+    {
+        const char* path = PchStr(ctx, header, deps[i].path, &fail);
+        const char* guard = PchStr(ctx, header, deps[i].guard, &fail);
+        int id = fail || !path ? -1 : FileOpen(path);
+
+        if (id < 0) continue;
+
+        if (guard) FileSetGuard(id, guard);
+
+        if (deps[i].once) FileSetOnce(id);
+
+        PPMarkEntered(pp, id);
+    }
+}
+
+static int PchLoadSymbols (PchCTX* ctx, const PchHeader* header, const int32_t* refs)
+{
+    const PchSymbol* records = (const PchSymbol*) ((const char*) ctx->map + header->symbols.offset);
+    int fail = 0;
+
+    for (int i = 0; i < ctx->symbolCount && !fail; i++)
+    {
+        const PchSymbol* r = &records[i];
+        Symbol* Symbol = &ctx->symbols[i];
+
+        if (r->tag < SYMBOL_UNDEFINED || r->tag > SYMBOL_PARAM
+            || r->parent < PCH_None || r->parent >= ctx->symbolCount
+            || !PchRefsValid(header, refs, r->children, r->childNo, ctx->symbolCount))
+            return 0;
+
+        Symbol->tag = r->tag;
+        Symbol->ident = (char*) PchStr(ctx, header, r->ident, &fail);
+
+        VectorInit(&Symbol->decls, 2);
+        Symbol->impl = 0;
+
+        if (PchHasType(Symbol))
+        {
+            if (r->dt < PCH_None || r->dt >= ctx->typeCount) return 0;
+
+            Symbol->dt = r->dt == PCH_None ? 0 : &ctx->types[r->dt];
+            Symbol->storage = r->storage;
+            Symbol->alignAs = r->align;
+        }
+        else
+        {
+            Symbol->size = r->size;
+            Symbol->typeMask = r->typeMask;
+            Symbol->complete = r->complete;
+            Symbol->align = r->align;
+            Symbol->packed = r->packed;
+        }
+
+        Symbol->parent = r->parent == PCH_None ? 0 : &ctx->symbols[r->parent];
+        Symbol->nthChild = r->nthChild;
+
+        VectorInit(&Symbol->children, r->childNo > 2 ? r->childNo : 2);
+
+        for (int j = 0; j < r->childNo; j++)
+            VectorPush(&Symbol->children, &ctx->symbols[refs[r->children + j]]);
+
+        /*строки остаются в отображении, SymbolDestroy их не освобождает:
+          символы заголовка подключаются через SYMBOL_MODULELINK*/
+        if (PchHasLabel(Symbol)) Symbol->label = (char*) PchStr(ctx, header, r->label, &fail);
+        else
+            Symbol->offset = r->value;
+    }
+
+    return !fail;
+}
+
+static int PchLoadTypes (PchCTX* ctx, const PchHeader* header, const int32_t* refs)
+{
+    const PchType* records = (const PchType*) ((const char*) ctx->map + header->types.offset);
+
+    for (int i = 0; i < ctx->typeCount; i++)
+    {
+        const PchType* r = &records[i];
+        Type* dt = &ctx->types[i];
+
+        dt->tag = r->tag;
+        dt->qual.isConst = r->isConst;
+
+        if (r->tag == TYPE_BASIC)
+        {
+            if (r->ref < 0 || r->ref >= ctx->symbolCount) return 0;
+
+            dt->basic = &ctx->symbols[r->ref];
+        }
+        else if (r->tag == TYPE_PTR || r->tag == TYPE_ARRAY)
+        {
+            if (r->ref < 0 || r->ref >= ctx->typeCount) return 0;
+
+            dt->base = &ctx->types[r->ref];
+            dt->array = r->array;
+        }
+        else if (r->tag == TYPE_FUNCTION)
+        {
+            if (r->ref < PCH_None || r->ref >= ctx->typeCount
+                || !PchRefsValid(header, refs, r->params, r->paramNo, ctx->typeCount))
+                return 0;
+
+            dt->returnType = r->ref == PCH_None ? 0 : &ctx->types[r->ref];
+            dt->paramTypes = &ctx->params[r->params];
+            dt->params = r->paramNo;
+            dt->variadic = r->variadic;
+
+            for (int j = 0; j < r->paramNo; j++)
+                ctx->params[r->params + j] = &ctx->types[refs[r->params + j]];
+        }
+        else if (r->tag != TYPE_INVALID)
+            return 0;
+    }
+
+    return 1;
+}
+
+//запись заголовка: global и все, что из него достижимо, макросы и защиты
+//файлов препроцессора pp
+int PchWrite (const char* filename, const Symbol* Global, const PPCTX* pp, const char* config)
+{
+    PchWriter w = {.fail = 0};
+    VectorInit(&w.symbols, PCH_MapSize);
+    VectorInit(&w.types, PCH_MapSize);
+    IntMapInit(&w.symbolNo, PCH_MapSize);
+    IntMapInit(&w.typeNo, PCH_MapSize);
+    HashMapInit(&w.stringNo, PCH_MapSize);
+
+    PchNumberSymbols(&w, Global);
+
+    for (int i = 0; i < w.symbols.length; i++)
+    {
+        const Symbol* Symbol = VectorGet(&w.symbols, i);
+
+        if (PchHasType(Symbol)) PchNumberType(&w, Symbol->dt);
+    }
+
+    if (w.fail)
+    {
+        PchWriterFree(&w);
+        return 1;
+    }
+
+    /*раскладка: заголовок, символы, типы, refs, зависимости, строки;
+      строки и refs заполняются при выводе записей, поэтому идут в конце*/
+    int depNo = 0;
+
+    for (int id = 0; id < FileCount(); id++)
+        depNo += PchIsDep(FileGet(id));
+
+    PchHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, pchMagic, sizeof(pchMagic));
+    header.version = PCH_Version;
+    header.global = PchSymbolNo(&w, Global);
+
+    header.symbols.count = w.symbols.length;
+    header.types.count = w.types.length;
+    header.deps.count = depNo;
+
+    PchSymbol* symbols = calloc(w.symbols.length + 1, sizeof(PchSymbol));
+    PchType* types = calloc(w.types.length + 1, sizeof(PchType));
+    PchDep* deps = calloc(depNo + 1, sizeof(PchDep));
+
+    for (int i = 0; i < w.symbols.length; i++)
+        PchPutSymbol(&w, &symbols[i], VectorGet(&w.symbols, i));
+
+    for (int i = 0; i < w.types.length; i++)
+        PchPutType(&w, &types[i], VectorGet(&w.types, i));
+
+    for (int id = 0, i = 0; id < FileCount(); id++)
+    {
+        const FileEntry* entry = FileGet(id);
+        struct stat st;
+
+        if (!PchIsDep(entry)) continue;
+
+        deps[i].path = PchString(&w, entry->name);
+        deps[i].guard = PchString(&w, entry->guard);
+        deps[i].once = entry->once;
+        deps[i].size = stat(entry->name, &st) == 0 ? st.st_size : -1;
+        deps[i].mtime = st.st_mtime;
+        i++;
+    }
+
+    int macrosLength;
+    char* macros = PPMacroText(pp, &macrosLength);
+
+    header.config = PchString(&w, config);
+    header.macros = PchString(&w, macros);
+    header.refs.count = w.refsLength;
+    header.strings.count = w.stringsLength;
+
+    header.symbols.offset = PchAlign(sizeof(PchHeader));
+    header.types.offset = PchAlign(header.symbols.offset + header.symbols.count*sizeof(PchSymbol));
+    header.refs.offset = PchAlign(header.types.offset + header.types.count*sizeof(PchType));
+    header.deps.offset = PchAlign(header.refs.offset + header.refs.count*sizeof(int32_t));
+    header.strings.offset = PchAlign(header.deps.offset + header.deps.count*sizeof(PchDep));
+    header.size = header.strings.offset + header.strings.count;
+
+    char* image = calloc(header.size, 1);
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + header.symbols.offset, symbols, header.symbols.count*sizeof(PchSymbol));
+    memcpy(image + header.types.offset, types, header.types.count*sizeof(PchType));
+    memcpy(image + header.refs.offset, w.refs, header.refs.count*sizeof(int32_t));
+    memcpy(image + header.deps.offset, deps, header.deps.count*sizeof(PchDep));
+    memcpy(image + header.strings.offset, w.strings, header.strings.count);
+
+    /*через временный файл, чтобы параллельная сборка не увидела половину*/
+    char* tmp = malloc(strlen(filename) + 24);
+    sprintf(tmp, "%s.tmp%d", filename, (int) getpid());
+
+    FILE* file = fopen(tmp, "wb");
+    int ok = file && fwrite(image, 1, header.size, file) == (size_t) header.size;
+
+    if (file) ok &= fclose(file) == 0;
+
+    ok = ok && rename(tmp, filename) == 0;
+
+    if (!ok)
+    {
+        unlink(tmp);
+        DebugError("PchWrite", "не удалось записать %s", filename);
+    }
+
+    free(tmp);
+    free(image);
+    free(symbols);
+    free(types);
+    free(deps);
+    PchWriterFree(&w);
+    free(macros);
+    return !ok;
+}
+
+//0, если файла нет, он поврежден, собран с другими настройками или
+//какой-то из его исходных файлов изменился. Макросы и защиты файлов
+//заголовка переходят в pp, который еще не начал разбор
+Symbol* PchLoad (PchCTX* ctx, const char* filename, const char* config, PPCTX* pp)
+{
+    memset(ctx, 0, sizeof(PchCTX));
+
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0) return 0;
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(PchHeader))
+    {
+        close(fd);
+        return 0;
+    }
+
+    ctx->size = st.st_size;
+    ctx->map = mmap(0, ctx->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (ctx->map == MAP_FAILED)
+    {
+        ctx->map = 0;
+        return 0;
+    }
+
+    const PchHeader* header = ctx->map;
+    const char* base = ctx->map;
+    int fail = 0;
+
+    if (   memcmp(header->magic, pchMagic, sizeof(pchMagic)) || header->version != PCH_Version
+        || header->size != ctx->size
+        || !PchSectionValid(ctx, header->symbols, sizeof(PchSymbol))
+        || !PchSectionValid(ctx, header->types, sizeof(PchType))
+        || !PchSectionValid(ctx, header->refs, sizeof(int32_t))
+        || !PchSectionValid(ctx, header->deps, sizeof(PchDep))
+        || !PchSectionValid(ctx, header->strings, 1)
+        || header->strings.count == 0 || base[header->strings.offset + header->strings.count - 1] != 0
+        || header->global < 0 || header->global >= header->symbols.count)
+    {
+        PchFree(ctx);
+        return 0;
+    }
+
+    const char* key = PchStr(ctx, header, header->config, &fail);
+    const char* macros = PchStr(ctx, header, header->macros, &fail);
+
+    if (fail || !key || !macros || strcmp(key, config) || !PchDepsFresh(ctx, header))
+    {
+        PchFree(ctx);
+        return 0;
+    }
+
+    /*все записи восстанавливаются за один проход, без разбора исходного текста*/
+    const int32_t* refs = (const int32_t*) (base + header->refs.offset);
+
+    ctx->symbolCount = header->symbols.count;
+    ctx->typeCount = header->types.count;
+    ctx->symbols = calloc(ctx->symbolCount, sizeof(Symbol));
+    ctx->types = calloc(ctx->typeCount + 1, sizeof(Type));
+    ctx->params = calloc(header->refs.count + 1, sizeof(Type*));
+
+    if (!PchLoadTypes(ctx, header, refs) || !PchLoadSymbols(ctx, header, refs))
+    {
+        PchFree(ctx);
+        return 0;
+    }
+
+    PchRestorePP(ctx, header, macros, pp);
+
+    ctx->global = &ctx->symbols[header->global];
+    return ctx->global;
+}
+
+void PchFree (PchCTX* ctx)
+{
+    for (int i = 0; ctx->symbols && i < ctx->symbolCount; i++)
+    {
+        VectorFree(&ctx->symbols[i].decls);
+        VectorFree(&ctx->symbols[i].children);
+    }
+
+    free(ctx->symbols);
+    free(ctx->types);
+    free(ctx->params);
+
+    if (ctx->map) munmap(ctx->map, ctx->size);
+
+    memset(ctx, 0, sizeof(PchCTX));
+}
@@ -0,0 +1,299 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include "..\include\pp.h"
+
+//вычисление выражений #if: defined и макросы уже заменены,
+//оставшиеся идентификаторы равны нулю
+typedef struct PPExpr {
+    const PPToken* tokens;
+    int length;
+    int pos;
+
+    int dead;               //внутри невычисляемого операнда && || ?:
+    const char* error;
+} PPExpr;
+
+//значение типа intmax_t или uintmax_t (6.10.1p4); арифметика - в unsigned,
+//чтобы переполнение знакового не было неопределенным
+typedef struct PPValue {
+    unsigned long long value;
+    int isUnsigned;
+} PPValue;
+
+//внутренние функции
+static PPValue PPExprTernary (PPExpr* e);
+
+static PPValue PPExprSigned (long long value)
+{
+    return (PPValue) {(unsigned long long) value, 0};
+}
+
+static const PPToken* PPExprPeek (const PPExpr* e)
+{
+    return e->pos < e->length ? &e->tokens[e->pos] : 0;
+}
+
+static int PPExprIsPunct (const PPExpr* e, PUNCT_TAG punct)
+{
+    const PPToken* t = PPExprPeek(e);
+    return t && t->tag == TOK_PUNCT && t->sub == punct;
+}
+
+static void PPExprFail (PPExpr* e, const char* message)
+{
+    if (!e->error) e->error = message;
+
+    e->pos = e->length;
+}
+
+//с суффиксом u или не входящее в intmax_t - беззнаковое
+static PPValue PPExprNumber (PPExpr* e, const PPToken* t)
+{
+    char buffer[64];
+
+    if (t->length >= (int) sizeof(buffer))
+    {
+        PPExprFail(e, "слишком длинное число");
+        return PPExprSigned(0);
+    }
+
+    memcpy(buffer, t->text, t->length);
+    buffer[t->length] = 0;
+
+    char* end;
+    PPValue result = {strtoull(buffer, &end, 0), 0};
+
+    result.isUnsigned = result.value > LLONG_MAX;
+
+    /*суффиксы u, l, ll*/
+    for (; *end == 'u' || *end == 'U' || *end == 'l' || *end == 'L'; end++)
+        result.isUnsigned |= *end == 'u' || *end == 'U';
+
+    if (*end) PPExprFail(e, "неверная целая константа");
+
+    return result;
+}
+
+static PPValue PPExprChar (PPExpr* e, const PPToken* t)
+{
+    const char* c = t->text + 1;
+
+    if (t->length < 3 || t->text[t->length - 1] != '\'')
+    {
+        PPExprFail(e, "неверная символьная константа");
+        return PPExprSigned(0);
+    }
+
+    if (*c != '\\') return PPExprSigned((unsigned char) *c);
+
+    switch (c[1])
+    {
+        case 'n': return PPExprSigned('\n');
+        case 't': return PPExprSigned('\t');
+        case 'r': return PPExprSigned('\r');
+        case 'a': return PPExprSigned('\a');
+        case 'b': return PPExprSigned('\b');
+        case 'f': return PPExprSigned('\f');
+        case 'v': return PPExprSigned('\v');
+        case 'x': return PPExprSigned(strtol(c + 2, 0, 16));
+        default:
+            return PPExprSigned(isdigit(c[1]) ? strtol(c + 1, 0, 8) : c[1]);
+    }
+}
+
+static PPValue PPExprUnary (PPExpr* e)
+{
+    const PPToken* t = PPExprPeek(e);
+
+    if (!t)
+    {
+        PPExprFail(e, "неожиданный конец выражения");
+        return PPExprSigned(0);
+    }
+
+    e->pos++;
+
+    if (t->tag == TOK_INT) return PPExprNumber(e, t);
+    else if (t->tag == TOK_CHR) return PPExprChar(e, t);
+    else if (t->tag == TOK_FLOAT)
+    {
+        PPExprFail(e, "плавающая константа в #if");
+        return PPExprSigned(0);
+    }
+    else if (t->tag == TOK_IDENT || t->tag == TOK_KEYWORD) return PPExprSigned(0);
+
+    else if (t->tag != TOK_PUNCT)
+    {
+        PPExprFail(e, "неожиданный токен в выражении");
+        return PPExprSigned(0);
+    }
+
+    PPValue operand;
+
+    switch (t->sub)
+    {
+        case PUNCT_PLUS: return PPExprUnary(e);
+
+        case PUNCT_MIN:
+            operand = PPExprUnary(e);
+            operand.value = -operand.value;
+            return operand;
+
+        case PUNCT_NOT: return PPExprSigned(!PPExprUnary(e).value);
+
+        case PUNCT_TILDE:
+            operand = PPExprUnary(e);
+            operand.value = ~operand.value;
+            return operand;
+
+        case PUNCT_LPAREN:
+        {
+            PPValue value = PPExprTernary(e);
+
+            if (PPExprIsPunct(e, PUNCT_RPAREN)) e->pos++;
+            else PPExprFail(e, "ожидалась ')'");
+
+            return value;
+        }
+
+        default:
+            PPExprFail(e, "неожиданный токен в выражении");
+            return PPExprSigned(0);
+    }
+}
+
+//приоритет бинарного оператора, 0 - не оператор
+static int PPExprPrec (const PPToken* t)
+{
+    if (!t || t->tag != TOK_PUNCT) return 0;
+
+    switch (t->sub)
+    {
+        case PUNCT_MUL: case PUNCT_DIV: case PUNCT_MOD: return 10;
+        case PUNCT_PLUS: case PUNCT_MIN: return 9;
+        case PUNCT_SHL: case PUNCT_SHR: return 8;
+        case PUNCT_LT: case PUNCT_GT: case PUNCT_LE: case PUNCT_GE: return 7;
+        case PUNCT_EQ: case PUNCT_NEQ: return 6;
+        case PUNCT_AND: return 5;
+        case PUNCT_XOR: return 4;
+        case PUNCT_OR: return 3;
+        case PUNCT_ANDAND: return 2;
+        case PUNCT_OROR: return 1;
+        default: return 0;
+    }
+}
+
+//обычные арифметические преобразования: беззнаковый операнд делает
+//беззнаковыми оба; сдвиг берет тип левого, сравнения дают знаковый 0 или 1
+static PPValue PPExprApply (PPExpr* e, PUNCT_TAG o, PPValue l, PPValue r)
+{
+    int isUnsigned = l.isUnsigned || r.isUnsigned;
+    unsigned long long a = l.value, b = r.value;
+    long long sa = (long long) a, sb = (long long) b;
+
+    switch (o)
+    {
+        case PUNCT_MUL: return (PPValue) {a * b, isUnsigned};
+        case PUNCT_DIV:
+        case PUNCT_MOD:
+            if (b == 0)
+            {
+                if (!e->dead) PPExprFail(e, "деление на ноль в #if");
+                return PPExprSigned(0);
+            }
+
+            if (isUnsigned) return (PPValue) {o == PUNCT_DIV ? a / b : a % b, 1};
+
+            /*LLONG_MIN / -1 не представимо: как и сложение, по модулю*/
+            if (sb == -1) return PPExprSigned(o == PUNCT_DIV ? (long long) -a : 0);
+
+            return PPExprSigned(o == PUNCT_DIV ? sa / sb : sa % sb);
+
+        case PUNCT_PLUS: return (PPValue) {a + b, isUnsigned};
+        case PUNCT_MIN: return (PPValue) {a - b, isUnsigned};
+        case PUNCT_SHL: return (PPValue) {a << (b & 63), l.isUnsigned};
+        case PUNCT_SHR: return (PPValue) {l.isUnsigned ? a >> (b & 63) : (unsigned long long) (sa >> (b & 63)), l.isUnsigned};
+        case PUNCT_LT: return PPExprSigned(isUnsigned ? a < b : sa < sb);
+        case PUNCT_GT: return PPExprSigned(isUnsigned ? a > b : sa > sb);
+        case PUNCT_LE: return PPExprSigned(isUnsigned ? a <= b : sa <= sb);
+        case PUNCT_GE: return PPExprSigned(isUnsigned ? a >= b : sa >= sb);
+        case PUNCT_EQ: return PPExprSigned(a == b);
+        case PUNCT_NEQ: return PPExprSigned(a != b);
+        case PUNCT_AND: return (PPValue) {a & b, isUnsigned};
+        case PUNCT_XOR: return (PPValue) {a ^ b, isUnsigned};
+        case PUNCT_OR: return (PPValue) {a | b, isUnsigned};
+        default: return PPExprSigned(0);
+    }
+}
+
+//восхождение по приоритетам: все бинарные операторы левоассоциативны
+static PPValue PPExprBinary (PPExpr* e, int minPrec)
+{
+    PPValue l = PPExprUnary(e);
+
+    for (int prec = PPExprPrec(PPExprPeek(e)); prec >= minPrec; prec = PPExprPrec(PPExprPeek(e)))
+    {
+        PUNCT_TAG o = PPExprPeek(e)->sub;
+        e->pos++;
+
+        /*правый операнд && и || вычисляется только для проверки синтаксиса*/
+        int skip = (o == PUNCT_ANDAND && !l.value) || (o == PUNCT_OROR && l.value);
+
+        e->dead += skip;
+        PPValue r = PPExprBinary(e, prec + 1);
+        e->dead -= skip;
+
+        if (o == PUNCT_ANDAND) l = PPExprSigned(l.value && r.value);
+        else if (o == PUNCT_OROR) l = PPExprSigned(l.value || r.value);
+        else l = PPExprApply(e, o, l, r);
+    }
+
+    return l;
+}
+
+static PPValue PPExprTernary (PPExpr* e)
+{
+    PPValue cond = PPExprBinary(e, 1);
+
+    if (!PPExprIsPunct(e, PUNCT_QUESTION)) return cond;
+
+    e->pos++;
+
+    e->dead += !cond.value;
+    PPValue l = PPExprTernary(e);
+    e->dead -= !cond.value;
+
+    if (PPExprIsPunct(e, PUNCT_COLON)) e->pos++;
+    else PPExprFail(e, "ожидалось ':'");
+
+    e->dead += !!cond.value;
+    PPValue r = PPExprTernary(e);
+    e->dead -= !!cond.value;
+
+    /*тип результата - общий для обеих ветвей*/
+    PPValue result = cond.value ? l : r;
+    result.isUnsigned = l.isUnsigned || r.isUnsigned;
+    return result;
+}
+
+int PPEval (const PPToken* tokens, int length, long long* value, const char** message)
+{
+    PPExpr e = {tokens, length, 0, 0, 0};
+
+    if (length == 0)
+    {
+        *message = "пустое выражение в #if";
+        return 0;
+    }
+
+    *value = (long long) PPExprTernary(&e).value;
+
+    if (!e.error && e.pos < e.length)
+        e.error = "лишние токены в конце выражения";
+
+    *message = e.error;
+    return e.error == 0;
+}
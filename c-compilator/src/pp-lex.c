@@ -0,0 +1,324 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "..\include\pp.h"
+#include "..\include\lexer.h"
+#include "..\include\stream.h"
+
+enum {
+    PP_LexChunkMin = 1 << 20,   //меньше этого на поток - не делить
+    PP_LexMaxThreads = 16,
+    PP_LexUnknown = -1          //состояние не определено: граница внутри шага
+};
+
+//состояния автомата, повторяющего пропуск пробелов, комментариев и
+//строк в лексере; токены других видов перевод строки не пересекают
+typedef enum PP_SCAN {
+    PP_SCAN_NORMAL,
+    PP_SCAN_COMMENT,        /* ... */
+    PP_SCAN_LINECOMMENT,    // ...
+    PP_SCAN_HASHCOMMENT,    //# без препроцессора
+    PP_SCAN_STRING,
+    PP_SCAN_CHAR
+} PP_SCAN;
+
+//кусок текста: сначала - отрезок для прохода состояний, затем - для лексера
+typedef struct PPLexChunk {
+    const char* text;       //весь файл
+    int length;
+    int start;
+    int end;
+    int file;
+    int directives;
+
+    int exit[2];            //состояние в end при входе в NORMAL и в COMMENT
+
+    PPToken* tokens;
+    int count;
+    int lines;              //переводов строки в куске
+} PPLexChunk;
+
+//внутренние функции
+static PPToken* PPLexRange (int file, const char* text, int length, int directives, int* count)
+{
+    LexerCTX* lexer = LexerInitStream(StreamInitText(text, length), directives);
+    int capacity = 64;
+    PPToken* tokens = malloc(sizeof(PPToken) * capacity);
+    int n = 0;
+
+    for (LexerNext(lexer); lexer->token != TOK_EOF; LexerNext(lexer))
+    {
+        if (n == capacity) tokens = realloc(tokens, sizeof(PPToken) * (capacity *= 2));
+
+        tokens[n++] = (PPToken) {
+            lexer->token, lexer->token == TOK_KEYWORD ? (int) lexer->keyword : (int) lexer->punct,
+            lexer->text, lexer->textLength,
+            (lexer->bol ? PPTOKEN_BOL : 0) | (lexer->space ? PPTOKEN_SPACE : 0),
+            file, lexer->line, lexer->lineChar, 0
+        };
+    }
+
+    LexerEnd(lexer);
+
+    *count = n;
+    return tokens;
+}
+
+//один шаг автомата; возвращает новую позицию
+static int PPScanStep (const PPLexChunk* chunk, int pos, int* state)
+{
+    char c = chunk->text[pos];
+    char next = pos + 1 < chunk->length ? chunk->text[pos + 1] : 0;
+
+    switch (*state)
+    {
+        case PP_SCAN_NORMAL:
+            if (c == '/' && next == '*')
+            {
+                *state = PP_SCAN_COMMENT;
+                return pos + 2;
+            }
+            else if (c == '/' && next == '/')
+            {
+                *state = PP_SCAN_LINECOMMENT;
+                return pos + 2;
+            }
+            else if (c == '#' && !chunk->directives) *state = PP_SCAN_HASHCOMMENT;
+            else if (c == '"') *state = PP_SCAN_STRING;
+            else if (c == '\'') *state = PP_SCAN_CHAR;
+
+            /*продолжение строки, как в LexerSkipInsignificants*/
+            else if (c == '\\' && (next == '\n' || next == '\r'))
+            {
+                pos++;
+
+                if (pos < chunk->length && chunk->text[pos] == '\r') pos++;
+                if (pos < chunk->length && chunk->text[pos] == '\n') pos++;
+
+                return pos;
+            }
+
+            return pos + 1;
+
+        case PP_SCAN_COMMENT:
+            if (c == '*' && next == '/')
+            {
+                *state = PP_SCAN_NORMAL;
+                return pos + 2;
+            }
+
+            return pos + 1;
+
+        case PP_SCAN_LINECOMMENT:
+        case PP_SCAN_HASHCOMMENT:
+            /*сам перевод строки пропускается уже как пробел*/
+            if (c == '\n' || (c == '\r' && *state == PP_SCAN_LINECOMMENT))
+            {
+                *state = PP_SCAN_NORMAL;
+                return pos;
+            }
+
+            return pos + 1;
+
+        default:
+            /*незакрытая строка заканчивается в конце строки*/
+            if (c == '\n')
+            {
+                *state = PP_SCAN_NORMAL;
+                return pos;
+            }
+            else if (c == (*state == PP_SCAN_STRING ? '"' : '\''))
+                *state = PP_SCAN_NORMAL;
+
+            else if (c == '\\')
+                return pos + 2;
+
+            return pos + 1;
+    }
+}
+
+//спекулятивный проход: начало отрезка может оказаться и вне комментария,
+//и внутри него; оба пути идут вместе, пока не сойдутся
+static void* PPScanWorker (void* arg)
+{
+    PPLexChunk* chunk = arg;
+    int posA = chunk->start, stateA = PP_SCAN_NORMAL;
+    int posB = chunk->start, stateB = PP_SCAN_COMMENT;
+    int same = 0;
+
+    while (posA < chunk->end)
+    {
+        if (!same && posB <= posA)
+        {
+            if (posB == posA && stateB == stateA) same = 1;
+            else
+            {
+                posB = PPScanStep(chunk, posB, &stateB);
+                continue;
+            }
+        }
+
+        posA = PPScanStep(chunk, posA, &stateA);
+    }
+
+    while (!same && posB < chunk->end)
+        posB = PPScanStep(chunk, posB, &stateB);
+
+    chunk->exit[0] = posA == chunk->end ? stateA : PP_LexUnknown;
+    chunk->exit[1] = same ? chunk->exit[0] : posB == chunk->end ? stateB : PP_LexUnknown;
+    return 0;
+}
+
+static void* PPLexWorker (void* arg)
+{
+    PPLexChunk* chunk = arg;
+
+    chunk->tokens = PPLexRange(chunk->file, chunk->text + chunk->start, chunk->end - chunk->start,
+                               chunk->directives, &chunk->count);
+
+    chunk->lines = 0;
+
+    for (const char* c = chunk->text + chunk->start, *end = chunk->text + chunk->end;
+         (c = memchr(c, '\n', end - c)); c++)
+        chunk->lines++;
+
+    return 0;
+}
+
+static void PPRunWorkers (PPLexChunk* chunks, int n, void* (*worker)(void*))
+{
+    pthread_t* threads = malloc(sizeof(pthread_t) * n);
+    int* started = calloc(n, sizeof(int));
+
+    for (int i = 1; i < n; i++)
+        started[i] = pthread_create(&threads[i], 0, worker, &chunks[i]) == 0;
+
+    /*первый кусок - в своем потоке; не запустившиеся - тоже здесь*/
+    worker(&chunks[0]);
+
+    for (int i = 1; i < n; i++)
+    {
+        if (started[i]) pthread_join(threads[i], 0);
+        else
+            worker(&chunks[i]);
+    }
+
+    free(started);
+    free(threads);
+}
+
+//граница куска: сразу после перевода строки, не продолженного '\'
+static int PPLexSplitPoint (const char* text, int length, int from)
+{
+    for (const char* c = text + from; c < text + length && (c = memchr(c, '\n', text + length - c)); c++)
+    {
+        int pos = c - text;
+        int prev = pos > 0 && text[pos - 1] == '\r' ? pos - 2 : pos - 1;
+
+        if (prev < 0 || text[prev] != '\\') return pos + 1;
+    }
+
+    return length;
+}
+
+static int PPLexThreads (int length)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = length / PP_LexChunkMin;
+
+    if (cores < threads) threads = cores;
+
+    return threads < PP_LexMaxThreads ? threads : PP_LexMaxThreads;
+}
+
+//границы по отрезкам: следующий кусок начинается только там, где
+//известный на входе автомат оказывается вне комментария
+static int PPLexParallel (PPLexChunk* ranges, int n, PPLexChunk* chunks)
+{
+    PPRunWorkers(ranges, n, PPScanWorker);
+
+    int state = PP_SCAN_NORMAL, chunkNo = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (i == 0 || state == PP_SCAN_NORMAL)
+            chunks[chunkNo++] = ranges[i];
+        else
+            chunks[chunkNo - 1].end = ranges[i].end;
+
+        state = ranges[i].exit[state == PP_SCAN_COMMENT];
+
+        if (state != PP_SCAN_NORMAL && state != PP_SCAN_COMMENT) return 0;
+    }
+
+    PPRunWorkers(chunks, chunkNo, PPLexWorker);
+    return chunkNo;
+}
+
+//токены текста файла; большие файлы разбираются кусками параллельно,
+//результат тот же, что у последовательного LexerNext
+PPToken* PPLexText (int file, const char* text, int length, int* count)
+{
+    int threads = PPLexThreads(length);
+
+    /*внутри комментария после '\0' лексер ведет себя особо - не делим*/
+    if (threads < 2 || memchr(text, 0, length))
+        return PPLexRange(file, text, length, 1, count);
+
+    PPLexChunk* ranges = calloc(threads, sizeof(PPLexChunk));
+    PPLexChunk* chunks = calloc(threads, sizeof(PPLexChunk));
+    int n = 0;
+
+    for (int i = 0, start = 0; i < threads && start < length; i++)
+    {
+        int end = i + 1 == threads ? length : PPLexSplitPoint(text, length, (long long) length * (i + 1) / threads);
+
+        if (end <= start) continue;
+
+        ranges[n++] = (PPLexChunk) {text, length, start, end, file, 1};
+        start = end;
+    }
+
+    int chunkNo = PPLexParallel(ranges, n, chunks);
+
+    if (chunkNo == 0)
+    {
+        free(ranges);
+        free(chunks);
+        return PPLexRange(file, text, length, 1, count);
+    }
+
+    /*сшивка: строки сдвигаются на число строк в предыдущих кусках; первый
+      токен куска шел после перевода строки, то есть после пробела*/
+    int total = 0;
+
+    for (int i = 0; i < chunkNo; i++)
+        total += chunks[i].count;
+
+    PPToken* tokens = malloc(sizeof(PPToken) * (total ? total : 1));
+    int at = 0, lines = 0;
+
+    for (int i = 0; i < chunkNo; i++)
+    {
+        for (int j = 0; j < chunks[i].count; j++)
+        {
+            PPToken* token = &tokens[at++];
+
+            *token = chunks[i].tokens[j];
+            token->line += lines;
+
+            if (i > 0 && j == 0) token->flags |= PPTOKEN_SPACE;
+        }
+
+        lines += chunks[i].lines;
+        free(chunks[i].tokens);
+    }
+
+    free(ranges);
+    free(chunks);
+
+    *count = total;
+    return tokens;
+}
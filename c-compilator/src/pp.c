@@ -0,0 +1,1572 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "..\include\pp.h"
+#include "..\include\lexer.h"
+#include "..\include\stream.h"
+#include "..\include\file.h"
+#include "..\include\vector.h"
+#include "..\include\hashmap.h"
+#include "..\include\error.h"
+#include "..\include\debug.h"
+#include "..\include\timer.h"
+
+enum {
+    PP_MapSize = 256,
+    PP_MaxIncludeDepth = 200,
+    PP_MaxIdentLength = 256
+};
+
+//аргумент функционального макроса
+typedef struct PPArg {
+    const PPToken* tokens;
+    int length;
+
+    PPToken* expanded;      //полностью раскрытый, считается при первой надобности
+    int expandedLength;
+    int done;
+} PPArg;
+
+//растущий массив токенов
+typedef struct PPTokens {
+    PPToken* buffer;
+    int length;
+    int capacity;
+} PPTokens;
+
+//внутренние функции
+static int PPExpand (PPCTX* ctx, PPToken* out, int barrier);
+
+static void PPTokensInit (PPTokens* list, int capacity)
+{
+    list->buffer = malloc(sizeof(PPToken) * capacity);
+    list->length = 0;
+    list->capacity = capacity;
+}
+
+static PPToken* PPTokensPush (PPTokens* list, const PPToken* token)
+{
+    if (list->length == list->capacity)
+        list->buffer = realloc(list->buffer, sizeof(PPToken) * (list->capacity *= 2));
+
+    list->buffer[list->length] = *token;
+    return &list->buffer[list->length++];
+}
+
+static void PPTokensPushArray (PPTokens* list, const PPToken* tokens, int length)
+{
+    for (int i = 0; i < length; i++)
+        PPTokensPush(list, &tokens[i]);
+}
+
+static int PPIsPunct (const PPToken* t, PUNCT_TAG punct)
+{
+    return t->tag == TOK_PUNCT && t->sub == punct;
+}
+
+static int PPIsName (const PPToken* t)
+{
+    return t->tag == TOK_IDENT || t->tag == TOK_KEYWORD;
+}
+
+static int PPIs (const PPToken* t, const char* str)
+{
+    int length = strlen(str);
+    return t->length == length && !memcmp(t->text, str, length);
+}
+
+static int PPSameSpelling (const PPToken* l, const PPToken* r)
+{
+    return l->length == r->length && !memcmp(l->text, r->text, l->length);
+}
+
+//'#' в начале строки файла
+static int PPIsDirectiveStart (const PPToken* t)
+{
+    return PPIsPunct(t, PUNCT_HASH) && (t->flags & PPTOKEN_BOL);
+}
+
+//строка в пуле: живет до PPFree
+static char* PPPoolStr (PPCTX* ctx, const char* str, int length)
+{
+    char* copy = malloc(length + 1);
+    memcpy(copy, str, length);
+    copy[length] = 0;
+
+    VectorPush(&ctx->pool, copy);
+    return copy;
+}
+
+//копия написания токена для сообщений
+static const char* PPTokenStr (const PPToken* t, char* buffer, int size)
+{
+    snprintf(buffer, size, "%.*s", t->length, t->text);
+    return buffer;
+}
+
+static void PPDiag (PPCTX* ctx, const PPToken* at, int error, const char* message, const char* detail)
+{
+    if (error) ctx->errors++;
+    else ctx->warnings++;
+
+    if (ctx->silent) return;
+
+    const char* filename = at ? FileName(at->file) : ctx->input;
+
+    ErrorF("$h:$d:$d: $r: $s", filename, at ? at->line : 0, at ? at->lineChar : 0,
+           error ? "ошибка" : "предупреждение", message);
+
+    if (detail) ErrorF(" '$s'", detail);
+
+    ErrorF("\n");
+}
+
+static void PPError (PPCTX* ctx, const PPToken* at, const char* message, const PPToken* detail)
+{
+    char buffer[PP_MaxIdentLength];
+    PPDiag(ctx, at, 1, message, detail ? PPTokenStr(detail, buffer, sizeof(buffer)) : 0);
+}
+
+//--- наборы скрытия ---
+static int PPHideHas (const PPHideSet* hide, const PPMacro* macro)
+{
+    for (; hide; hide = hide->next)
+        if (hide->macro == macro) return 1;
+
+    return 0;
+}
+
+static const PPHideSet* PPHideAdd (PPCTX* ctx, const PPHideSet* hide, const PPMacro* macro)
+{
+    if (PPHideHas(hide, macro)) return hide;
+
+    PPHideSet* node = malloc(sizeof(PPHideSet));
+    node->macro = macro;
+    node->next = hide;
+
+    VectorPush(&ctx->pool, node);
+    return node;
+}
+
+//наборы неизменяемы, поэтому общий хвост не копируется
+static const PPHideSet* PPHideUnion (PPCTX* ctx, const PPHideSet* l, const PPHideSet* r)
+{
+    if (!l) return r;
+
+    for (; l; l = l->next)
+        r = PPHideAdd(ctx, r, l->macro);
+
+    return r;
+}
+
+static const PPHideSet* PPHideIntersect (PPCTX* ctx, const PPHideSet* l, const PPHideSet* r)
+{
+    const PPHideSet* result = 0;
+
+    for (; l; l = l->next)
+        if (PPHideHas(r, l->macro))
+            result = PPHideAdd(ctx, result, l->macro);
+
+    return result;
+}
+
+//--- файлы и источники ---
+static void PPFileDestroy (PPFile* file)
+{
+    if (!file) return;
+
+    free(file->tokens);
+    free(file);
+}
+
+static int PPLookDirective (const PPToken* t)
+{
+    static const struct {
+        const char* name;
+        int directive;
+    } directives[] = {
+        {"define", PP_DEFINE},
+        {"undef", PP_UNDEF},
+        {"ifdef", PP_IFDEF},
+        {"ifndef", PP_IFNDEF},
+        {"if", PP_IF},
+        {"else", PP_ELSE},
+        {"elif", PP_ELIF},
+        {"endif", PP_ENDIF},
+        {"include", PP_INCLUDE},
+        {"warning", PP_WARNING},
+        {"error", PP_ERROR},
+        {"line", PP_LINE},
+        {"pragma", PP_PRAGMA}
+    };
+
+    /*GNU: # 12 "file" - то же, что #line*/
+    if (t->tag == TOK_INT) return PP_LINE;
+
+    if (!PPIsName(t)) return 0;
+
+    for (int i = 0; i < (int) (sizeof(directives) / sizeof(*directives)); i++)
+        if (PPIs(t, directives[i].name)) return directives[i].directive;
+
+    return 0;
+}
+
+static int PPLineEnd (const PPToken* tokens, int count, int pos)
+{
+    while (pos < count && !(tokens[pos].flags & PPTOKEN_BOL))
+        pos++;
+
+    return pos;
+}
+
+//#ifndef X ... #endif (или #if !defined X) вокруг всего файла
+static int PPDetectGuard (const PPToken* t, int count, char* guard, int size)
+{
+    int name;
+
+    if (count < 3 || !PPIsDirectiveStart(t)) return 0;
+
+    if (PPIs(&t[1], "ifndef"))
+        name = 2;
+
+    else if (count >= 5 && PPIs(&t[1], "if") && PPIsPunct(&t[2], PUNCT_NOT) && PPIs(&t[3], "defined"))
+        name = PPIsPunct(&t[4], PUNCT_LPAREN) ? 5 : 4;
+
+    else
+        return 0;
+
+    int end = PPLineEnd(t, count, 1);
+
+    if (name >= end || !PPIsName(&t[name]) || end - name != (name == 5 ? 2 : 1))
+        return 0;
+
+    /*парный #endif должен закрывать файл*/
+    int depth = 1;
+
+    for (int i = end; i < count; i = PPLineEnd(t, count, i + 1))
+    {
+        if (!PPIsDirectiveStart(&t[i]) || i + 1 == count) continue;
+
+        int directive = PPLookDirective(&t[i + 1]);
+
+        if (directive == PP_IF || directive == PP_IFDEF || directive == PP_IFNDEF)
+            depth++;
+
+        else if ((directive == PP_ELSE || directive == PP_ELIF) && depth == 1)
+            return 0;
+
+        else if (directive == PP_ENDIF && --depth == 0)
+        {
+            /*усеченное имя совпало бы с чужим макросом*/
+            if (PPLineEnd(t, count, i + 1) != count || t[name].length >= size) return 0;
+
+            snprintf(guard, size, "%.*s", t[name].length, t[name].text);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//токены файла; при первом разборе в процессе запоминается защита
+static PPFile* PPGetFile (PPCTX* ctx, int id)
+{
+    while (ctx->files.length <= id)
+        VectorPush(&ctx->files, 0);
+
+    PPFile* file = VectorGet(&ctx->files, id);
+
+    if (file) return file;
+
+    const FileEntry* entry = FileGet(id);
+
+    file = malloc(sizeof(PPFile));
+    file->id = id;
+    TimerEnter(TIMER_LEX, entry->name);
+    file->tokens = PPLexText(id, entry->text, entry->length, &file->count);
+    TimerLeave();
+    VectorSet(&ctx->files, id, file);
+
+    if (!entry->guardKnown)
+    {
+        char guard[PP_MaxIdentLength];
+        FileSetGuard(id, PPDetectGuard(file->tokens, file->count, guard, sizeof(guard)) ? guard : 0);
+    }
+
+    return file;
+}
+
+static void PPMacroDestroy (PPMacro* macro)
+{
+    free(macro->params);
+    free(macro);
+}
+
+static void PPMacroKeyDtor (char* key, const void* value)
+{
+    (void) value;
+    free(key);
+}
+
+static PPSource* PPPush (PPCTX* ctx, const PPToken* tokens, int length, PPToken* owned)
+{
+    PPSource* src = calloc(1, sizeof(PPSource));
+    src->tokens = tokens;
+    src->length = length;
+    src->owned = owned;
+
+    VectorPush(&ctx->sources, src);
+    return src;
+}
+
+static void PPPushFile (PPCTX* ctx, PPFile* file)
+{
+    PPSource* src = PPPush(ctx, file->tokens, file->count, 0);
+    src->file = file;
+    src->conds = ctx->conds.length;
+    src->fileId = file->id;
+
+    IntSetAdd(&ctx->entered, file->id + 1);
+}
+
+static int PPFileDepth (const PPCTX* ctx)
+{
+    int depth = 0;
+
+    for (int i = 0; i < ctx->sources.length; i++)
+        depth += ((PPSource*) VectorGet(&ctx->sources, i))->file != 0;
+
+    return depth;
+}
+
+static void PPPop (PPCTX* ctx)
+{
+    PPSource* src = VectorPop(&ctx->sources);
+
+    /*незакрытые #if файла не переходят во включающий файл*/
+    if (src->file)
+    {
+        while (ctx->conds.length > src->conds)
+        {
+            free(VectorPop(&ctx->conds));
+
+            PPToken at = {0};
+            at.file = src->fileId;
+            at.line = src->length ? src->tokens[src->length - 1].line + src->lineDelta : 1;
+            PPError(ctx, &at, "незакрытый #if в конце файла", 0);
+        }
+    }
+
+    free(src->owned);
+    free(src);
+}
+
+//следующий токен без раскрытия; источники ниже barrier не трогаются
+static PPSource* PPRead (PPCTX* ctx, PPToken* out, int barrier)
+{
+    while (ctx->sources.length > barrier)
+    {
+        PPSource* src = VectorGet(&ctx->sources, ctx->sources.length - 1);
+
+        if (src->pos < src->length)
+        {
+            *out = src->tokens[src->pos++];
+
+            if (src->file)
+            {
+                out->file = src->fileId;
+                out->line += src->lineDelta;
+            }
+
+            return src;
+        }
+
+        PPPop(ctx);
+    }
+
+    return 0;
+}
+
+//следующий токен, не снимая источники; за конец файла не заглядывает
+static const PPToken* PPPeek (const PPCTX* ctx, int barrier)
+{
+    for (int i = ctx->sources.length - 1; i >= barrier; i--)
+    {
+        const PPSource* src = VectorGet(&ctx->sources, i);
+
+        if (src->pos < src->length) return &src->tokens[src->pos];
+        else if (src->file) return 0;
+    }
+
+    return 0;
+}
+
+//--- макросы ---
+//длинные имена копируются в кучу: ограничения на длину имени макроса нет
+static PPMacro* PPLookup (const PPCTX* ctx, const PPToken* t)
+{
+    if (!PPIsName(t)) return 0;
+
+    char buffer[PP_MaxIdentLength];
+    char* name = t->length < PP_MaxIdentLength ? buffer : malloc(t->length + 1);
+
+    memcpy(name, t->text, t->length);
+    name[t->length] = 0;
+
+    PPMacro* macro = HashMapMap(&ctx->macros, name);
+
+    if (name != buffer) free(name);
+
+    return macro && macro->defined ? macro : 0;
+}
+
+static PPMacro* PPMacroGet (PPCTX* ctx, const char* name, int length)
+{
+    char* key = PPPoolStr(ctx, name, length);
+    PPMacro* macro = HashMapMap(&ctx->macros, key);
+
+    if (macro) return macro;
+
+    /*ключ принадлежит таблице*/
+    VectorPop(&ctx->pool);
+
+    macro = calloc(1, sizeof(PPMacro));
+    macro->name = key;
+    HashMapAdd(&ctx->macros, key, macro);
+    return macro;
+}
+
+static int PPParamIndex (const PPMacro* macro, const PPToken* t)
+{
+    if (!macro->function || !PPIsName(t)) return -1;
+
+    for (int i = 0; i < macro->paramNo; i++)
+        if (PPSameSpelling(&macro->params[i], t)) return i;
+
+    return -1;
+}
+
+//повторное определение допустимо, только если оно совпадает (6.10.3p2)
+static int PPMacroEqual (const PPMacro* l, const PPMacro* r)
+{
+    if (l->function != r->function || l->variadic != r->variadic
+        || l->paramNo != r->paramNo || l->length != r->length)
+        return 0;
+
+    for (int i = 0; i < l->paramNo; i++)
+        if (!PPSameSpelling(&l->params[i], &r->params[i])) return 0;
+
+    for (int i = 0; i < l->length; i++)
+    {
+        if (!PPSameSpelling(&l->body[i], &r->body[i])) return 0;
+
+        if (i && (l->body[i].flags & PPTOKEN_SPACE) != (r->body[i].flags & PPTOKEN_SPACE))
+            return 0;
+    }
+
+    return 1;
+}
+
+static void PPDirectiveDefine (PPCTX* ctx, const PPToken* at, const PPToken* line, int length)
+{
+    static const char* vaArgs = "__VA_ARGS__";
+
+    if (length == 0 || !PPIsName(line))
+    {
+        PPError(ctx, at, "ожидалось имя макроса", 0);
+        return;
+    }
+
+    PPMacro macro = {0};
+    macro.defined = 1;
+
+    int i = 1;
+
+    /*'(' сразу за именем - функциональный макрос*/
+    if (length > 1 && PPIsPunct(&line[1], PUNCT_LPAREN) && !(line[1].flags & PPTOKEN_SPACE))
+    {
+        macro.function = 1;
+        macro.params = malloc(sizeof(PPToken) * length);
+
+        int ok = 1;
+        i = 2;
+
+        /*(a, b, ...), (args...) или ()*/
+        while (ok && !(i < length && PPIsPunct(&line[i], PUNCT_RPAREN) && macro.paramNo == 0))
+        {
+            if (i < length && PPIsPunct(&line[i], PUNCT_ELLIPSIS))
+            {
+                macro.params[macro.paramNo] = line[i];
+                macro.params[macro.paramNo].text = vaArgs;
+                macro.params[macro.paramNo++].length = strlen(vaArgs);
+                macro.variadic = 1;
+                i++;
+            }
+            else if (i < length && PPIsName(&line[i]))
+            {
+                macro.params[macro.paramNo++] = line[i++];
+
+                if (i < length && PPIsPunct(&line[i], PUNCT_ELLIPSIS))
+                {
+                    macro.variadic = 1;
+                    i++;
+                }
+            }
+            else
+                ok = 0;
+
+            if (!ok || (i < length && PPIsPunct(&line[i], PUNCT_RPAREN)))
+                break;
+
+            else if (!macro.variadic && i < length && PPIsPunct(&line[i], PUNCT_COMMA))
+                i++;
+
+            else
+                ok = 0;
+        }
+
+        if (!ok || i >= length || !PPIsPunct(&line[i], PUNCT_RPAREN))
+        {
+            PPError(ctx, i < length ? &line[i] : at, "неверный список параметров макроса", i < length ? &line[i] : 0);
+            free(macro.params);
+            return;
+        }
+
+        i++;
+    }
+
+    macro.body = line + i;
+    macro.length = length - i;
+
+    /*'##' не может стоять с краю, '#' - только перед параметром*/
+    for (int j = 0; j < macro.length; j++)
+    {
+        const PPToken* t = &macro.body[j];
+
+        if (PPIsPunct(t, PUNCT_HASHHASH) && (j == 0 || j == macro.length - 1))
+        {
+            PPError(ctx, t, "'##' не может стоять в начале или конце макроса", 0);
+            free(macro.params);
+            return;
+        }
+        else if (macro.function && PPIsPunct(t, PUNCT_HASH)
+                 && (j == macro.length - 1 || PPParamIndex(&macro, &macro.body[j + 1]) < 0))
+        {
+            PPError(ctx, t, "за '#' должен следовать параметр макроса", 0);
+            free(macro.params);
+            return;
+        }
+    }
+
+    PPMacro* old = PPMacroGet(ctx, line->text, line->length);
+
+    if (old->kind)
+    {
+        PPError(ctx, line, "нельзя переопределить встроенный макрос", line);
+        free(macro.params);
+        return;
+    }
+
+    if (old->defined && !PPMacroEqual(old, &macro))
+    {
+        char buffer[PP_MaxIdentLength];
+        PPDiag(ctx, line, 0, "макрос переопределен", PPTokenStr(line, buffer, sizeof(buffer)));
+    }
+
+    macro.name = old->name;
+    free(old->params);
+    *old = macro;
+}
+
+static void PPDirectiveUndef (PPCTX* ctx, const PPToken* at, const PPToken* line, int length)
+{
+    if (length == 0 || !PPIsName(line))
+    {
+        PPError(ctx, at, "ожидалось имя макроса", 0);
+        return;
+    }
+
+    PPMacro* macro = PPLookup(ctx, line);
+
+    if (macro && macro->kind)
+        PPError(ctx, line, "нельзя удалить встроенный макрос", line);
+
+    else if (macro)
+        macro->defined = 0;
+}
+
+//__FILE__, __LINE__, __DATE__, __TIME__
+static PPToken PPBuiltin (PPCTX* ctx, const PPMacro* macro, const PPToken* at)
+{
+    PPToken t = *at;
+    char buffer[PP_MaxIdentLength + 32];
+
+    t.flags |= PPTOKEN_NOEXPAND;
+    t.hide = 0;
+
+    if (macro->kind == PP_LINE)
+    {
+        t.tag = TOK_INT;
+        t.sub = 0;
+        t.length = sprintf(buffer, "%d", at->line);
+    }
+    else if (macro->kind == PP_FILE)
+    {
+        t.tag = TOK_STR;
+        t.sub = 0;
+        t.length = 0;
+        buffer[t.length++] = '"';
+
+        for (const char* c = FileName(at->file); *c && t.length < (int) sizeof(buffer) - 3; c++)
+        {
+            if (*c == '"' || *c == '\\') buffer[t.length++] = '\\';
+
+            buffer[t.length++] = *c;
+        }
+
+        buffer[t.length++] = '"';
+    }
+    else
+    {
+        time_t now = time(0);
+        const char* format = !strcmp(macro->name, "__TIME__") ? "\"%H:%M:%S\"" : "\"%b %e %Y\"";
+
+        t.tag = TOK_STR;
+        t.sub = 0;
+        t.length = strftime(buffer, sizeof(buffer), format, localtime(&now));
+    }
+
+    t.text = PPPoolStr(ctx, buffer, t.length);
+    return t;
+}
+
+//'#': аргумент как строковая константа
+static PPToken PPStringize (PPCTX* ctx, const PPToken* at, const PPArg* arg)
+{
+    int capacity = 2;
+
+    for (int i = 0; i < arg->length; i++)
+        capacity += arg->tokens[i].length * 2 + 1;
+
+    char* str = malloc(capacity + 1);
+    int length = 0;
+
+    str[length++] = '"';
+
+    for (int i = 0; i < arg->length; i++)
+    {
+        const PPToken* t = &arg->tokens[i];
+
+        if (i && (t->flags & (PPTOKEN_SPACE | PPTOKEN_BOL)))
+            str[length++] = ' ';
+
+        for (int j = 0; j < t->length; j++)
+        {
+            char c = t->text[j];
+
+            if ((t->tag == TOK_STR || t->tag == TOK_CHR) && (c == '"' || c == '\\'))
+                str[length++] = '\\';
+
+            str[length++] = c;
+        }
+    }
+
+    str[length++] = '"';
+    str[length] = 0;
+
+    VectorPush(&ctx->pool, str);
+
+    PPToken t = *at;
+    t.tag = TOK_STR;
+    t.sub = 0;
+    t.text = str;
+    t.length = length;
+    t.hide = 0;
+    return t;
+}
+
+//'##': склейка двух токенов и повторный разбор результата
+static PPToken PPPaste (PPCTX* ctx, const PPToken* l, const PPToken* r)
+{
+    char* text = malloc(l->length + r->length + 1);
+    memcpy(text, l->text, l->length);
+    memcpy(text + l->length, r->text, r->length);
+    text[l->length + r->length] = 0;
+
+    VectorPush(&ctx->pool, text);
+
+    int count;
+    PPToken* tokens = PPLexText(l->file, text, l->length + r->length, &count);
+    PPToken t = *l;
+
+    if (count == 1)
+    {
+        t.tag = tokens[0].tag;
+        t.sub = tokens[0].sub;
+        t.text = text;
+        t.length = l->length + r->length;
+    }
+    else
+        PPDiag(ctx, l, 1, "'##' не дает допустимый токен", text);
+
+    free(tokens);
+    return t;
+}
+
+//раскрыть отрезок токенов целиком, не выходя за его конец
+static PPToken* PPExpandSpan (PPCTX* ctx, const PPToken* tokens, int length, int* count)
+{
+    int barrier = ctx->sources.length;
+    PPTokens list;
+    PPTokensInit(&list, length + 4);
+
+    PPPush(ctx, tokens, length, 0);
+
+    PPToken t;
+
+    while (PPExpand(ctx, &t, barrier))
+        PPTokensPush(&list, &t);
+
+    *count = list.length;
+    return list.buffer;
+}
+
+static const PPToken* PPArgExpanded (PPCTX* ctx, PPArg* arg)
+{
+    if (!arg->done)
+    {
+        arg->expanded = PPExpandSpan(ctx, arg->tokens, arg->length, &arg->expandedLength);
+        arg->done = 1;
+    }
+
+    return arg->expanded;
+}
+
+//подстановка параметров в тело (алгоритм Проссера)
+static void PPSubst (PPCTX* ctx, const PPMacro* macro, const PPToken* name, PPArg* args,
+                     const PPHideSet* hide, PPTokens* out)
+{
+    const PPToken* body = macro->body;
+
+    for (int i = 0; i < macro->length; i++)
+    {
+        const PPToken* t = &body[i];
+        int param = PPParamIndex(macro, t);
+        int pasteNext = i + 1 < macro->length && PPIsPunct(&body[i + 1], PUNCT_HASHHASH);
+        int first = out->length;
+
+        /*# param*/
+        if (macro->function && PPIsPunct(t, PUNCT_HASH))
+        {
+            PPToken str = PPStringize(ctx, t, &args[PPParamIndex(macro, &body[++i])]);
+            PPTokensPush(out, &str);
+        }
+
+        /*GNU: , ## __VA_ARGS__ убирает запятую при пустом остатке*/
+        else if (PPIsPunct(t, PUNCT_COMMA) && pasteNext && macro->variadic && i + 2 < macro->length
+                 && PPParamIndex(macro, &body[i + 2]) == macro->paramNo - 1)
+        {
+            PPArg* rest = &args[macro->paramNo - 1];
+
+            if (rest->length)
+            {
+                PPTokensPush(out, t);
+                PPTokensPushArray(out, rest->tokens, rest->length);
+            }
+
+            i += 2;
+        }
+
+        /*## правый: склеивается с последним выданным токеном*/
+        else if (PPIsPunct(t, PUNCT_HASHHASH))
+        {
+            const PPToken* r = &body[++i];
+            int rparam = PPParamIndex(macro, r);
+            const PPToken* rtokens = rparam >= 0 ? args[rparam].tokens : r;
+            int rlength = rparam >= 0 ? args[rparam].length : 1;
+
+            if (rlength == 0) continue;
+
+            /*левый операнд пуст: правый выдается как есть*/
+            if (out->length == 0)
+                PPTokensPushArray(out, rtokens, rlength);
+
+            else
+            {
+                out->buffer[out->length - 1] = PPPaste(ctx, &out->buffer[out->length - 1], rtokens);
+                PPTokensPushArray(out, rtokens + 1, rlength - 1);
+            }
+
+            first = -1;
+        }
+
+        /*параметр перед ## не раскрывается*/
+        else if (param >= 0 && pasteNext)
+        {
+            if (args[param].length == 0)
+            {
+                /*пустой левый операнд: ## выдаст правый как есть*/
+                const PPToken* r = &body[i + 2];
+                int rparam = PPParamIndex(macro, r);
+
+                if (rparam >= 0) PPTokensPushArray(out, args[rparam].tokens, args[rparam].length);
+                else PPTokensPush(out, r);
+
+                i += 2;
+            }
+            else
+                PPTokensPushArray(out, args[param].tokens, args[param].length);
+        }
+
+        else if (param >= 0)
+        {
+            const PPToken* expanded = PPArgExpanded(ctx, &args[param]);
+            PPTokensPushArray(out, expanded, args[param].expandedLength);
+        }
+
+        else
+            PPTokensPush(out, t);
+
+        /*первый токен подстановки занимает место параметра*/
+        if (first >= 0 && first < out->length)
+            out->buffer[first].flags = (out->buffer[first].flags & ~(PPTOKEN_SPACE | PPTOKEN_BOL))
+                                       | (t->flags & PPTOKEN_SPACE);
+    }
+
+    /*все токены раскрытия указывают на место вызова*/
+    for (int i = 0; i < out->length; i++)
+    {
+        PPToken* t = &out->buffer[i];
+
+        t->hide = PPHideUnion(ctx, t->hide, hide);
+        t->file = name->file;
+        t->line = name->line;
+        t->lineChar = name->lineChar;
+        t->flags &= ~PPTOKEN_BOL;
+    }
+
+    if (out->length)
+        out->buffer[0].flags = (out->buffer[0].flags & ~PPTOKEN_SPACE) | (name->flags & (PPTOKEN_SPACE | PPTOKEN_BOL));
+}
+
+static void PPArgsFree (PPArg* args, int n)
+{
+    for (int i = 0; i < n; i++)
+        free(args[i].expanded);
+
+    free(args);
+}
+
+static void PPDirective (PPCTX* ctx, PPSource* src, const PPToken* hash);
+
+//токен аргумента: директивы внутри вызова макроса тоже выполняются
+static PPSource* PPReadArg (PPCTX* ctx, PPToken* out, int barrier)
+{
+    PPSource* src;
+
+    while ((src = PPRead(ctx, out, barrier)) && src->file && PPIsDirectiveStart(out))
+        PPDirective(ctx, src, out);
+
+    return src;
+}
+
+//аргументы вызова после '('; 0 - ошибка
+static PPArg* PPCollectArgs (PPCTX* ctx, const PPMacro* macro, const PPToken* name, int barrier,
+                             PPTokens* buffer, PPToken* rparen)
+{
+    int n = macro->paramNo > 0 ? macro->paramNo : 1;
+    PPArg* args = calloc(n + 1, sizeof(PPArg));
+    int* starts = calloc(n + 1, sizeof(int));
+
+    int argNo = 0;
+    int depth = 0;
+    PPToken t;
+
+    starts[0] = 0;
+
+    while (1)
+    {
+        if (!PPReadArg(ctx, &t, barrier))
+        {
+            PPError(ctx, name, "незавершенный вызов макроса", name);
+            free(starts);
+            PPArgsFree(args, n + 1);
+            return 0;
+        }
+
+        if (depth == 0 && PPIsPunct(&t, PUNCT_RPAREN))
+            break;
+
+        /*запятая на верхнем уровне разделяет аргументы, кроме остатка variadic*/
+        else if (depth == 0 && PPIsPunct(&t, PUNCT_COMMA) && !(macro->variadic && argNo == n - 1))
+        {
+            if (argNo < n) args[argNo].length = buffer->length - starts[argNo];
+
+            if (++argNo < n) starts[argNo] = buffer->length;
+            continue;
+        }
+
+        if (PPIsPunct(&t, PUNCT_LPAREN)) depth++;
+        else if (PPIsPunct(&t, PUNCT_RPAREN)) depth--;
+
+        if (argNo < n) PPTokensPush(buffer, &t);
+    }
+
+    *rparen = t;
+
+    if (argNo < n) args[argNo].length = buffer->length - starts[argNo];
+
+    argNo++;
+
+    /*пустой остаток variadic можно не передавать*/
+    if (macro->variadic && argNo == n - 1) argNo++;
+
+    /*f() - один пустой аргумент, у макроса без параметров это допустимо*/
+    if (argNo != n || (macro->paramNo == 0 && args[0].length))
+    {
+        PPError(ctx, name, "неверное число аргументов макроса", name);
+        free(starts);
+        PPArgsFree(args, n + 1);
+        return 0;
+    }
+
+    for (int i = 0; i < n; i++)
+        args[i].tokens = buffer->buffer + starts[i];
+
+    free(starts);
+    return args;
+}
+
+static void PPExpandMacro (PPCTX* ctx, const PPMacro* macro, const PPToken* name, PPArg* args, const PPHideSet* hide)
+{
+    PPTokens out;
+    PPTokensInit(&out, macro->length + 4);
+    PPSubst(ctx, macro, name, args, hide, &out);
+
+    if (out.length) PPPush(ctx, out.buffer, out.length, out.buffer);
+    else free(out.buffer);
+}
+
+//следующий полностью раскрытый токен
+static int PPExpand (PPCTX* ctx, PPToken* out, int barrier)
+{
+    while (1)
+    {
+        PPToken t;
+        PPSource* src = PPRead(ctx, &t, barrier);
+
+        if (!src) return 0;
+
+        if (src->file && PPIsDirectiveStart(&t))
+        {
+            PPDirective(ctx, src, &t);
+            continue;
+        }
+
+        PPMacro* macro = !(t.flags & PPTOKEN_NOEXPAND) ? PPLookup(ctx, &t) : 0;
+
+        if (!macro)
+        {
+            *out = t;
+            return 1;
+        }
+
+        if (PPHideHas(t.hide, macro))
+        {
+            t.flags |= PPTOKEN_NOEXPAND;
+            *out = t;
+            return 1;
+        }
+
+        if (macro->kind)
+        {
+            *out = PPBuiltin(ctx, macro, &t);
+            return 1;
+        }
+
+        if (!macro->function)
+        {
+            PPExpandMacro(ctx, macro, &t, 0, PPHideAdd(ctx, t.hide, macro));
+            continue;
+        }
+
+        /*имя функционального макроса без '(' - просто идентификатор*/
+        const PPToken* next = PPPeek(ctx, barrier);
+
+        if (!next || !PPIsPunct(next, PUNCT_LPAREN))
+        {
+            *out = t;
+            return 1;
+        }
+
+        PPToken paren, rparen;
+        PPRead(ctx, &paren, barrier);
+
+        PPTokens buffer;
+        PPTokensInit(&buffer, 16);
+
+        PPArg* args = PPCollectArgs(ctx, macro, &t, barrier, &buffer, &rparen);
+
+        if (args)
+        {
+            const PPHideSet* hide = PPHideAdd(ctx, PPHideIntersect(ctx, t.hide, rparen.hide), macro);
+            PPExpandMacro(ctx, macro, &t, args, hide);
+            PPArgsFree(args, macro->paramNo > 0 ? macro->paramNo + 1 : 2);
+        }
+
+        free(buffer.buffer);
+    }
+}
+
+//--- директивы ---
+//пропустить группу до #elif, #else или #endif того же уровня; '#' остается следующим
+static void PPSkipGroup (PPSource* src)
+{
+    int depth = 0;
+
+    for (; src->pos < src->length; src->pos++)
+    {
+        const PPToken* t = &src->tokens[src->pos];
+
+        if (!PPIsDirectiveStart(t) || src->pos + 1 == src->length || (t[1].flags & PPTOKEN_BOL))
+            continue;
+
+        int directive = PPLookDirective(&t[1]);
+
+        if (directive == PP_IF || directive == PP_IFDEF || directive == PP_IFNDEF)
+            depth++;
+
+        else if (directive == PP_ENDIF && depth-- == 0)
+            return;
+
+        else if ((directive == PP_ELSE || directive == PP_ELIF) && depth == 0)
+            return;
+    }
+}
+
+//условие #if: defined, затем макросы, затем вычисление
+static int PPCondition (PPCTX* ctx, const PPToken* at, const PPToken* line, int length)
+{
+    static const char* one = "1";
+    static const char* zero = "0";
+
+    PPTokens list;
+    PPTokensInit(&list, length + 1);
+
+    for (int i = 0; i < length; i++)
+    {
+        if (!PPIs(&line[i], "defined"))
+        {
+            PPTokensPush(&list, &line[i]);
+            continue;
+        }
+
+        int paren = i + 1 < length && PPIsPunct(&line[i + 1], PUNCT_LPAREN);
+        int name = i + 1 + paren;
+
+        if (name >= length || !PPIsName(&line[name]) || (paren && (name + 1 >= length || !PPIsPunct(&line[name + 1], PUNCT_RPAREN))))
+        {
+            PPError(ctx, &line[i], "неверное использование defined", 0);
+            free(list.buffer);
+            return 0;
+        }
+
+        PPToken value = line[i];
+        value.tag = TOK_INT;
+        value.sub = 0;
+        value.text = PPLookup(ctx, &line[name]) ? one : zero;
+        value.length = 1;
+
+        PPTokensPush(&list, &value);
+        i = name + paren;
+    }
+
+    int count;
+    PPToken* expanded = PPExpandSpan(ctx, list.buffer, list.length, &count);
+
+    long long value = 0;
+    const char* message;
+
+    if (!PPEval(expanded, count, &value, &message))
+    {
+        PPDiag(ctx, at, 1, message, 0);
+        value = 0;
+    }
+
+    free(expanded);
+    free(list.buffer);
+    return value != 0;
+}
+
+static void PPDirectiveIf (PPCTX* ctx, PPSource* src, int directive, const PPToken* at, const PPToken* line, int length)
+{
+    int taking;
+
+    if (directive == PP_IF)
+        taking = PPCondition(ctx, at, line, length);
+
+    else if (length == 0 || !PPIsName(line))
+    {
+        PPError(ctx, at, "ожидалось имя макроса", 0);
+        taking = 0;
+    }
+    else
+        taking = (PPLookup(ctx, line) != 0) == (directive == PP_IFDEF);
+
+    PPCond* cond = malloc(sizeof(PPCond));
+    cond->taken = taking;
+    cond->hadElse = 0;
+    VectorPush(&ctx->conds, cond);
+
+    if (!taking) PPSkipGroup(src);
+}
+
+static void PPDirectiveElse (PPCTX* ctx, PPSource* src, int directive, const PPToken* at, const PPToken* line, int length)
+{
+    if (ctx->conds.length <= src->conds)
+    {
+        PPError(ctx, at, directive == PP_ENDIF ? "#endif без #if" : directive == PP_ELSE ? "#else без #if" : "#elif без #if", 0);
+        return;
+    }
+
+    PPCond* cond = VectorGet(&ctx->conds, ctx->conds.length - 1);
+
+    if (directive == PP_ENDIF)
+    {
+        free(VectorPop(&ctx->conds));
+        return;
+    }
+
+    if (cond->hadElse)
+        PPError(ctx, at, directive == PP_ELSE ? "повторный #else" : "#elif после #else", 0);
+
+    cond->hadElse |= directive == PP_ELSE;
+
+    /*условие #elif вычисляется, только если ни одна ветвь еще не выбрана*/
+    if (!cond->taken && (directive == PP_ELSE || PPCondition(ctx, at, line, length)))
+        cond->taken = 1;
+    else
+        PPSkipGroup(src);
+}
+
+//имя файла из #include "..." или #include <...>
+static char* PPIncludeName (PPCTX* ctx, const PPToken* at, const PPToken* line, int length, int* quoted)
+{
+    if (length == 1 && line->tag == TOK_STR && line->length >= 2)
+    {
+        *quoted = 1;
+        return PPPoolStr(ctx, line->text + 1, line->length - 2);
+    }
+
+    if (length >= 2 && PPIsPunct(line, PUNCT_LT) && PPIsPunct(&line[length - 1], PUNCT_GT))
+    {
+        /*написание собирается из токенов между '<' и '>'*/
+        int capacity = 1;
+
+        for (int i = 1; i < length - 1; i++)
+            capacity += line[i].length + 1;
+
+        char* name = malloc(capacity);
+        int n = 0;
+
+        for (int i = 1; i < length - 1; i++)
+        {
+            if (i > 1 && (line[i].flags & PPTOKEN_SPACE)) name[n++] = ' ';
+
+            memcpy(name + n, line[i].text, line[i].length);
+            n += line[i].length;
+        }
+
+        name[n] = 0;
+        VectorPush(&ctx->pool, name);
+
+        *quoted = 0;
+        return name;
+    }
+
+    PPError(ctx, at, "ожидалось \"файл\" или <файл>", 0);
+    return 0;
+}
+
+//номер найденного файла или -1
+static int PPFindInclude (const PPCTX* ctx, const PPSource* src, const char* name, int quoted)
+{
+    if (name[0] == '/')
+        return FileOpen(name);
+
+    /*"..." сначала ищется рядом с включающим файлом*/
+    for (int i = quoted ? -1 : 0; i < ctx->paths.length; i++)
+    {
+        const char* dir = i < 0 ? FileGet(src->file->id)->dir : VectorGet(&ctx->paths, i);
+        char* path = malloc(strlen(dir) + strlen(name) + 2);
+
+        if (!strcmp(dir, ".")) strcpy(path, name);
+        else sprintf(path, "%s/%s", dir, name);
+
+        int id = FileOpen(path);
+        free(path);
+
+        if (id >= 0) return id;
+    }
+
+    return -1;
+}
+
+//повторно включаемый файл с #pragma once или с определенным макросом
+//защиты пропускается, не разбираясь на токены
+static int PPIncludeSkipped (const PPCTX* ctx, int id)
+{
+    const FileEntry* entry = FileGet(id);
+
+    if (entry->once && IntSetTest(&ctx->entered, id + 1))
+        return 1;
+
+    if (!entry->guard) return 0;
+
+    const PPMacro* macro = HashMapMap(&ctx->macros, entry->guard);
+    return macro && macro->defined;
+}
+
+static void PPDirectiveInclude (PPCTX* ctx, PPSource* src, const PPToken* at, const PPToken* line, int length)
+{
+    int quoted;
+    char* name;
+
+    if (length >= 1 && (line->tag == TOK_STR || PPIsPunct(line, PUNCT_LT)))
+        name = PPIncludeName(ctx, at, line, length, &quoted);
+
+    /*#include МАКРОС*/
+    else
+    {
+        int count;
+        PPToken* expanded = PPExpandSpan(ctx, line, length, &count);
+
+        name = PPIncludeName(ctx, at, expanded, count, &quoted);
+        free(expanded);
+    }
+
+    if (!name) return;
+
+    if (PPFileDepth(ctx) >= PP_MaxIncludeDepth)
+    {
+        PPDiag(ctx, at, 1, "слишком глубокая вложенность #include", name);
+        return;
+    }
+
+    int id = PPFindInclude(ctx, src, name, quoted);
+
+    if (id < 0)
+        PPDiag(ctx, at, 1, "файл не найден", name);
+
+    else if (!PPIncludeSkipped(ctx, id))
+        PPPushFile(ctx, PPGetFile(ctx, id));
+}
+
+static void PPDirectiveLine (PPCTX* ctx, PPSource* src, const PPToken* at, const PPToken* line, int length)
+{
+    int count;
+    PPToken* expanded = line->tag == TOK_INT ? 0 : PPExpandSpan(ctx, line, length, &count);
+
+    if (expanded) line = expanded, length = count;
+
+    if (length == 0 || line->tag != TOK_INT)
+        PPError(ctx, at, "ожидался номер строки", 0);
+
+    else
+    {
+        /*следующая строка файла получает номер из директивы*/
+        int physical = at->line - src->lineDelta;
+        src->lineDelta = atoi(line->text) - (physical + 1);
+
+        if (length >= 2 && line[1].tag == TOK_STR)
+        {
+            char* name = strndup(line[1].text + 1, line[1].length - 2);
+            src->fileId = FileIntern(name);
+            free(name);
+        }
+    }
+
+    free(expanded);
+}
+
+static void PPDirectiveMessage (PPCTX* ctx, int directive, const PPToken* at, const PPToken* line, int length)
+{
+    int capacity = 1;
+
+    for (int i = 0; i < length; i++)
+        capacity += line[i].length + 1;
+
+    char* message = malloc(capacity);
+    int n = 0;
+
+    for (int i = 0; i < length; i++)
+    {
+        if (i) message[n++] = ' ';
+
+        memcpy(message + n, line[i].text, line[i].length);
+        n += line[i].length;
+    }
+
+    message[n] = 0;
+
+    PPDiag(ctx, at, directive == PP_ERROR, directive == PP_ERROR ? "#error" : "#warning", message);
+    free(message);
+}
+
+//строка директивы - отрезок токенов файла до следующего начала строки
+static void PPDirective (PPCTX* ctx, PPSource* src, const PPToken* hash)
+{
+    int end = PPLineEnd(src->tokens, src->length, src->pos);
+
+    const PPToken* line = src->tokens + src->pos;
+    int length = end - src->pos;
+
+    src->pos = end;
+
+    /*пустая директива*/
+    if (length == 0) return;
+
+    PPToken at = *line;
+    at.file = src->fileId;
+    at.line = hash->line;
+
+    int directive = PPLookDirective(line);
+
+    if (directive != PP_LINE || line->tag != TOK_INT)
+        line++, length--;
+
+    switch (directive)
+    {
+        case PP_DEFINE: PPDirectiveDefine(ctx, &at, line, length); break;
+        case PP_UNDEF: PPDirectiveUndef(ctx, &at, line, length); break;
+
+        case PP_IF:
+        case PP_IFDEF:
+        case PP_IFNDEF:
+            PPDirectiveIf(ctx, src, directive, &at, line, length);
+            break;
+
+        case PP_ELIF:
+        case PP_ELSE:
+        case PP_ENDIF:
+            PPDirectiveElse(ctx, src, directive, &at, line, length);
+            break;
+
+        case PP_INCLUDE: PPDirectiveInclude(ctx, src, &at, line, length); break;
+        case PP_LINE: PPDirectiveLine(ctx, src, &at, line, length); break;
+
+        case PP_ERROR:
+        case PP_WARNING:
+            PPDirectiveMessage(ctx, directive, &at, line, length);
+            break;
+
+        /*неизвестные #pragma игнорируются*/
+        case PP_PRAGMA:
+            if (length && PPIs(line, "once")) FileSetOnce(src->file->id);
+
+            break;
+
+        default:
+            PPError(ctx, &at, "неизвестная директива", &at);
+    }
+}
+
+static void PPStart (PPCTX* ctx)
+{
+    ctx->started = 1;
+
+    int id = FileOpen(ctx->input);
+
+    if (id < 0)
+    {
+        PPDiag(ctx, 0, 1, "не удалось открыть файл", ctx->input);
+        return;
+    }
+
+    PPPushFile(ctx, PPGetFile(ctx, id));
+
+    /*определения из командной строки идут до первой строки файла*/
+    if (ctx->predefsLength)
+    {
+        PPPushFile(ctx, PPGetFile(ctx, FileAddText("<command-line>", ctx->predefs, ctx->predefsLength)));
+        ctx->predefs = 0;
+    }
+}
+
+void PPInit (PPCTX* ctx, const char* input)
+{
+    static const struct {
+        const char* name;
+        int kind;
+    } builtins[] = {
+        {"__FILE__", PP_FILE},
+        {"__LINE__", PP_LINE},
+        {"__DATE__", PP_DATE},
+        {"__TIME__", PP_DATE}
+    };
+
+    ctx->input = input;
+    VectorInit(&ctx->paths, 4);
+    ctx->predefs = 0;
+    ctx->predefsLength = 0;
+
+    HashMapInit(&ctx->macros, PP_MapSize);
+    VectorInit(&ctx->files, 8);
+    IntSetInit(&ctx->entered, 16);
+    VectorInit(&ctx->sources, 16);
+    VectorInit(&ctx->conds, 8);
+    VectorInit(&ctx->pool, 64);
+
+    ctx->started = 0;
+    ctx->silent = 0;
+    ctx->errors = 0;
+    ctx->warnings = 0;
+
+    for (int i = 0; i < (int) (sizeof(builtins) / sizeof(*builtins)); i++)
+    {
+        PPMacro* macro = PPMacroGet(ctx, builtins[i].name, strlen(builtins[i].name));
+        macro->kind = builtins[i].kind;
+        macro->defined = 1;
+    }
+
+    PPDefine(ctx, "__STDC__=1");
+    PPDefine(ctx, "__SCC__=1");
+}
+
+void PPFree (PPCTX* ctx)
+{
+    while (ctx->sources.length)
+    {
+        PPSource* src = VectorPop(&ctx->sources);
+        free(src->owned);
+        free(src);
+    }
+
+    VectorFreeObjs(&ctx->paths, free);
+    VectorFreeObjs(&ctx->files, (VectorDtor) PPFileDestroy);
+    IntSetFree(&ctx->entered);
+    VectorFree(&ctx->sources);
+    VectorFreeObjs(&ctx->conds, free);
+    VectorFreeObjs(&ctx->pool, free);
+    HashMapFreeObjs(&ctx->macros, PPMacroKeyDtor, (hashmapValueDtor) PPMacroDestroy);
+    free(ctx->predefs);
+}
+
+void PPAddPath (PPCTX* ctx, const char* dir)
+{
+    VectorPush(&ctx->paths, strdup(dir));
+}
+
+//"NAME", "NAME=value" как у -D
+void PPDefine (PPCTX* ctx, const char* definition)
+{
+    const char* eq = strchr(definition, '=');
+    int nameLength = eq ? eq - definition : (int) strlen(definition);
+    const char* value = eq ? eq + 1 : "1";
+
+    int length = nameLength + strlen(value) + 10;
+    ctx->predefs = realloc(ctx->predefs, ctx->predefsLength + length + 1);
+    ctx->predefsLength += sprintf(ctx->predefs + ctx->predefsLength, "#define %.*s %s\n", nameLength, definition, value);
+}
+
+//текст директив, выполняется вместе с -D перед входным файлом
+void PPPredefine (PPCTX* ctx, const char* text, int length)
+{
+    ctx->predefs = realloc(ctx->predefs, ctx->predefsLength + length + 1);
+    memcpy(ctx->predefs + ctx->predefsLength, text, length);
+    ctx->predefsLength += length;
+    ctx->predefs[ctx->predefsLength] = 0;
+}
+
+//файл уже включался: повторный #include с #pragma once пропускается
+void PPMarkEntered (PPCTX* ctx, int id)
+{
+    IntSetAdd(&ctx->entered, id + 1);
+}
+
+/*макросы директивами #define и #undef, встроенные не выводятся. Пробелы
+  между токенами тела те же, поэтому повторное определение совпадает
+  с исходным (6.10.3p2). Освобождать free*/
+char* PPMacroText (const PPCTX* ctx, int* length)
+{
+    int capacity = PP_MapSize;
+    char* text = malloc(capacity);
+
+    *length = 0;
+
+    for (int i = 0; i < ctx->macros.size; i++)
+    {
+        const PPMacro* macro = ctx->macros.values[i];
+
+        if (!macro || macro->kind) continue;
+
+        int need = strlen(macro->name) + 16;
+
+        for (int j = 0; j < macro->paramNo; j++)
+            need += macro->params[j].length + 4;
+
+        for (int j = 0; j < macro->length; j++)
+            need += macro->body[j].length + 1;
+
+        if (*length + need > capacity)
+            text = realloc(text, capacity = 2*capacity + need);
+
+        char* out = text + *length;
+
+        if (!macro->defined) out += sprintf(out, "#undef %s", macro->name);
+        else
+        {
+            out += sprintf(out, "#define %s", macro->name);
+
+            if (macro->function)
+            {
+                *out++ = '(';
+
+                for (int j = 0; j < macro->paramNo; j++)
+                {
+                    const PPToken* param = &macro->params[j];
+                    int last = macro->variadic && j == macro->paramNo - 1;
+
+                    if (j) *out++ = ',';
+
+                    /*(...) хранится как параметр __VA_ARGS__*/
+                    if (last && param->length == 11 && !memcmp(param->text, "__VA_ARGS__", 11))
+                        out += sprintf(out, "...");
+                    else
+                        out += sprintf(out, "%.*s%s", param->length, param->text, last ? "..." : "");
+                }
+
+                *out++ = ')';
+            }
+
+            for (int j = 0; j < macro->length; j++)
+            {
+                if (j == 0 || (macro->body[j].flags & PPTOKEN_SPACE)) *out++ = ' ';
+
+                memcpy(out, macro->body[j].text, macro->body[j].length);
+                out += macro->body[j].length;
+            }
+        }
+
+        *out++ = '\n';
+        *length = out - text;
+    }
+
+    text[*length] = 0;
+    return text;
+}
+
+int PPNext (PPCTX* ctx, PPToken* token)
+{
+    TimerEnter(TIMER_PREPROCESS, 0);
+
+    if (!ctx->started) PPStart(ctx);
+
+    int found = PPExpand(ctx, token, 0);
+
+    TimerLeave();
+    return found;
+}
@@ -0,0 +1,558 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "..\include\profile.h"
+#include "..\include\ir.h"
+#include "..\include\asm64.h"
+#include "..\include\cache.h"
+#include "..\include\error.h"
+#include "..\include\debug.h"
+#include "..\include\timer.h"
+
+enum {
+    PROFILE_RecordNo = 64,
+    PROFILE_WordSize = 4096     //наибольшая длина имени в файле профиля
+};
+
+//ребра функции: блоки по порядку fn->blocks, у каждого - в порядке succs,
+//последним виртуальное ребро из эпилога в пролог, его поток - число вызовов
+typedef struct ProfileEdges {
+    int n;              //вместе с виртуальным
+    int* from;
+    int* to;
+    int* start;         //первое исходящее ребро блока
+    char* tree;         //ребро остовного дерева, счетчика на нем нет
+} ProfileEdges;
+
+typedef struct ProfileWeighted {
+    long weight;
+    int edge;
+} ProfileWeighted;
+
+//внутренние функции
+static int ProfileCompareWeighted (const void* left, const void* right)
+{
+    const ProfileWeighted *L = left, *R = right;
+
+    if (L->weight != R->weight) return L->weight < R->weight ? 1 : -1;
+    else
+        return L->edge - R->edge;
+}
+
+static int ProfileFind (int* parent, int x)
+{
+    while (parent[x] != x) x = parent[x] = parent[parent[x]];
+
+    return x;
+}
+
+//максимальное остовное дерево по статическим весам: счетчики достаются
+//редким ребрам, виртуальное ребро в дереве всегда
+static void ProfileEdgesInit (ProfileEdges* edges, const IrFN* fn)
+{
+    int blocks = fn->blocks.length, n = 0;
+
+    for (int i = 0; i < blocks; i++)
+        n += ((IrBLOCK*) VectorGet(&fn->blocks, i))->succs.length;
+
+    long* weights = malloc(sizeof(long) * (n + 1));
+    ProfileWeighted* order = malloc(sizeof(ProfileWeighted) * (n + 1));
+    int* parent = malloc(sizeof(int) * blocks);
+
+    edges->n = n + 1;
+    edges->from = malloc(sizeof(int) * (n + 1));
+    edges->to = malloc(sizeof(int) * (n + 1));
+    edges->start = malloc(sizeof(int) * (blocks + 1));
+    edges->tree = calloc(n + 1, sizeof(char));
+
+    IrLayoutEstimate(fn, weights);
+
+    for (int i = 0, e = 0; i < blocks; i++)
+    {
+        const IrBLOCK* block = VectorGet(&fn->blocks, i);
+
+        edges->start[i] = e;
+
+        for (int k = 0; k < block->succs.length; k++, e++)
+        {
+            edges->from[e] = i;
+            edges->to[e] = ((IrBLOCK*) VectorGet(&block->succs, k))->nthChild;
+            order[e] = (ProfileWeighted) {weights[e], e};
+        }
+    }
+
+    edges->start[blocks] = n;
+    edges->from[n] = fn->epilogue->nthChild;
+    edges->to[n] = fn->prologue->nthChild;
+    edges->tree[n] = 1;
+
+    for (int i = 0; i < blocks; i++)
+        parent[i] = i;
+
+    parent[ProfileFind(parent, edges->from[n])] = ProfileFind(parent, edges->to[n]);
+
+    qsort(order, n, sizeof(ProfileWeighted), ProfileCompareWeighted);
+
+    for (int i = 0; i < n; i++)
+    {
+        int e = order[i].edge;
+        int a = ProfileFind(parent, edges->from[e]), b = ProfileFind(parent, edges->to[e]);
+
+        if (a == b) continue;
+
+        parent[a] = b;
+        edges->tree[e] = 1;
+    }
+
+    free(parent);
+    free(order);
+    free(weights);
+}
+
+static void ProfileEdgesFree (ProfileEdges* edges)
+{
+    free(edges->from);
+    free(edges->to);
+    free(edges->start);
+    free(edges->tree);
+}
+
+//форма CFG: при любом изменении счетчики не соответствуют ребрам
+static void ProfileChecksum (const IrFN* fn, char* checksum)
+{
+    Hasher h;
+    HasherInit(&h);
+
+    HasherAddInt(&h, fn->blocks.length);
+
+    for (int i = 0; i < fn->blocks.length; i++)
+    {
+        const IrBLOCK* block = VectorGet(&fn->blocks, i);
+
+        HasherAddInt(&h, block->term ? block->term->tag : TERM_UNDEFINED);
+        HasherAddInt(&h, block->succs.length);
+
+        for (int k = 0; k < block->succs.length; k++)
+            HasherAddInt(&h, ((IrBLOCK*) VectorGet(&block->succs, k))->nthChild);
+    }
+
+    HasherDigest(&h, checksum);
+}
+
+static ProfileRecord* ProfileRecordCreate (const char* module, const char* fn, int n)
+{
+    ProfileRecord* record = malloc(sizeof(ProfileRecord));
+
+    record->key = malloc(strlen(module) + strlen(fn) + 2);
+    sprintf(record->key, "%s %s", module, fn);
+
+    record->module = strdup(module);
+    record->fn = strdup(fn);
+    record->checksum[0] = 0;
+    record->first = 0;
+    record->n = n;
+    record->counters = calloc(n + 1, sizeof(long long));
+    return record;
+}
+
+static void ProfileRecordDestroy (ProfileRecord* record)
+{
+    free(record->key);
+    free(record->module);
+    free(record->fn);
+    free(record->counters);
+    free(record);
+}
+
+static int ProfileCompareRecords (const void* left, const void* right)
+{
+    const ProfileRecord *L = *(ProfileRecord**) left, *R = *(ProfileRecord**) right;
+
+    return strcmp(L->key, R->key);
+}
+
+//поток по ребрам дерева из сохранения потока в каждом блоке: сколько вошло,
+//столько вышло; блок с одним неизвестным ребром его определяет
+static int ProfileSolve (const IrFN* fn, const ProfileEdges* edges, const ProfileRecord* record, long long* flow)
+{
+    int blocks = fn->blocks.length, unknown = 0;
+    char* known = calloc(edges->n, sizeof(char));
+    int* incStart = calloc(blocks + 1, sizeof(int));
+    int* inc = malloc(sizeof(int) * 2 * edges->n);
+    int* work = malloc(sizeof(int) * (blocks + 2 * edges->n));
+    int top = 0;
+
+    for (int e = 0, j = 0; e < edges->n; e++)
+    {
+        if (edges->tree[e]) unknown++;
+        else
+        {
+            flow[e] = record->counters[j++];
+            known[e] = 1;
+        }
+
+        incStart[edges->from[e]]++;
+        incStart[edges->to[e]]++;
+    }
+
+    /*ребра, инцидентные блоку, подряд*/
+    for (int i = 0, sum = 0; i <= blocks; i++)
+    {
+        int count = incStart[i];
+
+        incStart[i] = sum;
+        sum += i < blocks ? count : 0;
+    }
+
+    int* fill = malloc(sizeof(int) * (blocks + 1));
+    memcpy(fill, incStart, sizeof(int) * (blocks + 1));
+
+    for (int e = 0; e < edges->n; e++)
+    {
+        inc[fill[edges->from[e]]++] = e;
+        inc[fill[edges->to[e]]++] = e;
+    }
+
+    free(fill);
+
+    for (int i = 0; i < blocks; i++)
+        work[top++] = i;
+
+    while (top > 0 && unknown > 0)
+    {
+        int b = work[--top], missing = -1, misses = 0;
+        long long balance = 0;  /*вход минус выход по известным ребрам*/
+
+        for (int i = incStart[b]; i < incStart[b + 1]; i++)
+        {
+            int e = inc[i];
+
+            /*петля входит и выходит, в баланс не попадает*/
+            if (edges->from[e] == edges->to[e]) continue;
+
+            if (!known[e])
+            {
+                missing = e;
+                misses++;
+            }
+            else
+                balance += edges->to[e] == b ? flow[e] : -flow[e];
+        }
+
+        if (misses != 1) continue;
+
+        flow[missing] = edges->to[missing] == b ? -balance : balance;
+        known[missing] = 1;
+        unknown--;
+
+        work[top++] = edges->from[missing];
+        work[top++] = edges->to[missing];
+    }
+
+    free(work);
+    free(inc);
+    free(incStart);
+    free(known);
+
+    return unknown == 0;
+}
+
+//счетчики в блоки и ветвления: число выполнений блока - его входящий поток
+static void ProfileApply (IrFN* fn, const ProfileEdges* edges, const long long* flow)
+{
+    for (int i = 0; i < fn->blocks.length; i++)
+        ((IrBLOCK*) VectorGet(&fn->blocks, i))->count = 0;
+
+    for (int e = 0; e < edges->n; e++)
+    {
+        IrBLOCK* to = VectorGet(&fn->blocks, edges->to[e]);
+
+        to->count += flow[e] > 0 ? flow[e] : 0;
+    }
+
+    for (int i = 0; i < fn->blocks.length; i++)
+    {
+        IrBLOCK* block = VectorGet(&fn->blocks, i);
+        IrTERM* term = block->term;
+
+        if (!term || term->tag != TERM_BRANCH || block->succs.length != 2) continue;
+
+        long long first = flow[edges->start[i]], second = flow[edges->start[i] + 1];
+        int trueFirst = VectorGet(&block->succs, 0) == term->ifTrue;
+
+        term->trueCount = trueFirst ? first : second;
+        term->falseCount = trueFirst ? second : first;
+    }
+}
+
+//-fprofile-generate: счетчики на ребрах вне остовного дерева каждой функции
+void ProfileInstrument (IrCTX* ctx, const char* module, const char* output)
+{
+    DebugEnter("ProfileInstrument");
+
+    ProfileModule* profile = malloc(sizeof(ProfileModule));
+
+    profile->name = strdup(module);
+    profile->output = strdup(output);
+    profile->label = malloc(16);
+    sprintf(profile->label, ".P%04X", ctx->labelNo++);
+    VectorInit(&profile->fns, PROFILE_RecordNo);
+    profile->counters = 0;
+
+    for (int i = 0; i < ctx->fns.length; i++)
+    {
+        IrFN* fn = VectorGet(&ctx->fns, i);
+        ProfileEdges edges;
+
+        /*код взят из инкрементальной сборки и уже выдан*/
+        if (fn->code) continue;
+
+        TimerEnterFn(TIMER_PROFILE, fn->name);
+        ProfileEdgesInit(&edges, fn);
+
+        int n = 0;
+        IrBLOCK** from = malloc(sizeof(IrBLOCK*) * edges.n);
+        IrBLOCK** to = malloc(sizeof(IrBLOCK*) * edges.n);
+
+        /*ребра запоминаются до разрезания: новые блоки меняют fn->blocks*/
+        for (int e = 0; e < edges.n; e++)
+        {
+            if (edges.tree[e]) continue;
+
+            from[n] = VectorGet(&fn->blocks, edges.from[e]);
+            to[n++] = VectorGet(&fn->blocks, edges.to[e]);
+        }
+
+        ProfileRecord* record = ProfileRecordCreate(module, fn->name, n);
+
+        ProfileChecksum(fn, record->checksum);
+        record->first = profile->counters;
+
+        /*у блока с одним преемником счетчик в конце, иначе на ребре свой блок*/
+        for (int j = 0; j < n; j++)
+        {
+            IrBLOCK* at = from[j]->succs.length == 1 ? from[j] : IrEdgeSplit(ctx, fn, from[j], to[j]);
+
+            AsmProfileCount(ctx, at, profile->label, profile->counters++);
+        }
+
+        VectorPush(&profile->fns, record);
+
+        free(to);
+        free(from);
+        ProfileEdgesFree(&edges);
+        TimerLeave();
+    }
+
+    IrStaticProfile(ctx, profile);
+
+    DebugLeave();
+}
+
+//-fprofile-use: число выполнений блоков и переходов ветвлений по профилю;
+//возвращает число размеченных функций
+int ProfileAnnotate (IrCTX* ctx, const ProfileData* data, const char* module)
+{
+    DebugEnter("ProfileAnnotate");
+
+    int annotated = 0;
+
+    for (int i = 0; i < ctx->fns.length; i++)
+    {
+        IrFN* fn = VectorGet(&ctx->fns, i);
+        char* key = malloc(strlen(module) + strlen(fn->name) + 2);
+        char checksum[CACHE_KeyLength + 1];
+
+        sprintf(key, "%s %s", module, fn->name);
+
+        const ProfileRecord* record = HashMapMap(&data->records, key);
+
+        free(key);
+
+        if (!record) continue;
+
+        TimerEnterFn(TIMER_PROFILE, fn->name);
+
+        ProfileEdges edges;
+        ProfileEdgesInit(&edges, fn);
+        ProfileChecksum(fn, checksum);
+
+        int counters = 0;
+
+        for (int e = 0; e < edges.n; e++)
+            counters += !edges.tree[e];
+
+        long long* flow = calloc(edges.n, sizeof(long long));
+
+        if (strcmp(checksum, record->checksum) || counters != record->n)
+            ErrorF("$h: $r: профиль функции '$h' устарел и не применяется\n", module, "предупреждение", fn->name);
+
+        else if (ProfileSolve(fn, &edges, record, flow))
+        {
+            ProfileApply(fn, &edges, flow);
+            annotated++;
+        }
+
+        free(flow);
+        ProfileEdgesFree(&edges);
+        TimerLeave();
+    }
+
+    DebugLeave();
+    return annotated;
+}
+
+void ProfileModuleFree (ProfileModule* module)
+{
+    VectorFreeObjs(&module->fns, (VectorDtor) ProfileRecordDestroy);
+    free(module->name);
+    free(module->output);
+    free(module->label);
+    free(module);
+}
+
+//имя в виде слова файла профиля; среда выполнения пишет имена как
+//есть, поэтому в данные модуля они попадают уже в этом виде
+char* ProfileEscape (const char* name)
+{
+    char* escaped = malloc(4*strlen(name) + 1);
+    char* out = escaped;
+
+    for (const unsigned char* c = (const unsigned char*) name; *c; c++)
+    {
+        if (*c <= ' ' || *c == '\\' || *c >= 0x7f) out += sprintf(out, "\\%03o", *c);
+        else
+            *out++ = *c;
+    }
+
+    *out = 0;
+    return escaped;
+}
+
+//обратно к имени, на месте
+static void ProfileUnescape (char* word)
+{
+    char* out = word;
+
+    for (const char* c = word; *c;)
+    {
+        if (c[0] == '\\' && c[1] >= '0' && c[1] <= '3' && c[2] >= '0' && c[2] <= '7' && c[3] >= '0' && c[3] <= '7')
+        {
+            *out++ = (char) ((c[1] - '0')*64 + (c[2] - '0')*8 + (c[3] - '0'));
+            c += 4;
+        }
+        else
+            *out++ = *c++;
+    }
+
+    *out = 0;
+}
+
+//профиль в памяти
+void ProfileInit (ProfileData* data)
+{
+    HashMapInit(&data->records, PROFILE_RecordNo);
+    VectorInit(&data->list, PROFILE_RecordNo);
+}
+
+void ProfileFree (ProfileData* data)
+{
+    VectorFreeObjs(&data->list, (VectorDtor) ProfileRecordDestroy);
+    HashMapFree(&data->records);
+}
+
+//сырой или индексированный профиль; записи одной функции складываются,
+//записи с другой формой CFG отбрасываются. 0 - файл не прочитан
+int ProfileRead (ProfileData* data, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    char module[PROFILE_WordSize], fn[PROFILE_WordSize], checksum[PROFILE_WordSize];
+    int n, ok = 1;
+
+    if (!file) return 0;
+
+    while (ok && fscanf(file, "%4095s", module) == 1)
+    {
+        /*заголовки: сырой перед каждым запуском, индексированный в начале*/
+        if (!strcmp(module, "scc-profraw") || !strcmp(module, "scc-profdata"))
+        {
+            ok = fscanf(file, "%*[^\n]") != EOF || feof(file);
+            continue;
+        }
+
+        if (fscanf(file, "%4095s %4095s %d", fn, checksum, &n) != 3 || n < 0 || strlen(checksum) != CACHE_KeyLength)
+        {
+            ok = 0;
+            break;
+        }
+
+        ProfileUnescape(module);
+        ProfileUnescape(fn);
+
+        ProfileRecord* record = ProfileRecordCreate(module, fn, n);
+        ProfileRecord* existing = HashMapMap(&data->records, record->key);
+
+        strcpy(record->checksum, checksum);
+
+        for (int i = 0; i < n && ok; i++)
+            ok = fscanf(file, "%lld", &record->counters[i]) == 1;
+
+        if (!ok) ProfileRecordDestroy(record);
+        else if (!existing)
+        {
+            HashMapAdd(&data->records, record->key, record);
+            VectorPush(&data->list, record);
+        }
+        else
+        {
+            if (!strcmp(existing->checksum, record->checksum) && existing->n == record->n)
+            {
+                for (int i = 0; i < n; i++)
+                    existing->counters[i] += record->counters[i];
+            }
+            else
+                ErrorF("$h: $r: у функции '$h' разная форма CFG в запусках, запись пропущена\n", path, "предупреждение", fn);
+
+            ProfileRecordDestroy(record);
+        }
+    }
+
+    fclose(file);
+    return ok;
+}
+
+//индексированный профиль: число записей и записи по порядку ключей
+int ProfileWrite (const ProfileData* data, const char* path)
+{
+    FILE* file = fopen(path, "w");
+
+    if (!file) return 1;
+
+    ProfileRecord** sorted = malloc(sizeof(ProfileRecord*) * (data->list.length + 1));
+
+    for (int i = 0; i < data->list.length; i++)
+        sorted[i] = VectorGet(&data->list, i);
+
+    qsort(sorted, data->list.length, sizeof(ProfileRecord*), ProfileCompareRecords);
+
+    fprintf(file, "%s %d\n", PROFILE_DataMagic, data->list.length);
+
+    for (int i = 0; i < data->list.length; i++)
+    {
+        char* module = ProfileEscape(sorted[i]->module);
+        char* fn = ProfileEscape(sorted[i]->fn);
+
+        fprintf(file, "%s %s %s %d", module, fn, sorted[i]->checksum, sorted[i]->n);
+        free(module);
+        free(fn);
+
+        for (int j = 0; j < sorted[i]->n; j++)
+            fprintf(file, " %lld", sorted[i]->counters[j]);
+
+        fputc('\n', file);
+    }
+
+    free(sorted);
+    return fclose(file) != 0;
+}
@@ -1,24 +1,43 @@
 #include "..\include\register.h"
 #include "..\include\debug.h"
+#include "..\include\timer.h"
 
-Register Regs[REG_MAX] = {
+//таблица занятости своя у каждого потока: функция от начала и до конца
+//обрабатывается одним потоком пула
+_Thread_local Register Regs[REG_MAX] = {
     {1, {"undefined", "undefined", "undefined", "undefined"}, 0},
     {1, {"al", "ax", "eax", "rax"}, 0},
-    {1, {"al", "bx", "ebx", "rbx"}, 0},
+    {1, {"bl", "bx", "ebx", "rbx"}, 0},
     {1, {"cl", "cx", "ecx", "rcx"}, 0},
     {1, {"dl", "dx", "edx", "rdx"}, 0},
     {2, {0, "si", "esi", "rsi"}, 0},
     {2, {0, "di", "edi", "rdi"}, 0},
-    {8, {0, 0, 0, "r8"}, 0},
-    {8, {0, 0, 0, "r9"}, 0},
-    {8, {0, 0, 0, "r10"}, 0},
-    {8, {0, 0, 0, "r11"}, 0},
-    {8, {0, 0, 0, "r12"}, 0},
-    {8, {0, 0, 0, "r13"}, 0},
-    {8, {0, 0, 0, "r14"}, 0},
-    {8, {0, 0, 0, "r15"}, 0},
+    {8, {"r8b", "r8w", "r8d", "r8"}, 0},
+    {8, {"r9b", "r9w", "r9d", "r9"}, 0},
+    {8, {"r10b", "r10w", "r10d", "r10"}, 0},
+    {8, {"r11b", "r11w", "r11d", "r11"}, 0},
+    {8, {"r12b", "r12w", "r12d", "r12"}, 0},
+    {8, {"r13b", "r13w", "r13d", "r13"}, 0},
+    {8, {"r14b", "r14w", "r14d", "r14"}, 0},
+    {8, {"r15b", "r15w", "r15d", "r15"}, 0},
     {2, {0, "bp", "ebp", "rbp"}, 0},
-    {2, {0, "sp", "esp", "rsp"}, 0}
+    {2, {0, "sp", "esp", "rsp"}, 0},
+    {4, {0, 0, "xmm0", "xmm0"}, 0},
+    {4, {0, 0, "xmm1", "xmm1"}, 0},
+    {4, {0, 0, "xmm2", "xmm2"}, 0},
+    {4, {0, 0, "xmm3", "xmm3"}, 0},
+    {4, {0, 0, "xmm4", "xmm4"}, 0},
+    {4, {0, 0, "xmm5", "xmm5"}, 0},
+    {4, {0, 0, "xmm6", "xmm6"}, 0},
+    {4, {0, 0, "xmm7", "xmm7"}, 0},
+    {4, {0, 0, "xmm8", "xmm8"}, 0},
+    {4, {0, 0, "xmm9", "xmm9"}, 0},
+    {4, {0, 0, "xmm10", "xmm10"}, 0},
+    {4, {0, 0, "xmm11", "xmm11"}, 0},
+    {4, {0, 0, "xmm12", "xmm12"}, 0},
+    {4, {0, 0, "xmm13", "xmm13"}, 0},
+    {4, {0, 0, "xmm14", "xmm14"}, 0},
+    {4, {0, 0, "xmm15", "xmm15"}, 0}
 };
 
 int RegIsUsed (REG_INDEX r)
@@ -26,6 +45,11 @@ int RegIsUsed (REG_INDEX r)
     return Regs[r].allocatedAs != 0;
 }
 
+int RegIsFloat (REG_INDEX r)
+{
+    return r >= REG_XMM0 && r <= REG_XMM15;
+}
+
 const Register* RegGet (REG_INDEX r)
 {
     return &Regs[r];
@@ -57,16 +81,51 @@ Register* RegAlloc (int size)
     if (size == 0)
         return 0;
 
+    TimerEnter(TIMER_REGALLOC, 0);
+
+    Register* found = 0;
+
     /*Bugger RAX. Functions put their rets in there, so its just a hassle*/
-    for (REG_INDEX r = REG_RBX; r <= REG_R15; r++)
+    for (REG_INDEX r = REG_RBX; r <= REG_R15 && !found; r++)
+        found = RegRequest(r, size);
+
+    if (!found)
     {
-        if (RegRequest(r, size) != 0)
-            return &Regs[r];
+        if (RegIsUsed(REG_RAX)) DebugError("RegAlloc", "no registers left");
+
+        found = RegRequest(REG_RAX, size);
     }
-    
-    if (RegIsUsed(REG_RAX)) DebugError("RegAlloc", "no registers left");
 
-    return RegRequest(REG_RAX, size);
+    TimerLeave();
+    return found;
+}
+
+//XMM регистр для float (4) или double (8). XMM4-5 заняты блочными пересылками,
+//XMM0-7 - аргументы, поэтому сначала XMM8-15
+Register* RegAllocFloat (int size)
+{
+    static const REG_INDEX order[14] = {
+        REG_XMM8, REG_XMM9, REG_XMM10, REG_XMM11, REG_XMM12, REG_XMM13, REG_XMM14, REG_XMM15,
+        REG_XMM6, REG_XMM7, REG_XMM3, REG_XMM2, REG_XMM1, REG_XMM0
+    };
+
+    if (size != 4 && size != 8)
+    {
+        DebugErrorUnhandledInt("RegAllocFloat", "register size", size);
+        return 0;
+    }
+
+    TimerEnter(TIMER_REGALLOC, 0);
+
+    Register* found = 0;
+
+    for (int i = 0; i < 14 && !found; i++)
+        found = RegRequest(order[i], size);
+
+    if (!found) DebugError("RegAllocFloat", "no registers left");
+
+    TimerLeave();
+    return found;
 }
 
 const char* RegIndexGetName (REG_INDEX r, int size)
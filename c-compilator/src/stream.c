@@ -1,34 +1,71 @@
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "..\include\stream.h"
 
-StreamCTX* StreamInit(const char* filename)
+//прочитать файл целиком, 0 - если открыть не удалось
+char* StreamReadFile (const char* filename, int* length)
+{
+    FILE* file = fopen(filename, "rb");
+
+    if (!file) return 0;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* text = malloc(size + 1);
+    size = fread(text, 1, size, file);
+    text[size] = 0;
+
+    fclose(file);
+
+    *length = size;
+    return text;
+}
+
+StreamCTX* StreamInitText (const char* text, int length)
 {
     StreamCTX* ctx = malloc(sizeof(StreamCTX));
-    ctx->file = fopen(filename, "r");
-    
-    ctx->current = 0;
+    ctx->text = text;
+    ctx->length = length;
+    ctx->pos = 0;
+    ctx->owned = 0;
+
+    ctx->current = length > 0 ? text[0] : 0;
     ctx->line = 1;
-    ctx->lineChar = 0;
-    
-    StreamNext(ctx);
+    ctx->lineChar = 1;
+
+    return ctx;
+}
+
+StreamCTX* StreamInit (const char* filename)
+{
+    int length;
+    char* text = StreamReadFile(filename, &length);
+
+    if (!text) return 0;
+
+    StreamCTX* ctx = StreamInitText(text, length);
+    ctx->owned = text;
     
     return ctx;
 }
 
 void StreamEnd (StreamCTX* ctx)
 {
-    fclose(ctx->file);
+    free(ctx->owned);
     free(ctx);
 }
 
 char StreamNext (StreamCTX* ctx)
 {
     char old = ctx->current;
-    ctx->current = fgetc(ctx->file);
 
-    if (feof(ctx->file) || ctx->current == '\255') ctx->current = 0;
+    if (ctx->pos < ctx->length) ctx->pos++;
+
+    ctx->current = ctx->pos < ctx->length ? ctx->text[ctx->pos] : 0;
 
     ctx->lineChar++;
 
@@ -42,23 +79,8 @@ char StreamNext (StreamCTX* ctx)
     return old;
 }
 
-char StreamPrev (StreamCTX* ctx)
+//символ после текущего, без сдвига
+char StreamPeek (const StreamCTX* ctx)
 {
-    char old = ctx->current;
-
-    fseek(ctx->file, -2, SEEK_CUR);
-    StreamNext(ctx);
-
-    ctx->lineChar--;
-
-    if (ctx->current == '\n')
-    {
-        ctx->line--;
-        ctx->lineChar = -1;
-
-    }
-    else if (ctx->current == '\t') ctx->lineChar -= 3;
-
-    return old;
+    return ctx->pos + 1 < ctx->length ? ctx->text[ctx->pos + 1] : 0;
 }
-
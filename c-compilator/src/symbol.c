@@ -32,6 +32,7 @@ Symbol* SymbolCreateType (Symbol* Parent, const char* ident, int size, TYPEMASK_
     Symbol->size = size;
     Symbol->typeMask = typeMask;
     Symbol->complete = 1;
+    Symbol->align = size;
     return Symbol;
 }
 
@@ -76,7 +77,24 @@ const Symbol* SymbolGetNthParam (const Symbol* fn, int n)
     return 0;
 }
 
+static int SymbolInNs (const Symbol* Symbol, SYMBOL_NS ns)
+{
+    int isTag = Symbol->tag == SYMBOL_STRUCT || Symbol->tag == SYMBOL_UNION || Symbol->tag == SYMBOL_ENUM;
+
+    return ns == SYMBOL_NS_ANY || (ns == SYMBOL_NS_TAG) == isTag;
+}
+
 Symbol* SymbolChild (const Symbol* Scope, const char* look)
+{
+    return SymbolChildNs(Scope, look, SYMBOL_NS_ANY);
+}
+
+Symbol* SymbolFind (const Symbol* Scope, const char* look)
+{
+    return SymbolFindNs(Scope, look, SYMBOL_NS_ANY);
+}
+
+Symbol* SymbolChildNs (const Symbol* Scope, const char* look, SYMBOL_NS ns)
 {
 
     for (int n = 0; n < Scope->children.length; n++)
@@ -84,12 +102,12 @@ Symbol* SymbolChild (const Symbol* Scope, const char* look)
         Symbol* Current = VectorGet(&Scope->children, n);
 
         /*Found it?*/
-        if (Current->ident && !strcmp(Current->ident, look)) return Current;
+        if (Current->ident && !strcmp(Current->ident, look) && SymbolInNs(Current, ns)) return Current;
 
         /*Anonymous inside a struct/union?*/
         if (Current->ident && !Current->ident[0] && (Current->parent->tag == SYMBOL_STRUCT || Current->parent->tag == SYMBOL_UNION))
         {
-            Symbol* Found = SymbolChild(Current, look);
+            Symbol* Found = SymbolChildNs(Current, look, ns);
 
             if (Found) return Found;
         }
@@ -97,14 +115,14 @@ Symbol* SymbolChild (const Symbol* Scope, const char* look)
         /*Included module?*/
         if (Current->tag == SYMBOL_MODULELINK)
         {
-            Symbol* Found = SymbolChild(Current->children.buffer[0], look);
+            Symbol* Found = SymbolChildNs(Current->children.buffer[0], look, ns);
 
             if (Found) return Found;
         /*Reparented symbol?*/
         }
         else if (Current->tag == SYMBOL_LINK)
         {
-            Symbol* Found = SymbolChild(Current, look);
+            Symbol* Found = SymbolChildNs(Current, look, ns);
 
             if (Found) return Found;
         }
@@ -113,11 +131,11 @@ Symbol* SymbolChild (const Symbol* Scope, const char* look)
     return 0;
 }
 
-Symbol* SymbolFind (const Symbol* Scope, const char* look)
+Symbol* SymbolFindNs (const Symbol* Scope, const char* look, SYMBOL_NS ns)
 {
     for (;Scope;Scope = Scope->parent)
     {
-        Symbol* Found = SymbolChild(Scope, look);
+        Symbol* Found = SymbolChildNs(Scope, look, ns);
 
         if (Found) return Found;
     }
@@ -179,10 +197,13 @@ static Symbol* SymbolCreate (SYMBOL_TAG tag)
 
     sym->storage = SYMBOL_UNDEFINED;
     sym->dt = 0;
+    sym->alignAs = 0;
 
     sym->size = 0;
     sym->typeMask = TYPEMASK_NONE;
     sym->complete = 0;
+    sym->align = 0;
+    sym->packed = 0;
 
     VectorInit(&sym->children, 4);
     sym->parent = 0;
@@ -0,0 +1,394 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "..\include\timer.h"
+#include "..\include\vector.h"
+
+//замеры фаз компиляции: интервалы вкладываются на стеке своего потока,
+//собственное время фазы - без вложенных. Интервал с detail попадает в
+//трассу, без detail - только в сводку, так замеряются места, через
+//которые проходит каждый токен или регистр
+
+enum {
+    TIMER_MaxDepth = 64,
+    TIMER_EventNo = 1024,
+    TIMER_TopFns = 10
+};
+
+//открытый интервал
+typedef struct TimerFrame {
+    TIMER_PHASE phase;
+    const char* detail;
+    int isFn;
+
+    long long start;        //нс от TimerInit
+    long long child;        //время вложенных интервалов
+    long long heap;         //занятая куча на входе, только с detail
+    long long childHeap;    //прирост кучи во вложенных интервалах с detail
+} TimerFrame;
+
+//закрытый интервал для трассы
+typedef struct TimerEvent {
+    TIMER_PHASE phase;
+    char* detail;
+    int isFn;
+    int tid;
+
+    long long start;
+    long long duration;
+    long long heap;         //прирост занятой кучи, байт
+} TimerEvent;
+
+//время одной функции по фазам, для сводки
+typedef struct TimerFn {
+    const char* name;
+    long long total;
+    long long phases[TIMER_MAX];
+} TimerFn;
+
+typedef struct TimerState {
+    struct timespec origin;
+    int threads;
+
+    Vector events;
+    long long self[TIMER_MAX];  //собственное время, сумма по потокам
+    long long heap[TIMER_MAX];  //собственный прирост кучи
+    long calls[TIMER_MAX];
+} TimerState;
+
+int timerOn = 0;
+
+static TimerState timer;
+static pthread_mutex_t timerLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*у каждого потока свой стек; накопленное без detail сливается в timer
+  при закрытии ближайшего интервала с detail*/
+static _Thread_local TimerFrame stack[TIMER_MaxDepth];
+static _Thread_local int depth, overflow, tid;
+static _Thread_local long long localSelf[TIMER_MAX];
+static _Thread_local long localCalls[TIMER_MAX];
+
+static const char* TimerNames[TIMER_MAX] = {
+    [TIMER_TOTAL] = "компиляция",
+    [TIMER_LEX] = "лексер",
+    [TIMER_PREPROCESS] = "препроцессор",
+    [TIMER_PARSE] = "парсер",
+    [TIMER_ANALYZE] = "анализ",
+    [TIMER_SELECT] = "выбор команд",
+    [TIMER_OPTIMISE] = "оптимизация",
+    [TIMER_PROFILE] = "профиль",
+    [TIMER_REGALLOC] = "регистры",
+    [TIMER_EMIT] = "выдача",
+    [TIMER_PCH] = "pch"
+};
+
+static void TimerPush (TIMER_PHASE phase, const char* detail, int isFn);
+static long long TimerNow (void);
+static long long TimerHeap (void);
+static void TimerEventDestroy (void* event);
+static int TimerCompareNames (const void* left, const void* right);
+static int TimerCompareFns (const void* left, const void* right);
+static void TimerPad (FILE* file, const char* str, int width);
+static void TimerJsonStr (FILE* file, const char* str);
+
+//начало замеров единицы трансляции
+void TimerInit (void)
+{
+    timerOn = 1;
+    clock_gettime(CLOCK_MONOTONIC, &timer.origin);
+    VectorInit(&timer.events, TIMER_EventNo);
+}
+
+void TimerFree (void)
+{
+    if (!timerOn) return;
+
+    VectorFreeObjs(&timer.events, TimerEventDestroy);
+    memset(&timer, 0, sizeof(TimerState));
+    timerOn = 0;
+}
+
+//открыть интервал фазы; detail - имя файла или функции для трассы,
+//0 - интервал только в сводке. Строка detail должна жить до TimerLeave
+void TimerPhaseEnter (TIMER_PHASE phase, const char* detail)
+{
+    TimerPush(phase, detail, 0);
+}
+
+//интервал одной функции: попадает еще и в список самых долгих
+void TimerPhaseEnterFn (TIMER_PHASE phase, const char* fn)
+{
+    TimerPush(phase, fn ? fn : "?", 1);
+}
+
+void TimerPhaseLeave (void)
+{
+    if (!timerOn || (!depth && !overflow)) return;
+
+    if (overflow)
+    {
+        overflow--;
+        return;
+    }
+
+    long long end = TimerNow();
+    TimerFrame* frame = &stack[--depth];
+    long long duration = end - frame->start;
+
+    localSelf[frame->phase] += duration - frame->child;
+    localCalls[frame->phase]++;
+
+    if (depth) stack[depth - 1].child += duration;
+
+    if (!frame->detail) return;
+
+    /*прирост кучи, как и время, вычитается из ближайшего интервала с detail*/
+    long long heap = TimerHeap() - frame->heap;
+
+    for (int i = depth - 1; i >= 0; i--)
+    {
+        if (stack[i].detail)
+        {
+            stack[i].childHeap += heap;
+            break;
+        }
+    }
+
+    TimerEvent* event = malloc(sizeof(TimerEvent));
+
+    event->phase = frame->phase;
+    event->detail = strdup(frame->detail);
+    event->isFn = frame->isFn;
+    event->tid = tid;
+    event->start = frame->start;
+    event->duration = duration;
+    event->heap = heap;
+
+    pthread_mutex_lock(&timerLock);
+
+    VectorPush(&timer.events, event);
+    timer.heap[frame->phase] += heap - frame->childHeap;
+
+    for (int i = 0; i < TIMER_MAX; i++)
+    {
+        timer.self[i] += localSelf[i];
+        timer.calls[i] += localCalls[i];
+        localSelf[i] = 0;
+        localCalls[i] = 0;
+    }
+
+    pthread_mutex_unlock(&timerLock);
+}
+
+//-ftime-report: собственное время и память фаз, самые долгие функции
+void TimerReport (FILE* file)
+{
+    long long sum = 0, wall = 0;
+
+    for (int i = 0; i < TIMER_MAX; i++)
+        sum += timer.self[i];
+
+    for (int i = 0; i < timer.events.length; i++)
+    {
+        const TimerEvent* event = VectorGet(&timer.events, i);
+
+        if (event->phase == TIMER_TOTAL && event->duration > wall) wall = event->duration;
+    }
+
+    fprintf(file, "время компиляции %.3f мс, по фазам - собственное, потоки суммируются:\n", wall / 1e6);
+    fprintf(file, "  ");
+    TimerPad(file, "фаза", 14);
+    TimerPad(file, "мс", 12);
+    TimerPad(file, "%", 8);
+    TimerPad(file, "вызовов", 10);
+    fprintf(file, "куча, КБ\n");
+
+    for (int i = 0; i < TIMER_MAX; i++)
+    {
+        if (!timer.calls[i]) continue;
+
+        fprintf(file, "  ");
+        TimerPad(file, TimerNames[i], 14);
+        fprintf(file, "%-12.3f%-8.1f%-10ld%lld\n", timer.self[i] / 1e6, sum ? 100.0 * timer.self[i] / sum : 0.0,
+                timer.calls[i], timer.heap[i] / 1024);
+    }
+
+    /*интервалы функций по имени, затем суммы по убыванию*/
+    const TimerEvent** fns = malloc(sizeof(TimerEvent*) * (timer.events.length + 1));
+    TimerFn* totals = calloc(timer.events.length + 1, sizeof(TimerFn));
+    int fnNo = 0, totalNo = 0;
+
+    for (int i = 0; i < timer.events.length; i++)
+    {
+        const TimerEvent* event = VectorGet(&timer.events, i);
+
+        if (event->isFn) fns[fnNo++] = event;
+    }
+
+    qsort(fns, fnNo, sizeof(TimerEvent*), TimerCompareNames);
+
+    for (int i = 0; i < fnNo; i++)
+    {
+        if (!totalNo || strcmp(totals[totalNo - 1].name, fns[i]->detail))
+            totals[totalNo++].name = fns[i]->detail;
+
+        totals[totalNo - 1].total += fns[i]->duration;
+        totals[totalNo - 1].phases[fns[i]->phase] += fns[i]->duration;
+    }
+
+    qsort(totals, totalNo, sizeof(TimerFn), TimerCompareFns);
+
+    if (totalNo) fprintf(file, "самые долгие функции:\n");
+
+    for (int i = 0; i < totalNo && i < TIMER_TopFns; i++)
+    {
+        fprintf(file, "  %-24s %10.3f мс (", totals[i].name, totals[i].total / 1e6);
+
+        for (int k = 0, first = 1; k < TIMER_MAX; k++)
+        {
+            if (!totals[i].phases[k]) continue;
+
+            fprintf(file, "%s%s %.3f", first ? "" : ", ", TimerNames[k], totals[i].phases[k] / 1e6);
+            first = 0;
+        }
+
+        fprintf(file, ")\n");
+    }
+
+    free(totals);
+    free(fns);
+
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        fprintf(file, "пиковая память процесса: %ld КБ\n", usage.ru_maxrss);
+}
+
+//-ftime-trace: интервалы в формате Chrome trace event, открываются
+//в chrome://tracing или Perfetto. Возвращает 0 при успехе
+int TimerWriteTrace (const char* filename)
+{
+    FILE* file = fopen(filename, "w");
+
+    if (!file) return 1;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+
+    for (int i = 0; i < timer.events.length; i++)
+    {
+        const TimerEvent* event = VectorGet(&timer.events, i);
+
+        fprintf(file, "{\"name\":");
+        TimerJsonStr(file, TimerNames[event->phase]);
+        fprintf(file, ",\"cat\":\"scc\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"detail\":",
+                event->tid, event->start / 1e3, event->duration / 1e3);
+        TimerJsonStr(file, event->detail);
+        fprintf(file, ",\"heap\":%lld}},\n", event->heap);
+    }
+
+    /*имена потоков: первый - основной, остальные - пул функций*/
+    for (int i = 1; i <= timer.threads; i++)
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}%s\n",
+                i, i == 1 ? "scc" : "worker", i, i < timer.threads ? "," : "");
+
+    fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(file) != 0;
+}
+
+//внутренние функции
+static void TimerPush (TIMER_PHASE phase, const char* detail, int isFn)
+{
+    if (!timerOn) return;
+
+    if (depth == TIMER_MaxDepth)
+    {
+        overflow++;
+        return;
+    }
+
+    if (!tid)
+    {
+        pthread_mutex_lock(&timerLock);
+        tid = ++timer.threads;
+        pthread_mutex_unlock(&timerLock);
+    }
+
+    TimerFrame* frame = &stack[depth++];
+
+    frame->phase = phase;
+    frame->detail = detail;
+    frame->isFn = isFn;
+    frame->child = 0;
+    frame->childHeap = 0;
+    frame->heap = detail ? TimerHeap() : 0;
+
+    /*последним, чтобы опрос кучи не входил в интервал*/
+    frame->start = TimerNow();
+}
+
+static long long TimerNow (void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - timer.origin.tv_sec) * 1000000000ll + now.tv_nsec - timer.origin.tv_nsec;
+}
+
+//занятая куча процесса; при нескольких потоках приросты интервалов
+//перекрываются и верны лишь приблизительно
+static long long TimerHeap (void)
+{
+    struct mallinfo2 info = mallinfo2();
+    return (long long) (info.uordblks + info.hblkhd);
+}
+
+static void TimerEventDestroy (void* event)
+{
+    free(((TimerEvent*) event)->detail);
+    free(event);
+}
+
+static int TimerCompareNames (const void* left, const void* right)
+{
+    const TimerEvent *L = *(const TimerEvent**) left, *R = *(const TimerEvent**) right;
+    return strcmp(L->detail, R->detail);
+}
+
+static int TimerCompareFns (const void* left, const void* right)
+{
+    const TimerFn *L = left, *R = right;
+
+    if (L->total != R->total) return L->total < R->total ? 1 : -1;
+    else
+        return strcmp(L->name, R->name);
+}
+
+//строка с дополнением пробелами до width символов UTF-8
+static void TimerPad (FILE* file, const char* str, int width)
+{
+    int length = 0;
+
+    for (const char* c = str; *c; c++)
+        length += (*c & 0xC0) != 0x80;
+
+    fprintf(file, "%s%*s", str, width > length ? width - length : 0, "");
+}
+
+static void TimerJsonStr (FILE* file, const char* str)
+{
+    fputc('"', file);
+
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\') fprintf(file, "\\%c", *str);
+        else if ((unsigned char) *str < 0x20) fprintf(file, "\\u%04x", *str);
+        else
+            fputc(*str, file);
+    }
+
+    fputc('"', file);
+}
@@ -0,0 +1,303 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "..\include\token-buffer.h"
+#include "..\include\file.h"
+
+enum {
+    TOKEN_Chunk = 4096,     //токенов за одно обращение к лексеру
+    TOKEN_MaxSources = 0xffff,
+    TOKEN_MapSize = 16
+};
+
+//внутренние функции
+static int TokenSourceHas (const TokenSource* source, const char* text, int length)
+{
+    uintptr_t begin = (uintptr_t) source->text, at = (uintptr_t) text;
+
+    return source->text && at >= begin && at + length <= begin + source->length;
+}
+
+static int TokenBufferAddSource (TokenBuffer* buffer, const char* text, int length)
+{
+    if (buffer->sourceNo == TOKEN_MaxSources) return 0;
+
+    if (buffer->sourceNo == buffer->sourceCapacity)
+    {
+        buffer->sourceCapacity *= 2;
+        buffer->sources = realloc(buffer->sources, buffer->sourceCapacity*sizeof(TokenSource));
+        buffer->order = realloc(buffer->order, buffer->sourceCapacity*sizeof(int));
+    }
+
+    /*order остается упорядоченным: вставка на место*/
+    int at = buffer->sourceNo - 1;
+
+    for (; at > 0 && (uintptr_t) buffer->sources[buffer->order[at - 1]].text > (uintptr_t) text; at--)
+        buffer->order[at] = buffer->order[at - 1];
+
+    buffer->order[at] = buffer->sourceNo;
+    buffer->sources[buffer->sourceNo] = (TokenSource) {text, length};
+    return buffer->sourceNo++;
+}
+
+//буфер файла file, добавляется при первом обращении; 0 - у файла нет текста
+static int TokenBufferFileSource (TokenBuffer* buffer, int file)
+{
+    int source = (intptr_t) IntMapMap(&buffer->fileSource, file + 2);
+
+    if (source) return source;
+
+    const FileEntry* entry = file >= 0 ? FileGet(file) : 0;
+    const StreamCTX* stream = buffer->lexer->stream;
+
+    if (entry && entry->text) source = TokenBufferAddSource(buffer, entry->text, entry->length);
+    else if (!entry && stream) source = TokenBufferAddSource(buffer, stream->text, stream->length);
+
+    if (source) IntMapAdd(&buffer->fileSource, file + 2, (void*) (intptr_t) source);
+
+    return source;
+}
+
+//двоичный поиск по адресу: буферы не пересекаются, так что текст может
+//лежать только в последнем из начинающихся не позже него
+static int TokenBufferSearch (const TokenBuffer* buffer, const char* text, int length)
+{
+    int lo = 0, hi = buffer->sourceNo - 1;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+
+        if ((uintptr_t) buffer->sources[buffer->order[mid]].text <= (uintptr_t) text) lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    int source = lo ? buffer->order[lo - 1] : 0;
+
+    return source && TokenSourceHas(&buffer->sources[source], text, length) ? source : 0;
+}
+
+//номер буфера, в котором лежит текст токена; 0 - не нашлось
+static int TokenBufferFindSource (TokenBuffer* buffer, const char* text, int length, int file)
+{
+    /*обычно это файл самого токена*/
+    int source = TokenBufferFileSource(buffer, file);
+
+    if (source && TokenSourceHas(&buffer->sources[source], text, length)) return source;
+
+    /*тело макроса из другого файла*/
+    if ((source = TokenBufferSearch(buffer, text, length))) return source;
+
+    /*файл, токенов из которого еще не было: таблица просматривается
+      только один раз, каждый файл добавляется в sources*/
+    if (buffer->fileNo == FileCount()) return 0;
+
+    for (; buffer->fileNo < FileCount(); buffer->fileNo++)
+        TokenBufferFileSource(buffer, buffer->fileNo);
+
+    return TokenBufferSearch(buffer, text, length);
+}
+
+//написание, созданное препроцессором (# и ##), копируется в пул
+static int TokenBufferPool (TokenBuffer* buffer, const char* text, int length)
+{
+    if (buffer->poolLength + length > buffer->poolCapacity)
+    {
+        buffer->poolCapacity = 2*buffer->poolCapacity + length;
+        buffer->pool = realloc(buffer->pool, buffer->poolCapacity);
+    }
+
+    int offset = buffer->poolLength;
+
+    if (length) memcpy(buffer->pool + offset, text, length);
+    buffer->poolLength += length;
+    return offset;
+}
+
+static void TokenBufferPush (TokenBuffer* buffer, const LexerCTX* lexer)
+{
+    if (buffer->length == buffer->capacity)
+    {
+        buffer->capacity *= 2;
+        buffer->tokens = realloc(buffer->tokens, buffer->capacity*sizeof(Token));
+    }
+
+    Token* token = &buffer->tokens[buffer->length];
+
+    token->tag = lexer->token;
+    token->sub = lexer->token == TOK_KEYWORD ? (int) lexer->keyword
+               : lexer->token == TOK_PUNCT ? (int) lexer->punct : 0;
+    token->flags = (lexer->bol ? TOKEN_BOL : 0) | (lexer->space ? TOKEN_SPACE : 0);
+    token->lineChar = lexer->lineChar;
+    token->length = lexer->textLength;
+
+    token->source = TokenBufferFindSource(buffer, lexer->text, lexer->textLength, lexer->file);
+    token->offset = token->source ? lexer->text - buffer->sources[token->source].text
+                                  : TokenBufferPool(buffer, lexer->text, lexer->textLength);
+
+    /*строки - приращениями, при смене файла - отметка с абсолютной строкой*/
+    if (buffer->length == 0 || lexer->file != buffer->lastFile)
+    {
+        if (buffer->markNo == buffer->markCapacity)
+        {
+            buffer->markCapacity *= 2;
+            buffer->marks = realloc(buffer->marks, buffer->markCapacity*sizeof(TokenMark));
+        }
+
+        buffer->marks[buffer->markNo++] = (TokenMark) {buffer->length, lexer->file};
+        token->flags |= TOKEN_FILE;
+        token->lineDelta = lexer->line;
+    }
+    else
+        token->lineDelta = lexer->line - buffer->lastLine;
+
+    buffer->lastFile = lexer->file;
+    buffer->lastLine = lexer->line;
+    buffer->length++;
+}
+
+//прочитать у лексера следующий кусок; после TOK_EOF лексер не трогается
+static int TokenBufferFill (TokenBuffer* buffer)
+{
+    if (buffer->length && buffer->tokens[buffer->length - 1].tag == TOK_EOF) return 0;
+
+    for (int i = 0; i < TOKEN_Chunk; i++)
+    {
+        LexerNext(buffer->lexer);
+        TokenBufferPush(buffer, buffer->lexer);
+
+        if (buffer->lexer->token == TOK_EOF) break;
+    }
+
+    return 1;
+}
+
+//позиция текущего токена из приращений
+static void TokenBufferApply (TokenBuffer* buffer)
+{
+    const Token* token = &buffer->tokens[buffer->pos];
+
+    if (token->flags & TOKEN_FILE)
+    {
+        buffer->file = buffer->marks[buffer->mark++].file;
+        buffer->line = token->lineDelta;
+    }
+    else
+        buffer->line += token->lineDelta;
+}
+
+void TokenBufferInit (TokenBuffer* buffer, LexerCTX* lexer)
+{
+    buffer->lexer = lexer;
+
+    buffer->length = 0;
+    buffer->capacity = TOKEN_Chunk;
+    buffer->tokens = malloc(buffer->capacity*sizeof(Token));
+
+    buffer->markNo = 0;
+    buffer->markCapacity = TOKEN_MapSize;
+    buffer->marks = malloc(buffer->markCapacity*sizeof(TokenMark));
+
+    /*источник 0 - пул, его адрес меняется при росте*/
+    buffer->sourceNo = 1;
+    buffer->sourceCapacity = TOKEN_MapSize;
+    buffer->sources = malloc(buffer->sourceCapacity*sizeof(TokenSource));
+    buffer->order = malloc(buffer->sourceCapacity*sizeof(int));
+    buffer->sources[0] = (TokenSource) {0, 0};
+    IntMapInit(&buffer->fileSource, TOKEN_MapSize);
+    buffer->fileNo = 0;
+
+    buffer->pool = 0;
+    buffer->poolLength = 0;
+    buffer->poolCapacity = 0;
+
+    buffer->pos = 0;
+    buffer->file = -1;
+    buffer->line = 0;
+    buffer->mark = 0;
+    buffer->lastFile = -1;
+    buffer->lastLine = 0;
+
+    TokenBufferFill(buffer);
+    TokenBufferApply(buffer);
+}
+
+void TokenBufferFree (TokenBuffer* buffer)
+{
+    free(buffer->tokens);
+    free(buffer->marks);
+    free(buffer->sources);
+    free(buffer->order);
+    free(buffer->pool);
+    IntMapFree(&buffer->fileSource);
+}
+
+//k-й токен после текущего, за концом - TOK_EOF; указатель
+//действителен до следующего обращения к буферу
+const Token* TokenBufferPeek (TokenBuffer* buffer, int k)
+{
+    while (buffer->pos + k >= buffer->length)
+        if (!TokenBufferFill(buffer)) return &buffer->tokens[buffer->length - 1];
+
+    return &buffer->tokens[buffer->pos + k];
+}
+
+void TokenBufferNext (TokenBuffer* buffer)
+{
+    if (buffer->tokens[buffer->pos].tag == TOK_EOF) return;
+
+    TokenBufferPeek(buffer, 1);
+    buffer->pos++;
+    TokenBufferApply(buffer);
+}
+
+//возврат к уже прочитанному токену pos со строкой line; файл
+//восстанавливается по отметкам смены файла
+void TokenBufferSeek (TokenBuffer* buffer, int pos, int line)
+{
+    int lo = 0, hi = buffer->markNo;
+
+    /*mark - число отметок с index <= pos*/
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+
+        if (buffer->marks[mid].index <= pos) lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    buffer->pos = pos;
+    buffer->line = line;
+    buffer->mark = lo;
+    buffer->file = lo ? buffer->marks[lo - 1].file : -1;
+}
+
+//написание без завершающего нуля, длина - token->length
+const char* TokenBufferText (const TokenBuffer* buffer, const Token* token)
+{
+    if (token->length == 0) return "";
+
+    return (token->source ? buffer->sources[token->source].text : buffer->pool) + token->offset;
+}
+
+//копия в виде, который выдавал LexerCTX.buffer: у строк и символов без кавычек
+char* TokenBufferDup (const TokenBuffer* buffer, const Token* token)
+{
+    const char* text = TokenBufferText(buffer, token);
+    int length = token->length;
+
+    if ((token->tag == TOK_STR || token->tag == TOK_CHR) && length > 0)
+    {
+        int closed = length >= 2 && text[length - 1] == text[0];
+
+        text++;
+        length -= closed ? 2 : 1;
+    }
+
+    char* str = malloc(length + 1);
+    memcpy(str, text, length);
+    str[length] = 0;
+    return str;
+}
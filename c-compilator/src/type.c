@@ -185,6 +185,21 @@ int TypeGetSize (const Arch* arch, const Type* dt)
     }
 }
 
+//выравнивание в памяти; void и неполные типы - 1
+int TypeGetAlign (const Arch* arch, const Type* dt)
+{
+    dt = TypeTryThroughTypedef(dt);
+
+    if (TypeIsInvalid(dt)) return 1;
+    else if (TypeIsArray(dt)) return TypeGetAlign(arch, dt->base);
+    else if (TypeIsPtr(dt) || TypeIsFunction(dt)) return arch->wordsize;
+    else
+    {
+        assert(TypeIsBasic(dt));
+        return dt->basic->align > 0 ? dt->basic->align : 1;
+    }
+}
+
 char* TypeToStr (const Type* dt)
 {
     return TypeToStrEmbed(dt, "");
@@ -500,8 +515,8 @@ int TypeIsCompatible (const Type* dt, const Type* Model)
     {
         if (TypeIsPtr(dt))
             return Model->basic->typeMask & TYPEMASK_NUMERIC;
-        else if (Model->basic->typeMask == TYPEMASK_INTEGRAL)
-            return dt->tag == TYPE_BASIC && dt->basic->typeMask == TYPEMASK_INTEGRAL;
+        else if ((Model->basic->typeMask & TYPEMASK_INTEGRAL) == TYPEMASK_INTEGRAL)
+            return dt->tag == TYPE_BASIC && (dt->basic->typeMask & TYPEMASK_INTEGRAL) == TYPEMASK_INTEGRAL;
         else
             return dt->tag == TYPE_BASIC && dt->basic == Model->basic;
     }